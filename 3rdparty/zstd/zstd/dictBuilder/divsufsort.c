@@ -39,6 +39,9 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#ifdef LIBBSC_OPENMP
+#include <omp.h>
+#endif
 
 #include "divsufsort.h"
 
@@ -23,6 +23,49 @@ namespace terark {
     ASSERT_TRUE(strVec.lower_bound("4") == 4);
     ASSERT_TRUE(strVec.lower_bound("0") == 0);
   }
+  static void check_sort_radix(size_t num, size_t threads) {
+    std::mt19937_64 rnd(num);
+    SortableStrVec strVec;
+    std::string str;
+    for (size_t i = 0; i < num; ++i) {
+      // long common prefixes, duplicates and prefix of each other
+      str.assign(rnd() % 3 ? "user_key_" : "");
+      size_t len = rnd() % 12;
+      for (size_t j = 0; j < len; ++j)
+        str.push_back(char('a' + rnd() % 4));
+      strVec.push_back(str);
+    }
+    valvec<SortableStrVec::SEntry> expected = strVec.m_index;
+    const byte_t* pool = strVec.m_strpool.data();
+    std::stable_sort(expected.begin(), expected.end(),
+      [pool](const SortableStrVec::SEntry& x, const SortableStrVec::SEntry& y) {
+        return fstring(pool + x.offset, x.length) < fstring(pool + y.offset, y.length);
+      });
+    valvec<uint32_t> lcp;
+    strVec.sort_radix(&lcp, threads);
+    ASSERT_EQ(strVec.size(), num);
+    ASSERT_EQ(lcp.size(), num);
+    for (size_t i = 0; i < num; ++i) {
+      ASSERT_EQ(strVec.nth_seq_id(i), size_t(expected[i].seq_id)); // stable
+      if (i == 0) {
+        ASSERT_EQ(lcp[i], 0u);
+      } else {
+        fstring x = strVec[i-1], y = strVec[i];
+        size_t k = 0;
+        while (k < x.size() && k < y.size() && x[k] == y[k]) k++;
+        ASSERT_EQ(lcp[i], k);
+      }
+    }
+  }
+
+  TEST(SORTABLE_STRVEC_TEST, SORT_RADIX) {
+    check_sort_radix(0, 1);
+    check_sort_radix(1, 1);
+    check_sort_radix(1000, 1);
+    check_sort_radix(200000, 1);
+    check_sort_radix(200000, 4);
+  }
+
   /**
    * Helper function equivelent to std::lower_bound
    */
@@ -19,7 +19,7 @@ class MyTask : public PipelineTask
 public:
 	int val;
 
-	MyTask(int x) : val(x) {}
+	MyTask(int x) : val(x) { plbytes = 1000; }
 };
 
 class GeneratorStep : public PipelineStage
@@ -69,8 +69,18 @@ public:
 		PipelineLockGuard lock(*step->getMutex());
 		printf("step2: threadno=%d plserial=%06lu\n", threadno, task->plserial);
 	}
+	unsigned long serial3;
+	size_t maxInflightBytes;
+	PipelineProcessor* pipeline;
 	void step3(PipelineStage* step, int threadno, PipelineQueueItem* task)
 	{
+		// step3 is a keep-serial step
+		TERARK_RT_assert(serial3 == task->plserial, std::runtime_error);
+		serial3++;
+		if (maxInflightBytes) {
+			TERARK_RT_assert(pipeline->getInflightBytes() <= maxInflightBytes, std::runtime_error);
+			TERARK_RT_assert(step->getInputQueueBytes() <= maxInflightBytes, std::runtime_error);
+		}
 		if (!G_bPrint) return;
 		PipelineLockGuard lock(*step->getMutex());
 		printf("step3: threadno=%d plserial=%06lu\n", threadno, task->plserial);
@@ -117,13 +127,26 @@ public:
 		G_bPrint = argc >= 2 ? atoi(argv[1]) : 0;
 		maxNum = argc >= 3 ? atoi(argv[2]) : TERARK_IF_DEBUG(10000, 50000);
 		int bcompile = argc >= 4 ? atoi(argv[3]) : 1;
-		int err1 = run_test(EUType::thread, 3, bcompile);
-		int err2 = run_test(EUType::fiber , 0, bcompile);
-		int err3 = run_test(EUType::mixed , 3, bcompile);
-		return err1 + err2 + err3;
+		int err1 = run_test(EUType::thread, 3, bcompile, false, 0);
+		int err2 = run_test(EUType::fiber , 0, bcompile, false, 0);
+		int err3 = run_test(EUType::mixed , 3, bcompile, false, 0);
+		int err4 = run_test(EUType::thread, 1, bcompile, true , 0);
+		int err5 = run_test(EUType::thread, 1, bcompile, false, 3);
+		int err6 = run_test(EUType::thread, 1, bcompile, true , 3);
+		int err7 = run_test(EUType::thread, 1, bcompile, false, 0, 10000);
+		int err8 = run_test(EUType::fiber , 0, bcompile, false, 0, 10000);
+		int err9 = run_test(EUType::thread, 1, bcompile, true , 3, 10000);
+		return err1 + err2 + err3 + err4 + err5 + err6 + err7 + err8 + err9;
     }
-    int run_test(EUType euType, int logLevel, int bcompile) {
+    int run_test(EUType euType, int logLevel, int bcompile, bool lockFree,
+                 int poolThreads, size_t maxBytes = 0) {
 		PipelineProcessor pipeline;
+		serial3 = 1;
+		maxInflightBytes = maxBytes;
+		this->pipeline = &pipeline;
+		pipeline.setMaxInflightBytes(maxBytes); // 10 tasks
+		pipeline.setLockFreeQueue(lockFree);
+		pipeline.setSharedPool(poolThreads);
 		pipeline.setLogLevel(logLevel);
 		pipeline.setQueueTimeout(1);
 		pipeline.setQueueSize(4); // small queue is likely full
@@ -161,8 +184,20 @@ public:
 			pipeline.compile();
 
 			// corresponding to GeneratorStep
-			for (unsigned long i = 0; i < maxNum; ++i)
-				pipeline.enqueue(new MyTask(i+2)); // send to the pipeline
+			if (lockFree) {
+				// batch enqueue, batch size is larger than queue size
+				PipelineTask* tasks[7];
+				for (unsigned long i = 0; i < maxNum; ) {
+					size_t n = std::min<unsigned long>(7, maxNum - i);
+					for (size_t j = 0; j < n; ++j, ++i)
+						tasks[j] = new MyTask(i+2);
+					pipeline.enqueue(tasks, n);
+				}
+			}
+			else {
+				for (unsigned long i = 0; i < maxNum; ++i)
+					pipeline.enqueue(new MyTask(i+2)); // send to the pipeline
+			}
 			pipeline.stop(); // just set stop flag
 			pipeline.wait(); // wait for all pending items to be processed
 		} else {
@@ -174,8 +209,12 @@ public:
 			pipeline.wait();
 		}
 		long long t1 = pf.now();
-		fprintf(stderr, "%s pipeline test passed, time=%ld'us, average=%f'us\n",
-		        modeName, (long)pf.us(t0, t1), (double)pf.ns(t0, t1)/1000/maxNum);
+		TERARK_RT_assert(serial3 == maxNum + 1, std::runtime_error);
+		TERARK_RT_assert(pipeline.getInflightBytes() == 0, std::runtime_error);
+		fprintf(stderr, "%s%s%s%s pipeline test passed, time=%ld'us, average=%f'us\n",
+		        modeName, lockFree ? "(lockfree)" : "", poolThreads ? "(pool)" : "",
+		        maxBytes ? "(budget)" : "",
+		        (long)pf.us(t0, t1), (double)pf.ns(t0, t1)/1000/maxNum);
 		return 0;
 	}
 };
@@ -13,6 +13,15 @@
 #include "zbs_mixed_len.hpp"
 
 #include <terark/zbs/mixed_len_blob_store.hpp>
+#include <terark/zbs/zip_offset_blob_store.hpp>
+#include <terark/zbs/plain_blob_store.hpp>
+#include <terark/zbs/entropy_zip_blob_store.hpp>
+#include <terark/zbs/zstd_block_blob_store.hpp>
+#include <terark/zbs/zip_reorder_map.hpp>
+#include <terark/zbs/blob_store_row_cache.hpp>
+#include <terark/zbs/lru_page_cache.hpp>
+#include <terark/util/hugepage.hpp>
+#include <terark/util/mmap.hpp>
 
 // inline void print_bytes(const std::string &str) {
 //   const char *c = str.c_str();
@@ -213,3 +222,699 @@ TEST(ZBS_TEST, MIXED_LEN_BLOB_STORE) {
 
   // Read Data and Validate
 }
+
+/// get_records and pread_records(with and without LruReadonlyCache) must
+/// return the same records as single get_record calls
+static void check_batch_get_records(const std::string& fname,
+                                    const std::vector<std::string>& records) {
+  std::unique_ptr<terark::AbstractBlobStore> store;
+  store.reset(terark::AbstractBlobStore::load_from_mmap(fname, false));
+  ASSERT_EQ(store->num_records(), records.size());
+
+  std::mt19937 gen(5678);
+  std::vector<size_t> ids;
+  for (int i = 0; i < 1000; ++i) {
+    ids.push_back(gen() % records.size());
+  }
+  for (size_t i = 0; i < 100; ++i) {
+    ids.push_back(i); // contiguous run
+  }
+  std::vector<valvec<byte_t>> expected(ids.size());
+  for (size_t i = 0; i < ids.size(); ++i) {
+    store->get_record(ids[i], &expected[i]);
+    ASSERT_EQ(fstring(expected[i]), fstring(records[ids[i]])) << fname;
+  }
+  std::vector<valvec<byte_t>> recs(ids.size());
+  store->get_records(ids.data(), ids.size(), recs.data());
+  for (size_t i = 0; i < ids.size(); ++i) {
+    ASSERT_EQ(fstring(recs[i]), fstring(expected[i])) << fname;
+  }
+  int fd = ::open(fname.c_str(), O_RDONLY);
+  ASSERT_GE(fd, 0);
+  std::vector<valvec<byte_t>> recs2(ids.size());
+  store->pread_records(NULL, fd, 0, ids.data(), ids.size(), recs2.data());
+  for (size_t i = 0; i < ids.size(); ++i) {
+    ASSERT_EQ(fstring(recs2[i]), fstring(expected[i])) << fname;
+  }
+  std::unique_ptr<terark::LruReadonlyCache> cache(
+      terark::LruReadonlyCache::create(4 << 20, 2, 16, false));
+  intptr_t fi = cache->open(fd);
+  for (int pass = 0; pass < 2; ++pass) { // miss, then hit
+    std::vector<valvec<byte_t>> recs3(ids.size());
+    store->pread_records(cache.get(), fi, 0, ids.data(), ids.size(), recs3.data());
+    for (size_t i = 0; i < ids.size(); ++i) {
+      ASSERT_EQ(fstring(recs3[i]), fstring(expected[i])) << fname;
+    }
+  }
+  cache->close(fi);
+  ::close(fd);
+  store.reset();
+  ::remove(fname.c_str());
+}
+
+TEST(ZBS_TEST, BATCH_GET_RECORDS) {
+  const int total_records = 10000;
+  std::vector<std::string> records;
+  size_t content_size = 0;
+  terark::freq_hist_o1 freq;
+  std::mt19937 gen(1234);
+  for (int i = 0; i < total_records; ++i) {
+    std::string rec;
+    for (size_t j = 0, n = gen() % 200; j < n; ++j) {
+      rec.push_back(char('a' + (i + j % 7 + gen() % 3) % 26));
+    }
+    content_size += rec.size();
+    freq.add_record(rec);
+    records.push_back(std::move(rec));
+  }
+  freq.finish();
+  {
+    std::string fname = "zip_offset_blob_store.batch.test.zbs";
+    terark::ZipOffsetBlobStore::Options opt;
+    terark::ZipOffsetBlobStore::MyBuilder builder(fname, 0, opt);
+    for (auto& rec : records) builder.addRecord(rec);
+    builder.finish();
+    check_batch_get_records(fname, records);
+  }
+  {
+    std::string fname = "plain_blob_store.batch.test.zbs";
+    terark::PlainBlobStore::MyBuilder builder(content_size, total_records,
+                                              fname, 0, 2, 0);
+    for (auto& rec : records) builder.addRecord(rec);
+    builder.finish();
+    check_batch_get_records(fname, records);
+  }
+  {
+    std::string fname = "entropy_zip_blob_store.batch.test.zbs";
+    terark::EntropyZipBlobStore::MyBuilder builder(freq, 128, fname);
+    for (auto& rec : records) builder.addRecord(rec);
+    builder.finish();
+    check_batch_get_records(fname, records);
+  }
+  {
+    std::string fname = "dict_zip_blob_store.batch.test.zbs";
+    terark::DictZipBlobStore::Options opt;
+    opt.embeddedDict = true;
+    std::unique_ptr<terark::DictZipBlobStore::ZipBuilder> builder(
+        terark::DictZipBlobStore::createZipBuilder(opt));
+    for (size_t i = 0; i < records.size(); i += 10) {
+      builder->addSample(records[i]);
+    }
+    builder->finishSample();
+    builder->prepare(records.size(), fname);
+    for (auto& rec : records) builder->addRecord(rec);
+    builder->finish(terark::DictZipBlobStore::ZipBuilder::FinishFreeDict);
+    check_batch_get_records(fname, records);
+  }
+}
+
+TEST(ZBS_TEST, GET_RECORD_VIEW) {
+  const int total_records = 5000;
+  const size_t fixed_len = 16;
+  std::string plain_fname = "plain_blob_store.view.test.zbs";
+  std::string mixed_fname = "mixed_len_blob_store.view.test.zbs";
+  std::vector<std::string> records;
+  size_t content_size = 0, var_size = 0, var_cnt = 0;
+  std::mt19937 gen(4321);
+  for (int i = 0; i < total_records; ++i) {
+    size_t len = i % 3 ? fixed_len : gen() % 100;
+    records.emplace_back(len, char('a' + i % 26));
+    content_size += len;
+    if (len != fixed_len) {
+      var_size += len;
+      var_cnt++;
+    }
+  }
+  {
+    terark::PlainBlobStore::MyBuilder builder(content_size, total_records,
+                                              plain_fname, 0, 2, 0);
+    for (auto& rec : records) builder.addRecord(rec);
+    builder.finish();
+  }
+  {
+    terark::MixedLenBlobStore::MyBuilder builder(fixed_len, var_size, var_cnt,
+                                                 mixed_fname, 0, 2, 0);
+    for (auto& rec : records) builder.addRecord(rec);
+    builder.finish();
+  }
+  for (auto& fname : {plain_fname, mixed_fname}) {
+    std::unique_ptr<terark::AbstractBlobStore> store;
+    store.reset(terark::AbstractBlobStore::load_from_mmap(fname, false));
+    ASSERT_TRUE(store->support_get_record_view());
+    for (int i = 0; i < total_records; ++i) {
+      ASSERT_EQ(store->get_record_view(i), fstring(records[i]));
+    }
+    store.reset();
+    ::remove(fname.c_str());
+  }
+
+  // compressed store must fall back to copying into the caller's buffer
+  std::string zip_fname = "zip_offset_blob_store.view.test.zbs";
+  {
+    terark::ZipOffsetBlobStore::Options opt;
+    terark::ZipOffsetBlobStore::MyBuilder builder(zip_fname, 0, opt);
+    for (auto& rec : records) builder.addRecord(rec);
+    builder.finish();
+  }
+  std::unique_ptr<terark::AbstractBlobStore> store;
+  store.reset(terark::AbstractBlobStore::load_from_mmap(zip_fname, false));
+  ASSERT_FALSE(store->support_get_record_view());
+  valvec<byte_t> buf;
+  for (int i = 0; i < total_records; ++i) {
+    ASSERT_EQ(store->get_record_view(i, &buf), fstring(records[i]));
+  }
+  store.reset();
+  ::remove(zip_fname.c_str());
+}
+
+TEST(ZBS_TEST, ENTROPY_COMPACT_TABLE) {
+  const int total_records = 5000;
+  std::vector<std::string> records;
+  terark::freq_hist_o1 freq;
+  std::mt19937 gen(1234);
+  for (int i = 0; i < total_records; ++i) {
+    std::string rec;
+    char prev = 'a';
+    for (size_t j = 0, n = gen() % 200; j < n; ++j) {
+      // order-1 skewed, with some rare bytes for long codes
+      prev = j % 97 == 0 ? char(gen()) : char('a' + (prev * 7 + gen() % 3) % 26);
+      rec.push_back(prev);
+    }
+    freq.add_record(rec);
+    records.push_back(std::move(rec));
+  }
+  freq.finish();
+  for (bool compress : {false, true}) {
+    terark::freq_hist_o1 f(freq);
+    terark::FileMemIO memory;
+    terark::EntropyZipBlobStore::MyBuilder builder(f, 128, memory, 2, 0,
+                                                   compress, true);
+    for (auto& rec : records) builder.addRecord(rec);
+    builder.finish();
+    std::unique_ptr<terark::AbstractBlobStore> store(
+        terark::AbstractBlobStore::load_from_user_memory(
+            fstring(memory.begin(), memory.size()),
+            terark::AbstractBlobStore::Dictionary()));
+    auto ezbs = dynamic_cast<terark::EntropyZipBlobStore*>(store.get());
+    ASSERT_TRUE(ezbs != nullptr);
+    ASSERT_TRUE(ezbs->is_order1());
+    ASSERT_TRUE(ezbs->is_entropy_table_compact());
+    valvec<byte_t> buf;
+    for (int i = 0; i < total_records; ++i) {
+      store->get_record(i, &buf);
+      ASSERT_EQ(fstring(buf), fstring(records[i]));
+    }
+  }
+}
+
+TEST(ZBS_TEST, ZSTD_BLOCK_BLOB_STORE) {
+  const int total_records = 20000;
+  std::string fname = "zstd_block_blob_store.test.zbs";
+  std::vector<std::string> records;
+  std::mt19937 gen(1234);
+  for (int i = 0; i < total_records; ++i) {
+    char buf[128];
+    int len = snprintf(buf, sizeof buf,
+                       "{\"id\":%d,\"name\":\"user_%u\",\"score\":%u,\"tag\":\"%s\"}",
+                       i, unsigned(gen() % 1000), unsigned(gen() % 100),
+                       i % 3 ? "normal" : "premium");
+    records.emplace_back(buf, len);
+  }
+  records[100].clear(); // empty record
+  {
+    std::unique_ptr<terark::AbstractBlobStore::Builder> builder(
+        terark::AbstractBlobStore::Builder::createBuilder(
+            "ZstdBlockBlobStore", fname,
+            "block_records=32;dict_size=8192;sample_bytes=262144"));
+    ASSERT_TRUE(builder != nullptr);
+    for (auto& rec : records) builder->addRecord(rec);
+    builder->finish();
+  }
+  std::unique_ptr<terark::AbstractBlobStore> store;
+  store.reset(terark::AbstractBlobStore::load_from_mmap(fname, false));
+  auto zbbs = dynamic_cast<terark::ZstdBlockBlobStore*>(store.get());
+  ASSERT_TRUE(zbbs != nullptr);
+  ASSERT_EQ(zbbs->block_records(), 32u);
+  ASSERT_FALSE(zbbs->zstd_dict().empty());
+  ASSERT_EQ(store->num_records(), size_t(total_records));
+  ASSERT_TRUE(store->mem_size() < store->total_data_size());
+  valvec<byte_t> buf;
+  for (int i = 0; i < total_records; ++i) {
+    store->get_record(i, &buf);
+    ASSERT_EQ(fstring(buf), fstring(records[i]));
+  }
+  terark::AbstractBlobStore::CacheOffsets co;
+  for (int i = total_records; i-- > 0; ) {
+    store->get_record(i, &co);
+    ASSERT_EQ(fstring(co.recData), fstring(records[i]));
+  }
+  std::vector<size_t> ids;
+  for (int i = 0; i < 1000; ++i) {
+    ids.push_back(gen() % total_records);
+  }
+  int fd = ::open(fname.c_str(), O_RDONLY);
+  ASSERT_GE(fd, 0);
+  std::vector<valvec<byte_t>> recs(ids.size());
+  store->pread_records(NULL, fd, 0, ids.data(), ids.size(), recs.data());
+  for (size_t i = 0; i < ids.size(); ++i) {
+    ASSERT_EQ(fstring(recs[i]), fstring(records[ids[i]]));
+  }
+  ::close(fd);
+
+  // reverse the records, the dictionary is reused
+  std::string map_file = fname + ".map";
+  {
+    terark::ZReorderMap::Builder builder(total_records, -1, map_file, "wb");
+    for (int i = total_records; i-- > 0; )
+      builder.push_back(i);
+    builder.finish();
+  }
+  terark::FileMemIO memory;
+  {
+    terark::ZReorderMap newToOld(map_file);
+    store->reorder_zip_data(newToOld, [&](const void* data, size_t size) {
+      memory.write(data, size);
+    }, fname + ".tmp");
+  }
+  ::remove(map_file.c_str());
+  std::unique_ptr<terark::AbstractBlobStore> reordered(
+      terark::AbstractBlobStore::load_from_user_memory(
+          fstring(memory.begin(), memory.size()),
+          terark::AbstractBlobStore::Dictionary()));
+  ASSERT_EQ(dynamic_cast<terark::ZstdBlockBlobStore*>(reordered.get())->zstd_dict(),
+            zbbs->zstd_dict());
+  for (int i = 0; i < total_records; ++i) {
+    reordered->get_record(i, &buf);
+    ASSERT_EQ(fstring(buf), fstring(records[total_records - 1 - i]));
+  }
+  reordered.reset();
+  store.reset();
+  ::remove(fname.c_str());
+
+  // too few samples for a dictionary, plain zstd blocks in memory
+  terark::FileMemIO small;
+  {
+    terark::ZstdBlockBlobStore::MyBuilder builder(small);
+    for (int i = 0; i < 10; ++i) builder.addRecord(records[i]);
+    builder.finish();
+  }
+  store.reset(terark::AbstractBlobStore::load_from_user_memory(
+      fstring(small.begin(), small.size()),
+      terark::AbstractBlobStore::Dictionary()));
+  for (int i = 0; i < 10; ++i) {
+    store->get_record(i, &buf);
+    ASSERT_EQ(fstring(buf), fstring(records[i]));
+  }
+
+  // compressLevel is stored as uint8, out of range levels are rejected
+  terark::ZstdBlockBlobStore::Options opt;
+  ASSERT_THROW(opt.set_config("compress_level=-1"), std::invalid_argument);
+  ASSERT_THROW(opt.set_config("compress_level=0"), std::invalid_argument);
+  ASSERT_THROW(opt.set_config("compress_level=300"), std::invalid_argument);
+  opt.set_config("compress_level=19");
+  ASSERT_EQ(opt.compress_level, 19);
+  opt.compress_level = -5;
+  terark::FileMemIO bad;
+  ASSERT_THROW(terark::ZstdBlockBlobStore::MyBuilder(bad, opt),
+               std::invalid_argument);
+}
+
+TEST(ZBS_TEST, ROW_CACHE) {
+  const int total_records = 20000;
+  std::vector<std::string> records;
+  std::mt19937 gen(1234);
+  for (int i = 0; i < total_records; ++i) {
+    records.emplace_back(gen() % 200, char('a' + i % 26));
+  }
+  terark::FileMemIO memory;
+  {
+    terark::ZipOffsetBlobStore::Options opt;
+    opt.compress_level = 4;
+    terark::ZipOffsetBlobStore::MyBuilder builder(memory, opt);
+    for (auto& rec : records) builder.addRecord(rec);
+    builder.finish();
+  }
+  std::unique_ptr<terark::AbstractBlobStore> store(
+      terark::AbstractBlobStore::load_from_user_memory(
+          fstring(memory.begin(), memory.size()),
+          terark::AbstractBlobStore::Dictionary()));
+  for (bool tinyLFU : {false, true}) {
+    terark::BlobStoreRowCache cache(256 * 1024, 8, tinyLFU);
+    std::vector<std::thread> threads;
+    std::atomic<size_t> errors{0};
+    for (int t = 0; t < 4; ++t) {
+      threads.emplace_back([&, t]() {
+        std::mt19937 g(t);
+        valvec<byte_t> buf;
+        for (int i = 0; i < 50000; ++i) {
+          // 90% of reads hit 500 hot records
+          size_t id = g() % 10 ? g() % 500 : g() % total_records;
+          cache.get_record(store.get(), id, &buf);
+          if (fstring(buf) != fstring(records[id])) errors++;
+        }
+      });
+    }
+    for (auto& th : threads) th.join();
+    ASSERT_EQ(errors.load(), 0u);
+    auto st = cache.get_stat();
+    ASSERT_EQ(st.hit + st.miss, 200000u);
+    ASSERT_TRUE(st.hit > st.miss);
+    ASSERT_TRUE(st.usedBytes <= 256 * 1024);
+
+    // a full scan must not flush the hot records with tinyLFU
+    valvec<byte_t> buf;
+    for (int i = 0; i < total_records; ++i) {
+      cache.get_record(store.get(), i, &buf);
+      ASSERT_EQ(fstring(buf), fstring(records[i]));
+    }
+    auto st1 = cache.get_stat();
+    for (int i = 0; i < 500; ++i) {
+      cache.get_record(store.get(), i, &buf);
+    }
+    auto st2 = cache.get_stat();
+    if (tinyLFU) {
+      ASSERT_TRUE(st2.hit - st1.hit > 400);
+    }
+    cache.erase_store(store.get());
+    ASSERT_EQ(cache.get_stat().entries, 0u);
+    ASSERT_EQ(cache.get_stat().usedBytes, 0u);
+  }
+}
+
+TEST(ZBS_TEST, HUGEPAGE_LOAD) {
+  {
+    // falls back to the caller's blocks if hugepages are unavailable
+    std::string big(terark::hugepage_size + 100, 'b'), small(4096, 's');
+    valvec<fstring> blocks;
+    blocks.emplace_back(small);
+    blocks.emplace_back(big);
+    terark::HugepageCopy copy;
+    if (copy.copy(&blocks)) {
+      ASSERT_EQ(size_t(blocks[0].data()) % terark::hugepage_size, 0u);
+      ASSERT_EQ(size_t(blocks[1].data()) % 64, 0u);
+    }
+    ASSERT_EQ(blocks[0], fstring(small));
+    ASSERT_EQ(blocks[1], fstring(big));
+    valvec<fstring> smallBlocks;
+    smallBlocks.emplace_back(small);
+    terark::HugepageCopy smallCopy;
+    ASSERT_FALSE(smallCopy.copy(&smallBlocks));
+    ASSERT_EQ(smallBlocks[0].data(), small.data());
+  }
+  // offsets of 1M records exceed hugepage_size
+  const int total_records = 1000000;
+  std::vector<std::string> records;
+  std::mt19937 gen(2468);
+  size_t content_size = 0;
+  for (int i = 0; i < total_records; ++i) {
+    records.emplace_back(gen() % 8, char('a' + i % 26));
+    content_size += records.back().size();
+  }
+  std::string fname = "plain_blob_store.hugepage.test.zbs";
+  {
+    terark::PlainBlobStore::MyBuilder builder(content_size, total_records,
+                                              fname, 0, 2, 0);
+    for (auto& rec : records) builder.addRecord(rec);
+    builder.finish();
+  }
+  bool old = terark::get_hugepage_load();
+  terark::set_hugepage_load(true);
+  std::unique_ptr<terark::AbstractBlobStore> store(
+      terark::AbstractBlobStore::load_from_mmap(fname, false));
+  terark::set_hugepage_load(old);
+  fstring image = store->get_mmap();
+  auto in_image = [&](fstring b) {
+    return b.data() >= image.data() && b.end() <= image.end();
+  };
+  valvec<fstring> blocks;
+  store->get_meta_blocks(&blocks);
+  ASSERT_EQ(blocks.size(), 1u);
+  ASSERT_GE(blocks[0].size(), terark::hugepage_size);
+  if (!in_image(blocks[0])) {
+    ASSERT_EQ(size_t(blocks[0].data()) % terark::hugepage_size, 0u);
+  }
+  store->get_data_blocks(&blocks);
+  ASSERT_TRUE(in_image(blocks[0])); // not copied
+  valvec<byte_t> buf;
+  for (int i = 0; i < total_records; ++i) {
+    store->get_record(i, &buf);
+    ASSERT_EQ(fstring(buf), fstring(records[i]));
+  }
+  store.reset();
+  ::remove(fname.c_str());
+}
+
+TEST(ZBS_TEST, PLAIN_DETACH_META_BLOCKS) {
+  // the meta block is the offsets alone, detach must not skip the content
+  // size into it, with or without hugepages
+  const int total_records = 3000;
+  std::vector<std::string> records;
+  std::mt19937 gen(1357);
+  size_t content_size = 0;
+  for (int i = 0; i < total_records; ++i) {
+    records.emplace_back(gen() % 50, char('a' + i % 26));
+    content_size += records.back().size();
+  }
+  std::string fname = "plain_blob_store.detach.test.zbs";
+  {
+    terark::PlainBlobStore::MyBuilder builder(content_size, total_records,
+                                              fname, 0, 2, 0);
+    for (auto& rec : records) builder.addRecord(rec);
+    builder.finish();
+  }
+  std::unique_ptr<terark::AbstractBlobStore> store(
+      terark::AbstractBlobStore::load_from_mmap(fname, false));
+  valvec<fstring> blocks;
+  store->get_meta_blocks(&blocks);
+  ASSERT_EQ(blocks.size(), 1u);
+  valvec<byte_t> copy(blocks[0].udata(), blocks[0].size());
+  blocks[0] = fstring(copy.data(), copy.size());
+  store->detach_meta_blocks(blocks);
+  store->get_meta_blocks(&blocks);
+  ASSERT_EQ(blocks[0].udata(), copy.data());
+  valvec<byte_t> buf;
+  for (int i = 0; i < total_records; ++i) {
+    store->get_record(i, &buf);
+    ASSERT_EQ(fstring(buf), fstring(records[i]));
+  }
+  store.reset();
+  ::remove(fname.c_str());
+}
+
+TEST(ZBS_TEST, DICT_ZIP_UNZIP_IMP) {
+  // the dict is exactly the sample, so the tail of a record can be a
+  // global match ending at the end of the dict and of the output
+  std::mt19937 gen(8642);
+  std::string dict(64 << 10, '\0');
+  for (auto& ch : dict) ch = char('a' + gen() % 26);
+  std::vector<std::string> records;
+  auto literals = [&](size_t n) {
+    std::string s(n, '\0');
+    for (auto& ch : s) ch = char('0' + gen() % 10);
+    return s;
+  };
+  for (size_t len : {5, 6, 7, 8, 15, 16, 17, 31, 32, 33, 63, 64, 65, 100, 257, 1000}) {
+    records.push_back(dict.substr(dict.size() - len));
+    records.push_back(literals(1 + gen() % 40) + dict.substr(dict.size() - len));
+    records.push_back(dict.substr(gen() % (dict.size() - len), len) + literals(1 + gen() % 40));
+    // local matches: rle, short and long distance
+    for (size_t distance : {1, 3, 8, 12, 31, 32, 40}) {
+      std::string unit = literals(distance), rec;
+      while (rec.size() < distance + len) rec += unit;
+      rec.resize(distance + len);
+      records.push_back(rec);
+    }
+  }
+  records.emplace_back();
+  for (int i = 0; i < 2000; ++i) {
+    std::string rec;
+    for (size_t n = gen() % 5; n--; ) {
+      size_t len = 1 + gen() % 300;
+      rec += gen() % 2 ? literals(len) : dict.substr(gen() % (dict.size() - len), len);
+    }
+    records.push_back(rec);
+  }
+  std::string fname = "dict_zip_blob_store.unzip_imp.test.zbs";
+  {
+    terark::DictZipBlobStore::Options opt;
+    opt.embeddedDict = true;
+    opt.sampleSort = terark::DictZipBlobStore::Options::kSortNone;
+    std::unique_ptr<terark::DictZipBlobStore::ZipBuilder> builder(
+        terark::DictZipBlobStore::createZipBuilder(opt));
+    builder->addSample(dict);
+    builder->finishSample();
+    builder->prepare(records.size(), fname);
+    for (auto& rec : records) builder->addRecord(rec);
+    builder->finish(terark::DictZipBlobStore::ZipBuilder::FinishFreeDict);
+  }
+  const int old = terark::DictZipBlobStore::getUnzipImp();
+  for (int imp : {1, 6, 7}) {
+    if (!terark::DictZipBlobStore::setUnzipImp(imp)) {
+      std::cout << "TerarkDictZipUnzipImp=" << imp << " unsupported, skip" << std::endl;
+      continue;
+    }
+    std::unique_ptr<terark::AbstractBlobStore> store(
+        terark::AbstractBlobStore::load_from_mmap(fname, false));
+    for (size_t i = 0; i < records.size(); ++i) {
+      valvec<byte_t> buf;
+      store->get_record(i, &buf);
+      ASSERT_EQ(fstring(buf), fstring(records[i])) << "imp = " << imp << ", i = " << i;
+      valvec<byte_t> exact; // output buffer ends exactly at the record end
+      exact.reserve(records[i].size());
+      store->get_record(i, &exact);
+      ASSERT_EQ(fstring(exact), fstring(records[i])) << "imp = " << imp << ", i = " << i;
+    }
+  }
+  terark::DictZipBlobStore::setUnzipImp(old);
+  ::remove(fname.c_str());
+}
+
+TEST(ZBS_TEST, DICT_BUILD_THREADS) {
+  // 2MB random letters: the bfs levels of depth 2 and 3 have far more than
+  // ParallelBfsMinParents states, so dictBuildThreads = 4 takes the parallel
+  // divsufsort and the parallel bfs_build_cache
+  std::mt19937 gen(1357);
+  std::string dict(2 << 20, '\0');
+  for (auto& ch : dict) ch = char('a' + gen() % 26);
+  std::vector<std::string> records;
+  for (int i = 0; i < 5000; ++i) {
+    size_t len = 1 + gen() % 500;
+    std::string rec = dict.substr(gen() % (dict.size() - len), len);
+    rec += std::to_string(gen());
+    records.push_back(rec);
+  }
+  auto build = [&](int threads) {
+    std::string fname = "dict_zip_blob_store.build_threads_"
+                      + std::to_string(threads) + ".test.zbs";
+    terark::DictZipBlobStore::Options opt;
+    opt.embeddedDict = true;
+    opt.sampleSort = terark::DictZipBlobStore::Options::kSortNone;
+    opt.dictBuildThreads = threads;
+    std::unique_ptr<terark::DictZipBlobStore::ZipBuilder> builder(
+        terark::DictZipBlobStore::createZipBuilder(opt));
+    builder->addSample(dict);
+    builder->finishSample();
+    builder->prepare(records.size(), fname);
+    for (auto& rec : records) builder->addRecord(rec);
+    builder->finish(terark::DictZipBlobStore::ZipBuilder::FinishFreeDict);
+    return fname;
+  };
+  std::string fname1 = build(1);
+  std::string fname4 = build(4);
+  {
+    terark::MmapWholeFile mm1(fname1), mm4(fname4);
+    ASSERT_EQ(mm1.size, mm4.size);
+    ASSERT_EQ(0, memcmp(mm1.base, mm4.base, mm1.size));
+    std::unique_ptr<terark::AbstractBlobStore> store(
+        terark::AbstractBlobStore::load_from_mmap(fname4, false));
+    ASSERT_EQ(store->num_records(), records.size());
+    valvec<byte_t> buf;
+    for (size_t i = 0; i < records.size(); ++i) {
+      store->get_record(i, &buf);
+      ASSERT_EQ(fstring(buf), fstring(records[i])) << "i = " << i;
+    }
+  }
+  ::remove(fname1.c_str());
+  ::remove(fname4.c_str());
+}
+
+TEST(ZBS_TEST, DICT_ZIP_ENTROPY_COMPACT_TABLE) {
+  const int total_records = 5000;
+  std::vector<std::string> records;
+  std::mt19937 gen(4321);
+  for (int i = 0; i < total_records; ++i) {
+    std::string rec;
+    char prev = 'a';
+    for (size_t j = 0, n = 20 + gen() % 200; j < n; ++j) {
+      // order-1 skewed literals, rarely matched by the small dict
+      prev = j % 97 == 0 ? char(gen()) : char('a' + (prev * 7 + gen() % 3) % 26);
+      rec.push_back(prev);
+    }
+    records.push_back(std::move(rec));
+  }
+  auto check = [&](terark::AbstractBlobStore* store, bool reversed) {
+    auto dzbs = dynamic_cast<terark::DictZipBlobStore*>(store);
+    ASSERT_TRUE(dzbs != nullptr);
+    ASSERT_TRUE(dzbs->is_entropy_table_compact());
+    ASSERT_EQ(store->num_records(), size_t(total_records));
+    valvec<byte_t> buf;
+    for (int i = 0; i < total_records; ++i) {
+      store->get_record(i, &buf);
+      int j = reversed ? total_records - 1 - i : i;
+      ASSERT_EQ(fstring(buf), fstring(records[j])) << "i = " << i;
+    }
+  };
+  std::string fname = "dict_zip_blob_store.compact.test.zbs";
+  std::string map_file = fname + ".map";
+  {
+    terark::ZReorderMap::Builder builder(total_records, -1, map_file, "wb");
+    for (int i = total_records; i-- > 0; )
+      builder.push_back(i);
+    builder.finish();
+  }
+  for (bool compressGlobalDict : {false, true}) {
+    terark::DictZipBlobStore::Options opt;
+    opt.embeddedDict = true;
+    opt.compressGlobalDict = compressGlobalDict;
+    opt.entropyAlgo = terark::DictZipBlobStore::Options::kHuffmanO1;
+    opt.entropyTableCompact = true;
+    auto build = [&](terark::DictZipBlobStore::ZipBuilder* builder) {
+      for (int i = 0; i < total_records; i += 50) builder->addSample(records[i]);
+      builder->finishSample();
+    };
+    // file: load_from_mmap, then detach the meta blocks
+    {
+      std::unique_ptr<terark::DictZipBlobStore::ZipBuilder> builder(
+          terark::DictZipBlobStore::createZipBuilder(opt));
+      build(builder.get());
+      builder->prepare(records.size(), fname);
+      for (auto& rec : records) builder->addRecord(rec);
+      builder->finish(terark::DictZipBlobStore::ZipBuilder::FinishFreeDict);
+    }
+    std::unique_ptr<terark::AbstractBlobStore> store(
+        terark::AbstractBlobStore::load_from_mmap(fname, false));
+    check(store.get(), false);
+    valvec<fstring> blocks;
+    store->get_meta_blocks(&blocks);
+    std::vector<std::string> copies;
+    for (auto& b : blocks) copies.emplace_back(b.data(), b.size());
+    for (size_t i = 0; i < blocks.size(); ++i) blocks[i] = copies[i];
+    store->detach_meta_blocks(blocks);
+    check(store.get(), false);
+
+    // memory: the builder calls setDataMemory on the in-memory image
+    terark::FileMemIO memory;
+    {
+      std::unique_ptr<terark::DictZipBlobStore::ZipBuilder> builder(
+          terark::DictZipBlobStore::createZipBuilder(opt));
+      build(builder.get());
+      builder->prepare(records.size(), memory);
+      for (auto& rec : records) builder->addRecord(rec);
+      builder->finish(terark::DictZipBlobStore::ZipBuilder::FinishFreeDict);
+    }
+    std::unique_ptr<terark::AbstractBlobStore> memStore(
+        terark::AbstractBlobStore::load_from_user_memory(
+            fstring(memory.begin(), memory.size()),
+            terark::AbstractBlobStore::Dictionary()));
+    check(memStore.get(), false);
+
+    // reorder keeps entropyTableCompact in the new header
+    terark::FileMemIO reorderMem;
+    {
+      terark::ZReorderMap newToOld(map_file);
+      memStore->reorder_zip_data(newToOld, [&](const void* data, size_t size) {
+        reorderMem.write(data, size);
+      }, fname + ".tmp");
+    }
+    std::unique_ptr<terark::AbstractBlobStore> reordered(
+        terark::AbstractBlobStore::load_from_user_memory(
+            fstring(reorderMem.begin(), reorderMem.size()),
+            terark::AbstractBlobStore::Dictionary()));
+    check(reordered.get(), true);
+    reordered.reset();
+    memStore.reset();
+    store.reset();
+    ::remove(fname.c_str());
+  }
+  ::remove(map_file.c_str());
+}
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <terark/gold_hash_map.hpp>
+#include <terark/hash_strmap.hpp>
+#include <terark/thread/mutex.hpp>
+#include <boost/noncopyable.hpp>
+#include <shared_mutex>
+#include <new>
+#include <stdlib.h>
+
+namespace terark {
+
+/// Thread safe hash map made of Map stripes, each stripe keeps the compact
+/// link/bucket layout of Map and is guarded by its own spin_rw_mutex.
+/// A key is mapped to a stripe by the high bits of its hash, so operations
+/// on different stripes never contend, and a rehash only blocks the stripe
+/// it grows, which is 1/stripe_num() of the table.
+///
+/// Values are accessed by copy or by callbacks which run in the stripe lock,
+/// callbacks must not access the same map.
+template<class Map, class KeyHash>
+class concurrent_hash_tab : boost::noncopyable, private KeyHash {
+    struct alignas(64) Stripe {
+        mutable spin_rw_mutex mtx;
+        Map map;
+    };
+    typedef std::lock_guard<spin_rw_mutex>  WriteLock;
+    typedef std::shared_lock<spin_rw_mutex> ReadLock;
+    Stripe*  m_stripes;
+    unsigned m_shift;
+
+    template<class KeyT>
+    Stripe& stripe_of(const KeyT& key) const {
+        uint64_t h = uint64_t(KeyHash::operator()(key));
+        // m_shift = 63 - bits, shift 64 is UB when there is only 1 stripe
+        return m_stripes[((h * 0x9E3779B97F4A7C15ull) >> 1) >> m_shift];
+    }
+
+public:
+    typedef Map map_type;
+    typedef typename std::remove_reference<
+        decltype(((Map*)0)->val(0))>::type value_type;
+
+    /// @param stripes 0 means 8 * hardware_concurrency, it is rounded up
+    ///                to power of 2
+    explicit concurrent_hash_tab(size_t stripes = 0, KeyHash hash = KeyHash())
+      : KeyHash(hash) {
+        if (0 == stripes)
+            stripes = 8 * std::max(std::thread::hardware_concurrency(), 2u);
+        unsigned bits = 0;
+        while ((size_t(1) << bits) < stripes)
+            bits++;
+        stripes = size_t(1) << bits;
+        m_shift = 63 - bits;
+        void* mem = NULL;
+        if (posix_memalign(&mem, alignof(Stripe), sizeof(Stripe) * stripes))
+            throw std::bad_alloc();
+        m_stripes = (Stripe*)mem;
+        for (size_t i = 0; i < stripes; ++i)
+            new(m_stripes + i) Stripe();
+    }
+    ~concurrent_hash_tab() {
+        for (size_t i = 0, n = stripe_num(); i < n; ++i)
+            m_stripes[i].~Stripe();
+        ::free(m_stripes);
+    }
+    size_t stripe_num() const { return size_t(1) << (63 - m_shift); }
+
+    /// copy the value of key into *val
+    template<class KeyT>
+    bool find(const KeyT& key, value_type* val) const {
+        const Stripe& s = stripe_of(key);
+        ReadLock lock(s.mtx);
+        size_t idx = s.map.find_i(key);
+        if (s.map.end_i() == idx)
+            return false;
+        *val = s.map.val(idx);
+        return true;
+    }
+    /// op(const value_type&) is called in the read lock
+    template<class KeyT, class OP>
+    bool find_and(const KeyT& key, OP op) const {
+        const Stripe& s = stripe_of(key);
+        ReadLock lock(s.mtx);
+        size_t idx = s.map.find_i(key);
+        if (s.map.end_i() == idx)
+            return false;
+        op(s.map.val(idx));
+        return true;
+    }
+    template<class KeyT>
+    bool exists(const KeyT& key) const {
+        const Stripe& s = stripe_of(key);
+        ReadLock lock(s.mtx);
+        return s.map.end_i() != s.map.find_i(key);
+    }
+
+    /// @returns false if key existed, the existing value is not changed
+    template<class KeyT>
+    bool insert(const KeyT& key, const value_type& val) {
+        Stripe& s = stripe_of(key);
+        WriteLock lock(s.mtx);
+        return s.map.insert_i(key, val).second;
+    }
+    /// @returns true if key is newly inserted
+    template<class KeyT>
+    bool insert_or_assign(const KeyT& key, const value_type& val) {
+        Stripe& s = stripe_of(key);
+        WriteLock lock(s.mtx);
+        std::pair<size_t, bool> ib = s.map.insert_i(key, val);
+        if (!ib.second)
+            s.map.val(ib.first) = val;
+        return ib.second;
+    }
+    /// if key exists, op(value_type&) is called in the write lock,
+    /// else key is inserted with init
+    /// @returns true if key is newly inserted
+    template<class KeyT, class OP>
+    bool upsert(const KeyT& key, const value_type& init, OP op) {
+        Stripe& s = stripe_of(key);
+        WriteLock lock(s.mtx);
+        std::pair<size_t, bool> ib = s.map.insert_i(key, init);
+        if (!ib.second)
+            op(s.map.val(ib.first));
+        return ib.second;
+    }
+    template<class KeyT>
+    size_t erase(const KeyT& key) {
+        Stripe& s = stripe_of(key);
+        WriteLock lock(s.mtx);
+        size_t idx = s.map.find_i(key);
+        if (s.map.end_i() == idx)
+            return 0;
+        s.map.erase_i(idx);
+        return 1;
+    }
+
+    /// not a snapshot if there are concurrent writers
+    size_t size() const {
+        size_t sum = 0;
+        for (size_t i = 0, n = stripe_num(); i < n; ++i) {
+            ReadLock lock(m_stripes[i].mtx);
+            sum += m_stripes[i].map.size();
+        }
+        return sum;
+    }
+    bool empty() const { return size() == 0; }
+    void clear() {
+        for (size_t i = 0, n = stripe_num(); i < n; ++i) {
+            WriteLock lock(m_stripes[i].mtx);
+            m_stripes[i].map.clear();
+        }
+    }
+    /// reserve for cap elements in total, locks one stripe a time
+    void reserve(size_t cap) {
+        size_t n = stripe_num();
+        size_t per_stripe = (cap + n - 1) / n + (cap ? 16 : 0);
+        for (size_t i = 0; i < n; ++i) {
+            WriteLock lock(m_stripes[i].mtx);
+            if (m_stripes[i].map.size() < per_stripe)
+                m_stripes[i].map.reserve(per_stripe);
+        }
+    }
+    /// op(key, const value_type&) is called for each element, one stripe
+    /// is read locked at a time
+    template<class OP>
+    void for_each(OP op) const {
+        for (size_t i = 0, n = stripe_num(); i < n; ++i) {
+            const Map& m = m_stripes[i].map;
+            ReadLock lock(m_stripes[i].mtx);
+            for (size_t j = m.beg_i(); j < m.end_i(); j = m.next_i(j))
+                op(m.key(j), m.val(j));
+        }
+    }
+};
+
+template< class Key
+        , class Value
+        , class HashFunc = DEFAULT_HASH_FUNC<Key>
+        , class KeyEqual = std::equal_to<Key>
+        >
+class concurrent_gold_hash_map : public concurrent_hash_tab
+    < gold_hash_map<Key, Value, HashFunc, KeyEqual>, HashFunc>
+{
+    typedef concurrent_hash_tab
+    < gold_hash_map<Key, Value, HashFunc, KeyEqual>, HashFunc> super;
+public:
+    explicit concurrent_gold_hash_map(size_t stripes = 0) : super(stripes) {}
+};
+
+/// keys are copied into the string pool of the stripe
+template< class Value
+        , class HashFunc = fstring_func::IF_SP_ALIGN(hash_align, hash)
+        , class KeyEqual = fstring_func::IF_SP_ALIGN(equal_align, equal)
+        >
+class concurrent_hash_strmap : public concurrent_hash_tab
+    < hash_strmap<Value, HashFunc, KeyEqual>, HashFunc>
+{
+    typedef concurrent_hash_tab
+    < hash_strmap<Value, HashFunc, KeyEqual>, HashFunc> super;
+public:
+    explicit concurrent_hash_strmap(size_t stripes = 0) : super(stripes) {}
+};
+
+} // namespace terark
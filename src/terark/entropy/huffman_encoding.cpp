@@ -368,11 +368,10 @@ inline void HuffmanBuildDTable(const HuffmanEncSymbol* csyms, byte_t* ari, uint8
     memset(&ari[item[max_j].bits], item[max_j].data, (1u << BLOCK_BITS) - item[max_j].bits);
 }
 
-// Build DTable from byte stream
-inline void HuffmanBuildDTable(const byte_t** pptr, byte_t* ari, uint8_t* cnt) {
-    HuffmanEncSymbol ctable[256];
+// Build CTable from byte stream
+inline void HuffmanReadCTable(const byte_t** pptr, HuffmanEncSymbol* ctable) {
     uint64_t freq[256];
-    memset(&ctable, 0, sizeof ctable);
+    memset(ctable, 0, sizeof(*ctable) * 256);
     memset(&freq, 0, sizeof freq);
     size_t j, rle_j = 0;
     if (pptr != nullptr) {
@@ -399,6 +398,14 @@ inline void HuffmanBuildDTable(const byte_t** pptr, byte_t* ari, uint8_t* cnt) {
             }
         } while (j);
         HuffmanBuildCTable(nullptr, freq, ctable);
+    }
+}
+
+// Build DTable from byte stream
+inline void HuffmanBuildDTable(const byte_t** pptr, byte_t* ari, uint8_t* cnt) {
+    if (pptr != nullptr) {
+        HuffmanEncSymbol ctable[256];
+        HuffmanReadCTable(pptr, ctable);
         HuffmanBuildDTable(ctable, ari, cnt);
     }
 }
@@ -844,26 +851,32 @@ EntropyBits encoder_o1::bitwise_encode_xN(fstring record, TerarkContext* context
 
 // --------------------------------------------------------------------------
 
-decoder_o1::decoder_o1() {
-}
+struct decoder_o1_impl {
+    template<class Decoder>
+    static void init(Decoder* d, fstring table, size_t* psize);
 
-decoder_o1::decoder_o1(fstring table, size_t* psize) {
-    init(table, psize);
-}
+    static void build(decoder_o1* d, size_t i, const byte_t** pptr) {
+        HuffmanBuildDTable(pptr, d->ari_[i], d->cnt_[i]);
+    }
+    static void build(decoder_o1_compact* d, size_t i, const byte_t** pptr);
 
-void decoder_o1::init(fstring table, size_t* psize) {
+    template<class Decoder>
+    static bool decode_x1(const Decoder* d, const EntropyBits& data, valvec<byte_t>* record);
+    template<size_t N, class Decoder>
+    static bool decode_xN(const Decoder* d, const EntropyBits& data, valvec<byte_t>* record, TerarkContext* context);
+};
+
+template<class Decoder>
+void decoder_o1_impl::init(Decoder* d, fstring table, size_t* psize) {
     size_t i, rle_i;
     const byte_t *cp = table.udata();
     const byte_t *end = cp + table.size();
 
-    memset(&ari_, 0, sizeof ari_);
-    memset(&cnt_, 255, sizeof cnt_);
-
     valvec<byte_t> table_huf;
     if (*cp == 255) {
         size_t read = 0;
-        decoder d(table.substr(1), &read);
-        d.decode(table.substr(1 + read), &table_huf, GetTlsTerarkContext());
+        decoder dec(table.substr(1), &read);
+        dec.decode(table.substr(1 + read), &table_huf, GetTlsTerarkContext());
         if (psize != nullptr) {
             *psize = table.size();
         }
@@ -886,7 +899,7 @@ void decoder_o1::init(fstring table, size_t* psize) {
         rle_i = 0;
         i = *cp++;
         do {
-            HuffmanBuildDTable(&cp, ari_[i], cnt_[i]);
+            build(d, i, &cp);
 
             if (!rle_i && i + 1 == *cp) {
                 i = *cp++;
@@ -901,13 +914,30 @@ void decoder_o1::init(fstring table, size_t* psize) {
             }
         } while (i);
     }
-    HuffmanBuildDTable(&cp, ari_[256], cnt_[256]);
+    build(d, 256, &cp);
 
     if (psize != nullptr && end == table.udata() + table.size()) {
         *psize = cp - table.udata();
     }
 }
 
+decoder_o1::decoder_o1() {
+}
+
+decoder_o1::decoder_o1(fstring table, size_t* psize) {
+    init(table, psize);
+}
+
+void decoder_o1::init(fstring table, size_t* psize) {
+    memset(&ari_, 0, sizeof ari_);
+    memset(&cnt_, 255, sizeof cnt_);
+    decoder_o1_impl::init(this, table, psize);
+}
+
+inline uint16_t decoder_o1::lookup(size_t l, size_t bits) const {
+    byte_t c = ari_[l][bits];
+    return c | uint16_t(cnt_[l][c]) << 8;
+}
 
 bool decoder_o1::decode_x1(fstring data, valvec<byte_t>* record, TerarkContext* context) const {
     auto bits = EntropyBytesToBits(data);
@@ -929,7 +959,8 @@ bool decoder_o1::decode_x8(fstring data, valvec<byte_t>* record, TerarkContext*
     return bitwise_decode_x8(bits, record, context);
 }
 
-bool decoder_o1::bitwise_decode_x1(const EntropyBits& data, valvec<byte_t>* record, TerarkContext* context) const {
+template<class Decoder>
+bool decoder_o1_impl::decode_x1(const Decoder* d, const EntropyBits& data, valvec<byte_t>* record) {
     record->risk_set_size(0);
 
     EntropyBitsReader reader(data);
@@ -950,8 +981,9 @@ bool decoder_o1::bitwise_decode_x1(const EntropyBits& data, valvec<byte_t>* reco
                     break;
                 }
             }
-            byte_t c = ari_[l][huf.bits >> (64 - BLOCK_BITS)];
-            uint8_t b = cnt_[l][c];
+            uint16_t cb = d->lookup(l, huf.bits >> (64 - BLOCK_BITS));
+            byte_t c = byte_t(cb);
+            uint8_t b = uint8_t(cb >> 8);
             if (terark_unlikely(b > huf.bit_count)) return false;
             record->unchecked_push(l = c);
             huf.bits <<= b;
@@ -961,8 +993,12 @@ bool decoder_o1::bitwise_decode_x1(const EntropyBits& data, valvec<byte_t>* reco
     return true;
 }
 
+bool decoder_o1::bitwise_decode_x1(const EntropyBits& data, valvec<byte_t>* record, TerarkContext* context) const {
+    return decoder_o1_impl::decode_x1(this, data, record);
+}
+
 bool decoder_o1::bitwise_decode_x2(const EntropyBits& data, valvec<byte_t>* record, TerarkContext* context) const {
-    return bitwise_decode_xN<2>(data, record, context);
+    return decoder_o1_impl::decode_xN<2>(this, data, record, context);
 }
 
 #ifdef __AVX2__
@@ -1376,17 +1412,17 @@ bool decoder_o1::bitwise_decode_x8(const EntropyBits& data, valvec<byte_t>* reco
 #else
 
 bool decoder_o1::bitwise_decode_x4(const EntropyBits& data, valvec<byte_t>* record, TerarkContext* context) const {
-    return bitwise_decode_xN<4>(data, record, context);
+    return decoder_o1_impl::decode_xN<4>(this, data, record, context);
 }
 
 bool decoder_o1::bitwise_decode_x8(const EntropyBits& data, valvec<byte_t>* record, TerarkContext* context) const {
-    return bitwise_decode_xN<8>(data, record, context);
+    return decoder_o1_impl::decode_xN<8>(this, data, record, context);
 }
 
 #endif
 
-template<size_t N>
-bool decoder_o1::bitwise_decode_xN(const EntropyBits& data, valvec<byte_t>* record, TerarkContext* context) const {
+template<size_t N, class Decoder>
+bool decoder_o1_impl::decode_xN(const Decoder* d, const EntropyBits& data, valvec<byte_t>* record, TerarkContext* context) {
     record->risk_set_size(0);
 
 #define w0 0
@@ -1444,33 +1480,42 @@ bool decoder_o1::bitwise_decode_xN(const EntropyBits& data, valvec<byte_t>* reco
         if (w7 == 7) bits[w7] = HuffmanDecStateInit(&reader);
 
         byte_t c[N];
+        uint8_t b[N];
         while (true) {
             size_t s[N];
-            uint8_t b[N];
+            uint16_t cb[N];
 
-            if (w0 == 0) c[w0] = ari_[l[w0]][bits[w0]];
-            if (w0 == 0) s[w0] =     0 + (b[w0] = cnt_[l[w0]][c[w0]]);
+            if (w0 == 0) cb[w0] = d->lookup(l[w0], bits[w0]);
+            if (w0 == 0) c[w0] = byte_t(cb[w0]);
+            if (w0 == 0) s[w0] =     0 + (b[w0] = uint8_t(cb[w0] >> 8));
 
-            if (w1 == 1) c[w1] = ari_[l[w1]][bits[w1]];
-            if (w1 == 1) s[w1] = s[w0] + (b[w1] = cnt_[l[w1]][c[w1]]);
+            if (w1 == 1) cb[w1] = d->lookup(l[w1], bits[w1]);
+            if (w1 == 1) c[w1] = byte_t(cb[w1]);
+            if (w1 == 1) s[w1] = s[w0] + (b[w1] = uint8_t(cb[w1] >> 8));
 
-            if (w2 == 2) c[w2] = ari_[l[w2]][bits[w2]];
-            if (w2 == 2) s[w2] = s[w1] + (b[w2] = cnt_[l[w2]][c[w2]]);
+            if (w2 == 2) cb[w2] = d->lookup(l[w2], bits[w2]);
+            if (w2 == 2) c[w2] = byte_t(cb[w2]);
+            if (w2 == 2) s[w2] = s[w1] + (b[w2] = uint8_t(cb[w2] >> 8));
 
-            if (w3 == 3) c[w3] = ari_[l[w3]][bits[w3]];
-            if (w3 == 3) s[w3] = s[w2] + (b[w3] = cnt_[l[w3]][c[w3]]);
+            if (w3 == 3) cb[w3] = d->lookup(l[w3], bits[w3]);
+            if (w3 == 3) c[w3] = byte_t(cb[w3]);
+            if (w3 == 3) s[w3] = s[w2] + (b[w3] = uint8_t(cb[w3] >> 8));
 
-            if (w4 == 4) c[w4] = ari_[l[w4]][bits[w4]];
-            if (w4 == 4) s[w4] = s[w3] + (b[w4] = cnt_[l[w4]][c[w4]]);
+            if (w4 == 4) cb[w4] = d->lookup(l[w4], bits[w4]);
+            if (w4 == 4) c[w4] = byte_t(cb[w4]);
+            if (w4 == 4) s[w4] = s[w3] + (b[w4] = uint8_t(cb[w4] >> 8));
 
-            if (w5 == 5) c[w5] = ari_[l[w5]][bits[w5]];
-            if (w5 == 5) s[w5] = s[w4] + (b[w5] = cnt_[l[w5]][c[w5]]);
+            if (w5 == 5) cb[w5] = d->lookup(l[w5], bits[w5]);
+            if (w5 == 5) c[w5] = byte_t(cb[w5]);
+            if (w5 == 5) s[w5] = s[w4] + (b[w5] = uint8_t(cb[w5] >> 8));
 
-            if (w6 == 6) c[w6] = ari_[l[w6]][bits[w6]];
-            if (w6 == 6) s[w6] = s[w5] + (b[w6] = cnt_[l[w6]][c[w6]]);
+            if (w6 == 6) cb[w6] = d->lookup(l[w6], bits[w6]);
+            if (w6 == 6) c[w6] = byte_t(cb[w6]);
+            if (w6 == 6) s[w6] = s[w5] + (b[w6] = uint8_t(cb[w6] >> 8));
 
-            if (w7 == 7) c[w7] = ari_[l[w7]][bits[w7]];
-            if (w7 == 7) s[w7] = s[w6] + (b[w7] = cnt_[l[w7]][c[w7]]);
+            if (w7 == 7) cb[w7] = d->lookup(l[w7], bits[w7]);
+            if (w7 == 7) c[w7] = byte_t(cb[w7]);
+            if (w7 == 7) s[w7] = s[w6] + (b[w7] = uint8_t(cb[w7] >> 8));
 
             if (terark_unlikely(s[N - 1] >= reader.size())) {
                 break;
@@ -1568,14 +1613,14 @@ bool decoder_o1::bitwise_decode_xN(const EntropyBits& data, valvec<byte_t>* reco
         size_t bit_count;
 
         do {
-            if (w0 == 0) { byte_t b = cnt_[l[w0]][c[w0]]; output->unchecked_push(l[w0] = c[w0]); if (HuffmanDecBreak(&bits[w0], &bit_count, b, &reader)) { remain = 0; break; } }
-            if (w1 == 1) { byte_t b = cnt_[l[w1]][c[w1]]; output->unchecked_push(l[w1] = c[w1]); if (HuffmanDecBreak(&bits[w1], &bit_count, b, &reader)) { remain = 1; break; } }
-            if (w2 == 2) { byte_t b = cnt_[l[w2]][c[w2]]; output->unchecked_push(l[w2] = c[w2]); if (HuffmanDecBreak(&bits[w2], &bit_count, b, &reader)) { remain = 2; break; } }
-            if (w3 == 3) { byte_t b = cnt_[l[w3]][c[w3]]; output->unchecked_push(l[w3] = c[w3]); if (HuffmanDecBreak(&bits[w3], &bit_count, b, &reader)) { remain = 3; break; } }
-            if (w4 == 4) { byte_t b = cnt_[l[w4]][c[w4]]; output->unchecked_push(l[w4] = c[w4]); if (HuffmanDecBreak(&bits[w4], &bit_count, b, &reader)) { remain = 4; break; } }
-            if (w5 == 5) { byte_t b = cnt_[l[w5]][c[w5]]; output->unchecked_push(l[w5] = c[w5]); if (HuffmanDecBreak(&bits[w5], &bit_count, b, &reader)) { remain = 5; break; } }
-            if (w6 == 6) { byte_t b = cnt_[l[w6]][c[w6]]; output->unchecked_push(l[w6] = c[w6]); if (HuffmanDecBreak(&bits[w6], &bit_count, b, &reader)) { remain = 6; break; } }
-            if (w7 == 7) { byte_t b = cnt_[l[w7]][c[w7]]; output->unchecked_push(l[w7] = c[w7]); if (HuffmanDecBreak(&bits[w7], &bit_count, b, &reader)) { remain = 7; break; } }
+            if (w0 == 0) { output->unchecked_push(l[w0] = c[w0]); if (HuffmanDecBreak(&bits[w0], &bit_count, b[w0], &reader)) { remain = 0; break; } }
+            if (w1 == 1) { output->unchecked_push(l[w1] = c[w1]); if (HuffmanDecBreak(&bits[w1], &bit_count, b[w1], &reader)) { remain = 1; break; } }
+            if (w2 == 2) { output->unchecked_push(l[w2] = c[w2]); if (HuffmanDecBreak(&bits[w2], &bit_count, b[w2], &reader)) { remain = 2; break; } }
+            if (w3 == 3) { output->unchecked_push(l[w3] = c[w3]); if (HuffmanDecBreak(&bits[w3], &bit_count, b[w3], &reader)) { remain = 3; break; } }
+            if (w4 == 4) { output->unchecked_push(l[w4] = c[w4]); if (HuffmanDecBreak(&bits[w4], &bit_count, b[w4], &reader)) { remain = 4; break; } }
+            if (w5 == 5) { output->unchecked_push(l[w5] = c[w5]); if (HuffmanDecBreak(&bits[w5], &bit_count, b[w5], &reader)) { remain = 5; break; } }
+            if (w6 == 6) { output->unchecked_push(l[w6] = c[w6]); if (HuffmanDecBreak(&bits[w6], &bit_count, b[w6], &reader)) { remain = 6; break; } }
+            if (w7 == 7) { output->unchecked_push(l[w7] = c[w7]); if (HuffmanDecBreak(&bits[w7], &bit_count, b[w7], &reader)) { remain = 7; break; } }
 
             assert(false);
         } while (false);
@@ -1614,8 +1659,9 @@ bool decoder_o1::bitwise_decode_xN(const EntropyBits& data, valvec<byte_t>* reco
                     break;                                                      \
                 }                                                               \
             }                                                                   \
-            byte_t c = ari_[l[w]][huf.bits >> (64 - BLOCK_BITS)];               \
-            uint8_t b = cnt_[l[w]][c];                                          \
+            uint16_t cb = d->lookup(l[w], huf.bits >> (64 - BLOCK_BITS));       \
+            byte_t c = byte_t(cb);                                              \
+            uint8_t b = uint8_t(cb >> 8);                                       \
             if (terark_unlikely(b > huf.bit_count)) return false;               \
             output->unchecked_push(l[w] = c);                                   \
             huf.bits <<= b;                                                     \
@@ -1694,5 +1740,106 @@ bool decoder_o1::bitwise_decode_xN(const EntropyBits& data, valvec<byte_t>* reco
 
 // --------------------------------------------------------------------------
 
+void decoder_o1_impl::build(decoder_o1_compact* d, size_t i, const byte_t** pptr) {
+    static constexpr size_t LUT_BITS = decoder_o1_compact::LUT_BITS;
+    HuffmanEncSymbol ctable[256];
+    HuffmanReadCTable(pptr, ctable);
+    auto& x = d->ctx_[i];
+    // codes of same length are consecutive in symbol order, and longer
+    // codes are smaller, so long codes are (first, base) per length
+    size_t n = 0;
+    for (size_t len = BLOCK_BITS; len > LUT_BITS; --len) {
+        x.base[len - LUT_BITS - 1] = uint8_t(n);
+        for (size_t j = 0; j < 256; ++j) {
+            if (ctable[j].bit_count != len) {
+                continue;
+            }
+            uint16_t code = uint16_t(ctable[j].bits << (BLOCK_BITS - len));
+            if (x.first[len - LUT_BITS - 1] > code) {
+                x.first[len - LUT_BITS - 1] = code;
+            }
+            d->long_[i][n++] = byte_t(j);
+        }
+    }
+    for (size_t j = 0; j < 256; ++j) {
+        size_t len = ctable[j].bit_count;
+        if (len == 0 || len > LUT_BITS) {
+            continue;
+        }
+        size_t code = size_t(ctable[j].bits) << (LUT_BITS - len);
+        uint16_t e = uint16_t(j | len << 8);
+        std::fill_n(x.lut + code, size_t(1) << (LUT_BITS - len), e);
+    }
+}
+
+decoder_o1_compact::decoder_o1_compact() {
+}
+
+decoder_o1_compact::decoder_o1_compact(fstring table, size_t* psize) {
+    init(table, psize);
+}
+
+void decoder_o1_compact::init(fstring table, size_t* psize) {
+    memset(&ctx_, 0, sizeof ctx_);
+    memset(&long_, 0, sizeof long_);
+    for (auto& x : ctx_) {
+        std::fill_n(x.first, BLOCK_BITS - LUT_BITS, uint16_t(0xFFFF));
+    }
+    decoder_o1_impl::init(this, table, psize);
+}
+
+inline uint16_t decoder_o1_compact::lookup(size_t l, size_t bits) const {
+    const context_t& x = ctx_[l];
+    uint16_t e = x.lut[bits >> (BLOCK_BITS - LUT_BITS)];
+    if (terark_likely(e >> 8)) {
+        return e;
+    }
+    for (size_t i = 0; i < BLOCK_BITS - LUT_BITS; ++i) {
+        if (bits >= x.first[i]) {
+            size_t len = LUT_BITS + 1 + i;
+            return long_[l][x.base[i] + ((bits - x.first[i]) >> (BLOCK_BITS - len))] | uint16_t(len << 8);
+        }
+    }
+    return uint16_t(255 << 8); // bad code, same as decoder_o1::cnt_ default
+}
+
+bool decoder_o1_compact::decode_x1(fstring data, valvec<byte_t>* record, TerarkContext* context) const {
+    auto bits = EntropyBytesToBits(data);
+    return bitwise_decode_x1(bits, record, context);
+}
+
+bool decoder_o1_compact::decode_x2(fstring data, valvec<byte_t>* record, TerarkContext* context) const {
+    auto bits = EntropyBytesToBits(data);
+    return bitwise_decode_x2(bits, record, context);
+}
+
+bool decoder_o1_compact::decode_x4(fstring data, valvec<byte_t>* record, TerarkContext* context) const {
+    auto bits = EntropyBytesToBits(data);
+    return bitwise_decode_x4(bits, record, context);
+}
+
+bool decoder_o1_compact::decode_x8(fstring data, valvec<byte_t>* record, TerarkContext* context) const {
+    auto bits = EntropyBytesToBits(data);
+    return bitwise_decode_x8(bits, record, context);
+}
+
+bool decoder_o1_compact::bitwise_decode_x1(const EntropyBits& data, valvec<byte_t>* record, TerarkContext* context) const {
+    return decoder_o1_impl::decode_x1(this, data, record);
+}
+
+bool decoder_o1_compact::bitwise_decode_x2(const EntropyBits& data, valvec<byte_t>* record, TerarkContext* context) const {
+    return decoder_o1_impl::decode_xN<2>(this, data, record, context);
+}
+
+bool decoder_o1_compact::bitwise_decode_x4(const EntropyBits& data, valvec<byte_t>* record, TerarkContext* context) const {
+    return decoder_o1_impl::decode_xN<4>(this, data, record, context);
+}
+
+bool decoder_o1_compact::bitwise_decode_x8(const EntropyBits& data, valvec<byte_t>* record, TerarkContext* context) const {
+    return decoder_o1_impl::decode_xN<8>(this, data, record, context);
+}
+
+// --------------------------------------------------------------------------
+
 
 }}
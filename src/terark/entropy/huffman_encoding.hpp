@@ -77,6 +77,8 @@ private:
     valvec<byte_t> table_;
 };
 
+struct decoder_o1_impl;
+
 class TERARK_DLL_EXPORT decoder_o1 {
 public:
     decoder_o1();
@@ -95,11 +97,48 @@ public:
     bool bitwise_decode_x8(const EntropyBits& data, valvec<byte_t>* record, TerarkContext* context) const;
 
 private:
-    template<size_t N>
-    bool bitwise_decode_xN(const EntropyBits& data, valvec<byte_t>* record, TerarkContext* context) const;
+    friend struct decoder_o1_impl;
+    uint16_t lookup(size_t l, size_t bits) const;
 
     byte_t ari_[257][1u << BLOCK_BITS];
     uint8_t cnt_[257][256];
 };
 
+/// Same bitstream as decoder_o1, but each context only keeps a
+/// 2^LUT_BITS entry (symbol, length) table for short codes and resolves
+/// longer codes canonically, so the whole image is ~200K instead of ~1.1M
+/// and the hot part of all contexts stays in L2.
+/// Like decoder_o1 it is a flat object, usable directly from mmap.
+class TERARK_DLL_EXPORT decoder_o1_compact {
+public:
+    static constexpr size_t LUT_BITS = 8;
+
+    decoder_o1_compact();
+    decoder_o1_compact(fstring table, size_t* psize = nullptr);
+
+    void init(fstring table, size_t* psize);
+
+    bool decode_x1(fstring data, valvec<byte_t>* record, TerarkContext* context) const;
+    bool decode_x2(fstring data, valvec<byte_t>* record, TerarkContext* context) const;
+    bool decode_x4(fstring data, valvec<byte_t>* record, TerarkContext* context) const;
+    bool decode_x8(fstring data, valvec<byte_t>* record, TerarkContext* context) const;
+
+    bool bitwise_decode_x1(const EntropyBits& data, valvec<byte_t>* record, TerarkContext* context) const;
+    bool bitwise_decode_x2(const EntropyBits& data, valvec<byte_t>* record, TerarkContext* context) const;
+    bool bitwise_decode_x4(const EntropyBits& data, valvec<byte_t>* record, TerarkContext* context) const;
+    bool bitwise_decode_x8(const EntropyBits& data, valvec<byte_t>* record, TerarkContext* context) const;
+
+private:
+    friend struct decoder_o1_impl;
+    uint16_t lookup(size_t l, size_t bits) const;
+
+    struct context_t {
+        uint16_t lut[1u << LUT_BITS];           // sym | len << 8, 0 for long codes
+        uint16_t first[BLOCK_BITS - LUT_BITS];  // first code of len LUT_BITS+1+i
+        uint8_t  base[BLOCK_BITS - LUT_BITS];   // its index in long_
+    };
+    context_t ctx_[257];
+    byte_t long_[257][256];
+};
+
 }}
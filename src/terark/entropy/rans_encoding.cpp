@@ -2,6 +2,12 @@
 #include <memory>
 #include <cmath>
 #include <terark/bitmanip.hpp>
+#include <terark/io/var_int.hpp>
+#include <terark/util/cpu_features.hpp>
+
+#if defined(TERARK_TARGET_DISPATCH)
+  #include <immintrin.h>
+#endif
 
 // --------------------------------------------------------------------------
 
@@ -672,10 +678,17 @@ decoder::decoder(fstring table, size_t* psize) {
     init(table, psize);
 }
 
+decoder::~decoder() {
+    delete[] slot32_.load(std::memory_order_relaxed);
+}
+
 void decoder::init(fstring table, size_t* psize) {
     const byte_t *cp = table.udata();
 
+    memset(syms_, 0, sizeof(syms_));
+    memset(ari_, 0, sizeof(ari_));
     Rans64BuildDTable(&cp, ari_, syms_);
+    delete[] slot32_.exchange(nullptr, std::memory_order_relaxed);
     if (psize != nullptr) {
         *psize = cp - table.udata();
     }
@@ -849,6 +862,269 @@ size_t decoder::decode_xN(fstring data, valvec<byte_t>* record, TerarkContext* c
     return ptr - data.udata();
 }
 
+// --------------------------------------------------------------------------
+// x32: 32 interleaved 32 bit states in [RANS_L, RANS_L << 16), symbol i is
+// coded by state i % 32, renormalization reads/writes 16 bits.
+// stream: tag, var_uint(record size), 32 * 4 bytes final states, words
+
+static constexpr byte_t X32_TAG = 0xA5;
+static constexpr size_t X32_LANES = 32;
+
+static inline uint32_t X32Freq(uint32_t slot) { return (slot >> 8 & 0xFFF) + 1; }
+
+static inline void
+Rans32EncRenorm(uint64_t* r, byte_t** pptr, ContextBuffer& buffer, size_t freq) {
+    uint64_t x_max = ((RANS_L >> TF_SHIFT) << 16) * freq;
+    if (*r >= x_max) {
+        uint16_t w = uint16_t(*r);
+        Rans64EncWrite(pptr, &w, 2, buffer);
+        *r >>= 16;
+    }
+}
+
+EntropyBytes encoder::encode_x32(fstring record, TerarkContext* context) const {
+    auto ctx_buffer = context->alloc();
+    ctx_buffer.resize(record.size() * 5 / 4 + 4 * X32_LANES + 16);
+    byte_t* ptr = ctx_buffer.data() + ctx_buffer.size();
+    const byte_t* record_data = record.udata();
+    uint64_t rans[X32_LANES];
+    for (size_t j = 0; j < X32_LANES; ++j) {
+        rans[j] = RANS_L;
+    }
+    for (size_t i = record.size(); i-- > 0; ) {
+        uint64_t* r = &rans[i % X32_LANES];
+        const Rans64EncSymbol* s = &syms_[record_data[i]];
+        Rans32EncRenorm(r, &ptr, ctx_buffer, s->freq);
+        Rans64EncPutSymbol(r, s, TF_SHIFT);
+        assert(*r < (RANS_L << 16));
+    }
+    for (size_t j = X32_LANES; j-- > 0; ) {
+        uint32_t x = uint32_t(rans[j]);
+        Rans64EncWrite(&ptr, &x, 4, ctx_buffer);
+    }
+    byte_t head[16], *hp = head;
+    *hp++ = X32_TAG;
+    hp = save_var_uint64(hp, record.size());
+    Rans64EncWrite(&ptr, head, hp - head, ctx_buffer);
+    return EntropyBytes{
+        fstring{ptr, ctx_buffer.data() + ctx_buffer.size() - ptr},
+        std::move(ctx_buffer)
+    };
+}
+
+// 16K table is only needed by decode_x32, concurrent first calls may each
+// build it, one of them is kept
+const uint32_t* decoder::get_slot32() const {
+    uint32_t* slot32 = slot32_.load(std::memory_order_acquire);
+    if (terark_likely(nullptr != slot32)) {
+        return slot32;
+    }
+    std::unique_ptr<uint32_t[]> built(new uint32_t[TOTFREQ]);
+    for (size_t m = 0; m < TOTFREQ; ++m) {
+        const Rans64DecSymbol& sym = syms_[ari_[m]];
+        uint32_t freq_1 = sym.freq ? sym.freq - 1 : 0;
+        uint32_t bias = sym.freq ? uint32_t(m - sym.start) : 0;
+        built[m] = ari_[m] | freq_1 << 8 | bias << 20;
+    }
+    if (slot32_.compare_exchange_strong(slot32, built.get(),
+                                        std::memory_order_acq_rel)) {
+        return built.release();
+    }
+    return slot32; // built by another thread
+}
+
+static inline bool
+X32DecHead(fstring data, const byte_t** pptr, size_t* psize) {
+    const byte_t* ptr = data.udata();
+    const byte_t* end = ptr + data.size();
+    if (data.size() < 2 + 4 * X32_LANES || *ptr != X32_TAG) {
+        return false;
+    }
+    *psize = load_var_uint64(ptr + 1, &ptr);
+    if (end - ptr < ptrdiff_t(4 * X32_LANES)) {
+        return false;
+    }
+    *pptr = ptr;
+    return true;
+}
+
+static inline bool
+X32DecStep(uint32_t* r, const uint32_t* slot32, byte_t* out,
+           const byte_t** pptr, const byte_t* end) {
+    uint32_t x = *r;
+    uint32_t slot = slot32[x & (TOTFREQ - 1)];
+    x = X32Freq(slot) * (x >> TF_SHIFT) + (slot >> 20);
+    *out = byte_t(slot);
+    if (x < RANS_L) {
+        if (end - *pptr < 2) {
+            return false;
+        }
+        x = x << 16 | unaligned_load<uint16_t>(*pptr);
+        *pptr += 2;
+    }
+    *r = x;
+    return true;
+}
+
+#if defined(TERARK_TARGET_DISPATCH)
+// lane i takes the k'th loaded word, k = popcount(mask & ((1 << i) - 1))
+static const struct X32RenormShuffle {
+    uint32_t idx[256][8];
+    X32RenormShuffle() {
+        for (uint32_t mask = 0; mask < 256; ++mask) {
+            for (uint32_t i = 0, k = 0; i < 8; ++i) {
+                idx[mask][i] = k;
+                k += mask >> i & 1;
+            }
+        }
+    }
+} g_x32_shuffle;
+
+static inline TERARK_TARGET("avx2")
+__m256i X32DecStepAvx2(__m256i x, const uint32_t* slot32, __m256i* sym) {
+    const __m256i m = _mm256_and_si256(x, _mm256_set1_epi32(TOTFREQ - 1));
+    const __m256i slot = _mm256_i32gather_epi32((const int*)slot32, m, 4);
+    __m256i freq = _mm256_and_si256(_mm256_srli_epi32(slot, 8), _mm256_set1_epi32(0xFFF));
+    freq = _mm256_add_epi32(freq, _mm256_set1_epi32(1));
+    x = _mm256_mullo_epi32(freq, _mm256_srli_epi32(x, TF_SHIFT));
+    *sym = _mm256_and_si256(slot, _mm256_set1_epi32(0xFF));
+    return _mm256_add_epi32(x, _mm256_srli_epi32(slot, 20));
+}
+
+// requires at least 16 readable bytes at *pptr
+static inline TERARK_TARGET("avx2")
+__m256i X32DecRenormAvx2(__m256i x, const byte_t** pptr) {
+    const __m256i need = _mm256_cmpeq_epi32(_mm256_srli_epi32(x, 16),
+                                            _mm256_setzero_si256());
+    const uint32_t mask = _mm256_movemask_ps(_mm256_castsi256_ps(need));
+    if (mask) {
+        __m128i raw = _mm_loadu_si128((const __m128i*)*pptr);
+        __m256i words = _mm256_cvtepu16_epi32(raw);
+        __m256i idx = _mm256_loadu_si256((const __m256i*)g_x32_shuffle.idx[mask]);
+        words = _mm256_permutevar8x32_epi32(words, idx);
+        __m256i nx = _mm256_or_si256(_mm256_slli_epi32(x, 16), words);
+        x = _mm256_blendv_epi8(x, nx, need);
+        *pptr += 2 * fast_popcount32(mask);
+    }
+    return x;
+}
+
+// same as X32DecRenormAvx2 on x[0..3] in order, but loads are independent
+// requires at least 64 readable bytes at *pptr
+static inline TERARK_TARGET("avx2")
+void X32DecRenorm4Avx2(__m256i x[4], const byte_t** pptr) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i need[4];
+    uint32_t mask[4];
+    for (size_t v = 0; v < 4; ++v) {
+        need[v] = _mm256_cmpeq_epi32(_mm256_srli_epi32(x[v], 16), zero);
+        mask[v] = _mm256_movemask_ps(_mm256_castsi256_ps(need[v]));
+    }
+    const byte_t* ptr = *pptr;
+    for (size_t v = 0; v < 4; ++v) {
+        __m128i raw = _mm_loadu_si128((const __m128i*)ptr);
+        __m256i words = _mm256_cvtepu16_epi32(raw);
+        __m256i idx = _mm256_loadu_si256((const __m256i*)g_x32_shuffle.idx[mask[v]]);
+        words = _mm256_permutevar8x32_epi32(words, idx);
+        __m256i nx = _mm256_or_si256(_mm256_slli_epi32(x[v], 16), words);
+        x[v] = _mm256_blendv_epi8(x[v], nx, need[v]);
+        ptr += 2 * fast_popcount32(mask[v]);
+    }
+    *pptr = ptr;
+}
+
+static TERARK_TARGET("avx2")
+size_t decode_x32_avx2(fstring data, valvec<byte_t>* record, const uint32_t* slot32) {
+    const byte_t* ptr;
+    const byte_t* end = data.udata() + data.size();
+    size_t record_size;
+    if (!X32DecHead(data, &ptr, &record_size)) {
+        return 0;
+    }
+    record->resize_no_init(record_size);
+    byte_t* out = record->data();
+    __m256i x[4];
+    for (size_t v = 0; v < 4; ++v) {
+        x[v] = _mm256_loadu_si256((const __m256i*)ptr + v);
+    }
+    ptr += 4 * X32_LANES;
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    size_t i = 0;
+    for (; i + X32_LANES <= record_size; i += X32_LANES) {
+        __m256i sym[4];
+        for (size_t v = 0; v < 4; ++v) {
+            x[v] = X32DecStepAvx2(x[v], slot32, &sym[v]);
+        }
+        // 4 x 8 lanes of uint32 sym -> 32 bytes in lane order
+        __m256i s01 = _mm256_packus_epi32(sym[0], sym[1]);
+        __m256i s23 = _mm256_packus_epi32(sym[2], sym[3]);
+        __m256i s03 = _mm256_packus_epi16(s01, s23);
+        s03 = _mm256_permutevar8x32_epi32(s03, order);
+        _mm256_storeu_si256((__m256i*)(out + i), s03);
+        if (terark_likely(end - ptr >= 16 * 4)) {
+            X32DecRenorm4Avx2(x, &ptr);
+        }
+        else {
+            for (size_t v = 0; v < 4; ++v) {
+                if (end - ptr >= 16) {
+                    x[v] = X32DecRenormAvx2(x[v], &ptr);
+                    continue;
+                }
+                alignas(32) uint32_t r[8];
+                _mm256_store_si256((__m256i*)r, x[v]);
+                for (size_t j = 0; j < 8; ++j) {
+                    if (r[j] < RANS_L) {
+                        if (end - ptr < 2) return 0;
+                        r[j] = r[j] << 16 | unaligned_load<uint16_t>(ptr);
+                        ptr += 2;
+                    }
+                }
+                x[v] = _mm256_load_si256((const __m256i*)r);
+            }
+        }
+    }
+    alignas(32) uint32_t rans[X32_LANES];
+    for (size_t v = 0; v < 4; ++v) {
+        _mm256_store_si256((__m256i*)rans + v, x[v]);
+    }
+    for (size_t j = 0; i < record_size; ++i, ++j) {
+        if (!X32DecStep(&rans[j], slot32, out + i, &ptr, end)) return 0;
+    }
+    for (size_t j = 0; j < X32_LANES; ++j) {
+        if (rans[j] != RANS_L) return 0;
+    }
+    return ptr - data.udata();
+}
+#endif
+
+size_t decoder::decode_x32(fstring data, valvec<byte_t>* record) const {
+    record->risk_set_size(0);
+    const uint32_t* slot32 = get_slot32();
+#if defined(TERARK_TARGET_DISPATCH)
+    if (g_cpu_features.avx2) {
+        return decode_x32_avx2(data, record, slot32);
+    }
+#endif
+    const byte_t* ptr;
+    const byte_t* end = data.udata() + data.size();
+    size_t record_size;
+    if (!X32DecHead(data, &ptr, &record_size)) {
+        return 0;
+    }
+    record->resize_no_init(record_size);
+    byte_t* out = record->data();
+    uint32_t rans[X32_LANES];
+    memcpy(rans, ptr, sizeof(rans));
+    ptr += sizeof(rans);
+    for (size_t i = 0; i < record_size; ++i) {
+        if (!X32DecStep(&rans[i % X32_LANES], slot32, out + i, &ptr, end)) return 0;
+    }
+    for (size_t j = 0; j < X32_LANES; ++j) {
+        if (rans[j] != RANS_L) return 0;
+    }
+    return ptr - data.udata();
+}
+
 // --------------------------------------------------------------------------
 
 encoder_o1::encoder_o1() {
@@ -3,6 +3,7 @@
 #include <terark/fstring.hpp>
 #include <terark/valvec.hpp>
 #include "entropy_base.hpp"
+#include <atomic>
 
 namespace terark { namespace rANS_static_64 {
 
@@ -53,6 +54,10 @@ namespace terark { namespace rANS_static_64 {
         EntropyBytes encode_x4(fstring record, TerarkContext* context) const;
         EntropyBytes encode_x8(fstring record, TerarkContext* context) const;
 
+        /// 32 interleaved 32 bit states with 16 bit renormalization, the
+        /// stream has its own format tag and only decode_x32 can decode it
+        EntropyBytes encode_x32(fstring record, TerarkContext* context) const;
+
     private:
         template<size_t N>
         EntropyBytes encode_xN(fstring record, TerarkContext* context, bool check) const;
@@ -65,6 +70,9 @@ namespace terark { namespace rANS_static_64 {
     public:
         decoder();
         decoder(fstring table, size_t* psize = nullptr);
+        decoder(const decoder&) = delete;
+        decoder& operator=(const decoder&) = delete;
+        ~decoder();
 
         void init(fstring table, size_t* psize);
 
@@ -74,12 +82,19 @@ namespace terark { namespace rANS_static_64 {
         size_t decode_x4(fstring data, valvec<byte_t>* record, TerarkContext* context) const;
         size_t decode_x8(fstring data, valvec<byte_t>* record, TerarkContext* context) const;
 
+        /// decode stream of encode_x32, 8 lanes per step with avx2 gather
+        /// if cpu supports it, returns 0 if data is not such a stream
+        size_t decode_x32(fstring data, valvec<byte_t>* record) const;
+
     private:
         template<size_t N>
         size_t decode_xN(fstring data, valvec<byte_t>* record, TerarkContext* context, bool check) const;
+        const uint32_t* get_slot32() const;
 
         Rans64DecSymbol syms_[256];
         byte_t ari_[TOTFREQ];
+        // for decode_x32, built on first use, sym | (freq-1) << 8 | (slot-start) << 20
+        mutable std::atomic<uint32_t*> slot32_{nullptr};
     };
 
     class TERARK_DLL_EXPORT encoder_o1 {
@@ -3,7 +3,13 @@
 
 #include <inttypes.h>
 
+#include <condition_variable>
 #include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <terark/util/fstrvec.hpp>
+#include <terark/util/function.hpp>
 namespace {
 static constexpr uint32_t invalid_pos = uint32_t(-1);
 }  // namespace
@@ -144,6 +150,92 @@ void CritBitTriePackedBuilder::encode() {
   }
 }
 
+void CritBitTriePackedBuilder::build(const std::function<fstring()>& next,
+                                     size_t threads) {
+  threads = std::max<size_t>(1, std::min<size_t>(threads, trie_nums_));
+  if (threads == 1) {
+    for (size_t i = 0; i < num_words_; ++i) {
+      insert(next(), i / entry_per_trie_);
+    }
+    encode();
+    return;
+  }
+  // each sub trie only depends on its own keys, the calling thread copies
+  // the keys of a sub trie and queues it, at most 2*threads are queued
+  typedef std::pair<size_t, std::unique_ptr<fstrvec> > Task;
+  std::mutex mtx;
+  std::condition_variable cond;
+  std::deque<Task> queue;
+  bool eof = false;
+  auto worker = [&]() {
+    for (;;) {
+      Task task;
+      {
+        std::unique_lock<std::mutex> lock(mtx);
+        cond.wait(lock, [&]() { return !queue.empty() || eof; });
+        if (queue.empty()) {
+          return;
+        }
+        task = std::move(queue.front());
+        queue.pop_front();
+      }
+      cond.notify_all();
+      auto& builder = builder_list_[task.first];
+      const fstrvec& keys = *task.second;
+      for (size_t i = 0; i < keys.size(); ++i) {
+        builder.insert(keys[i]);
+      }
+      builder.node_storage_.pop_back();
+      builder.encode();
+      builder.compress_diff_bit_array();
+    }
+  };
+  valvec<std::thread> workers(threads, valvec_reserve());
+  // on exception, drop pending tasks and join workers before unwinding,
+  // destroying a joinable std::thread calls std::terminate
+  TERARK_SCOPE_EXIT(
+    if (!workers.empty() && workers[0].joinable()) {
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        queue.clear();
+        eof = true;
+      }
+      cond.notify_all();
+      for (auto& th : workers) {
+        th.join();
+      }
+    }
+  );
+  for (size_t i = 0; i < threads; ++i) {
+    workers.unchecked_emplace_back(worker);
+  }
+  for (size_t t = 0, beg = 0; t < trie_nums_; ++t, beg += entry_per_trie_) {
+    size_t num = std::min<size_t>(entry_per_trie_, num_words_ - beg);
+    std::unique_ptr<fstrvec> keys(new fstrvec);
+    keys->reserve(num);
+    for (size_t i = 0; i < num; ++i) {
+      keys->push_back(next());
+    }
+    std::unique_lock<std::mutex> lock(mtx);
+    cond.wait(lock, [&]() { return queue.size() < 2 * threads; });
+    queue.emplace_back(t, std::move(keys));
+    lock.unlock();
+    cond.notify_all();
+  }
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    eof = true;
+  }
+  cond.notify_all();
+  for (auto& th : workers) {
+    th.join();
+  }
+  max_layer_ = 0;
+  for (auto& builder : builder_list_) {
+    max_layer_ = std::max(max_layer_, builder.layer_);
+  }
+}
+
 void CritBitTriePacked::save(
     std::function<void(const void*, size_t)> append) const {
   IndexCBTPrefixHeader header;
@@ -32,6 +32,10 @@ class CritBitTriePackedBuilder {
   ~CritBitTriePackedBuilder();
   void insert(fstring key, size_t pos);
   void encode();
+  /// insert num_words() keys in order from next() and encode, sub tries are
+  /// inserted and encoded by up to `threads` threads, while keys are read
+  /// by the calling thread, the result is same as insert() + encode()
+  void build(const std::function<fstring()>& next, size_t threads);
   size_t num_words() const { return num_words_; }
   size_t trie_nums() const { return trie_nums_; }
   size_t total_key_size() const { return total_key_size_; }
@@ -173,6 +173,7 @@ Patricia::Patricia() {
     m_dyn_sigma = 256;
     m_is_dag = true;
     m_insert = nullptr;
+    m_erase = nullptr;
     m_valsize = 0;
 }
 Patricia::~Patricia() {}
@@ -466,6 +467,7 @@ void PatriciaMem<Align>::mempool_set_readonly() {
 #endif
   }
   m_insert = (insert_func_t)&PatriciaMem::insert_readonly_throw;
+  m_erase = (erase_func_t)&PatriciaMem::erase_readonly_throw;
   m_writing_concurrent_level = NoWriteReadOnly;
 }
 
@@ -478,6 +480,14 @@ case SingleThreadShared : m_insert = (insert_func_t)&MainPatricia::insert_one_wr
 case OneWriteMultiRead  : m_insert = (insert_func_t)&MainPatricia::insert_one_writer<OneWriteMultiRead >; break;
 case MultiWriteMultiRead: m_insert = (insert_func_t)&MainPatricia::insert_multi_writer;                   break;
     }
+    switch (conLevel) {
+default: TERARK_DIE("Unknown == conLevel"); break;
+case NoWriteReadOnly    : m_erase = (erase_func_t)&MainPatricia::erase_readonly_throw;             break;
+case SingleThreadStrict : m_erase = (erase_func_t)&MainPatricia::erase_impl<SingleThreadStrict >; break;
+case SingleThreadShared : m_erase = (erase_func_t)&MainPatricia::erase_impl<SingleThreadShared >; break;
+case OneWriteMultiRead  : m_erase = (erase_func_t)&MainPatricia::erase_impl<OneWriteMultiRead  >; break;
+case MultiWriteMultiRead: m_erase = (erase_func_t)&MainPatricia::erase_impl<MultiWriteMultiRead>; break;
+    }
 }
 
 // to avoid too large backup buffer in MultiWriteMultiRead insert
@@ -1224,14 +1234,6 @@ MainPatricia::insert_one_writer(fstring key, void* value, WriterToken* token) {
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 auto update_curr_ptr = [&](size_t newCurr, size_t nodeIncNum) {
     assert(newCurr != curr);
-    if (ConLevel != SingleThreadStrict) {
-        ullong age = token->m_link.verseq;
-        m_lazy_free_list_sgl.push_back({age, uint32_t(curr), ni.node_size});
-        m_lazy_free_list_sgl.m_mem_size += ni.node_size;
-    }
-    else {
-        free_node<SingleThreadStrict>(curr, ni.node_size, nullptr);
-    }
     if (ConLevel < OneWriteMultiRead)
         SingleThreadShared_check_for_sync_token_list(),
         a = reinterpret_cast<PatriciaNode*>(m_mempool.data());
@@ -1241,6 +1243,14 @@ auto update_curr_ptr = [&](size_t newCurr, size_t nodeIncNum) {
     this->m_total_zpath_len += key.size() - pos - nodeIncNum;
     a[curr_slot].child = uint32_t(newCurr);
     maximize(this->m_max_word_len, key.size());
+    if (ConLevel != SingleThreadStrict) {
+        ullong age = lazy_free_age(); // after curr is unlinked
+        m_lazy_free_list_sgl.push_back({age, uint32_t(curr), ni.node_size});
+        m_lazy_free_list_sgl.m_mem_size += ni.node_size;
+    }
+    else {
+        free_node<SingleThreadStrict>(curr, ni.node_size, nullptr);
+    }
 };
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // begin search key...
@@ -1595,20 +1605,7 @@ MarkFinalStateOmitSetNodeInfo:
 }
 }
 
-bool
-MainPatricia::insert_multi_writer(fstring key, void* value, WriterToken* token) {
-    constexpr auto ConLevel = MultiWriteMultiRead;
-    assert(MultiWriteMultiRead == m_writing_concurrent_level);
-    assert(nullptr != m_token_tail);
-    assert(ThisThreadID() == token->m_thread_id);
-    assert(token->m_min_age <= token->m_link.verseq);
-    assert(token->m_min_age <= m_token_tail->m_link.verseq);
-    assert(token->m_link.verseq <= m_token_tail->m_link.verseq);
-    TERARK_ASSERT_GE(token->m_link.verseq, m_dummy.m_min_age);
-    auto const lzf = reinterpret_cast<LazyFreeListTLS*>(token->m_tls);
-    assert(nullptr != lzf);
-    assert(static_cast<LazyFreeListTLS*>(m_mempool_lock_free.tls()) == lzf);
-    assert(AcquireDone == token->m_flags.state);
+void MainPatricia::multi_writer_sync_tls(WriterToken* token, LazyFreeListTLS* lzf) {
     if (terark_unlikely(token->m_flags.is_head)) {
         //now is_head is set before m_dummy.m_link.next, this assert
         //may fail false positive
@@ -1637,6 +1634,23 @@ MainPatricia::insert_multi_writer(fstring key, void* value, WriterToken* token)
             }
         }
     }
+}
+
+bool
+MainPatricia::insert_multi_writer(fstring key, void* value, WriterToken* token) {
+    constexpr auto ConLevel = MultiWriteMultiRead;
+    assert(MultiWriteMultiRead == m_writing_concurrent_level);
+    assert(nullptr != m_token_tail);
+    assert(ThisThreadID() == token->m_thread_id);
+    assert(token->m_min_age <= token->m_link.verseq);
+    assert(token->m_min_age <= m_token_tail->m_link.verseq);
+    assert(token->m_link.verseq <= m_token_tail->m_link.verseq);
+    TERARK_ASSERT_GE(token->m_link.verseq, m_dummy.m_min_age);
+    auto const lzf = reinterpret_cast<LazyFreeListTLS*>(token->m_tls);
+    assert(nullptr != lzf);
+    assert(static_cast<LazyFreeListTLS*>(m_mempool_lock_free.tls()) == lzf);
+    assert(AcquireDone == token->m_flags.state);
+    multi_writer_sync_tls(token, lzf);
     auto const a = reinterpret_cast<PatriciaNode*>(m_mempool.data());
     bool is_value_inited = false;
     size_t const valsize = m_valsize;
@@ -1688,7 +1702,7 @@ auto update_curr_ptr_concurrent = [&](size_t newCurr, size_t nodeIncNum, int lin
     }
     if (cas_weak(a[curr_slot].child, uint32_t(curr), uint32_t(newCurr))) {
         as_atomic(a[parent].flags).fetch_and(uint08_t(~FLAG_lock), std::memory_order_release);
-        ullong age = token->m_link.verseq;
+        ullong age = lazy_free_age();
         assert(age >= m_dummy.m_min_age);
         maximize(lzf->m_max_word_len, key.size());
         lzf->m_n_nodes += nodeIncNum;
@@ -1957,30 +1971,40 @@ assert(pos < key.size());
     //
     assert(a->bytes == m_mempool.data());
     assert(reinterpret_cast<PatriciaNode*>(m_mempool.data()) == a);
-    assert(0 == a[curr].meta.b_lazy_free);
     assert(0 == a[curr].meta.n_zpath_len);
-    init_token_value_mw(-1, -1, suffix_node); // must before cas set child
-    uint32_t nil = nil_state;
-    if (cas_weak(a[curr+2+ch].child, nil, uint32_t(suffix_node))) {
-        as_atomic(a[curr+1].big.n_children).fetch_add(1, std::memory_order_relaxed);
-        lzf->m_n_nodes += 1;
-        lzf->m_n_words += 1;
-        lzf->m_adfa_total_words_len += key.size();
-        lzf->m_total_zpath_len += key.size() - pos - 1;
-        if (pos + 1 < key.size()) {
-            lzf->m_zpath_states += zp_states_inc;
+    init_token_value_mw(-1, -1, suffix_node); // must before set child
+    // lock curr, erase may be unlinking or copying curr(lazy_free), or
+    // removing a child from curr(lock)
+    PatriciaNode curr_unlock, curr_locked;
+    curr_unlock = as_atomic(a[curr]).load(std::memory_order_relaxed);
+    curr_unlock.meta.b_lazy_free = 0;
+    curr_unlock.meta.b_lock = 0;
+    curr_locked = curr_unlock;
+    curr_locked.meta.b_lock = 1;
+    if (cas_weak(a[curr], curr_unlock, curr_locked)) {
+        if (nil_state == a[curr+2+ch].child) {
+            as_atomic(a[curr+2+ch].child).store(uint32_t(suffix_node), std::memory_order_release);
+            as_atomic(a[curr+1].big.n_children).fetch_add(1, std::memory_order_relaxed);
+            as_atomic(a[curr].flags).fetch_and(uint08_t(~FLAG_lock), std::memory_order_release);
+            lzf->m_n_nodes += 1;
+            lzf->m_n_words += 1;
+            lzf->m_adfa_total_words_len += key.size();
+            lzf->m_total_zpath_len += key.size() - pos - 1;
+            if (pos + 1 < key.size()) {
+                lzf->m_zpath_states += zp_states_inc;
+            }
+            maximize(lzf->m_max_word_len, key.size());
+            return true;
         }
-        maximize(lzf->m_max_word_len, key.size());
-        return true;
-    }
-    else { // curr has updated by other threads
-        free_node<MultiWriteMultiRead>(suffix_node, node_size(a + suffix_node, valsize), lzf);
-        if (csppDebugLevel >= 3)
-            fprintf(stderr,
-                "thread-%08zX: retry %zd, set root child confict(root(=curr) = %zd)\n",
-                ThisThreadID(), n_retry, curr);
-        goto retry;
+        as_atomic(a[curr].flags).fetch_and(uint08_t(~FLAG_lock), std::memory_order_release);
     }
+    // curr has updated by other threads
+    free_node<MultiWriteMultiRead>(suffix_node, node_size(a + suffix_node, valsize), lzf);
+    if (csppDebugLevel >= 3)
+        fprintf(stderr,
+            "thread-%08zX: retry %zd, set fast node child confict(curr = %zd)\n",
+            ThisThreadID(), n_retry, curr);
+    goto retry;
 }
 ForkBranch: {
     if (a[curr].meta.b_is_final) {
@@ -2073,13 +2097,27 @@ SplitZpath: {
 
 // FastNode: cnt_type = 15 always has value space
 MarkFinalStateOnFastNode: {
-    assert(0 == a[curr].meta.b_lazy_free);
     assert(0 == a[curr].meta.n_zpath_len);
     size_t valpos = AlignSize * (curr + 2 + 256);
-    if (as_atomic(a[curr].flags).fetch_or(FLAG_set_final, std::memory_order_acq_rel) & FLAG_set_final) {
+    auto& flags = as_atomic(a[curr].flags);
+    uint08_t old_flags = flags.load(std::memory_order_relaxed);
+    do {
+        if (old_flags & FLAG_lazy_free)
+            goto retry; // being copied or unlinked by erase
+        if (old_flags & FLAG_set_final)
+            break;
+    } while (!flags.compare_exchange_weak(old_flags,
+                uint08_t(old_flags | FLAG_set_final),
+                std::memory_order_acq_rel, std::memory_order_relaxed));
+    if (old_flags & FLAG_set_final) {
       // very rare: other thread set final
-      // FLAG_set_final is permanent for FastNode: once set, never clear
-      while (!(as_atomic(a[curr].flags).load(std::memory_order_relaxed) & FLAG_final)) {
+      // FLAG_set_final is permanent for FastNode: once set, only erase clear
+      for (;;) {
+          auto cur_flags = flags.load(std::memory_order_relaxed);
+          if (cur_flags & FLAG_final)
+              break;
+          if (!(cur_flags & FLAG_set_final))
+              goto retry; // erased by other thread
           _mm_pause();
       }
       token->m_value = (char*)a->chars + valpos;
@@ -2289,6 +2327,10 @@ MainPatricia::add_state_move(size_t curr, byte_t ch,
                         }
                     }
                 }
+                if (a[curr].meta.b_is_final) { // zpath is empty
+                    tiny_memcpy_align_4(a + node + 2 + 256,
+                                        a + curr + 10 + n_children, valsize);
+                }
                 assert(nil_state == a[node+2+ch].child);
                 a[node+2+ch].child = suffix_node;
                 break;
@@ -2354,6 +2396,507 @@ MainPatricia::add_state_move(size_t curr, byte_t ch,
     return node;
 }
 
+// remove transition curr[ch], curr must not be a fast node,
+// the result node keeps curr's zpath and value
+template<MainPatricia::ConcurrentLevel ConLevel>
+size_t
+MainPatricia::del_state_move(size_t curr, byte_t ch, size_t valsize, LazyFreeListTLS* tls) {
+    assert(curr < total_states());
+    auto a = reinterpret_cast<PatriciaNode*>(m_mempool.data());
+    assert(15 != a[curr].meta.n_cnt_type);
+    byte_t   labels[256];
+    uint32_t childs[256];
+    size_t   n = 0;
+    for_each_move(curr, [&](size_t child, size_t label) {
+        if (label != ch) {
+            labels[n] = byte_t(label);
+            childs[n] = uint32_t(child);
+            n++;
+        }
+    });
+    assert(n + 1 == num_children(curr));
+    assert(n > 0 || a[curr].meta.b_is_final);
+    size_t  old_cnt_type = a[curr].meta.n_cnt_type;
+    size_t  old_skip = s_skip_slots[old_cnt_type];
+    size_t  zplen = a[curr].meta.n_zpath_len;
+    size_t  aligned_valzplen = pow2_align_up(zplen, AlignSize);
+    if (a[curr].meta.b_is_final) {
+        aligned_valzplen += valsize;
+    }
+    size_t  cnt_type = n <= 6 ? n : n <= 16 ? 7 : 8;
+    size_t  skip = s_skip_slots[cnt_type];
+    size_t  node = alloc_node<ConLevel>(AlignSize*(skip + n) + aligned_valzplen, tls);
+    if (ConLevel >= OneWriteMultiRead && mem_alloc_fail == node)
+        return size_t(-1);
+    if (ConLevel < OneWriteMultiRead)
+        a = reinterpret_cast<PatriciaNode*>(m_mempool.data());
+    PatriciaNode* p = a + node;
+    memset(p, 0, AlignSize*skip);
+    p->meta.n_cnt_type = byte_t(cnt_type);
+    p->meta.b_is_final = a[curr].meta.b_is_final;
+    p->meta.n_zpath_len = byte_t(zplen);
+    switch (cnt_type) {
+    default: // 0 == cnt_type
+        break;
+    case 1: case 2: case 3: case 4: case 5: case 6:
+        memcpy(p->bytes + 2, labels, n); // meta.c_label may span 2 slots
+        break;
+    case 7: // cnt in [ 7, 16 ]
+        p->big.n_children = uint16_t(n);
+        memcpy(p[1].bytes, labels, n);
+        break;
+    case 8: { // cnt >= 17
+        p->big.n_children = uint16_t(n);
+        uint32_t* bits = &p[2].child;
+        for (size_t i = 0; i < n; i++) {
+            terark_bit_set1(bits, labels[i]);
+        }
+        size_t rank1 = 0;
+        for (size_t i = 0; i < 4; ++i) {
+            p[1].bytes[i] = byte_t(rank1);
+            ullong w = unaligned_load<uint64_t>(bits, i);
+            rank1 += fast_popcount64(w);
+        }
+        break; }
+    }
+    cpfore(&p[skip].child, childs, n);
+    small_memcpy_align_4(p + skip + n,
+                         a + curr + old_skip + n + 1, aligned_valzplen);
+  #if !defined(NDEBUG)
+    if (ConLevel != MultiWriteMultiRead || falseConcurrent) {
+        assert(num_children(node) == n);
+        assert(nil_state == state_move(node, ch));
+        for (size_t i = 0; i < n; i++) {
+            assert(state_move(node, labels[i]) == childs[i]);
+        }
+        if (zplen) {
+            assert(get_zpath_data(node) == get_zpath_data(curr));
+        }
+    }
+  #endif
+    return node;
+}
+
+bool Patricia::erase_readonly_throw(fstring, WriterToken*) {
+    assert(NoWriteReadOnly == m_writing_concurrent_level);
+    THROW_STD(logic_error, "invalid operation: erase from readonly trie");
+}
+
+// Erase clears the final bit and reclaims what becomes unreachable:
+//  1. root: clear final bit in place, the inline value space of the empty
+//     key is reused by the next insert of the empty key, this is the only
+//     case a token's value may be overwritten before the token is released
+//  2. node has children: copy the node with final bit cleared, a fast node
+//     is copied with its value space, other nodes without value space
+//  3. leaf node: unlink the chain of non-final single child nodes ending at
+//     the leaf from the nearest branch point(root, final node or node with
+//     multiple children), fast branch point is updated in place, others are
+//     copied by del_state_move, thus emptied fast nodes are pruned as well
+//     and no reachable node is non-final and childless.
+// Replaced and unlinked nodes go to lazy free list aged by lazy_free_age()
+// after they are unlinked, they are freed when all tokens have passed the
+// age, as insert does.
+// MultiWriteMultiRead: nodes to be replaced or unlinked are locked by
+// b_lazy_free, fast nodes are updated in place only under b_lock, so an
+// inserter can not add child to or mark final a fast node being erased.
+template<MainPatricia::ConcurrentLevel ConLevel>
+bool MainPatricia::erase_impl(fstring key, WriterToken* token) {
+    assert(AcquireDone == token->m_flags.state);
+    assert(m_writing_concurrent_level == ConLevel);
+    LazyFreeListTLS* lzf = nullptr;
+    if (ConLevel >= MultiWriteMultiRead) {
+        lzf = reinterpret_cast<LazyFreeListTLS*>(token->m_tls);
+        assert(nullptr != lzf);
+        assert(ThisThreadID() == token->m_thread_id);
+        multi_writer_sync_tls(token, lzf);
+    }
+    else {
+        assert(token->m_link.verseq <= m_token_tail->m_link.verseq);
+    }
+    auto a = reinterpret_cast<PatriciaNode*>(m_mempool.data());
+    size_t const valsize = m_valsize;
+    size_t const fast_node_size = AlignSize * (2 + 256) + valsize;
+    uint32_t backup[256];
+    auto n_children = [&](size_t x) -> size_t {
+        size_t cnt_type = a[x].meta.n_cnt_type;
+        if (cnt_type <= 6)
+            return cnt_type;
+        if (15 == cnt_type)
+            return as_atomic(a[x+1].big.n_children).load(std::memory_order_relaxed);
+        return a[x].big.n_children;
+    };
+    if (0) {
+    retry:
+        lzf->m_n_retry++;
+        a = reinterpret_cast<PatriciaNode*>(m_mempool.data());
+    }
+    size_t parent = size_t(-1);
+    size_t curr_slot = size_t(-1);
+    size_t curr = initial_state;
+    size_t bp = initial_state, bp_parent = size_t(-1), bp_slot = size_t(-1);
+    size_t chain_head = nil_state;
+    size_t chain_pos = 0; // key pos of chain_head
+    byte_t bp_ch = 0;
+    for (size_t pos = 0; ; pos++) {
+        auto p = a + curr;
+        size_t cnt_type = p->meta.n_cnt_type;
+        size_t zlen = p->meta.n_zpath_len;
+        if (zlen) {
+            size_t zpos = AlignSize * (s_skip_slots[cnt_type] + n_children(curr));
+            if (key.size() - pos < zlen ||
+                    memcmp(key.udata() + pos, p->bytes + zpos, zlen) != 0) {
+                return false;
+            }
+            pos += zlen;
+        }
+        if (key.size() == pos) {
+            break;
+        }
+        if (p->meta.b_is_final || n_children(curr) >= 2) {
+            bp = curr;
+            bp_parent = parent;
+            bp_slot = curr_slot;
+        }
+        size_t next_slot;
+        size_t next = state_move_impl(a, curr, byte_t(key[pos]), &next_slot);
+        if (nil_state == next) {
+            return false;
+        }
+        if (bp == curr) {
+            bp_ch = key[pos];
+            chain_head = next;
+            chain_pos = pos + 1;
+        }
+        parent = curr;
+        curr_slot = next_slot;
+        curr = next;
+    }
+    if (!a[curr].meta.b_is_final) {
+        return false;
+    }
+    size_t valpos = get_valpos(a, curr);
+    ullong age = 0; // set on first lazy_free, which is after unlink
+    auto lazy_free = [&](size_t node, size_t size) {
+        if (0 == age && ConLevel != SingleThreadStrict)
+            age = lazy_free_age();
+        if (ConLevel >= MultiWriteMultiRead) {
+            lzf->push_back({ age, uint32_t(node), uint32_t(size) });
+            lzf->m_mem_size += size;
+        }
+        else if (ConLevel != SingleThreadStrict) {
+            m_lazy_free_list_sgl.push_back({ age, uint32_t(node), uint32_t(size) });
+            m_lazy_free_list_sgl.m_mem_size += size;
+        }
+        else {
+            free_node<SingleThreadStrict>(node, size, nullptr);
+        }
+    };
+    auto update_stat = [&](size_t nodeDecNum, size_t zpathDecLen, size_t zpathDecStates) {
+        if (ConLevel >= MultiWriteMultiRead) {
+            lzf->m_n_nodes -= nodeDecNum;
+            lzf->m_n_words -= 1;
+            lzf->m_adfa_total_words_len -= key.size();
+            lzf->m_total_zpath_len -= zpathDecLen;
+            lzf->m_zpath_states -= zpathDecStates;
+        }
+        else {
+            m_n_nodes -= nodeDecNum;
+            m_n_words -= 1;
+            m_adfa_total_words_len -= key.size();
+            m_total_zpath_len -= zpathDecLen;
+            m_zpath_states -= zpathDecStates;
+        }
+    };
+    // next node of chain node x, pos is key pos of x and moves to next
+    auto chain_next = [&](size_t x, size_t& pos) -> size_t {
+        pos += a[x].meta.n_zpath_len;
+        if (pos >= key.size())
+            return nil_state;
+        size_t slot;
+        return state_move_impl(a, x, byte_t(key[pos++]), &slot);
+    };
+    // b_lock is for in place update of x's child slots
+    auto try_lock = [&](size_t x) -> bool {
+        PatriciaNode x_unlock = as_atomic(a[x]).load(std::memory_order_relaxed);
+        x_unlock.meta.b_lazy_free = 0;
+        x_unlock.meta.b_lock = 0;
+        PatriciaNode x_locked = x_unlock;
+        x_locked.meta.b_lock = 1;
+        return cas_weak(a[x], x_unlock, x_locked);
+    };
+    auto unlock = [&](size_t x) {
+        as_atomic(a[x].flags).fetch_and(uint08_t(~FLAG_lock), std::memory_order_release);
+    };
+    // b_lazy_free is for replacing or unlinking x, a fast node being marked
+    // final by an inserter can not be locked
+    auto lock_node = [&](size_t x) -> bool {
+        PatriciaNode x_unlock = as_atomic(a[x]).load(std::memory_order_relaxed);
+        if (15 == x_unlock.meta.n_cnt_type &&
+                x_unlock.meta.b_set_final && !x_unlock.meta.b_is_final)
+            return false;
+        x_unlock.meta.b_lazy_free = 0;
+        x_unlock.meta.b_lock = 0;
+        PatriciaNode x_locked = x_unlock;
+        x_locked.meta.b_lazy_free = 1;
+        return cas_weak(a[x], x_unlock, x_locked);
+    };
+    auto unlock_node = [&](size_t x) {
+        as_atomic(a[x].flags).fetch_and(uint08_t(~FLAG_lazy_free), std::memory_order_release);
+    };
+    // lock nodes of chain [chain_head, curr] as lazy free, a locked node is
+    // frozen, verify it is still a chain node: not final with single child,
+    // or the leaf curr. @returns first failed node, nodes before it are locked
+    auto lock_chain = [&]() -> size_t {
+        size_t pos = chain_pos;
+        for (size_t x = chain_head; ; ) {
+            if (!lock_node(x))
+                return x;
+            bool is_leaf = x == curr;
+            if (n_children(x) != (is_leaf ? 0 : 1) ||
+                    a[x].meta.b_is_final != is_leaf) {
+                unlock_node(x);
+                return x;
+            }
+            if (is_leaf)
+                return nil_state;
+            size_t next = chain_next(x, pos);
+            if (nil_state == next) {
+                unlock_node(x);
+                return x;
+            }
+            x = next;
+        }
+    };
+    auto unlock_chain = [&](size_t stop) {
+        size_t pos = chain_pos;
+        for (size_t x = chain_head; x != stop; ) {
+            size_t next = x == curr ? nil_state : chain_next(x, pos);
+            unlock_node(x);
+            x = next;
+        }
+    };
+    // replace oldNode in a[slot] by newNode, backup are oldNode's children
+    // for MultiWriteMultiRead, if with_chain, the chain is also locked
+    auto update_ptr_concurrent = [&](size_t par, size_t slot, size_t oldNode,
+                                     size_t newNode, const NodeInfo& oni,
+                                     bool with_chain) -> bool {
+        if (try_lock(par)) {
+            if (lock_node(oldNode)) {
+                if (array_eq(backup, &a[oldNode + oni.n_skip].child, oni.n_children)) {
+                    size_t fail = with_chain ? lock_chain() : nil_state;
+                    if (nil_state == fail) {
+                        if (cas_weak(a[slot].child, uint32_t(oldNode), uint32_t(newNode))) {
+                            unlock(par);
+                            return true;
+                        }
+                    }
+                    if (with_chain)
+                        unlock_chain(fail);
+                }
+                unlock_node(oldNode);
+            }
+            unlock(par);
+        }
+        free_node<MultiWriteMultiRead>(newNode, node_size(a + newNode, valsize), lzf);
+        return false;
+    };
+    if (ConLevel >= MultiWriteMultiRead)
+        revoke_expired_nodes<ConLevel>(*lzf, token);
+    else
+        revoke_expired_nodes<ConLevel>(lazy_free_list(ConLevel), NULL);
+
+    if (initial_state == curr) {
+        // root is always a fast node and can not be replaced
+        if (ConLevel >= MultiWriteMultiRead) {
+            auto& flags = as_atomic(a[curr].flags);
+            uint08_t old_flags = flags.load(std::memory_order_relaxed);
+            do {
+                if (!(old_flags & FLAG_final))
+                    return false; // erased by other thread
+            } while (!flags.compare_exchange_weak(old_flags,
+                        uint08_t(old_flags & ~(FLAG_final|FLAG_set_final)),
+                        std::memory_order_acq_rel, std::memory_order_relaxed));
+        }
+        else {
+            a[curr].meta.b_is_final = false;
+            a[curr].meta.b_set_final = false;
+        }
+        update_stat(0, 0, 0);
+        token->m_value = a->bytes + valpos;
+        return true;
+    }
+    if (15 == a[curr].meta.n_cnt_type && n_children(curr)) {
+        // copy fast node with final bit cleared, keep old value space alive
+        size_t newCurr = alloc_node<ConLevel>(fast_node_size, lzf);
+        if (ConLevel >= OneWriteMultiRead && mem_alloc_fail == newCurr) {
+            token->m_value = NULL;
+            return true;
+        }
+        if (ConLevel < OneWriteMultiRead) {
+            SingleThreadShared_check_for_sync_token_list();
+            a = reinterpret_cast<PatriciaNode*>(m_mempool.data());
+        }
+        if (ConLevel >= MultiWriteMultiRead) {
+            if (!try_lock(parent)) {
+                free_node<MultiWriteMultiRead>(newCurr, fast_node_size, lzf);
+                goto retry;
+            }
+            if (a[curr_slot].child != curr || !lock_node(curr)) {
+                unlock(parent);
+                free_node<MultiWriteMultiRead>(newCurr, fast_node_size, lzf);
+                goto retry;
+            }
+            // curr is frozen now
+            if (!a[curr].meta.b_is_final || 0 == n_children(curr)) {
+                unlock_node(curr);
+                unlock(parent);
+                free_node<MultiWriteMultiRead>(newCurr, fast_node_size, lzf);
+                goto retry;
+            }
+        }
+        tiny_memcpy_align_4(a + newCurr, a + curr, AlignSize * (2 + 256));
+        a[newCurr].meta.b_is_final = false;
+        a[newCurr].meta.b_set_final = false;
+        a[newCurr].meta.b_lazy_free = false;
+        a[newCurr].meta.b_lock = false;
+        if (ConLevel >= MultiWriteMultiRead) {
+            as_atomic(a[curr_slot].child).store(uint32_t(newCurr), std::memory_order_release);
+            unlock(parent);
+        }
+        else {
+            a[curr_slot].child = uint32_t(newCurr);
+        }
+        lazy_free(curr, fast_node_size);
+        update_stat(0, 0, 0);
+        token->m_value = a->bytes + valpos;
+        return true;
+    }
+    if (15 != a[curr].meta.n_cnt_type && a[curr].meta.n_cnt_type) {
+        // has children, copy curr without value space
+        size_t zlen = a[curr].meta.n_zpath_len;
+        NodeInfo ni;
+        ni.set(a + curr, zlen, valsize);
+        size_t newCurr = alloc_node<ConLevel>(ni.va_offset, lzf);
+        if (ConLevel >= OneWriteMultiRead && mem_alloc_fail == newCurr) {
+            token->m_value = NULL;
+            return true;
+        }
+        if (ConLevel < OneWriteMultiRead) {
+            SingleThreadShared_check_for_sync_token_list();
+            a = reinterpret_cast<PatriciaNode*>(m_mempool.data());
+        }
+        if (ConLevel >= MultiWriteMultiRead) {
+            cpfore(backup, &a[curr + ni.n_skip].child, ni.n_children);
+        }
+        tiny_memcpy_align_4(a + newCurr, a + curr, ni.va_offset);
+        a[newCurr].meta.b_is_final = false;
+        if (ConLevel >= MultiWriteMultiRead) {
+            if (a[newCurr].flags & (FLAG_lazy_free|FLAG_lock)) {
+                free_node<MultiWriteMultiRead>(newCurr, ni.va_offset, lzf);
+                goto retry;
+            }
+            if (!update_ptr_concurrent(parent, curr_slot, curr, newCurr, ni, false)) {
+                goto retry;
+            }
+        }
+        else {
+            a[curr_slot].child = uint32_t(newCurr);
+        }
+        lazy_free(curr, ni.node_size);
+        update_stat(0, 0, 0);
+        token->m_value = a->bytes + valpos;
+        return true;
+    }
+    // curr is leaf(maybe an emptied fast node), unlink [chain_head, curr]
+    assert(nil_state != chain_head);
+    assert(bp != curr);
+    if (15 == a[bp].meta.n_cnt_type) {
+        if (ConLevel >= MultiWriteMultiRead) {
+            if (!try_lock(bp)) {
+                goto retry;
+            }
+            // bp is still a branch point and chain_head is still its child
+            if (a[bp+2+bp_ch].child != chain_head ||
+                    !(initial_state == bp || a[bp].meta.b_is_final ||
+                      n_children(bp) >= 2)) {
+                unlock(bp);
+                goto retry;
+            }
+            size_t fail = lock_chain();
+            if (nil_state != fail) {
+                unlock_chain(fail);
+                unlock(bp);
+                goto retry;
+            }
+            as_atomic(a[bp+2+bp_ch].child).store(nil_state, std::memory_order_release);
+            as_atomic(a[bp+1].big.n_children).fetch_sub(1, std::memory_order_relaxed);
+            unlock(bp);
+        }
+        else {
+            assert(a[bp+2+bp_ch].child == chain_head);
+            a[bp+2+bp_ch].child = nil_state;
+            a[bp+1].big.n_children--;
+        }
+    }
+    else {
+        NodeInfo bpi;
+        bpi.set(a + bp, a[bp].meta.n_zpath_len, a[bp].meta.b_is_final ? valsize : 0);
+        if (ConLevel >= MultiWriteMultiRead) {
+            cpfore(backup, &a[bp + bpi.n_skip].child, bpi.n_children);
+        }
+        size_t newBp = del_state_move<ConLevel>(bp, bp_ch, valsize, lzf);
+        if (ConLevel >= OneWriteMultiRead && size_t(-1) == newBp) {
+            token->m_value = NULL;
+            return true;
+        }
+        if (ConLevel < OneWriteMultiRead) {
+            SingleThreadShared_check_for_sync_token_list();
+            a = reinterpret_cast<PatriciaNode*>(m_mempool.data());
+        }
+        if (ConLevel >= MultiWriteMultiRead) {
+            if (a[newBp].flags & (FLAG_lazy_free|FLAG_lock)) {
+                free_node<MultiWriteMultiRead>(newBp, node_size(a + newBp, valsize), lzf);
+                goto retry;
+            }
+            if (!update_ptr_concurrent(bp_parent, bp_slot, bp, newBp, bpi, true)) {
+                goto retry;
+            }
+        }
+        else {
+            a[bp_slot].child = uint32_t(newBp);
+        }
+        lazy_free(bp, bpi.node_size);
+    }
+    // all nodes in chain are not final and have single child except leaf
+    size_t nodeDecNum = 0, zpathDecLen = 0, zpathDecStates = 0;
+    size_t pos = chain_pos;
+    for (size_t x = chain_head; ; ) {
+        size_t xzlen = a[x].meta.n_zpath_len;
+        bool   is_leaf = x == curr;
+        size_t next = is_leaf ? nil_state : chain_next(x, pos);
+        size_t xsize;
+        if (15 == a[x].meta.n_cnt_type) {
+            xsize = fast_node_size;
+        } else {
+            NodeInfo xi;
+            xi.set(a + x, xzlen, is_leaf ? valsize : 0);
+            xsize = xi.node_size;
+        }
+        assert(is_leaf || (1 == n_children(x) && !a[x].meta.b_is_final));
+        assert(is_leaf || nil_state != next);
+        nodeDecNum++;
+        zpathDecLen += xzlen;
+        zpathDecStates += xzlen ? 1 : 0;
+        lazy_free(x, xsize);
+        if (is_leaf)
+            break;
+        x = next;
+    }
+    update_stat(nodeDecNum, zpathDecLen, zpathDecStates);
+    token->m_value = a->bytes + valpos;
+    return true;
+}
+
 static const size_t BULK_FREE_NUM = 32;
 
 template<size_t Align>
@@ -2447,6 +2990,17 @@ static long g_lazy_free_debug_level =
         print("B");
 }
 
+// age of nodes which are just unlinked: a token enqueued after the unlink is
+// visible gets a larger verseq, but a token being enqueued concurrently gets
+// m_tail.verseq + 1 and may still reach the unlinked nodes.
+// writer's own m_link.verseq is not used because tokens enqueued after the
+// writer's acquire are also alive when the nodes are unlinked
+template<size_t Align>
+ullong PatriciaMem<Align>::lazy_free_age() const {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return as_atomic(m_tail.verseq).load(std::memory_order_relaxed) + 1;
+}
+
 bool MainPatricia::lookup(fstring key, TokenBase* token) const {
   #if !defined(NDEBUG)
     if (m_writing_concurrent_level >= SingleThreadShared) {
@@ -4773,9 +5327,10 @@ bool MainPatricia::IterImpl::incr() {
         //  assert(curr == initial_state);
             ch = m_word.data()[len] + 1;
             for (; ch < 256; ch++) {
-                if (nil_state != p[2+ch].child) {
+                uint32_t child = p[2+ch].child; // erase may nil it
+                if (nil_state != child) {
                     m_iter[top].nth_child = ch;
-                    curr = p[2+ch].child;
+                    curr = child;
                     goto switch_done;
                 }
             }
@@ -4906,8 +5461,9 @@ bool MainPatricia::IterImpl::decr() {
         ch = m_word.data()[len];
         while (ch) {
             ch--;
-            if (nil_state != p[2+ch].child) {
-                curr = p[2 + ch].child;
+            uint32_t child = p[2+ch].child; // erase may nil it
+            if (nil_state != child) {
+                curr = child;
                 m_iter[top].nth_child = ch;
                 goto switch_done;
             }
@@ -5022,8 +5578,10 @@ size_t MainPatricia::IterImpl::seek_max_prefix(fstring key) {
             goto RestoreLastMatch;
         case 15:
             assert(256 == p->big.n_children);
-            if (nil_state != p[2 + ch].child) {
-                match_nth_char(2, ch);
+            curr = p[2 + ch].child; // erase may nil it
+            if (nil_state != curr) {
+                e->nth_child = ch;
+                break;
             }
             goto RestoreLastMatch;
         }
@@ -166,6 +166,7 @@ public:
         WriterToken();
         void acquire(Patricia*);
         bool insert(fstring key, void* value);
+        bool erase(fstring key);
         bool lookup(fstring);
     };
     using WriterTokenPtr = std::unique_ptr<WriterToken, DisposeAsDelete>;
@@ -210,6 +211,21 @@ public:
         return (this->*m_insert)(key, value, token);
     }
 
+    /// @returns
+    ///  true: key existed and has been erased, token->value() points to the
+    ///        erased value, it is kept alive by lazy free until token is
+    ///        released or updated(until next write for SingleThreadStrict),
+    ///        value is NOT destroyed
+    ///     token->value() == NULL : reached memory limit, key is not erased
+    ///                              and still can be found, same as insert,
+    ///                              only for OneWriteMultiRead and above
+    ///  false: key does not exist
+    ///
+    terark_forceinline
+    bool erase(fstring key, WriterToken* token) {
+        return (this->*m_erase)(key, token);
+    }
+
     ConcurrentLevel concurrent_level() const { return m_writing_concurrent_level; }
     virtual bool lookup(fstring key, TokenBase* token) const = 0;
     virtual void set_readonly() = 0;
@@ -265,6 +281,9 @@ protected:
     bool insert_readonly_throw(fstring key, void* value, WriterToken*);
     typedef bool (Patricia::*insert_func_t)(fstring, void*, WriterToken*);
     insert_func_t    m_insert;
+    bool erase_readonly_throw(fstring, WriterToken*);
+    typedef bool (Patricia::*erase_func_t)(fstring, WriterToken*);
+    erase_func_t     m_erase;
     ConcurrentLevel  m_writing_concurrent_level;
     ConcurrentLevel  m_mempool_concurrent_level;
     bool             m_is_virtual_alloc;
@@ -281,6 +300,11 @@ bool Patricia::WriterToken::insert(fstring key, void* value) {
     return m_trie->insert(key, value, this);
 }
 
+terark_forceinline
+bool Patricia::WriterToken::erase(fstring key) {
+    return m_trie->erase(key, this);
+}
+
 terark_forceinline
 bool Patricia::WriterToken::lookup(fstring key) {
     return m_trie->lookup(key, this);
@@ -39,7 +39,8 @@ namespace terark {
 union PatriciaNode {
     // 1. b_lazy_free can only be set to 1 once, it is permanent: once set,
     //    never clear. b_lazy_free is just for non fast node.
-    // 2. b_set_final is the lock for set fast node's final bit, it's permanent.
+    // 2. b_set_final is the lock for set fast node's final bit, it's permanent
+    //    except erase, which clears b_set_final and b_is_final in one CAS.
     //    permanent makes a little simple and performance gain.
     // 3. b_set_final is a optimization, we use it, just because it is an
     //    unused bit if we don't use it. if we don't use it, b_lock should be
@@ -169,6 +170,7 @@ protected:
     void revoke_expired_nodes();
     template<ConcurrentLevel, class LazyList>
     void revoke_expired_nodes(LazyList&, TokenBase*);
+    ullong lazy_free_age() const;
     void check_valsize(size_t valsize) const;
     void SingleThreadShared_sync_token_list(byte_t* oldmembase);
 
@@ -633,6 +635,9 @@ public:
     template<ConcurrentLevel>
     bool insert_one_writer(fstring key, void* value, WriterToken* token);
     bool insert_multi_writer(fstring key, void* value, WriterToken* token);
+    void multi_writer_sync_tls(WriterToken* token, LazyFreeListTLS* lzf);
+    template<ConcurrentLevel>
+    bool erase_impl(fstring key, WriterToken* token);
 
     struct NodeInfo;
 
@@ -651,6 +656,9 @@ public:
     template<ConcurrentLevel>
     size_t add_state_move(size_t curr, byte_t ch, size_t suffix_node, size_t valsize, LazyFreeListTLS*);
 
+    template<ConcurrentLevel>
+    size_t del_state_move(size_t curr, byte_t ch, size_t valsize, LazyFreeListTLS*);
+
     size_t get_valpos(const PatriciaNode* a, size_t state) const {
         assert(state < total_states());
         size_t cnt_type = a[state].meta.n_cnt_type;
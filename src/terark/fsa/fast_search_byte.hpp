@@ -3,6 +3,7 @@
 
 #include <immintrin.h>
 #include <terark/succinct/rank_select_basic.hpp>
+#include <terark/util/cpu_features.hpp>
 
 namespace terark {
 
@@ -23,7 +24,19 @@ binary_search_byte(const byte_t* data, size_t len, byte_t key) {
 		return len;
 }
 
-#if defined(__SSE4_2__) // && (defined(NDEBUG) || !defined(__GNUC__))
+#if defined(__SSE4_2__)
+	#define TERARK_SSE42_TARGET
+#else
+	#define TERARK_SSE42_TARGET TERARK_TARGET("sse4.2")
+#endif
+#if defined(__AVX512BW__) && defined(__AVX512VL__)
+	#define TERARK_AVX512BW_TARGET
+#else
+	#define TERARK_AVX512BW_TARGET TERARK_TARGET("avx512bw,avx512vl")
+#endif
+
+#if defined(__SSE4_2__) || defined(TERARK_TARGET_DISPATCH)
+	TERARK_SSE42_TARGET
 	inline int // _mm_cmpestri length param is int32
 	sse4_2_search_byte(const byte_t* data, int len, byte_t key) {
 		// intrinsic: _mm_cmpestri can not generate "pcmpestri xmm, mem, imm"
@@ -69,15 +82,9 @@ binary_search_byte(const byte_t* data, size_t len, byte_t key) {
 		return pos + idx;
 	#endif
 	}
+	TERARK_SSE42_TARGET
 	inline size_t
-	fast_search_byte(const byte_t* data, size_t len, byte_t key) {
-		if (len <= 16)
-			return sse4_2_search_byte(data, int(len), key);
-		else
-			return binary_search_byte(data, len, key);
-	}
-	inline size_t
-	fast_search_byte_max_35(const byte_t* data, size_t len, byte_t key) {
+	sse4_2_search_byte_max_35(const byte_t* data, size_t len, byte_t key) {
 		assert(len <= 35);
 		if (len <= 16) {
 			return sse4_2_search_byte(data, int(len), key);
@@ -95,7 +102,92 @@ binary_search_byte(const byte_t* data, size_t len, byte_t key) {
 		}
 		return 32 + sse4_2_search_byte(data + 32, int(len - 32), key);
 	}
+#endif // __SSE4_2__ || TERARK_TARGET_DISPATCH
+
+#if defined(__AVX512BW__) && defined(__AVX512VL__) || defined(TERARK_TARGET_DISPATCH)
+	/// one masked compare, never touch bytes beyond len
+	/// @returns len if not found
+	TERARK_AVX512BW_TARGET
+	inline size_t
+	avx512_search_byte_max_32(const byte_t* data, size_t len, byte_t key) {
+		assert(len <= 32);
+		__mmask32 k = _cvtu32_mask32(uint32_t((uint64_t(1) << len) - 1));
+		__m256i   d = _mm256_maskz_loadu_epi8(k, data);
+		uint32_t eq = _cvtmask32_u32(_mm256_mask_cmpeq_epi8_mask(k, d,
+									 _mm256_set1_epi8(char(key))));
+		return eq ? fast_ctz32(eq) : len;
+	}
+	TERARK_AVX512BW_TARGET
+	inline size_t
+	avx512_search_byte_max_35(const byte_t* data, size_t len, byte_t key) {
+		assert(len <= 35);
+		if (len <= 32) {
+			return avx512_search_byte_max_32(data, len, key);
+		}
+		size_t pos = avx512_search_byte_max_32(data, 32, key);
+		if (pos < 32) {
+			return pos;
+		}
+		return 32 + avx512_search_byte_max_32(data + 32, len - 32, key);
+	}
+#endif
+
+#if defined(__AVX512BW__) && defined(__AVX512VL__)
+	inline size_t
+	fast_search_byte(const byte_t* data, size_t len, byte_t key) {
+		if (len <= 32)
+			return avx512_search_byte_max_32(data, len, key);
+		else
+			return binary_search_byte(data, len, key);
+	}
+	#define fast_search_byte_max_16 avx512_search_byte_max_32
+	#define fast_search_byte_max_35 avx512_search_byte_max_35
+#elif defined(__SSE4_2__)
+	// labels of 16 bytes are the common case, where the inline pcmpestri is
+	// cheaper than a call to the avx512 kernel
+	inline size_t
+	fast_search_byte(const byte_t* data, size_t len, byte_t key) {
+		if (len <= 16)
+			return sse4_2_search_byte(data, int(len), key);
+	#if defined(TERARK_TARGET_DISPATCH)
+		if (len <= 32 && g_cpu_features.avx512bw && g_cpu_features.avx512vl)
+			return avx512_search_byte_max_32(data, len, key);
+	#endif
+		return binary_search_byte(data, len, key);
+	}
+	inline size_t
+	fast_search_byte_max_35(const byte_t* data, size_t len, byte_t key) {
+	#if defined(TERARK_TARGET_DISPATCH)
+		if (len > 16 && g_cpu_features.avx512bw && g_cpu_features.avx512vl)
+			return avx512_search_byte_max_35(data, len, key);
+	#endif
+		return sse4_2_search_byte_max_35(data, len, key);
+	}
 	#define fast_search_byte_max_16 sse4_2_search_byte
+#elif defined(TERARK_TARGET_DISPATCH)
+	inline size_t
+	fast_search_byte(const byte_t* data, size_t len, byte_t key) {
+		if (len <= 32 && g_cpu_features.avx512bw && g_cpu_features.avx512vl)
+			return avx512_search_byte_max_32(data, len, key);
+		if (len <= 16 && g_cpu_features.sse42)
+			return sse4_2_search_byte(data, int(len), key);
+		return binary_search_byte(data, len, key);
+	}
+	inline size_t
+	fast_search_byte_max_16(const byte_t* data, size_t len, byte_t key) {
+		assert(len <= 16);
+		if (g_cpu_features.sse42)
+			return sse4_2_search_byte(data, int(len), key);
+		return binary_search_byte(data, len, key);
+	}
+	inline size_t
+	fast_search_byte_max_35(const byte_t* data, size_t len, byte_t key) {
+		if (g_cpu_features.avx512bw && g_cpu_features.avx512vl)
+			return avx512_search_byte_max_35(data, len, key);
+		if (g_cpu_features.sse42)
+			return sse4_2_search_byte_max_35(data, len, key);
+		return binary_search_byte(data, len, key);
+	}
 #else
 	#define fast_search_byte binary_search_byte
 	#define fast_search_byte_max_16 binary_search_byte
@@ -20,6 +20,7 @@ namespace terark {
 #include <terark/util/autoclose.hpp>
 #include <terark/util/profiling.hpp>
 #include <terark/num_to_str.hpp>
+#include <thread>
 
 // This is initially designed for using NestLoudsTrie to compress long keys as
 // database record/value, it is proved this is a bad idea.
@@ -66,6 +67,7 @@ NestLoudsTrieConfig::NestLoudsTrieConfig() {
 	useMixedCoreLink = true;
 	enableQueueCompression = true;
 	speedupNestTrieBuild = false;
+	buildThreads = 1;
 }
 
 NestLoudsTrieConfig::~NestLoudsTrieConfig() {
@@ -131,6 +133,9 @@ void NestLoudsTrieConfig::initFromEnv() {
 	enableQueueCompression = getEnvBool("NestLoudsTrie_enableQueueCompression", true);
 	useMixedCoreLink = getEnvBool("NestLoudsTrie_useMixedCoreLink", true);
 	speedupNestTrieBuild = getEnvBool("NestLoudsTrie_speedupNestTrieBuild", false);
+	if (const char* env = getenv("NestLoudsTrie_buildThreads")) {
+		buildThreads = std::max(1, atoi(env));
+	}
 	if (debugLevel >= 1) {
 		fprintf(stderr, "debugLevel            = %d\n", debugLevel);
 		fprintf(stderr, "optSearchDelimForward = %d\n", flags[optSearchDelimForward]);
@@ -146,6 +151,7 @@ void NestLoudsTrieConfig::initFromEnv() {
 		fprintf(stderr, "enableQueueCompression= %d\n", enableQueueCompression);
 		fprintf(stderr, "useMixedCoreLink      = %d\n", useMixedCoreLink);
 		fprintf(stderr, "speedupNestTrieBuild  = %d\n", speedupNestTrieBuild);
+		fprintf(stderr, "buildThreads          = %d\n", buildThreads);
 	}
 }
 
@@ -210,6 +216,10 @@ static int getRealMinLinkStrLen(const NestLoudsTrieConfig& conf) {
     else
         return conf.minLinkStrLen;
 }
+
+/// parallel BFS of build_self_trie is used only when each thread has at
+/// least so many parents in a BFS depth
+static const size_t ParallelBfsMinParents = 4096;
 /////////////////////////////////////////////////////////////////////////////
 
 namespace {
@@ -1014,6 +1024,113 @@ matchZpath_loop(size_t node_id, intptr_t pos, const byte_t* str, intptr_t slen)
     return pos;
 }
 
+template<class RankSelect, class RankSelect2, bool FastLabel>
+bool
+NestLoudsTrieTpl<RankSelect, RankSelect2, FastLabel>::
+matchZpath_start(size_t node_id, const byte_t* str, size_t slen,
+                 typename NextTrie::ZpathCursor* cur, intptr_t* len) const {
+    assert(node_id > 0);
+    assert(node_id < m_is_link.size());
+    assert(m_is_link[node_id]);
+    uint64_t linkVal = get_link_val(node_id);
+    if (linkVal < m_core_max_link_val) {
+        *len = matchZpath(node_id, str, slen);
+        return true;
+    }
+    size_t nest_id = size_t(linkVal - m_core_max_link_val);
+    cur->trie[0] = m_next_trie;
+    cur->node[0] = nest_id;
+    cur->depth = 1;
+    cur->pos = FastLabel ? 0 : -1;
+    cur->stage = 0;
+    return false;
+}
+
+// one iteration of matchZpath_loop, a nested zpath is pushed to cur instead
+// of recursion, nested tries are always FastLabel = false
+template<class RankSelect, class RankSelect2, bool FastLabel>
+bool
+NestLoudsTrieTpl<RankSelect, RankSelect2, FastLabel>::
+matchZpath_step(ZpathCursor& cur, const byte_t* str, intptr_t slen) const {
+    assert(!FastLabel);
+    assert(cur.depth > 0);
+    while (initial_state == cur.node[cur.depth-1]) {
+        if (--cur.depth == 0)
+            return true;
+    }
+    const size_t top = cur.depth - 1;
+    const NextTrie* trie = cur.trie[top];
+    const size_t parent = cur.node[top];
+    assert(parent < trie->total_states());
+    switch (cur.stage) {
+    case 0:
+        trie->m_louds.prefetch_select1(parent);
+        trie->m_is_link.prefetch_bit(parent);
+        _mm_prefetch((const char*)&trie->m_label_data[parent], _MM_HINT_T0);
+        cur.stage = 1;
+        return false;
+    case 1:
+        trie->m_louds.prefetch_select1_line(parent);
+        cur.stage = 2;
+        return false;
+    default:
+        break;
+    }
+    cur.stage = 0;
+    intptr_t pos = cur.pos;
+    if (pos == slen) { // zpath is longer than str
+        cur.pos = -pos;
+        return true;
+    }
+    cur.node[top] = trie->m_louds.select1(parent) - parent - 1;
+    if (trie->m_is_link.is1(parent)) {
+        size_t linkRank1 = trie->m_is_link.rank1(parent);
+        uint64_t linkVal = uint64_t(trie->m_next_link[linkRank1]) << 8
+                         | trie->m_label_data[parent];
+        if (linkVal < trie->m_core_max_link_val) {
+            size_t length = size_t(linkVal & trie->m_core_len_mask) + trie->m_core_min_len;
+            size_t offset = size_t(linkVal >> trie->m_core_len_bits);
+            assert(offset + length <= trie->m_core_size);
+            const byte_t* zpath = trie->m_core_data + offset;
+            const byte_t* pstr = str + pos;
+            const size_t  lim = std::min<size_t>(slen - pos, length);
+            size_t i = 0;
+            while (i < lim && zpath[i] == pstr[i]) ++i;
+            pos += i;
+            if (i < length) {
+                cur.pos = -pos;
+                return true;
+            }
+        }
+        else {
+            size_t link_id = size_t(linkVal - trie->m_core_max_link_val);
+            const NextTrie* next = trie->m_next_trie;
+            if (cur.depth < ZpathCursor::MaxNest) {
+                cur.trie[cur.depth] = next;
+                cur.node[cur.depth] = link_id;
+                cur.depth++;
+            }
+            else {
+                pos = next->matchZpath_loop(link_id, pos, str, slen);
+                if (pos <= 0) {
+                    cur.pos = pos;
+                    return true;
+                }
+            }
+        }
+    }
+    else {
+        if (str[pos] == trie->m_label_data[parent])
+            pos++;
+        else {
+            cur.pos = -pos;
+            return true;
+        }
+    }
+    cur.pos = pos;
+    return false;
+}
+
 template<class RankSelect, class RankSelect2, bool FastLabel>
 static void
 dot_file_write_node_loop(const NestLoudsTrieTpl<RankSelect, RankSelect2, FastLabel>* trie,
@@ -2199,167 +2316,309 @@ build_self_trie_tpl(StrVecType& strVec, SortableStrVec& nestStrVec,
 	m_louds.push_back(false);
 	labelStore->push_back(0); // reserve unused
 	const byte_t* strBase = strVec.m_strpool.data();
-	while (!q1->empty()) {
-		while (!q1->empty()) {
-			auto parent = q1->pop_front_val();
-			size_t parentBegRow = parent.begRow;
-			size_t parentEndRow = parent.endRow;
-			size_t parentBegCol = parent.begCol;
-			size_t childBegRow = parentBegRow;
-			while (childBegRow < parentEndRow) {
-				fstring childBegStr = strVec[childBegRow];
-				assert(parentBegCol < childBegStr.size());
-				size_t childEndRow = strVec.upper_bound_at_pos(childBegRow, parentEndRow, parentBegCol, childBegStr[parentBegCol]);
-				size_t childBegCol;
-			//	size_t childEndCol = std::min(childBegStr.size(), parentBegCol + MAX_ZPATH_LEN);
-				size_t childEndCol = std::min(childBegStr.size(), parentBegCol + maxFragLen0);
-				if (childEndRow - childBegRow > 1) {
-					childBegCol = unmatchPos(childBegStr.udata(),
-											 strVec.nth_data(childEndRow - 1),
-											 parentBegCol + 1, childEndCol);
-					if (terark_unlikely(conf.debugLevel >= 3))
-						printDup("found dup1", depth, childEndRow - childBegRow,
-								 childBegStr, parentBegCol, childBegCol);
-				}
+	typedef typename OnePassQueue<RangeTpl<index_t> >::FastT Range;
+	typedef SortableStrVec::OffsetLength OffsetLength;
+
+	// BfsDirectSink writes BFS output directly to the trie and queues,
+	// BfsPart buffers the output of a contiguous span of parents, it is used
+	// by the parallel BFS and appended in parent order, so the result is
+	// byte-identical to the serial BFS
+	struct BfsDirectSink {
+		NestLoudsTrieTpl* trie;
+		OnePassQueue<byte_t>* labelStore;
+		OnePassQueue<OffsetLength>* nextStrVecStore;
+		TempFile* nestStrPoolFile;
+		TempFile* linkSeqStore;
+		valvec<index_t>* linkVec;
+		std::unique_ptr<OnePassQueue<RangeTpl<index_t> > >* q2;
+		size_t* nestStrVecSize;
+		size_t* nestStrPoolSize;
+		void add_nest(fstring frag, size_t offset) {
+			++*nestStrVecSize; // should == m_is_link.max_rank1()
+			*nestStrPoolSize += frag.size();
+			if (nestStrPoolFile) {
+				nestStrPoolFile->oTmpBuf << frag;
+			}
+			else {
+				OffsetLength nextKey;
+				nextKey.offset = offset;
+				nextKey.length = uint32_t(frag.size());
+				nextStrVecStore->push_back(nextKey);
+			}
+		}
+		void add_child(byte_t ch, bool isLink) {
+			labelStore->push_back(ch);
+			trie->m_is_link.push_back(isLink);
+		}
+		void add_link(size_t seq_id) {
+			size_t linked_node_id = trie->m_is_link.size() - 1;
+			if (linkSeqStore) {
+				linkSeqStore->oTmpBuf << LinkSeq(linked_node_id, seq_id);
+			} else {
+				assert(index_t(-1) == (*linkVec)[seq_id]);
+				(*linkVec)[seq_id] = linked_node_id;
+			}
+		}
+		void end_child(const Range& child) {
+			(*q2)->push_back(child);
+			trie->m_louds.push_back(true);
+		}
+		void end_parent() { trie->m_louds.push_back(false); }
+	};
+	struct BfsPart {
+		valvec<Range>    q2;
+		valvec<byte_t>   label;
+		valvec<byte_t>   isLink;
+		valvec<uint16_t> numChildren; // of each parent, max is 256
+		valvec<OffsetLength> nest;
+		valvec<std::pair<size_t, size_t> > link; // (node in part, seq_id)
+		size_t nestStrPoolSize = 0;
+		void add_nest(fstring frag, size_t offset) {
+			OffsetLength nextKey;
+			nextKey.offset = offset;
+			nextKey.length = uint32_t(frag.size());
+			nest.push_back(nextKey);
+			nestStrPoolSize += frag.size();
+		}
+		void add_child(byte_t ch, bool isLink1) {
+			label.push_back(ch);
+			isLink.push_back(isLink1);
+		}
+		void add_link(size_t seq_id) {
+			link.emplace_back(isLink.size() - 1, seq_id);
+		}
+		void end_child(const Range& child) { q2.push_back(child); }
+		void end_parent() {
+			numChildren.push_back(uint16_t(q2.size() - parentBegChild));
+			parentBegChild = q2.size();
+		}
+		size_t parentBegChild = 0;
+	};
+	BfsDirectSink direct = {
+		this, labelStore.get(), nextStrVecStore.get(), nestStrPoolFile.get(),
+		linkSeqStore.get(), &linkVec, &q2, &nestStrVecSize, &nestStrPoolSize
+	};
+	auto expand = [&](const Range& parent, auto& sink) {
+		size_t parentBegRow = parent.begRow;
+		size_t parentEndRow = parent.endRow;
+		size_t parentBegCol = parent.begCol;
+		size_t childBegRow = parentBegRow;
+		while (childBegRow < parentEndRow) {
+			fstring childBegStr = strVec[childBegRow];
+			assert(parentBegCol < childBegStr.size());
+			size_t childEndRow = strVec.upper_bound_at_pos(childBegRow, parentEndRow, parentBegCol, childBegStr[parentBegCol]);
+			size_t childBegCol;
+		//	size_t childEndCol = std::min(childBegStr.size(), parentBegCol + MAX_ZPATH_LEN);
+			size_t childEndCol = std::min(childBegStr.size(), parentBegCol + maxFragLen0);
+			if (childEndRow - childBegRow > 1) {
+				childBegCol = unmatchPos(childBegStr.udata(),
+										 strVec.nth_data(childEndRow - 1),
+										 parentBegCol + 1, childEndCol);
+				if (terark_unlikely(conf.debugLevel >= 3))
+					printDup("found dup1", depth, childEndRow - childBegRow,
+							 childBegStr, parentBegCol, childBegCol);
+			}
 #if defined(USE_SUFFIX_ARRAY_TRIE)
-				else if (conf.saFragMinFreq) {
-				//	size_t saMinFragLen = maxFragLen3;
-					size_t saMinFragLen = conf.minFragLen;
-				//	size_t saMinFragLen = 12;
-					if (childEndCol - parentBegCol > saMinFragLen) {
-				#if 1
-						auto res = conf.suffixTrie->sa_match_max_score(
-							childBegStr.substr(parentBegCol), saMinFragLen, conf.saFragMinFreq);
-				#else
-						auto res = conf.suffixTrie->sa_match_max_length(
-							childBegStr.substr(parentBegCol), conf.saFragMinFreq);
-				#endif
-						childBegCol = parentBegCol + res.depth;
-						if (terark_unlikely(conf.debugLevel >= 3))
-							printDup("found dup2", depth, res.freq(),
-									childBegStr, parentBegCol, childBegCol);
-					} else
-						childBegCol = childEndCol;
-				}
+			else if (conf.saFragMinFreq) {
+			//	size_t saMinFragLen = maxFragLen3;
+				size_t saMinFragLen = conf.minFragLen;
+			//	size_t saMinFragLen = 12;
+				if (childEndCol - parentBegCol > saMinFragLen) {
+			#if 1
+					auto res = conf.suffixTrie->sa_match_max_score(
+						childBegStr.substr(parentBegCol), saMinFragLen, conf.saFragMinFreq);
+			#else
+					auto res = conf.suffixTrie->sa_match_max_length(
+						childBegStr.substr(parentBegCol), conf.saFragMinFreq);
+			#endif
+					childBegCol = parentBegCol + res.depth;
+					if (terark_unlikely(conf.debugLevel >= 3))
+						printDup("found dup2", depth, res.freq(),
+								childBegStr, parentBegCol, childBegCol);
+				} else
+					childBegCol = childEndCol;
+			}
 #endif
 #if defined(NestLoudsTrie_EnableDelim) && defined(USE_SUFFIX_ARRAY_TRIE)
-				else if (conf.bestZipLenArr) {
-					size_t offset = childBegStr.udata() - strBase + parentBegCol;
-					size_t length = std::min(childBegStr.size() - parentBegCol, maxFragLen2);
-					auto   zipPtr = conf.bestZipLenArr + offset;
-					size_t currLen = max_n(zipPtr, length);
-					size_t bestLen = zipPtr[currLen];
-					if (currLen >= (size_t)conf.minFragLen)
-						childBegCol = parentBegCol + currLen;
-					else if (bestLen >= (size_t)conf.minFragLen)
-						childBegCol = parentBegCol + bestLen;
-					else
-						childBegCol = childEndCol;
-					if (terark_unlikely(conf.debugLevel >= 3)) {
-						printDup("found dup3", depth, childEndRow - childBegRow,
-								 childBegStr, parentBegCol, childBegCol);
-						printf("currLen=%zd bestLen=%zd\n", currLen, bestLen);
-					}
+			else if (conf.bestZipLenArr) {
+				size_t offset = childBegStr.udata() - strBase + parentBegCol;
+				size_t length = std::min(childBegStr.size() - parentBegCol, maxFragLen2);
+				auto   zipPtr = conf.bestZipLenArr + offset;
+				size_t currLen = max_n(zipPtr, length);
+				size_t bestLen = zipPtr[currLen];
+				if (currLen >= (size_t)conf.minFragLen)
+					childBegCol = parentBegCol + currLen;
+				else if (bestLen >= (size_t)conf.minFragLen)
+					childBegCol = parentBegCol + bestLen;
+				else
+					childBegCol = childEndCol;
+				if (terark_unlikely(conf.debugLevel >= 3)) {
+					printDup("found dup3", depth, childEndRow - childBegRow,
+							 childBegStr, parentBegCol, childBegCol);
+					printf("currLen=%zd bestLen=%zd\n", currLen, bestLen);
 				}
+			}
 #endif
 #if defined(NestLoudsTrie_EnableDelim)
-				else if (childEndCol - parentBegCol > maxFragLen3) {
-					auto str = childBegStr.udata();
-					childEndCol = std::min(childEndCol, parentBegCol + maxFragLen1);
-					if (conf.flags[NestLoudsTrieConfig::optSearchDelimForward]) {
-						childBegCol = parentBegCol + maxFragLen3;
-						for (; childBegCol < childEndCol; ++childBegCol) {
-							byte_t c = str[childBegCol];
-							if (conf.bestDelimBits.is1(c))
+			else if (childEndCol - parentBegCol > maxFragLen3) {
+				auto str = childBegStr.udata();
+				childEndCol = std::min(childEndCol, parentBegCol + maxFragLen1);
+				if (conf.flags[NestLoudsTrieConfig::optSearchDelimForward]) {
+					childBegCol = parentBegCol + maxFragLen3;
+					for (; childBegCol < childEndCol; ++childBegCol) {
+						byte_t c = str[childBegCol];
+						if (conf.bestDelimBits.is1(c))
+							break;
+						if (childBegCol >= parentBegCol + maxFragLen2) {
+							if (conf.flags[NestLoudsTrieConfig::optCutFragOnPunct] && ispunct(c))
 								break;
-							if (childBegCol >= parentBegCol + maxFragLen2) {
-								if (conf.flags[NestLoudsTrieConfig::optCutFragOnPunct] && ispunct(c))
-									break;
-							}
 						}
-					} else {
-						size_t lastPunctPos = 0;
-						size_t min_pos = parentBegCol + minFragLen1;
-						for (childBegCol = childEndCol; childBegCol > min_pos; --childBegCol) {
-							byte_t c = str[childBegCol - 1];
-							if (conf.bestDelimBits.is1(c))
-								goto BackwardSearchDone;
-							else if (0 == lastPunctPos) {
-								if (conf.flags[NestLoudsTrieConfig::optCutFragOnPunct] && ispunct(c))
-									lastPunctPos = childBegCol;
-							}
+					}
+				} else {
+					size_t lastPunctPos = 0;
+					size_t min_pos = parentBegCol + minFragLen1;
+					for (childBegCol = childEndCol; childBegCol > min_pos; --childBegCol) {
+						byte_t c = str[childBegCol - 1];
+						if (conf.bestDelimBits.is1(c))
+							goto BackwardSearchDone;
+						else if (0 == lastPunctPos) {
+							if (conf.flags[NestLoudsTrieConfig::optCutFragOnPunct] && ispunct(c))
+								lastPunctPos = childBegCol;
 						}
-						childBegCol = lastPunctPos ? lastPunctPos : childEndCol;
-						BackwardSearchDone:;
 					}
+					childBegCol = lastPunctPos ? lastPunctPos : childEndCol;
+					BackwardSearchDone:;
 				}
+			}
 #endif
-				else {
-					childBegCol = childEndCol;
-					assert(childBegCol > parentBegCol);
+			else {
+				childBegCol = childEndCol;
+				assert(childBegCol > parentBegCol);
+			}
+			size_t fragStrLen = childBegCol - parentBegCol;
+			assert(fragStrLen <= 253);
+			if (FastLabel)
+				fragStrLen--;
+			if (fragStrLen >= minLinkStrLen) {
+				size_t nestBegCol = parentBegCol + (FastLabel ? 1 : 0);
+				sink.add_nest(childBegStr.substr(nestBegCol, fragStrLen),
+							  size_t(childBegStr.udata() - strBase + nestBegCol));
+				if (FastLabel) {
+					sink.add_child(childBegStr[parentBegCol], true);
+				} else {
+					sink.add_child(0, true); // label reserved for latter use
 				}
-				size_t fragStrLen = childBegCol - parentBegCol;
-				assert(fragStrLen <= 253);
-				if (FastLabel)
-					fragStrLen--;
-				if (fragStrLen >= minLinkStrLen) {
-					nestStrVecSize++; // should == m_is_link.max_rank1()
-					nestStrPoolSize += fragStrLen;
-					size_t nestBegCol = parentBegCol + (FastLabel ? 1 : 0);
-					if (nestStrPoolFile) {
-						nestStrPoolFile->oTmpBuf <<
-							childBegStr.substr(nestBegCol, fragStrLen);
-					}
-					else {
-						SortableStrVec::OffsetLength nextKey;
-						nextKey.offset = size_t(childBegStr.udata() - strBase + nestBegCol);
-						nextKey.length = uint32_t(fragStrLen);
-						nextStrVecStore->push_back(nextKey);
-					}
-					if (FastLabel) {
-						labelStore->push_back(childBegStr[parentBegCol]);
-					} else {
-						labelStore->push_back(0); // reserved for latter use
-					}
-					m_is_link.push_back(true);
+			}
+			else {
+				childBegCol = parentBegCol + 1;
+				sink.add_child(childBegStr[parentBegCol], false);
+			}
+			if (terark_unlikely(conf.debugLevel >= 4))
+				fprintf(stderr
+					, "build_self_trie: parent=(%zd, %zd, %zd), child=(%zd %zd %zd %zd)\n"
+					, parentBegRow, parentEndRow, parentBegCol
+					, childBegRow, childEndRow, childBegCol, childEndCol
+					);
+			assert(childBegRow < childEndRow);
+			// strVec.nth_size(childBegRow) may be expesive and this loop may be small
+			if (childBegStr.size() == childBegCol) {
+				do {
+					sink.add_link(strVec.nth_seq_id(childBegRow));
+					childBegRow++;
+				} while (childBegRow < childEndRow && strVec.nth_size(childBegRow) == childBegCol);
+			}
+#if !defined(NDEBUG)
+            for (size_t i = childBegRow; i < childEndRow; ++i) {
+                fstring s = strVec[i];
+                assert(s.size() > childBegCol);
+            }
+#endif
+			sink.end_child(Range(childBegRow, childEndRow, childBegCol));
+			childBegRow = childEndRow;
+		}
+		sink.end_parent();
+	};
+	// parallel BFS requires linkVec and nestStrVec are in memory
+	size_t buildThreads = std::max(conf.buildThreads, 1);
+#if defined(USE_SUFFIX_ARRAY_TRIE)
+	if (conf.saFragMinFreq || conf.bestZipLenArr)
+		buildThreads = 1; // conf.suffixTrie is not thread safe
+#endif
+	if (linkSeqStore || nestStrPoolFile || conf.debugLevel >= 3)
+		buildThreads = 1;
+	valvec<Range> parents;
+	valvec<BfsPart> parts;
+	while (!q1->empty()) {
+		size_t numThreads = std::min(buildThreads, q1->size() / ParallelBfsMinParents);
+		if (numThreads <= 1) {
+			while (!q1->empty()) {
+				expand(q1->pop_front_val(), direct);
+			}
+		}
+		else {
+			parents.erase_all();
+			parents.reserve(q1->size());
+			while (!q1->empty()) {
+				parents.push_back(q1->pop_front_val());
+			}
+			// parents are disjoint and in row order, split by rows
+			size_t rowBeg = parents[0].begRow;
+			size_t rowNum = parents.back().endRow - rowBeg;
+			valvec<size_t> bounds(numThreads + 1, valvec_reserve());
+			bounds.push_back(0);
+			for (size_t t = 1; t < numThreads; ++t) {
+				size_t row = rowBeg + size_t(double(rowNum) * t / numThreads);
+				size_t lo = bounds.back(), hi = parents.size();
+				while (lo < hi) {
+					size_t mid = (lo + hi) / 2;
+					if (parents[mid].begRow < row)
+						lo = mid + 1;
+					else
+						hi = mid;
 				}
-				else {
-					childBegCol = parentBegCol + 1;
-					labelStore->push_back(childBegStr[parentBegCol]);
-					m_is_link.push_back(false);
+				bounds.push_back(lo);
+			}
+			bounds.push_back(parents.size());
+			parts.resize(numThreads);
+			auto thread_fun = [&](size_t tid) {
+				BfsPart& part = parts[tid];
+				for (size_t i = bounds[tid]; i < bounds[tid+1]; ++i) {
+					expand(parents[i], part);
 				}
-				if (terark_unlikely(conf.debugLevel >= 4))
-					fprintf(stderr
-						, "build_self_trie: parent=(%zd, %zd, %zd), child=(%zd %zd %zd %zd)\n"
-						, parentBegRow, parentEndRow, parentBegCol
-						, childBegRow, childEndRow, childBegCol, childEndCol
-						);
-				assert(childBegRow < childEndRow);
-				// strVec.nth_size(childBegRow) may be expesive and this loop may be small
-				if (childBegStr.size() == childBegCol) {
-					do {
-						size_t linked_node_id = m_is_link.size() - 1;
-						size_t seq_id = strVec.nth_seq_id(childBegRow);
-						if (linkSeqStore) {
-							linkSeqStore->oTmpBuf << LinkSeq(linked_node_id, seq_id);
-						} else {
-							assert(index_t(-1) == linkVec[seq_id]);
-							linkVec[seq_id] = linked_node_id;
-						}
-						childBegRow++;
-					} while (childBegRow < childEndRow && strVec.nth_size(childBegRow) == childBegCol);
+			};
+			valvec<std::thread> thrVec(numThreads - 1, valvec_reserve());
+			for (size_t i = 0; i + 1 < numThreads; ++i) {
+				thrVec.unchecked_emplace_back([&,i](){thread_fun(i);});
+			}
+			thread_fun(numThreads - 1); // last partition
+			for (auto& t : thrVec) {
+				t.join();
+			}
+			for (BfsPart& part : parts) {
+				size_t base = m_is_link.size();
+				for (size_t i = 0; i < part.isLink.size(); ++i) {
+					labelStore->push_back(part.label[i]);
+					m_is_link.push_back(part.isLink[i] != 0);
 				}
-#if !defined(NDEBUG)
-                for (size_t i = childBegRow; i < childEndRow; ++i) {
-                    fstring s = strVec[i];
-                    assert(s.size() > childBegCol);
-                }
-#endif
-				q2->push_back({childBegRow, childEndRow, childBegCol});
-				m_louds.push_back(true);
-				childBegRow = childEndRow;
+				for (size_t n : part.numChildren) {
+					for (size_t k = 0; k < n; ++k)
+						m_louds.push_back(true);
+					m_louds.push_back(false);
+				}
+				for (const OffsetLength& ol : part.nest) {
+					nextStrVecStore->push_back(ol);
+				}
+				nestStrVecSize += part.nest.size();
+				nestStrPoolSize += part.nestStrPoolSize;
+				for (const auto& x : part.link) {
+					assert(index_t(-1) == linkVec[x.second]);
+					linkVec[x.second] = index_t(base + x.first);
+				}
+				for (const Range& child : part.q2) {
+					q2->push_back(child);
+				}
+				part = BfsPart(); // free memory
 			}
-			m_louds.push_back(false);
 		}
 		q1->rewind_for_write();
 		q2->complete_write();
@@ -62,6 +62,11 @@ public:
 
 	bool speedupNestTrieBuild;
 
+	/// num threads for expanding each BFS depth of a trie, the result is
+	/// byte-identical to single thread build, default: 1
+	/// not used when linkVec or nestStrPool is in tmp file(tmpLevel >= 3)
+	int buildThreads;
+
 	NestLoudsTrieConfig();
 	~NestLoudsTrieConfig();
 	void initFromEnv();
@@ -147,6 +152,26 @@ public:
     intptr_t matchZpath(size_t, const byte_t* str, size_t slen) const;
 	intptr_t matchZpath_loop(size_t, intptr_t, const byte_t* str, intptr_t slen) const;
 
+	typedef NestLoudsTrieTpl<RankSelect, RankSelect> NextTrie;
+	/// resumable matchZpath_loop, to interleave zpath matching of many keys
+	struct ZpathCursor {
+		static const size_t MaxNest = 8;
+		const NextTrie* trie[MaxNest];
+		size_t   node[MaxNest];
+		size_t   depth;
+		intptr_t pos;
+		size_t   stage; // prefetch stage of node[depth-1]
+	};
+	/// same as matchZpath, but when zpath is in m_next_trie, just init cur
+	/// and returns false, then call m_next_trie->matchZpath_step(cur, ...)
+	/// until it returns true. When returns true, result is in *len
+	bool matchZpath_start(size_t, const byte_t* str, size_t slen,
+	                      typename NextTrie::ZpathCursor* cur, intptr_t* len) const;
+	/// walks one node in 3 calls, the first 2 calls just prefetch data of
+	/// the node, returns true when done, result is cur.pos which is same as
+	/// matchZpath_loop
+	bool matchZpath_step(ZpathCursor& cur, const byte_t* str, intptr_t slen) const;
+
 	NestLoudsTrieTpl();
 	NestLoudsTrieTpl(const NestLoudsTrieTpl&);
 	NestLoudsTrieTpl& operator=(const NestLoudsTrieTpl&);
@@ -229,6 +229,140 @@ index_impl(fstring str) const {
 	return null_word;
 }
 
+template<class NestTrie, class DawgType>
+void NestTrieDAWG<NestTrie, DawgType>::
+index_batch(const fstring* keys, size_t n, size_t* ids) const {
+    assert(m_trie->m_is_link.max_rank1() == this->m_zpath_states);
+    // interleaving has overhead, it is faster only when the trie is
+    // much larger than cpu cache
+    static const size_t minMem =
+        getEnvLong("NestTrieDAWG_indexBatchMinMem", 32L << 20);
+    if (NULL != m_cache || n < 2 || mem_size() < minMem) {
+        for (size_t k = 0; k < n; ++k)
+            ids[k] = index(keys[k]);
+        return;
+    }
+    if (m_trie->m_is_link.max_rank1() > 0)
+        index_batch_impl<true>(keys, n, ids);
+    else
+        index_batch_impl<false>(keys, n, ids);
+}
+
+// Same walk as index_impl(fstring), but up to Group lookups are advanced
+// round robin, each turn of a lookup either prefetches data of its current
+// node or walks one node(include nodes of nested zpath tries), so the
+// prefetched data is loaded while other lookups are stepping.
+template<class NestTrie, class DawgType>
+template<bool HasLink>
+terark_flatten
+void NestTrieDAWG<NestTrie, DawgType>::
+index_batch_impl(const fstring* keys, size_t n, size_t* ids) const {
+	assert(HasLink == (m_trie->m_is_link.max_rank1() > 0));
+	assert(NULL == m_cache);
+	typedef typename NestTrie::NextTrie::ZpathCursor ZpathCursor;
+	enum Stage : byte_t {
+		PrefetchSel0, PrefetchLine, Ready, InZpath
+	};
+	auto trie = m_trie;
+	auto loudsBits = trie->m_louds.bldata();
+	auto loudsSel0 = trie->m_louds.get_sel0_cache();
+	auto loudsRank = trie->m_louds.get_rank_cache();
+	auto labelData = trie->m_label_data;
+	const size_t Group = 32;
+	size_t curr[Group], pos[Group], slot[Group];
+	byte_t stage[Group];
+	ZpathCursor zcur[Group];
+	size_t active = std::min(n, Group);
+	size_t next = active;
+	for (size_t j = 0; j < active; ++j) {
+		curr[j] = initial_state;
+		pos[j] = 0;
+		slot[j] = j;
+		stage[j] = PrefetchSel0;
+	}
+	while (active) {
+		for (size_t j = 0; j < active; ) {
+			const fstring str = keys[slot[j]];
+			size_t s = curr[j];
+			size_t i = pos[j];
+			size_t word_id;
+			switch (stage[j]) {
+			case PrefetchSel0:
+				trie->m_louds.prefetch_select0(s);
+				this->prefetch_term_bit(trie, s);
+				stage[j] = PrefetchLine;
+				j++;
+				continue;
+			case PrefetchLine:
+				trie->m_louds.prefetch_select0_line(s);
+				stage[j] = Ready;
+				j++;
+				continue;
+			default:
+				break;
+			}
+			if (HasLink && (InZpath == stage[j] || trie->is_pzip(s))) {
+				const byte_t* zk = (const byte_t*)(str.p + i);
+				intptr_t matchLen;
+				if (InZpath == stage[j]) {
+					if (!trie->m_next_trie->matchZpath_step(zcur[j], zk, str.n - i)) {
+						j++;
+						continue;
+					}
+					matchLen = zcur[j].pos;
+				}
+				else if (!trie->matchZpath_start(s, zk, str.n - i, &zcur[j], &matchLen)) {
+					stage[j] = InZpath;
+					j++;
+					continue;
+				}
+				if (matchLen <= 0) {
+					word_id = null_word;
+					goto Done;
+				}
+				i += matchLen;
+			}
+			assert(i <= str.size());
+			if (terark_unlikely(str.size() == i)) {
+				if (this->is_term2(trie, s))
+					word_id = this->term_rank1(trie, s);
+				else
+					word_id = null_word;
+				goto Done;
+			}
+			if (HasLink)
+				s = trie->state_move_fast2(s, (byte_t)str.p[i], labelData, loudsBits, loudsSel0, loudsRank);
+			else
+				s = trie->template state_move_smart<HasLink>(s, (byte_t)str.p[i]);
+			if (nil_state == s) {
+				word_id = null_word;
+				goto Done;
+			}
+			curr[j] = s;
+			pos[j] = i + 1;
+			stage[j] = PrefetchSel0;
+			j++;
+			continue;
+		Done:
+			ids[slot[j]] = word_id;
+			if (next < n) {
+				curr[j] = initial_state;
+				pos[j] = 0;
+				slot[j] = next++;
+				stage[j] = PrefetchSel0;
+				j++;
+			} else {
+				active--;
+				curr[j] = curr[active];
+				pos[j] = pos[active];
+				slot[j] = slot[active];
+				stage[j] = stage[active];
+				zcur[j] = zcur[active];
+			}
+		}
+	}
+}
+
 template<class NestTrie, class DawgType>
 template<bool HasLink>
 terark_flatten
@@ -210,6 +210,11 @@ public:
 	template<bool HasLink>
 	size_t index_impl(MatchContext&, fstring) const;
 
+	/// ids[k] = index(keys[k]), lookups are interleaved to overlap cache misses
+	void index_batch(const fstring* keys, size_t n, size_t* ids) const;
+	template<bool HasLink>
+	void index_batch_impl(const fstring* keys, size_t n, size_t* ids) const;
+
     void lower_bound(MatchContext&, fstring, size_t* index, size_t* dict_rank) const override final;
     size_t index_begin() const;
     size_t index_end() const;
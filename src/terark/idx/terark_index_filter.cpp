@@ -0,0 +1,127 @@
+#include "terark_index_filter.hpp"
+#include <terark/util/throw.hpp>
+#include <zstd/common/xxhash.h>
+
+namespace terark {
+
+struct TerarkIndexFilter::Header {
+  uint64_t num_keys;
+  uint64_t num_blocks;
+  uint64_t seed;
+  uint8_t  num_probes;
+  uint8_t  format_version;
+  uint16_t padding_2;
+  uint32_t padding_4;
+};
+
+static const size_t BlockBytes = 64;
+static const size_t MaxProbes = 16;
+
+// block is selected by the high 32 bits, each probe takes 9 bits from the
+// low 32 bits which are remixed between probes, as rocksdb FastLocalBloom
+static inline size_t FilterBlock(uint64_t h, size_t num_blocks) {
+  return size_t((h >> 32) * num_blocks >> 32);
+}
+
+TerarkIndexFilter::TerarkIndexFilter() {
+  Reset();
+}
+TerarkIndexFilter::TerarkIndexFilter(TerarkIndexFilter&& y) : TerarkIndexFilter() {
+  *this = std::move(y);
+}
+TerarkIndexFilter& TerarkIndexFilter::operator=(TerarkIndexFilter&& y) {
+  m_owned.clear();
+  m_owned.swap(y.m_owned);
+  fstring mem = m_owned.empty() ? y.m_mem : fstring(m_owned.data(), m_owned.size());
+  m_blocks = y.m_blocks;
+  m_num_blocks = y.m_num_blocks;
+  m_num_probes = y.m_num_probes;
+  m_seed = y.m_seed;
+  m_mem = mem;
+  y.Reset();
+  return *this;
+}
+TerarkIndexFilter::~TerarkIndexFilter() {
+}
+
+void TerarkIndexFilter::Reset() {
+  m_mem = fstring();
+  m_owned.clear();
+  m_blocks = nullptr;
+  m_num_blocks = m_num_probes = 0;
+  m_seed = 0;
+}
+
+bool TerarkIndexFilter::MayContain(fstring key) const {
+  assert(!empty());
+  uint64_t h = XXH64(key.data(), key.size(), m_seed);
+  const byte_t* block = m_blocks + BlockBytes * FilterBlock(h, m_num_blocks);
+  uint32_t h32 = uint32_t(h);
+  for (size_t i = 0; i < m_num_probes; ++i) {
+    size_t bitpos = h32 >> (32 - 9);
+    if (!((block[bitpos / 8] >> (bitpos % 8)) & 1)) {
+      return false;
+    }
+    h32 *= 0x9e3779b9;
+  }
+  return true;
+}
+
+bool TerarkIndexFilter::Load(fstring mem) {
+  Reset();
+  if (mem.size() < sizeof(Header)) {
+    return false;
+  }
+  auto hp = (const Header*)mem.data();
+  if (hp->format_version != 0 || 0 == hp->num_blocks || hp->num_blocks >> 32 ||
+      0 == hp->num_probes || hp->num_probes > MaxProbes) {
+    return false;
+  }
+  if (sizeof(Header) + BlockBytes * hp->num_blocks != mem.size()) {
+    return false;
+  }
+  m_mem = mem;
+  m_blocks = (const byte_t*)(hp + 1);
+  m_num_blocks = hp->num_blocks;
+  m_num_probes = hp->num_probes;
+  m_seed = hp->seed;
+  return true;
+}
+
+void TerarkIndexFilter::Build(size_t n, size_t bits_per_key,
+                              const KeyEnumerator& enumerate) {
+  TERARK_VERIFY_GT(n, 0);
+  TERARK_VERIFY_GT(bits_per_key, 0);
+  Reset();
+  size_t num_blocks = (n * bits_per_key + BlockBytes * 8 - 1) / (BlockBytes * 8);
+  TERARK_VERIFY_LT(num_blocks, size_t(1) << 32);
+  // blocking loses some accuracy, so use slightly fewer probes than ln2 * bits
+  size_t num_probes = std::min(MaxProbes, std::max<size_t>(1, bits_per_key * 6 / 10));
+  m_owned.resize(sizeof(Header) + BlockBytes * num_blocks, 0);
+  auto hp = (Header*)m_owned.data();
+  hp->num_keys = n;
+  hp->num_blocks = num_blocks;
+  hp->seed = 0x2545F4914F6CDD1Dull;
+  hp->num_probes = byte_t(num_probes);
+  byte_t* blocks = (byte_t*)(hp + 1);
+  size_t cnt = 0;
+  enumerate([&](fstring key) {
+    uint64_t h = XXH64(key.data(), key.size(), hp->seed);
+    byte_t* block = blocks + BlockBytes * FilterBlock(h, num_blocks);
+    uint32_t h32 = uint32_t(h);
+    for (size_t i = 0; i < num_probes; ++i) {
+      size_t bitpos = h32 >> (32 - 9);
+      block[bitpos / 8] |= byte_t(1) << (bitpos % 8);
+      h32 *= 0x9e3779b9;
+    }
+    cnt++;
+  });
+  TERARK_VERIFY_EQ(cnt, n);
+  m_mem = fstring(m_owned.data(), m_owned.size());
+  m_blocks = blocks;
+  m_num_blocks = num_blocks;
+  m_num_probes = num_probes;
+  m_seed = hp->seed;
+}
+
+}  // namespace terark
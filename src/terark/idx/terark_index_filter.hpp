@@ -0,0 +1,44 @@
+#pragma once
+
+#include <functional>
+#include <terark/fstring.hpp>
+#include <terark/valvec.hpp>
+
+namespace terark {
+
+/// Cache line blocked bloom filter, all probes of a key are in one 64 byte
+/// block, so a lookup touches one cache line. With 10 bits per key the
+/// false positive rate is about 1%.
+class TERARK_DLL_EXPORT TerarkIndexFilter {
+ public:
+  typedef std::function<void(fstring key)> KeyCallback;
+  typedef std::function<void(const KeyCallback&)> KeyEnumerator;
+
+  TerarkIndexFilter();
+  TerarkIndexFilter(TerarkIndexFilter&&);
+  TerarkIndexFilter& operator=(TerarkIndexFilter&&);
+  ~TerarkIndexFilter();
+
+  /// enumerate(cb) must call cb(key) for each of the n keys
+  void Build(size_t n, size_t bits_per_key, const KeyEnumerator& enumerate);
+
+  bool Load(fstring mem);
+  fstring Memory() const { return m_mem; }
+  bool empty() const { return m_mem.empty(); }
+
+  /// @returns false if key is surely not in the set
+  bool MayContain(fstring key) const;
+
+ private:
+  struct Header;
+  void Reset();
+
+  fstring m_mem;
+  valvec<byte_t> m_owned;
+  const byte_t* m_blocks;
+  size_t m_num_blocks;
+  size_t m_num_probes;
+  uint64_t m_seed;
+};
+
+}  // namespace terark
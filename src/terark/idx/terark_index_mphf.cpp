@@ -0,0 +1,336 @@
+#include "terark_index_mphf.hpp"
+#include <terark/int_vector.hpp>
+#include <terark/util/throw.hpp>
+#include <zstd/common/xxhash.h>
+
+namespace terark {
+
+struct TerarkIndexMphf::Header {
+  uint64_t num_keys;
+  uint64_t table_size;
+  uint64_t num_buckets;
+  uint64_t dense_buckets;
+  uint64_t seed;
+  uint8_t  fp_bits;
+  uint8_t  id_bits;
+  uint8_t  slot_bits;
+  uint8_t  format_version;
+  uint32_t padding;
+};
+
+// 60% of keys are mapped to 30% of buckets, as PTHash does, the dense
+// buckets are placed first while the table is still empty
+static const uint64_t DenseHashThreshold = 0x9999999999999999ull;
+static const size_t MaxPilot = 65536;
+
+static inline uint64_t mix64(uint64_t x) {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdull;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ull;
+  x ^= x >> 33;
+  return x;
+}
+static inline size_t fastrange(uint64_t h, size_t n) {
+  return size_t((unsigned __int128)h * n >> 64);
+}
+static inline size_t bits_mask(size_t bits) {
+  return bits >= 64 ? size_t(-1) : (size_t(1) << bits) - 1;
+}
+static inline size_t MphfFingerprint(uint64_t h, size_t fp_bits) {
+  return size_t(mix64(h ^ 0x5bd1e9955bd1e995ull) >> (64 - fp_bits));
+}
+
+TerarkIndexMphf::TerarkIndexMphf() {
+  Reset();
+}
+TerarkIndexMphf::TerarkIndexMphf(TerarkIndexMphf&& y) : TerarkIndexMphf() {
+  *this = std::move(y);
+}
+TerarkIndexMphf& TerarkIndexMphf::operator=(TerarkIndexMphf&& y) {
+  m_owned.clear();
+  m_owned.swap(y.m_owned);
+  m_mem = m_owned.empty() ? y.m_mem : fstring(m_owned.data(), m_owned.size());
+  y.Reset();
+  if (m_mem.empty())
+    Reset();
+  else
+    SetView();
+  return *this;
+}
+TerarkIndexMphf::~TerarkIndexMphf() {}
+
+size_t TerarkIndexMphf::Bucket(uint64_t h) const {
+  uint64_t r = (h << 32) | (h >> 32);
+  if (h < DenseHashThreshold) {
+    return fastrange(r, m_dense_buckets);
+  }
+  return m_dense_buckets + fastrange(r, m_num_buckets - m_dense_buckets);
+}
+
+size_t TerarkIndexMphf::Position(uint64_t h, size_t pilot) const {
+  return fastrange(mix64(h ^ mix64(pilot + m_seed)), m_table_size);
+}
+
+size_t TerarkIndexMphf::Find(fstring key) const {
+  assert(!empty());
+  uint64_t h = XXH64(key.data(), key.size(), m_seed);
+  size_t pos = Position(h, m_pilots[Bucket(h)]);
+  if (pos >= m_num_keys) {
+    pos = UintVecMin0::fast_get(m_remap, m_slot_bits, bits_mask(m_slot_bits),
+                                pos - m_num_keys);
+  }
+  size_t entry_bits = m_fp_bits + m_id_bits;
+  size_t entry = UintVecMin0::fast_get(m_slots, entry_bits,
+                                       bits_mask(entry_bits), pos);
+  if ((entry >> m_id_bits) != MphfFingerprint(h, m_fp_bits)) {
+    return size_t(-1);
+  }
+  return entry & bits_mask(m_id_bits);
+}
+
+void TerarkIndexMphf::Reset() {
+  m_mem = fstring();
+  m_owned.clear();
+  m_pilots = nullptr;
+  m_remap = m_slots = nullptr;
+  m_seed = 0;
+  m_num_keys = m_table_size = m_num_buckets = m_dense_buckets = 0;
+  m_fp_bits = m_id_bits = m_slot_bits = 0;
+}
+
+void TerarkIndexMphf::SetView() {
+  auto hp = (const Header*)m_mem.data();
+  m_num_keys = hp->num_keys;
+  m_table_size = hp->table_size;
+  m_num_buckets = hp->num_buckets;
+  m_dense_buckets = hp->dense_buckets;
+  m_seed = hp->seed;
+  m_fp_bits = hp->fp_bits;
+  m_id_bits = hp->id_bits;
+  m_slot_bits = hp->slot_bits;
+  auto p = (const byte_t*)(hp + 1);
+  m_pilots = (const uint16_t*)p;
+  p += align_up(sizeof(uint16_t) * m_num_buckets, 8);
+  m_remap = p;
+  size_t num_remap = m_table_size - m_num_keys;
+  p += num_remap ? UintVecMin0::compute_mem_size(m_slot_bits, num_remap) : 0;
+  m_slots = p;
+}
+
+bool TerarkIndexMphf::Load(fstring mem) {
+  Reset();
+  if (mem.size() < sizeof(Header)) {
+    return false;
+  }
+  auto hp = (const Header*)mem.data();
+  if (hp->format_version != 0 || hp->table_size < hp->num_keys ||
+      hp->num_buckets < 2 || hp->dense_buckets >= hp->num_buckets ||
+      hp->fp_bits + hp->id_bits > MaxEntryBits || 0 == hp->fp_bits) {
+    return false;
+  }
+  size_t num_remap = hp->table_size - hp->num_keys;
+  size_t size = sizeof(Header) + align_up(sizeof(uint16_t) * hp->num_buckets, 8)
+      + (num_remap ? UintVecMin0::compute_mem_size(hp->slot_bits, num_remap) : 0)
+      + UintVecMin0::compute_mem_size(hp->fp_bits + hp->id_bits, hp->num_keys);
+  if (size != mem.size()) {
+    return false;
+  }
+  m_mem = mem;
+  SetView();
+  return true;
+}
+
+void TerarkIndexMphf::Save(std::function<void(const void*, size_t)> write) const {
+  write(m_mem.data(), m_mem.size());
+}
+
+void TerarkIndexMphf::RemapIds(const UintVecMin0& oldToNew) {
+  if (m_owned.empty()) {
+    m_owned.assign((const byte_t*)m_mem.data(), m_mem.size());
+    m_mem = fstring(m_owned.data(), m_owned.size());
+    SetView();
+  }
+  size_t entry_bits = m_fp_bits + m_id_bits;
+  size_t id_mask = bits_mask(m_id_bits);
+  byte_t* slots = (byte_t*)m_slots;
+  for (size_t i = 0; i < m_num_keys; ++i) {
+    size_t entry = UintVecMin0::fast_get(slots, entry_bits, bits_mask(entry_bits), i);
+    size_t new_id = oldToNew[entry & id_mask];
+    TERARK_VERIFY_LE(new_id, id_mask);
+    entry = (entry & ~id_mask) | new_id;
+    febitvec::s_set_uint((size_t*)slots, entry_bits * i, entry_bits, entry);
+  }
+}
+
+const size_t TerarkIndexMphf::MaxEntryBits;
+
+size_t TerarkIndexMphf::MaxFingerprintBits(size_t n) {
+  size_t id_bits = std::max<size_t>(1, UintVecMin0::compute_uintbits(n ? n - 1 : 0));
+  return MaxEntryBits - id_bits;
+}
+
+void TerarkIndexMphf::Build(size_t n, size_t fp_bits,
+                            const KeyIdEnumerator& enumerate) {
+  TERARK_VERIFY_GT(n, 0);
+  TERARK_VERIFY_GT(fp_bits, 0);
+  // a failure is a 64 bit hash collision or a bucket without pilot,
+  // both are very rare, so a few seeds are enough
+  for (uint64_t seed = 0x4d50484653656564ull, i = 0; i < 16; ++i, ++seed) {
+    if (TryBuild(n, fp_bits, mix64(seed), enumerate)) {
+      return;
+    }
+  }
+  THROW_STD(runtime_error, "TerarkIndexMphf: build failed, n = %zd", n);
+}
+
+bool TerarkIndexMphf::TryBuild(size_t n, size_t fp_bits, uint64_t seed,
+                               const KeyIdEnumerator& enumerate) {
+  size_t log2n = 1;
+  while ((size_t(1) << log2n) < n) log2n++;
+  m_seed = seed;
+  m_num_keys = n;
+  m_table_size = n + (n + 49) / 50; // load factor 0.98
+  m_num_buckets = std::max<size_t>(2, (5 * n + log2n - 1) / log2n);
+  m_dense_buckets = std::max<size_t>(1, m_num_buckets * 3 / 10);
+
+  // counting sort keys by bucket
+  valvec<size_t> bucket_beg(m_num_buckets + 1, 0);
+  valvec<uint64_t> hashes(n, valvec_no_init());
+  valvec<size_t>   ids(n, valvec_no_init());
+  size_t max_id = 0, cnt = 0;
+  enumerate([&](fstring key, size_t id) {
+    TERARK_VERIFY_LT(cnt, n);
+    uint64_t h = XXH64(key.data(), key.size(), seed);
+    hashes[cnt] = h;
+    ids[cnt++] = id;
+    bucket_beg[Bucket(h) + 1]++;
+    max_id = std::max(max_id, id);
+  });
+  TERARK_VERIFY_EQ(cnt, n);
+  size_t max_bucket_size = 0;
+  for (size_t b = 0; b < m_num_buckets; ++b) {
+    max_bucket_size = std::max<size_t>(max_bucket_size, bucket_beg[b + 1]);
+    bucket_beg[b + 1] += bucket_beg[b];
+  }
+  valvec<uint64_t> b_hashes(n, valvec_no_init());
+  valvec<size_t>   b_ids(n, valvec_no_init());
+  {
+    valvec<size_t> fill(bucket_beg.data(), m_num_buckets);
+    for (size_t i = 0; i < n; ++i) {
+      size_t j = fill[Bucket(hashes[i])]++;
+      b_hashes[j] = hashes[i];
+      b_ids[j] = ids[i];
+    }
+  }
+  hashes.clear();
+  ids.clear();
+
+  // buckets in descending size order
+  valvec<uint32_t> order(m_num_buckets, valvec_no_init());
+  {
+    valvec<size_t> size_beg(max_bucket_size + 2, 0);
+    for (size_t b = 0; b < m_num_buckets; ++b)
+      size_beg[max_bucket_size - (bucket_beg[b + 1] - bucket_beg[b]) + 1]++;
+    for (size_t s = 0; s <= max_bucket_size; ++s)
+      size_beg[s + 1] += size_beg[s];
+    for (size_t b = 0; b < m_num_buckets; ++b)
+      order[size_beg[max_bucket_size - (bucket_beg[b + 1] - bucket_beg[b])]++] = uint32_t(b);
+  }
+
+  m_fp_bits = fp_bits;
+  m_id_bits = std::max<size_t>(1, UintVecMin0::compute_uintbits(max_id));
+  TERARK_VERIFY_LE(m_fp_bits + m_id_bits, MaxEntryBits);
+  size_t entry_bits = m_fp_bits + m_id_bits;
+  size_t id_mask = bits_mask(m_id_bits);
+  UintVecMin0 entries;
+  entries.resize_with_uintbits(m_table_size, entry_bits);
+  valvec<uint16_t> pilots(m_num_buckets, 0);
+  febitvec taken(m_table_size, false);
+  valvec<size_t> pos(max_bucket_size, valvec_no_init());
+  for (size_t k = 0; k < m_num_buckets; ++k) {
+    size_t b = order[k];
+    size_t beg = bucket_beg[b], len = bucket_beg[b + 1] - beg;
+    if (0 == len) {
+      break; // all remaining buckets are empty
+    }
+    const uint64_t* bh = b_hashes.data() + beg;
+    size_t pilot = 0;
+    for (; pilot < MaxPilot; ++pilot) {
+      uint64_t ph = mix64(pilot + seed);
+      size_t j = 0;
+      for (; j < len; ++j) {
+        size_t p = fastrange(mix64(bh[j] ^ ph), m_table_size);
+        if (taken.is1(p))
+          break;
+        size_t i = 0;
+        while (i < j && pos[i] != p) i++;
+        if (i < j)
+          break;
+        pos[j] = p;
+      }
+      if (j == len)
+        break;
+      if (0 == pilot) {
+        // identical hashes always collide, check it once
+        for (size_t x = 1; x < len; ++x)
+          for (size_t y = 0; y < x; ++y)
+            if (bh[x] == bh[y])
+              return false;
+      }
+    }
+    if (MaxPilot == pilot) {
+      return false;
+    }
+    pilots[b] = uint16_t(pilot);
+    for (size_t j = 0; j < len; ++j) {
+      taken.set1(pos[j]);
+      size_t fp = MphfFingerprint(bh[j], fp_bits);
+      entries.set_wire(pos[j], fp << m_id_bits | (b_ids[beg + j] & id_mask));
+    }
+  }
+
+  // move entries in [n, table_size) to free slots in [0, n)
+  size_t num_remap = m_table_size - n;
+  m_slot_bits = std::max<size_t>(1, UintVecMin0::compute_uintbits(n - 1));
+  UintVecMin0 remap;
+  remap.resize_with_uintbits(num_remap, m_slot_bits);
+  size_t free_slot = 0;
+  for (size_t p = n; p < m_table_size; ++p) {
+    if (taken.is1(p)) {
+      while (taken.is1(free_slot)) free_slot++;
+      TERARK_VERIFY_LT(free_slot, n);
+      taken.set1(free_slot);
+      remap.set_wire(p - n, free_slot);
+      entries.set_wire(free_slot, entries[p]);
+    }
+  }
+
+  Header header;
+  memset(&header, 0, sizeof header);
+  header.num_keys = n;
+  header.table_size = m_table_size;
+  header.num_buckets = m_num_buckets;
+  header.dense_buckets = m_dense_buckets;
+  header.seed = seed;
+  header.fp_bits = uint8_t(m_fp_bits);
+  header.id_bits = uint8_t(m_id_bits);
+  header.slot_bits = uint8_t(m_slot_bits);
+  size_t pilots_size = align_up(sizeof(uint16_t) * m_num_buckets, 8);
+  size_t remap_size = num_remap ? UintVecMin0::compute_mem_size(m_slot_bits, num_remap) : 0;
+  size_t slots_size = UintVecMin0::compute_mem_size(entry_bits, n);
+  m_owned.resize(sizeof header + pilots_size + remap_size + slots_size, 0);
+  byte_t* p = m_owned.data();
+  memcpy(p, &header, sizeof header);
+  p += sizeof header;
+  memcpy(p, pilots.data(), sizeof(uint16_t) * m_num_buckets);
+  p += pilots_size;
+  memcpy(p, remap.data(), remap_size);
+  p += remap_size;
+  memcpy(p, entries.data(), std::min(slots_size, entries.mem_size()));
+  m_mem = fstring(m_owned.data(), m_owned.size());
+  SetView();
+  return true;
+}
+
+}  // namespace terark
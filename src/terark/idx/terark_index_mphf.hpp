@@ -0,0 +1,70 @@
+#pragma once
+
+#include <functional>
+#include <terark/fstring.hpp>
+#include <terark/valvec.hpp>
+
+namespace terark {
+
+class UintVecMin0;
+
+/// PTHash style minimal perfect hash of keys to [0, n), every slot stores
+/// a short fingerprint of its key and a payload id, so Find(key) returns
+/// the id of a key in the build set, and rejects other keys with a false
+/// positive rate of 1/2^fp_bits, each lookup touches about 2 cache lines.
+class TERARK_DLL_EXPORT TerarkIndexMphf {
+ public:
+  typedef std::function<void(fstring key, size_t id)> KeyIdCallback;
+  typedef std::function<void(const KeyIdCallback&)> KeyIdEnumerator;
+
+  TerarkIndexMphf();
+  TerarkIndexMphf(TerarkIndexMphf&&);
+  TerarkIndexMphf& operator=(TerarkIndexMphf&&);
+  ~TerarkIndexMphf();
+
+  /// fingerprint and payload id of a slot are packed in at most 58 bits
+  static const size_t MaxEntryBits = 58;
+  /// the largest fp_bits for n keys with ids in [0, n)
+  static size_t MaxFingerprintBits(size_t n);
+
+  /// enumerate(cb) must call cb(key, id) for each of the n distinct keys,
+  /// it may be called more than once
+  void Build(size_t n, size_t fp_bits, const KeyIdEnumerator& enumerate);
+
+  bool Load(fstring mem);
+  void Save(std::function<void(const void*, size_t)> write) const;
+  fstring Memory() const { return m_mem; }
+  bool empty() const { return m_mem.empty(); }
+  size_t num_keys() const { return m_num_keys; }
+
+  /// replace each payload id with oldToNew[id]
+  void RemapIds(const UintVecMin0& oldToNew);
+
+  /// @returns candidate id, size_t(-1) if key is surely not in the set
+  size_t Find(fstring key) const;
+
+ private:
+  struct Header;
+  size_t Bucket(uint64_t h) const;
+  size_t Position(uint64_t h, size_t pilot) const;
+  bool TryBuild(size_t n, size_t fp_bits, uint64_t seed,
+                const KeyIdEnumerator& enumerate);
+  void Reset();
+  void SetView();
+
+  fstring m_mem;
+  valvec<byte_t> m_owned;
+  const uint16_t* m_pilots;
+  const byte_t* m_remap;
+  const byte_t* m_slots;
+  uint64_t m_seed;
+  size_t m_num_keys;
+  size_t m_table_size;
+  size_t m_num_buckets;
+  size_t m_dense_buckets;
+  size_t m_fp_bits;
+  size_t m_id_bits;
+  size_t m_slot_bits;
+};
+
+}  // namespace terark
@@ -6,6 +6,9 @@
 #endif
 
 #include "terark_zip_index.hpp"
+#include "terark_index_filter.hpp"
+#include "terark_index_mphf.hpp"
+#include <thread>
 #include <typeindex>
 #include <terark/io/DataIO.hpp>
 #include <terark/io/FileStream.hpp>
@@ -22,6 +25,7 @@
 #include <terark/fsa/crit_bit_trie.hpp>
 #include <terark/util/tmpfile.hpp>
 #include <terark/util/crc.hpp>
+#include <terark/util/hugepage.hpp>
 #include <terark/util/mmap.hpp>
 #include <terark/zbs/blob_store_file_header.hpp>
 #include <terark/zbs/zip_reorder_map.hpp>
@@ -30,6 +34,7 @@
 #include <terark/zbs/dict_zip_blob_store.hpp>
 #include <terark/zbs/xxhash_helper.hpp>
 #include <terark/num_to_str.hpp>
+#include <terark/set_op.hpp>
 
 #if __clang__
 # pragma clang diagnostic push
@@ -243,6 +248,28 @@ struct TerarkIndexFooter {
   uint32_t footer_crc32;
 };
 
+// since format_version 1, optional sections are between suffix and footer,
+// the data of each section is followed by its trailer, and the total size of
+// the sections is the uint64 just before the footer, counted in footer_size
+struct TerarkIndexSectionTrailer {
+  uint64_t size; // data size, multiple of 8
+  uint32_t type;
+  uint32_t crc32;
+};
+enum TerarkIndexSectionType : uint32_t {
+  kIndexSectionMphf = 1,
+  kIndexSectionFilter = 2,
+};
+
+/// size of footer and optional sections
+inline size_t IndexTailSize(const TerarkIndexFooter& footer) {
+  size_t size = footer.footer_size;
+  if (footer.format_version >= 1) {
+    size += ((const uint64_t*)&footer)[-1];
+  }
+  return size;
+}
+
 struct IndexUintPrefixHeader {
   uint8_t key_length;
   uint8_t padding_1;
@@ -253,7 +280,32 @@ struct IndexUintPrefixHeader {
   uint64_t rank_select_size;
 };
 
+struct TerarkIndex::FileMemory {
+  MmapWholeFile mmap;
+  HugepageCopy meta;
+};
 TerarkIndex::~TerarkIndex() {}
+std::unique_ptr<TerarkIndex>
+TerarkIndex::LoadFile(fstring fpath, bool mmapPopulate) {
+  std::unique_ptr<FileMemory> fm(new FileMemory);
+  MmapWholeFile(fpath, false, mmapPopulate).swap(fm->mmap);
+  std::unique_ptr<TerarkIndex> index = LoadMemory(fm->mmap.memory());
+  if (get_hugepage_load()) {
+    // suffix data blocks stay in the file mapping
+    valvec<fstring> blocks = index->GetMetaData();
+    if (fm->meta.copy(&blocks)) {
+      index->DetachMetaData(blocks);
+    }
+  }
+  index->m_fileMem = std::move(fm);
+  return index;
+}
+void TerarkIndex::FindBatch(const fstring* keys, size_t n, size_t* ids,
+                            TerarkContext* ctx) const {
+  for (size_t i = 0; i < n; ++i) {
+    ids[i] = Find(keys[i], ctx);
+  }
+}
 TerarkIndex::Factory::~Factory() {}
 TerarkIndex::Iterator::~Iterator() {}
 
@@ -379,6 +431,12 @@ struct VirtualPrefixBase : public PrefixBase {
   virtual size_t TotalKeySize() const = 0;
   virtual size_t Find(fstring key, const SuffixBase* suffix, TerarkContext* ctx) const = 0;
   virtual size_t DictRank(fstring key, const SuffixBase* suffix, TerarkContext* ctx) const = 0;
+  virtual void FindBatch(const fstring* keys, size_t n, size_t* ids,
+                         const SuffixBase* suffix, TerarkContext* ctx) const {
+    for (size_t i = 0; i < n; ++i) {
+      ids[i] = Find(keys[i], suffix, ctx);
+    }
+  }
   virtual size_t AppendMinKey(valvec<byte_t>* buffer, TerarkContext* ctx) const = 0;
   virtual size_t AppendMaxKey(valvec<byte_t>* buffer, TerarkContext* ctx) const = 0;
 
@@ -443,6 +501,10 @@ struct VirtualPrefix : public PrefixBase {
   size_t DictRank(fstring key, const SuffixBase* suffix, TerarkContext* ctx) const {
     return prefix->DictRank(key, suffix, ctx);
   }
+  void FindBatch(const fstring* keys, size_t n, size_t* ids,
+                 const SuffixBase* suffix, TerarkContext* ctx) const {
+    prefix->FindBatch(keys, n, ids, suffix, ctx);
+  }
   size_t AppendMinKey(valvec<byte_t>* buffer, TerarkContext* ctx) const {
     return prefix->AppendMinKey(buffer, ctx);
   }
@@ -585,6 +647,97 @@ struct VirtualSuffix : public SuffixBase {
   }
 };
 
+template<class Prefix>
+void PrefixFindBatch(const Prefix& prefix, const fstring* keys, size_t n, size_t* ids,
+                     const SuffixBase* suffix, TerarkContext* ctx) {
+  for (size_t i = 0; i < n; ++i) {
+    ids[i] = prefix.Find(keys[i], suffix, ctx);
+  }
+}
+inline void PrefixFindBatch(const VirtualPrefix& prefix, const fstring* keys, size_t n, size_t* ids,
+                            const SuffixBase* suffix, TerarkContext* ctx) {
+  prefix.FindBatch(keys, n, ids, suffix, ctx);
+}
+
+/// optional parts of an index, saved as sections after the suffix
+struct IndexExtra {
+  TerarkIndexFilter filter;
+  TerarkIndexMphf mphf;
+
+  bool empty() const {
+    return filter.empty() && mphf.empty();
+  }
+  /// absent keys are mostly rejected without touching prefix and suffix
+  bool MayContain(fstring key) const {
+    if (!filter.empty() && !filter.MayContain(key)) {
+      return false;
+    }
+    return mphf.empty() || size_t(-1) != mphf.Find(key);
+  }
+  size_t Save(std::function<void(const void*, size_t)> write) const {
+    size_t size = 0;
+    auto save_section = [&](fstring mem, uint32_t type) {
+      if (mem.empty()) {
+        return;
+      }
+      TerarkIndexSectionTrailer trailer;
+      trailer.size = mem.size();
+      trailer.type = type;
+      trailer.crc32 = Crc32c_update(0, mem.data(), mem.size());
+      write(mem.data(), mem.size());
+      write(&trailer, sizeof trailer);
+      size += mem.size() + sizeof trailer;
+    };
+    save_section(filter.Memory(), kIndexSectionFilter);
+    save_section(mphf.Memory(), kIndexSectionMphf);
+    return size;
+  }
+  /// unknown sections are skipped
+  void Load(fstring mem) {
+    while (mem.size() > 0) {
+      TerarkIndexSectionTrailer trailer;
+      if (mem.size() < sizeof trailer) {
+        throw std::invalid_argument("TerarkIndex::LoadMemory section: bad mem");
+      }
+      memcpy(&trailer, mem.data() + mem.size() - sizeof trailer, sizeof trailer);
+      if (trailer.size > mem.size() - sizeof trailer) {
+        throw std::invalid_argument("TerarkIndex::LoadMemory section: bad size");
+      }
+      fstring data = mem.substr(mem.size() - sizeof trailer - trailer.size, trailer.size);
+      if (isChecksumVerifyEnabled()) {
+        uint32_t computed = Crc32c_update(0, data.data(), data.size());
+        if (computed != trailer.crc32) {
+          throw BadCrc32cException("TerarkIndex::LoadMemory section",
+                                   trailer.crc32, computed);
+        }
+      }
+      if (kIndexSectionMphf == trailer.type && !mphf.Load(data)) {
+        throw std::invalid_argument("TerarkIndex::LoadMemory mphf: bad mem");
+      }
+      if (kIndexSectionFilter == trailer.type && !filter.Load(data)) {
+        throw std::invalid_argument("TerarkIndex::LoadMemory filter: bad mem");
+      }
+      mem = mem.substr(0, data.data() - mem.data());
+    }
+  }
+  /// save with ids remapped by newToOld
+  size_t Reorder(ZReorderMap& newToOld, std::function<void(const void*, size_t)> write) const {
+    if (mphf.empty()) {
+      return Save(write);
+    }
+    size_t n = newToOld.size();
+    UintVecMin0 oldToNew(n, n - 1);
+    for (newToOld.rewind(); !newToOld.eof(); ++newToOld) {
+      oldToNew.set_wire(*newToOld, newToOld.index());
+    }
+    IndexExtra reordered;
+    reordered.filter.Load(filter.Memory());
+    reordered.mphf.Load(mphf.Memory());
+    reordered.mphf.RemapIds(oldToNew);
+    return reordered.Save(write);
+  }
+};
+
 template<class Prefix, class Suffix>
 struct IndexParts {
   IndexParts() {}
@@ -642,9 +795,11 @@ public:
 
   unique_ptr<TerarkIndex> LoadMemory(fstring mem) const {
     auto& footer = ((const TerarkIndexFooter*)(mem.data() + mem.size()))[-1];
-    fstring suffix = mem.substr(mem.size() - footer.footer_size - footer.suffix_size, footer.suffix_size);
+    size_t tail_size = IndexTailSize(footer);
+    fstring suffix = mem.substr(mem.size() - tail_size - footer.suffix_size, footer.suffix_size);
     fstring prefix = fstring(suffix.data() - footer.prefix_size, footer.prefix_size);
     fstring common = fstring(prefix.data() - align_up(footer.common_size, 8), footer.common_size);
+    fstring sections = fstring(suffix.data() + suffix.size(), tail_size - footer.footer_size);
     if (isChecksumVerifyEnabled()) {
       uint64_t computed = Crc32c_update(0, common.data(), common.size());
       uint64_t saved = footer.common_crc32;
@@ -675,24 +830,27 @@ public:
     if (!p->Load(prefix, s.get())) {
       throw std::invalid_argument("TerarkIndex::LoadMemory Prefix Fail, bad mem");
     }
+    IndexExtra extra;
+    extra.Load(sections);
 
-    return unique_ptr<TerarkIndex>(CreateIndex(&footer, Common(common, false), p.release(), s.release()));
+    return unique_ptr<TerarkIndex>(CreateIndex(&footer, Common(common, false), p.release(), s.release(),
+                                               std::move(extra)));
   }
 
-  template<class Prefix, class Suffix>
-  void SaveMmap(const IndexParts<Prefix, Suffix>* index,
+  template<class Index>
+  void SaveMmap(const Index* index,
                 std::function<void(const void*, size_t)> write) const {
-    SaveMmap(index->common_, index->prefix_, index->suffix_, write);
+    SaveMmap(index->common_, index->prefix_, index->suffix_, index->extra_, write);
   }
 
-  template<class Prefix, class Suffix>
-  void Reorder(const IndexParts<Prefix, Suffix>* index,
+  template<class Index>
+  void Reorder(const Index* index,
                ZReorderMap& newToOld, std::function<void(const void*, size_t)> write, fstring tmpFile) const {
-    Reorder(index->common_, index->prefix_, index->suffix_, newToOld, write, tmpFile);
+    Reorder(index->common_, index->prefix_, index->suffix_, index->extra_, newToOld, write, tmpFile);
   }
 
   virtual void SaveMmap(const Common& common, const PrefixBase& prefix, const SuffixBase& suffix,
-                        std::function<void(const void*, size_t)> write) const {
+                        const IndexExtra& extra, std::function<void(const void*, size_t)> write) const {
     TerarkIndexFooter footer;
     footer.format_version = 0;
     footer.bfs_suffix = prefix.flags.is_bfs_suffix;
@@ -720,6 +878,12 @@ public:
     });
     assert(footer.suffix_size % 8 == 0);
     footer.suffix_xxhash = dist.digest();
+    if (!extra.empty()) {
+      uint64_t sections_size = extra.Save(write);
+      write(&sections_size, sizeof sections_size);
+      footer.footer_size += sizeof sections_size;
+      footer.format_version = 1;
+    }
     auto name = Name();
     assert(name.size() == sizeof footer.class_name);
     memcpy(footer.class_name, name.data(), sizeof footer.class_name);
@@ -727,7 +891,8 @@ public:
     write(&footer, sizeof footer);
   }
 
-  virtual void Reorder(const Common& common, const PrefixBase& prefix, const SuffixBase& suffix, ZReorderMap& newToOld,
+  virtual void Reorder(const Common& common, const PrefixBase& prefix, const SuffixBase& suffix,
+                       const IndexExtra& extra, ZReorderMap& newToOld,
                        std::function<void(const void*, size_t)> write, fstring tmpFile) const {
     TerarkIndexFooter footer;
     footer.format_version = 0;
@@ -754,6 +919,12 @@ public:
       footer.suffix_size += size;
     }, tmpFile);
     footer.suffix_xxhash = dist.digest();
+    if (!extra.empty()) {
+      uint64_t sections_size = extra.Reorder(newToOld, write);
+      write(&sections_size, sizeof sections_size);
+      footer.footer_size += sizeof sections_size;
+      footer.format_version = 1;
+    }
     auto name = Name();
     assert(name.size() == sizeof footer.class_name);
     memcpy(footer.class_name, name.data(), sizeof footer.class_name);
@@ -772,7 +943,8 @@ public:
   virtual ~IndexFactoryBase() {}
 
   virtual TerarkIndex*
-  CreateIndex(const TerarkIndexFooter* footer, Common&& common, PrefixBase* prefix, SuffixBase* suffix) const {
+  CreateIndex(const TerarkIndexFooter* footer, Common&& common, PrefixBase* prefix, SuffixBase* suffix,
+              IndexExtra&& extra) const {
     TERARK_RT_assert(0, std::logic_error);
     return nullptr;
   }
@@ -1049,12 +1221,14 @@ public:
   Index(const IndexFactoryBase* factory, const TerarkIndexFooter* footer) : factory_(factory), footer_(footer) {}
 
   Index(const IndexFactoryBase* factory, const TerarkIndexFooter* footer, Common&& common, Prefix&& prefix,
-        Suffix&& suffix)
-      : base_t(std::move(common), std::move(prefix), std::move(suffix)), factory_(factory), footer_(footer) {
+        Suffix&& suffix, IndexExtra&& extra)
+      : base_t(std::move(common), std::move(prefix), std::move(suffix)), factory_(factory), footer_(footer),
+        extra_(std::move(extra)) {
   }
 
   const IndexFactoryBase* factory_;
   const TerarkIndexFooter* footer_;
+  IndexExtra extra_;
 
   fstring Name() const final {
     return factory_->Name();
@@ -1074,7 +1248,49 @@ public:
       return size_t(-1);
     }
     key = key.substr(common_.size());
-    return prefix_.Find(key, suffix_.TotalKeySize() != 0 ? &suffix_ : nullptr, ctx);
+    const SuffixBase* suffix = suffix_.TotalKeySize() != 0 ? &suffix_ : nullptr;
+    if (!extra_.filter.empty() && !extra_.filter.MayContain(key)) {
+      return size_t(-1);
+    }
+    if (!extra_.mphf.empty()) {
+      // most absent keys are rejected by the fingerprint, present keys are
+      // still verified by the trie walk, restoring the candidate key by id
+      // is not cheaper than the walk on a nested trie
+      size_t candidate = extra_.mphf.Find(key);
+      if (size_t(-1) == candidate) {
+        return candidate;
+      }
+      size_t id = prefix_.Find(key, suffix, ctx);
+      assert(size_t(-1) == id || id == candidate);
+      return id;
+    }
+    return prefix_.Find(key, suffix, ctx);
+  }
+
+  void FindBatch(const fstring* keys, size_t n, size_t* ids, TerarkContext* ctx) const final {
+    const SuffixBase* suffix = suffix_.TotalKeySize() != 0 ? &suffix_ : nullptr;
+    if (common_.size() == 0 && extra_.empty()) {
+      PrefixFindBatch(prefix_, keys, n, ids, suffix, ctx);
+      return;
+    }
+    const size_t Chunk = 64;
+    fstring sub_keys[Chunk];
+    size_t  sub_pos[Chunk], sub_ids[Chunk];
+    for (size_t i = 0; i < n; ) {
+      size_t m = 0;
+      for (; i < n && m < Chunk; ++i) {
+        if (keys[i].startsWith(common_) && extra_.MayContain(keys[i].substr(common_.size()))) {
+          sub_keys[m] = keys[i].substr(common_.size());
+          sub_pos[m++] = i;
+        } else {
+          ids[i] = size_t(-1);
+        }
+      }
+      PrefixFindBatch(prefix_, sub_keys, m, sub_ids, suffix, ctx);
+      for (size_t j = 0; j < m; ++j) {
+        ids[sub_pos[j]] = sub_ids[j];
+      }
+    }
   }
 
   size_t DictRank(fstring key, TerarkContext* ctx) const final {
@@ -1118,14 +1334,21 @@ public:
   fstring Memory() const final {
     auto f = footer_;
     size_t index_size = f ? align_up(f->common_size, 8) + f->prefix_size + f->suffix_size : 0;
-    return index_size == 0 ? fstring() : fstring((byte_t*)footer_ - index_size, index_size + f->footer_size);
+    size_t tail_size = f ? IndexTailSize(*f) : 0;
+    return index_size == 0 ? fstring() : fstring((byte_t*)(f + 1) - tail_size - index_size,
+                                                 index_size + tail_size);
   }
 
   valvec<fstring> GetMetaData() const final {
     assert(footer_ != nullptr);
     auto f = footer_;
-    fstring prefix = fstring((byte_t*)f - f->suffix_size - f->prefix_size, f->prefix_size);
+    fstring prefix = fstring((byte_t*)(f + 1) - IndexTailSize(*f) - f->suffix_size - f->prefix_size,
+                             f->prefix_size);
     valvec<fstring> meta_data;
+    if (!extra_.empty()) {
+      size_t sections_size = IndexTailSize(*f) - f->footer_size;
+      meta_data.emplace_back((byte_t*)(f + 1) - f->footer_size - sections_size, sections_size);
+    }
     suffix_.GetMetaData(&meta_data);
     meta_data.append(prefix);
     return meta_data;
@@ -1133,10 +1356,15 @@ public:
 
   void DetachMetaData(const valvec<fstring>& blocks) final {
     assert(footer_ != nullptr);
+    size_t skip = 0;
+    if (!extra_.empty()) {
+      extra_.Load(blocks.front());
+      skip = 1;
+    }
     bool ok = prefix_.Load(blocks.back(), suffix_.TotalKeySize() != 0 ? &suffix_ : nullptr);
     assert(ok); (void)ok;
     valvec<fstring> suffix_blocks;
-    suffix_blocks.risk_set_data((fstring*)blocks.data(), blocks.size() - 1);
+    suffix_blocks.risk_set_data((fstring*)blocks.data() + skip, blocks.size() - 1 - skip);
     suffix_.DetachMetaData(suffix_blocks);
     suffix_blocks.risk_release_ownership();
   }
@@ -1146,7 +1374,7 @@ public:
     double c = prefix_.KeyCount();
     double r = 1e9;
     size_t t = prefix_.TotalKeySize() + suffix_.TotalKeySize() + prefix_.KeyCount() * common_.size();
-    size_t index_size = f ? f->footer_size + align_up(f->common_size, 8) + f->prefix_size + f->suffix_size : 0;
+    size_t index_size = f ? IndexTailSize(*f) + align_up(f->common_size, 8) + f->prefix_size + f->suffix_size : 0;
     snprintf(
         buffer, size,
         "    total_key_len = %zd  common_size = %zd  entry_cnt = %zd\n"
@@ -1242,8 +1470,8 @@ public:
 
 protected:
   TerarkIndex* CreateIndex(const TerarkIndexFooter* footer, Common&& common, PrefixBase* prefix,
-                           SuffixBase* suffix) const final {
-    return new index_type(this, footer, std::move(common), Prefix(prefix), Suffix(suffix));
+                           SuffixBase* suffix, IndexExtra&& extra) const final {
+    return new index_type(this, footer, std::move(common), Prefix(prefix), Suffix(suffix), std::move(extra));
   }
   PrefixBase* CreatePrefix() const final {
     return new Prefix();
@@ -1993,6 +2221,14 @@ struct IndexNestLoudsTriePrefix : public VirtualPrefixBase {
     suffix->AppendKey(suffix_id, &suffix_key.get(), ctx);
     return key == suffix_key ? suffix_id : size_t(-1);
   }
+  void FindBatch(const fstring* keys, size_t n, size_t* ids,
+                 const SuffixBase* suffix, TerarkContext* ctx) const override {
+    if (suffix == nullptr && flags.is_bfs_suffix) {
+      trie_->index_batch(keys, n, ids);
+    } else {
+      VirtualPrefixBase::FindBatch(keys, n, ids, suffix, ctx);
+    }
+  }
   size_t DictRank(fstring key, const SuffixBase* suffix, TerarkContext* ctx) const {
     size_t rank;
     if (suffix == nullptr) {
@@ -2971,6 +3207,10 @@ void NestLoudsTriePrefixSetConfig(
   }
   conf.isInputSorted = true;
   conf.debugLevel = tiopt.debugLevel > 0 ? 1 : 0;
+  conf.buildThreads = tiopt.nltBuildThreads;
+  if (0 == conf.buildThreads) {
+    conf.buildThreads = std::thread::hardware_concurrency();
+  }
 }
 
 template<class NestLoudsTrieDAWG, class StrVec>
@@ -3107,10 +3347,11 @@ PrefixBase* BuildCritBitTriePrefix(InputBufferType& input,
   auto entryPerTrie = tiopt.cbtEntryPerTrie;
   std::unique_ptr<CritBitTriePackedBuilder> trie(new CritBitTriePackedBuilder(
       numKeys, entryPerTrie, sumKeyLen, isReverse, tiopt.cbtHashBits));
-  for (size_t i = 0; i < numKeys; ++i) {
-    trie->insert(input.next(), i / entryPerTrie);
+  size_t threads = tiopt.cbtBuildThreads;
+  if (threads == 0) {
+    threads = std::thread::hardware_concurrency();
   }
-  trie->encode();
+  trie->build([&]() { return input.next(); }, threads);
   auto cbt = trie->newcbt();
   fstrvec bounds;
   trie->get_bounds(false, &bounds);
@@ -3454,75 +3695,98 @@ PrefixBuildInfo TerarkIndex::GetPrefixBuildInfo(const TerarkIndexOptions& opt, c
 };
 
 
-class TerarkIndexDebugBuilder {
+// KeyStat of sorted keys, a key is counted when the next key is known
+class TerarkKeyStatCollector {
   freq_hist_o1 freq;
   TerarkIndex::KeyStat stat;
-  fstrvec data;
-  size_t keyCount = 0;
+  valvec<byte_t> last;
   size_t prevSamePrefix = 0;
-public:
 
-  void Init(size_t count);
+  void processKey(fstring key, size_t samePrefix);
+public:
+  void Init();
   void Add(fstring key);
-  TerarkKeyReader* Finish(TerarkIndex::KeyStat* output);
+  void Finish(TerarkIndex::KeyStat* output);
 };
 
-void TerarkIndexDebugBuilder::Init(size_t count) {
+void TerarkKeyStatCollector::Init() {
   freq.clear();
   stat.~KeyStat();
   ::new(&stat) TerarkIndex::KeyStat;
-  data.erase_all();
-  stat.keyCount = count;
-  keyCount = 0;
+  last.erase_all();
   prevSamePrefix = 0;
 }
 
-void TerarkIndexDebugBuilder::Add(fstring key) {
+void TerarkKeyStatCollector::processKey(fstring key, size_t samePrefix) {
+  size_t prefixSize = std::min(key.size(), std::max(samePrefix, prevSamePrefix) + 1);
+  size_t suffixSize = key.size() - prefixSize;
+  stat.minKeyLen = std::min(key.size(), stat.minKeyLen);
+  stat.maxKeyLen = std::max(key.size(), stat.maxKeyLen);
+  stat.sumKeyLen += key.size();
+  stat.sumPrefixLen += prefixSize;
+  stat.minPrefixLen = std::min(stat.minPrefixLen, prefixSize);
+  stat.maxPrefixLen = std::max(stat.maxPrefixLen, prefixSize);
+  stat.minSuffixLen = std::min(stat.minSuffixLen, suffixSize);
+  stat.maxSuffixLen = std::max(stat.maxSuffixLen, suffixSize);
+  auto& diff = stat.diff;
+  if (diff.size() < samePrefix) {
+    diff.resize(samePrefix);
+  }
+  for (size_t i = 0; i < samePrefix; ++i) {
+    ++diff[i].cur;
+    ++diff[i].cnt;
+  }
+  for (size_t i = samePrefix; i < diff.size(); ++i) {
+    diff[i].max = std::max(diff[i].cur, diff[i].max);
+    diff[i].cur = 0;
+  }
+  prevSamePrefix = samePrefix;
+}
+
+void TerarkKeyStatCollector::Add(fstring key) {
   freq.add_record(key);
-  auto processKey = [&](fstring key, size_t samePrefix) {
-    size_t prefixSize = std::min(key.size(), std::max(samePrefix, prevSamePrefix) + 1);
-    size_t suffixSize = key.size() - prefixSize;
-    stat.minKeyLen = std::min(key.size(), stat.minKeyLen);
-    stat.maxKeyLen = std::max(key.size(), stat.maxKeyLen);
-    stat.sumKeyLen += key.size();
-    stat.sumPrefixLen += prefixSize;
-    stat.minPrefixLen = std::min(stat.minPrefixLen, prefixSize);
-    stat.maxPrefixLen = std::max(stat.maxPrefixLen, prefixSize);
-    stat.minSuffixLen = std::min(stat.minSuffixLen, suffixSize);
-    stat.maxSuffixLen = std::max(stat.maxSuffixLen, suffixSize);
-    auto& diff = stat.diff;
-    if (diff.size() < samePrefix) {
-      diff.resize(samePrefix);
-    }
-    for (size_t i = 0; i < samePrefix; ++i) {
-      ++diff[i].cur;
-      ++diff[i].cnt;
-    }
-    for (size_t i = samePrefix; i < diff.size(); ++i) {
-      diff[i].max = std::max(diff[i].cur, diff[i].max);
-      diff[i].cur = 0;
-    }
-    prevSamePrefix = samePrefix;
-  };
-  if (keyCount++ == 0) {
-    data.push_back(key);
+  if (stat.keyCount++ == 0) {
     stat.minKey.assign(key);
   } else {
-    auto last = data.back();
     processKey(last, key.commonPrefixLen(last));
-    data.push_back(key);
-    if (keyCount == stat.keyCount) {
-      processKey(key, 0);
-      stat.maxKey.assign(key);
-    }
   }
+  last.assign(key);
 }
 
-TerarkKeyReader*
-TerarkIndexDebugBuilder::Finish(TerarkIndex::KeyStat* output) {
+void TerarkKeyStatCollector::Finish(TerarkIndex::KeyStat* output) {
+  if (stat.keyCount) {
+    processKey(last, 0);
+    stat.maxKey.assign(last);
+  }
   freq.finish();
   stat.entropyLen = freq_hist_o1::estimate_size(freq.histogram());
   *output = std::move(stat);
+}
+
+class TerarkIndexDebugBuilder {
+  TerarkKeyStatCollector collector;
+  fstrvec data;
+public:
+
+  void Init(size_t count);
+  void Add(fstring key);
+  TerarkKeyReader* Finish(TerarkIndex::KeyStat* output);
+};
+
+void TerarkIndexDebugBuilder::Init(size_t count) {
+  collector.Init();
+  data.erase_all();
+  data.reserve(count);
+}
+
+void TerarkIndexDebugBuilder::Add(fstring key) {
+  collector.Add(key);
+  data.push_back(key);
+}
+
+TerarkKeyReader*
+TerarkIndexDebugBuilder::Finish(TerarkIndex::KeyStat* output) {
+  collector.Finish(output);
   class TerarkKeyDebugReader : public TerarkKeyReader {
   public:
     fstrvec data;
@@ -3541,6 +3805,254 @@ TerarkIndexDebugBuilder::Finish(TerarkIndex::KeyStat* output) {
   return reader;
 }
 
+// sorted run of TerarkKeySorter, each key is written as TerarkKeyFileReader
+// reads it: length of prefix shared with the previous key, then the suffix
+struct TerarkKeySortedRun {
+  std::unique_ptr<TempFileDeleteOnClose> file;
+  NativeDataInput<InputBuffer> input;
+  valvec<byte_t> key;
+  bool eof = true;
+
+  void rewind() {
+    file->fp.rewind();
+    input.attach(&file->fp);
+    input.resetbuf(); // drop data buffered by previous pass
+    key.erase_all();
+    eof = false;
+    next();
+  }
+  void next() {
+    if (input.eof()) {
+      eof = true;
+      return;
+    }
+    var_uint64_t shared;
+    input >> shared;
+    key.risk_set_size(shared);
+    input.load_add(key);
+  }
+};
+
+// merges the runs by a loser tree, a run at eof is greater than any key
+class TerarkKeyRunMerger {
+  typedef TerarkKeySortedRun Run;
+  struct RunIter {
+    typedef std::input_iterator_tag iterator_category;
+    typedef const Run* value_type;
+    typedef ptrdiff_t difference_type;
+    typedef const Run** pointer;
+    typedef const Run*& reference;
+    Run* run;
+    const Run* operator*() const { return run; }
+    RunIter& operator++() { run->next(); return *this; }
+  };
+  struct RunLess {
+    bool operator()(const Run* x, const Run* y) const {
+      return !x->eof && (y->eof || fstring(x->key) < fstring(y->key));
+    }
+  };
+  std::vector<std::unique_ptr<Run>> m_runs;
+  Run m_eofRun; // max key of the loser tree
+  multi_way::LoserTree<RunIter, const Run*, false, RunLess> m_tree;
+  bool m_started = false;
+public:
+  explicit TerarkKeyRunMerger(std::vector<std::unique_ptr<TempFileDeleteOnClose>>&& files)
+    : m_tree(&m_eofRun) {
+    for (auto& file : files) {
+      m_runs.emplace_back(new Run);
+      m_runs.back()->file = std::move(file);
+      m_tree.m_ways.push_back(RunIter{m_runs.back().get()});
+    }
+    files.clear();
+  }
+  void rewind() {
+    for (auto& run : m_runs) {
+      run->rewind();
+    }
+    m_tree.start();
+    m_started = false;
+  }
+  /// returned key is valid until next call
+  bool next(fstring* key) {
+    if (m_started && !m_tree.empty()) {
+      m_tree.increment();
+    }
+    m_started = true;
+    if (m_tree.empty()) {
+      return false;
+    }
+    *key = m_tree.current_value()->key;
+    return true;
+  }
+};
+
+class TerarkKeySorter::Impl {
+public:
+  static const size_t kMaxFanIn = 128; // bounds open files and buffers
+  // sort_radix needs another SEntry per key, lcp needs 4 bytes
+  static const size_t kPerKey = 2 * sizeof(SortableStrVec::SEntry) + 4;
+  std::string tmpPrefix;
+  size_t memLimit;
+  size_t sortThreads;
+  SortableStrVec buf;
+  valvec<uint32_t> lcp;
+  std::vector<std::unique_ptr<TempFileDeleteOnClose>> runs;
+
+  std::unique_ptr<TempFileDeleteOnClose> NewRun() {
+    std::unique_ptr<TempFileDeleteOnClose> run(new TempFileDeleteOnClose);
+    run->path = tmpPrefix;
+    run->open_temp();
+    return run;
+  }
+  // capacity is charged to memLimit, buf is grown here because push_back
+  // doubling may exceed it
+  // @returns false if buf can not hold one more key in memLimit
+  bool Reserve(size_t keyLen) {
+    auto& index = buf.m_index;
+    auto& pool = buf.m_strpool;
+    size_t used = index.capacity() * kPerKey + pool.capacity();
+    size_t room = memLimit > used ? memLimit - used : 0;
+    // grow index and pool in step by average key len, leaving room for both
+    size_t avgLen = index.size() ? pool.size() / index.size() : keyLen;
+    if (index.size() == index.capacity()) {
+      size_t grow = std::min(std::max<size_t>(index.capacity(), 256), room / (kPerKey + avgLen));
+      if (0 == grow) {
+        return false;
+      }
+      index.reserve(index.capacity() + grow);
+      room -= grow * kPerKey;
+    }
+    size_t need = pool.size() + keyLen;
+    if (need > pool.capacity()) {
+      size_t want = need + (index.capacity() - index.size() - 1) * avgLen;
+      size_t cap = std::min(want, pool.capacity() + room);
+      if (cap < need) {
+        return false;
+      }
+      pool.reserve(cap);
+    }
+    return true;
+  }
+  void Spill() {
+    buf.sort_radix(&lcp, sortThreads);
+    auto run = NewRun();
+    for (size_t i = 0; i < buf.size(); ++i) {
+      fstring key = buf[i];
+      run->writer << var_uint64_t(lcp[i]) << var_uint64_t(key.size() - lcp[i]);
+      run->writer.ensureWrite(key.data() + lcp[i], key.size() - lcp[i]);
+    }
+    run->complete_write();
+    runs.push_back(std::move(run));
+    buf.m_index.erase_all(); // keep capacity for next run
+    buf.m_strpool.erase_all();
+  }
+  // merge the first kMaxFanIn runs into one until the final merge fits
+  void ReduceRuns() {
+    while (runs.size() > kMaxFanIn) {
+      std::vector<std::unique_ptr<TempFileDeleteOnClose>> group;
+      for (size_t i = 0; i < kMaxFanIn; ++i) {
+        group.push_back(std::move(runs[i]));
+      }
+      runs.erase(runs.begin(), runs.begin() + kMaxFanIn);
+      TerarkKeyRunMerger merger(std::move(group));
+      merger.rewind();
+      auto run = NewRun();
+      valvec<byte_t> prev;
+      fstring key;
+      while (merger.next(&key)) {
+        size_t shared = key.commonPrefixLen(prev);
+        run->writer << var_uint64_t(shared) << var_uint64_t(key.size() - shared);
+        run->writer.ensureWrite(key.data() + shared, key.size() - shared);
+        prev.assign(key);
+      }
+      run->complete_write();
+      runs.push_back(std::move(run));
+    }
+  }
+};
+
+TerarkKeySorter::TerarkKeySorter(const TerarkIndexOptions& tiopt)
+  : impl(new Impl) {
+  impl->tmpPrefix = tiopt.localTempDir + "/TerarkKeySorter-XXXXXX";
+  impl->memLimit = tiopt.smallTaskMemory;
+  impl->sortThreads = tiopt.keySortThreads;
+}
+
+TerarkKeySorter::~TerarkKeySorter() {}
+
+void TerarkKeySorter::Add(fstring key) {
+  auto& buf = impl->buf;
+  if (!impl->Reserve(key.size()) && buf.size()) {
+    impl->Spill(); // capacity is kept
+    impl->Reserve(key.size()); // a key larger than memLimit is still added
+  }
+  buf.push_back(key);
+}
+
+size_t TerarkKeySorter::NumRuns() const {
+  return impl->runs.size();
+}
+
+TerarkKeyReader* TerarkKeySorter::Finish(TerarkIndex::KeyStat* output) {
+  TerarkKeyStatCollector collector;
+  collector.Init();
+  if (impl->runs.empty()) {
+    // all keys fit in memory, no temp file
+    class TerarkKeyMemReader : public TerarkKeyReader {
+    public:
+      SortableStrVec keys;
+      size_t i = 0;
+
+      fstring next() final {
+        return keys[i++];
+      }
+      void rewind() final {
+        i = 0;
+      }
+    };
+    std::unique_ptr<TerarkKeyMemReader> reader(new TerarkKeyMemReader);
+    reader->keys.swap(impl->buf);
+    reader->keys.sort_radix(NULL, impl->sortThreads);
+    for (size_t i = 0; i < reader->keys.size(); ++i) {
+      collector.Add(reader->keys[i]);
+    }
+    collector.Finish(output);
+    impl->lcp.clear();
+    return reader.release();
+  }
+  if (impl->buf.size()) {
+    impl->Spill();
+  }
+  impl->buf.clear();
+  impl->lcp.clear();
+  impl->ReduceRuns();
+  class TerarkKeyMergeReader : public TerarkKeyReader {
+  public:
+    TerarkKeyRunMerger merger;
+
+    explicit TerarkKeyMergeReader(std::vector<std::unique_ptr<TempFileDeleteOnClose>>&& runs)
+      : merger(std::move(runs)) {}
+    fstring next() final {
+      fstring key;
+      TERARK_VERIFY(merger.next(&key));
+      return key;
+    }
+    void rewind() final {
+      merger.rewind();
+    }
+  };
+  std::unique_ptr<TerarkKeyMergeReader> reader(new TerarkKeyMergeReader(std::move(impl->runs)));
+  impl->runs.clear();
+  reader->merger.rewind();
+  fstring key;
+  while (reader->merger.next(&key)) {
+    collector.Add(key);
+  }
+  collector.Finish(output);
+  reader->merger.rewind();
+  return reader.release();
+}
+
 TerarkIndex* TerarkIndex::Factory::Build(TerarkKeyReader* reader, const TerarkIndexOptions& tiopt,
                                          const KeyStat& ks, const PrefixBuildInfo* info_ptr) {
   using namespace index_detail;
@@ -3677,11 +4189,30 @@ TerarkIndex* TerarkIndex::Factory::Build(TerarkKeyReader* reader, const TerarkIn
   };
 
   assert(ks.keyCount > 0);
+  if (tiopt.mphfFingerprintBits > TerarkIndexMphf::MaxFingerprintBits(ks.keyCount)) {
+    THROW_STD(invalid_argument,
+              "mphfFingerprintBits = %d, max is %zd for keyCount = %zd",
+              tiopt.mphfFingerprintBits,
+              TerarkIndexMphf::MaxFingerprintBits(ks.keyCount), ks.keyCount);
+  }
   bool isReverse = ks.minKey > ks.maxKey;
   PrefixBuildInfo uint_prefix_info = info_ptr != nullptr ? *info_ptr : GetPrefixBuildInfo(tiopt, ks);
   size_t cplen = uint_prefix_info.common_prefix;
   PrefixBase* prefix;
   SuffixBase* suffix;
+  IndexExtra extra;
+  auto build_mphf = [&] {
+    if (tiopt.mphfFingerprintBits == 0) {
+      return;
+    }
+    size_t n = ks.keyCount;
+    extra.mphf.Build(n, tiopt.mphfFingerprintBits, [&](const TerarkIndexMphf::KeyIdCallback& cb) {
+      reader->rewind();
+      for (size_t k = 0; k < n; ++k) {
+        cb(reader->next().substr(cplen), isReverse ? n - 1 - k : k);
+      }
+    });
+  };
   if (uint_prefix_info.key_length > 0) {
     if (ks.minKeyLen == ks.maxKeyLen && ks.maxKeyLen == cplen + uint_prefix_info.key_length) {
       DefaultInputBuffer input_reader{reader, cplen};
@@ -3709,6 +4240,7 @@ TerarkIndex* TerarkIndex::Factory::Build(TerarkKeyReader* reader, const TerarkIn
         input_reader, tiopt, ks.keyCount, ks.sumKeyLen - ks.keyCount * cplen,
         isReverse, ks.minKeyLen == ks.maxKeyLen);
     suffix = BuildEmptySuffix();
+    build_mphf();
   } else {
     MinimizePrefixInputBuffer prefix_input_reader{reader, cplen, ks.keyCount, ks.maxKeyLen};
     prefix = BuildNestLoudsTriePrefix(
@@ -3719,12 +4251,21 @@ TerarkIndex* TerarkIndex::Factory::Build(TerarkKeyReader* reader, const TerarkIn
         suffix_input_reader, ks.keyCount, ks.sumKeyLen - ks.sumPrefixLen,
         ks.minSuffixLen == ks.maxSuffixLen, isReverse,
         uint_prefix_info.zip_ratio, tiopt);
+    build_mphf();
+  }
+  if (tiopt.filterBitsPerKey > 0) {
+    extra.filter.Build(ks.keyCount, tiopt.filterBitsPerKey, [&](const TerarkIndexFilter::KeyCallback& cb) {
+      reader->rewind();
+      for (size_t k = 0; k < ks.keyCount; ++k) {
+        cb(reader->next().substr(cplen));
+      }
+    });
   }
   valvec<char> common(cplen, valvec_reserve());
   common.append(ks.minKey.data(), cplen);
   auto factory = IndexFactoryBase::GetFactoryByType(std::type_index(typeid(*prefix)), std::type_index(typeid(*suffix)));
   assert(factory != nullptr);
-  return factory->CreateIndex(nullptr, Common(common, true), prefix, suffix);
+  return factory->CreateIndex(nullptr, Common(common, true), prefix, suffix, std::move(extra));
 }
 
 size_t TerarkIndex::Factory::MemSizeForBuild(const TerarkIndex::KeyStat& ks) {
@@ -3766,7 +4307,10 @@ unique_ptr<TerarkIndex> TerarkIndex::LoadMemory(fstring mem) {
           + class_name.c_str());
     }
     TerarkIndex::Factory* factory = g_TerarkIndexFactroy.val(idx).get();
-    size_t index_size = footer.footer_size + align_up(footer.common_size, 8) + footer.prefix_size + footer.suffix_size;
+    size_t index_size = IndexTailSize(footer) + align_up(footer.common_size, 8) + footer.prefix_size + footer.suffix_size;
+    if (index_size > mem.size() - offset) {
+      throw std::invalid_argument("TerarkIndex::LoadMemory(): Bad index size");
+    }
     index_vec.emplace_back(factory->LoadMemory(mem.substr(mem.size() - index_size)));
     offset += index_size;
   } while (offset < mem.size());
@@ -16,11 +16,21 @@ struct TERARK_DLL_EXPORT TerarkIndexOptions {
   uint64_t smallTaskMemory = 1200 << 20;
   uint32_t cbtEntryPerTrie = 65536;
   uint32_t cbtMinKeySize = 16;
+  /// threads to build crit bit sub tries, 0 means hardware concurrency
+  uint32_t cbtBuildThreads = 1;
+  /// threads to expand BFS depths of nest louds trie, 0 means hardware concurrency
+  uint32_t nltBuildThreads = 1;
+  /// threads to radix sort keys in TerarkKeySorter, 0 means hardware concurrency
+  uint32_t keySortThreads = 1;
   double cbtMinKeyRatio = 0.5;
   int32_t indexNestLevel = 3;
   uint8_t debugLevel = 0;
   uint8_t indexNestScale = 8;
   uint8_t cbtHashBits = 0;
+  /// fingerprint bits of the minimal perfect hash for Find, 0 disables it
+  uint8_t mphfFingerprintBits = 0;
+  /// bits per key of the bloom filter for Find, 0 disables it
+  uint8_t filterBitsPerKey = 0;
   int8_t indexTempLevel = 0;
   bool compressGlobalDict = false;
   std::string localTempDir = "/tmp";
@@ -137,6 +147,10 @@ class TERARK_DLL_EXPORT TerarkIndex : boost::noncopyable {
   static PrefixBuildInfo GetPrefixBuildInfo(const TerarkIndexOptions& opt,
                                             const TerarkIndex::KeyStat& ks);
   static std::unique_ptr<TerarkIndex> LoadMemory(fstring mem);
+  /// load from a file mapping owned by the returned index, if
+  /// get_hugepage_load(), GetMetaData() is copied to hugepages
+  static std::unique_ptr<TerarkIndex> LoadFile(fstring fpath,
+                                               bool mmapPopulate = false);
   virtual ~TerarkIndex();
   virtual fstring Name() const = 0;
   virtual void SaveMmap(
@@ -146,6 +160,10 @@ class TERARK_DLL_EXPORT TerarkIndex : boost::noncopyable {
                        fstring tmpFile) const = 0;
   virtual size_t Find(fstring key, TerarkContext* ctx) const = 0;
   virtual size_t DictRank(fstring key, TerarkContext* ctx) const = 0;
+  /// ids[i] = Find(keys[i], ctx), lookups are interleaved where the prefix
+  /// supports it, to overlap cache misses of multi-get on large indices
+  virtual void FindBatch(const fstring* keys, size_t n, size_t* ids,
+                         TerarkContext* ctx) const;
   virtual void MinKey(valvec<byte_t>* key, TerarkContext* ctx) const = 0;
   virtual void MaxKey(valvec<byte_t>* key, TerarkContext* ctx) const = 0;
   virtual size_t NumKeys() const = 0;
@@ -162,6 +180,28 @@ class TERARK_DLL_EXPORT TerarkIndex : boost::noncopyable {
   virtual void BuildCache(double cacheRatio) = 0;
   virtual void DumpKeys(
       std::function<void(fstring, fstring, fstring)>) const = 0;
+
+ private:
+  struct FileMemory;
+  std::unique_ptr<FileMemory> m_fileMem; // set by LoadFile
+};
+
+/// External sort of index keys with bounded memory: keys are buffered up
+/// to smallTaskMemory, sorted and spilled as prefix compressed runs to
+/// localTempDir. Finish() merges the runs by a loser tree to compute the
+/// KeyStat, the returned reader merges them again on each rewind().
+/// Duplicate keys are kept.
+class TERARK_DLL_EXPORT TerarkKeySorter : boost::noncopyable {
+  class Impl;
+  std::unique_ptr<Impl> impl;
+
+ public:
+  explicit TerarkKeySorter(const TerarkIndexOptions&);
+  ~TerarkKeySorter();
+  void Add(fstring key);
+  size_t NumRuns() const;
+  /// the sorter is empty after Finish, the reader owns the runs
+  TerarkKeyReader* Finish(TerarkIndex::KeyStat* output);
 };
 
 }  // namespace terark
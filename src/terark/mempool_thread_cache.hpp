@@ -265,8 +265,11 @@ public:
                         n1->next[k] = n2->next[k];
                 while (huge_list.next[huge_list.size - 1] == list_tail && --huge_list.size > 0)
                     ;
-                if (remain)
+                if (remain) {
+                    // remain is poisoned as free, sfree writes link in it
+                    ASAN_UNPOISON_MEMORY_REGION(base + res + request, remain);
                     sfree(base, res + request, remain);
+                }
                 huge_size_sum -= request;
                 huge_node_cnt--;
                 fragment_size -= request;
@@ -296,6 +299,7 @@ public:
                         m_frag_inc = 0;
                     }
                     if (rlen > request) {
+                        ASAN_UNPOISON_MEMORY_REGION(base + res + request, rlen - request);
                         sfree(base, res + request, rlen - request);
                     }
                     ASAN_UNPOISON_MEMORY_REGION(base + res, request);
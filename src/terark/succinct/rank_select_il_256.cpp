@@ -487,7 +487,8 @@ void rank_select_il::build_cache_q(size_t Q0, size_t Q1) {
             / (sizeof(Line)/sizeof(uint32_t))
     );
     lines = m_lines.data();
-    memset(&lines[m_lines.size()], 0, sizeof(Line));
+    // zero all reserved lines, unused select slots would be saved as garbage
+    memset(&lines[m_lines.size()], 0, sizeof(Line) * (m_lines.capacity() - m_lines.size()));
     lines[m_lines.size()].rlev1 = (uint32_t)Rank1;
 
     uint32_t* select_index = (uint32_t*)(m_lines.end() + 1);
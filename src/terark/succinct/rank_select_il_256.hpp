@@ -171,6 +171,29 @@ public:
     static void fast_prefetch_rank1(const Line* /*m_lines*/, size_t /*bitpos*/)
         { /*_mm_prefetch((const char*)&m_lines[bitpos/LineBits].rlev1, _MM_HINT_T0);*/ }
 
+    /// prefetch select cache, then call prefetch_selectX_line later
+    void prefetch_select0(size_t Rank0) const {
+        if (m_fast_select0)
+            _mm_prefetch((const char*)&m_fast_select0[Rank0/LineBits], _MM_HINT_T0);
+    }
+    void prefetch_select1(size_t Rank1) const {
+        if (m_fast_select1)
+            _mm_prefetch((const char*)&m_fast_select1[Rank1/LineBits], _MM_HINT_T0);
+    }
+    /// prefetch the lines which selectX(RankX) is likely in
+    void prefetch_select0_line(size_t Rank0) const {
+        if (m_fast_select0)
+            prefetch_lines(m_fast_select0[Rank0/LineBits]);
+    }
+    void prefetch_select1_line(size_t Rank1) const {
+        if (m_fast_select1)
+            prefetch_lines(m_fast_select1[Rank1/LineBits]);
+    }
+    void prefetch_lines(size_t lo) const {
+        _mm_prefetch((const char*)(m_lines.data() + lo + 0), _MM_HINT_T0);
+        _mm_prefetch((const char*)(m_lines.data() + lo + 1), _MM_HINT_T0);
+    }
+
     static size_t fast_one_seq_len(const Line*, size_t bitpos);
 
 protected:
@@ -9,12 +9,16 @@
 #define TERARK_RANK_SELECT_INLINE_SLOW_HPP_
 
 #include <terark/util/throw.hpp>
+#include <terark/util/cpu_features.hpp>
+#if defined(TERARK_TARGET_DISPATCH)
+    #include <immintrin.h>
+#endif
 
 namespace terark {
 
 ///@param r rank range is [0, 64), more exctly: [0, popcnt(x))
 ///@returns [0, popcnt(x)), the bitpos of r'th 1
-inline unsigned UintSelect1(uint64_t x, unsigned r) {
+inline unsigned UintSelect1_slow(uint64_t x, unsigned r) {
     assert(0 != x);
 #if defined(NDEBUG)
     if (terark_unlikely(r >= (unsigned)fast_popcount(x))) {
@@ -59,6 +63,24 @@ inline unsigned UintSelect1(uint64_t x, unsigned r) {
     return s;
 }
 
+#if defined(TERARK_TARGET_DISPATCH)
+TERARK_TARGET("bmi,bmi2")
+inline unsigned UintSelect1_bmi2(uint64_t x, unsigned r) {
+    assert(0 != x);
+    return unsigned(63 - __builtin_clzll(_pdep_u64(_bzhi_u64(uint64_t(-1), r+1), x)));
+}
+#endif
+
+inline unsigned UintSelect1(uint64_t x, unsigned r) {
+#if defined(TERARK_TARGET_DISPATCH)
+    if (g_cpu_features.bmi2) {
+        assert(r < (unsigned)fast_popcount(x));
+        return UintSelect1_bmi2(x, r);
+    }
+#endif
+    return UintSelect1_slow(x, r);
+}
+
 // 'k' may be 0
 #define TERARK_GET_BITS_64(u64,k,width) ( k ? (u64 >> (k-1)*width) & ((1<<width)-1) : 0 )
 
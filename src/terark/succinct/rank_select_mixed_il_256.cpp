@@ -322,6 +322,8 @@ void rank_select_mixed_il_256::build_cache_dx(bool speed_select0, bool speed_sel
         shrink_to_fit();
         u32_slots_used = 0;
         reserve_bytes((lines + 1) * sizeof(RankCacheMixed));
+        // the extra line is saved too, it must not have garbage bits
+        memset(&m_lines[lines], 0, sizeof(RankCacheMixed));
     }
     bits_range_set0_dx<dimensions>(m_size[dimensions], ceiled_bits);
     m_flags |= (1 << flag_x_offset);
@@ -350,6 +350,8 @@ build_cache_impl(bool speed_select0,
     if (need_shrink_to_fit) {
         shrink_to_fit();
         reserve_bytes((lines + 1) * sizeof(RankCacheMixed));
+        // the extra line is saved too, it must not have garbage bits
+        memset(&m_lines[lines], 0, sizeof(RankCacheMixed));
     }
     (this->*bits_range_set0)(m_size[dimensions], ceiled_bits);
 
@@ -72,6 +72,29 @@ public:
         { _mm_prefetch((const char*)&m_rank_cache[bitpos/LineBits], _MM_HINT_T0); }
     static void fast_prefetch_rank1(const RankCache* rankCache, size_t bitpos)
         { _mm_prefetch((const char*)&rankCache[bitpos/LineBits], _MM_HINT_T0); }
+
+    /// prefetch select cache, then call prefetch_selectX_line later
+    void prefetch_select0(size_t Rank0) const {
+        if (m_sel0_cache)
+            _mm_prefetch((const char*)&m_sel0_cache[Rank0/LineBits], _MM_HINT_T0);
+    }
+    void prefetch_select1(size_t Rank1) const {
+        if (m_sel1_cache)
+            _mm_prefetch((const char*)&m_sel1_cache[Rank1/LineBits], _MM_HINT_T0);
+    }
+    /// prefetch rank cache and bits which selectX(RankX) is likely in
+    void prefetch_select0_line(size_t Rank0) const {
+        if (m_sel0_cache)
+            prefetch_lines(m_sel0_cache[Rank0/LineBits]);
+    }
+    void prefetch_select1_line(size_t Rank1) const {
+        if (m_sel1_cache)
+            prefetch_lines(m_sel1_cache[Rank1/LineBits]);
+    }
+    void prefetch_lines(size_t lo) const {
+        _mm_prefetch((const char*)&m_rank_cache[lo], _MM_HINT_T0);
+        _mm_prefetch((const char*)(this->m_words + lo*LineBits/WordBits), _MM_HINT_T0);
+    }
 };
 
 inline size_t rank_select_se::
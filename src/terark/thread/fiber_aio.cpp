@@ -7,6 +7,14 @@
 
 #if BOOST_OS_LINUX
   #include <libaio.h> // linux native aio
+  #include <sys/syscall.h>
+  #include <sys/uio.h>
+  #if defined(__has_include)
+    #if __has_include(<linux/io_uring.h>) && defined(__NR_io_uring_setup)
+      #include <linux/io_uring.h> // raw syscall, does not need liburing
+      #define TERARK_FIBER_AIO_HAS_URING 1
+    #endif
+  #endif
 #endif
 
 #if BOOST_OS_WINDOWS
@@ -18,6 +26,7 @@
   #include <aio.h> // posix aio
   #include <sys/types.h>
   #include <sys/mman.h>
+  #include <sys/resource.h>
 #endif
 
 #include "fiber_yield.hpp"
@@ -25,8 +34,10 @@
 #include <terark/fstring.hpp>
 #include <terark/util/atomic.hpp>
 #include <terark/util/throw.hpp>
+#include <terark/valvec.hpp>
 #include <boost/fiber/all.hpp>
 #include <boost/lockfree/queue.hpp>
+#include <mutex>
 
 namespace terark {
 
@@ -36,11 +47,13 @@ namespace terark {
 
 #if BOOST_OS_LINUX
 
+static int probe_aio_method();
+
 ///@returns
 //  0: posix aio
 //  1: linux aio(default)
-//  2: io uring (not supported now)
-static int g_aio_method = (int)getEnvLong("aio_method", 1);
+//  2: io uring, fallback to linux aio if kernel does not support it
+static int g_aio_method = probe_aio_method();
 
 static std::atomic<size_t> g_ft_num;
 
@@ -53,8 +66,14 @@ static std::atomic<size_t> g_ft_num;
     if (ret) TERARK_DIE("%s = %s", #expr, strerror(-ret)); \
   } while (0)
 
-struct io_return {
+// a fiber may wait for multiple io in a batch
+struct io_waiter {
   boost::fibers::context* fctx;
+  size_t pending;
+};
+
+struct io_return {
+  io_waiter* waiter; // not used by dt_exec_io
   intptr_t len;
   int err;
   bool done;
@@ -108,7 +127,8 @@ class io_fiber_context {
           ior->len = io_events[i].res;
           ior->err = io_events[i].res2;
           ior->done = true;
-          m_fy.unchecked_notify(&ior->fctx);
+          if (0 == --ior->waiter->pending)
+            m_fy.unchecked_notify(&ior->waiter->fctx);
         }
         io_reqnum -= ret;
         if (ret < reap_batch)
@@ -121,7 +141,8 @@ public:
   void yield() { m_fy.unchecked_yield(); }
 
   intptr_t exec_io(int fd, void* buf, size_t len, off_t offset, int cmd) {
-    io_return io_ret = {nullptr, 0, -1, false};
+    io_waiter waiter = {nullptr, 1};
+    io_return io_ret = {&waiter, 0, -1, false};
     struct iocb io = {0};
     io.data = &io_ret;
     io.aio_lio_opcode = cmd;
@@ -145,7 +166,7 @@ public:
       break;
     }
     io_reqnum++;
-    m_fy.unchecked_wait(&io_ret.fctx);
+    m_fy.unchecked_wait(&waiter.fctx);
     assert(io_ret.done);
     if (io_ret.err) {
       errno = io_ret.err;
@@ -153,6 +174,65 @@ public:
     return io_ret.len;
   }
 
+  size_t batch_io(int fd, fiber_aio_req* reqs, size_t num, int cmd) {
+    size_t nerr = 0;
+    for (size_t i = 0; i < num; ) {
+      size_t n = std::min<size_t>(num - i, reap_batch);
+      io_waiter   waiter = {nullptr, n};
+      io_return   io_ret[reap_batch];
+      struct iocb io_arr[reap_batch];
+      struct iocb* iop_arr[reap_batch];
+      for (size_t j = 0; j < n; j++) {
+        fiber_aio_req& r = reqs[i + j];
+        io_ret[j] = {&waiter, 0, -1, false};
+        memset(&io_arr[j], 0, sizeof(struct iocb));
+        io_arr[j].data = &io_ret[j];
+        io_arr[j].aio_lio_opcode = cmd;
+        io_arr[j].aio_fildes = fd;
+        io_arr[j].u.c.buf = r.buf;
+        io_arr[j].u.c.nbytes = r.len;
+        io_arr[j].u.c.offset = r.offset;
+        iop_arr[j] = &io_arr[j];
+      }
+      size_t submitted = 0;
+      while (submitted < n) {
+        int ret = io_submit(io_ctx, n - submitted, iop_arr + submitted);
+        if (ret < 0) {
+          int err = -ret;
+          if (EAGAIN == err) {
+            yield();
+            continue;
+          }
+          fprintf(stderr, "ERROR: ft_num = %zd, io_submit(nr=%zd) = %s\n", ft_num, n - submitted, strerror(err));
+          for (size_t j = submitted; j < n; j++) {
+            io_ret[j].err = err;
+            io_ret[j].done = true;
+          }
+          waiter.pending -= n - submitted;
+          break;
+        }
+        submitted += ret;
+        io_reqnum += ret;
+      }
+      if (waiter.pending)
+        m_fy.unchecked_wait(&waiter.fctx);
+      for (size_t j = 0; j < n; j++) {
+        fiber_aio_req& r = reqs[i + j];
+        assert(io_ret[j].done);
+        if (io_ret[j].err || io_ret[j].len < 0) {
+          r.ret = -1;
+          r.err = io_ret[j].err ? io_ret[j].err : int(-io_ret[j].len);
+          nerr++;
+        } else {
+          r.ret = io_ret[j].len;
+          r.err = 0;
+        }
+      }
+      i += n;
+    }
+    return nerr;
+  }
+
   intptr_t dt_exec_io(int fd, void* buf, size_t len, off_t offset, int cmd) {
     io_return io_ret = {nullptr, 0, -1, false};
     struct iocb io = {0};
@@ -212,6 +292,358 @@ static io_fiber_context& tls_io_fiber() {
   return io_fiber;
 }
 
+#if defined(TERARK_FIBER_AIO_HAS_URING)
+
+static int uring_setup(unsigned entries, struct io_uring_params* p) {
+  return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+static int uring_enter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+  return (int)syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, NULL, 0);
+}
+static int uring_register(int ring_fd, unsigned opcode, const void* arg, unsigned nr_args) {
+  return (int)syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args);
+}
+
+// buffers registered by fiber_aio_register_buffer, each thread local ring
+// re-registers them when version is changed
+static struct uring_fixed_buffers {
+  std::mutex            mtx;
+  valvec<struct iovec>  bufs;
+  size_t                bytes = 0;
+  std::atomic<unsigned> version{0};
+
+  unsigned snapshot(valvec<struct iovec>* out) {
+    std::lock_guard<std::mutex> lock(mtx);
+    out->assign(bufs);
+    return version.load(std::memory_order_relaxed);
+  }
+} g_uring_bufs;
+
+// one io_uring per thread, shared by all fibers of the thread.
+// fibers put sqe into the submission ring without syscall, the io fiber
+// submits all pending sqe by one io_uring_enter and polls the completion
+// ring in user space, so a batch of io costs just one syscall.
+class io_uring_fiber_context {
+  static const unsigned ring_entries = 256;
+  static const unsigned max_batch = 32;
+  enum class state {
+    ready,
+    running,
+    stopping,
+    stopped,
+  };
+  FiberYield           m_fy;
+  volatile state       m_state;
+  size_t               ft_num;
+  unsigned long long   counter;
+  boost::fibers::fiber io_fiber;
+  int                  ring_fd = -1;
+  unsigned             sq_entries;
+  unsigned             sq_mask;
+  unsigned             sq_tail;      // local tail, published on submit
+  unsigned             sq_pending = 0; // prepared but not submitted
+  unsigned*            sq_khead;
+  unsigned*            sq_ktail;
+  unsigned*            sq_array;
+  struct io_uring_sqe* sqes;
+  unsigned             cq_entries;
+  unsigned             cq_mask;
+  unsigned*            cq_khead;
+  unsigned*            cq_ktail;
+  struct io_uring_cqe* cqes;
+  void*                sq_ring_ptr = MAP_FAILED;
+  void*                cq_ring_ptr = MAP_FAILED;
+  void*                sqes_ptr = MAP_FAILED;
+  size_t               sq_ring_len = 0;
+  size_t               cq_ring_len = 0;
+  size_t               sqes_len = 0;
+  size_t               io_reqnum = 0; // submitted but not reaped
+  valvec<struct iovec> m_fixed;
+  unsigned             m_fixed_version = 0;
+  bool                 m_fixed_valid = true;
+
+  void fiber_proc() {
+    m_state = state::running;
+    while (state::running == m_state) {
+      io_submit_reap();
+      yield();
+      counter++;
+    }
+    assert(state::stopping == m_state);
+    m_state = state::stopped;
+  }
+
+  // the kernel refused the pending sqe, take them back from the ring and
+  // do them by blocking pread/pwrite, thus waiting fibers are woken up
+  void sync_exec_pending(int err) {
+    fprintf(stderr, "ERROR: ft_num = %zd, io_uring_enter(nr=%u) = %s, fallback to sync io\n", ft_num, sq_pending, strerror(err));
+    unsigned beg = sq_tail - sq_pending;
+    sq_tail = beg;
+    as_atomic(*sq_ktail).store(sq_tail, std::memory_order_release);
+    for (unsigned i = 0, n = sq_pending; i < n; i++) {
+      const struct io_uring_sqe* sqe = &sqes[sq_array[(beg + i) & sq_mask]];
+      io_return* ior = (io_return*)(uintptr_t)(sqe->user_data);
+      bool is_write = IORING_OP_WRITE == sqe->opcode || IORING_OP_WRITE_FIXED == sqe->opcode;
+      ssize_t ret = is_write
+          ? ::pwrite(sqe->fd, (const void*)(uintptr_t)sqe->addr, sqe->len, sqe->off)
+          : ::pread (sqe->fd, (void*)(uintptr_t)sqe->addr, sqe->len, sqe->off);
+      if (ret < 0) {
+        ior->len = -1;
+        ior->err = errno;
+      } else {
+        ior->len = ret;
+        ior->err = 0;
+      }
+      ior->done = true;
+      if (0 == --ior->waiter->pending)
+        m_fy.unchecked_notify(&ior->waiter->fctx);
+    }
+    sq_pending = 0;
+  }
+
+  void io_submit_reap() {
+    if (sq_pending) {
+      as_atomic(*sq_ktail).store(sq_tail, std::memory_order_release);
+      int ret = uring_enter(ring_fd, sq_pending, 0, 0);
+      if (ret < 0) {
+        int err = errno;
+        if (EAGAIN != err && EBUSY != err && EINTR != err)
+          sync_exec_pending(err);
+      }
+      else {
+        sq_pending -= ret;
+        io_reqnum += ret;
+      }
+    }
+    if (0 == io_reqnum) {
+      return;
+    }
+    unsigned head = *cq_khead;
+    unsigned tail = as_atomic(*cq_ktail).load(std::memory_order_acquire);
+    if (head == tail) {
+      return;
+    }
+    for (; head != tail; head++) {
+      const struct io_uring_cqe* cqe = &cqes[head & cq_mask];
+      io_return* ior = (io_return*)(uintptr_t)(cqe->user_data);
+      if (cqe->res < 0) {
+        ior->len = -1;
+        ior->err = -cqe->res;
+      } else {
+        ior->len = cqe->res;
+        ior->err = 0;
+      }
+      ior->done = true;
+      io_reqnum--;
+      if (0 == --ior->waiter->pending)
+        m_fy.unchecked_notify(&ior->waiter->fctx);
+    }
+    as_atomic(*cq_khead).store(head, std::memory_order_release);
+  }
+
+  // re-register fixed buffers only when ring is idle
+  void refresh_fixed_buffers() {
+    unsigned version = g_uring_bufs.version.load(std::memory_order_acquire);
+    if (terark_likely(version == m_fixed_version)) {
+      return;
+    }
+    if (io_reqnum || sq_pending) {
+      m_fixed_valid = false; // registered buffers may be freed
+      return;
+    }
+    if (!m_fixed.empty()) {
+      uring_register(ring_fd, IORING_UNREGISTER_BUFFERS, NULL, 0);
+      m_fixed.erase_all();
+    }
+    m_fixed_version = g_uring_bufs.snapshot(&m_fixed);
+    m_fixed_valid = true;
+    if (!m_fixed.empty()) {
+      if (uring_register(ring_fd, IORING_REGISTER_BUFFERS, m_fixed.data(), (unsigned)m_fixed.size()) < 0) {
+        fprintf(stderr, "WARN: ft_num = %zd, IORING_REGISTER_BUFFERS(nr=%zd) = %s, fallback to non-fixed buffer\n",
+                ft_num, m_fixed.size(), strerror(errno));
+        m_fixed.erase_all();
+      }
+    }
+  }
+
+  int find_fixed(const void* buf, size_t len) const {
+    if (!m_fixed_valid) {
+      return -1;
+    }
+    for (size_t i = 0; i < m_fixed.size(); i++) {
+      auto beg = (const byte_t*)m_fixed[i].iov_base;
+      auto end = beg + m_fixed[i].iov_len;
+      if ((const byte_t*)buf >= beg && (const byte_t*)buf + len <= end)
+        return int(i);
+    }
+    return -1;
+  }
+
+  struct io_uring_sqe* get_sqe() {
+    // bound in-flight io by cq size to avoid completion ring overflow
+    while (sq_tail - as_atomic(*sq_khead).load(std::memory_order_acquire) >= sq_entries
+        || io_reqnum + sq_pending >= cq_entries) {
+      yield();
+    }
+    unsigned idx = sq_tail & sq_mask;
+    sq_array[idx] = idx;
+    sq_tail++;
+    sq_pending++;
+    struct io_uring_sqe* sqe = &sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+  }
+
+public:
+  void yield() { m_fy.unchecked_yield(); }
+
+  size_t batch_io(int fd, fiber_aio_req* reqs, size_t num, bool is_write) {
+    refresh_fixed_buffers();
+    size_t nerr = 0;
+    for (size_t i = 0; i < num; ) {
+      size_t n = std::min<size_t>(num - i, max_batch);
+      io_waiter waiter = {nullptr, n};
+      io_return io_ret[max_batch];
+      for (size_t j = 0; j < n; j++) {
+        fiber_aio_req& r = reqs[i + j];
+        io_ret[j] = {&waiter, 0, -1, false};
+        struct io_uring_sqe* sqe = get_sqe();
+        int buf_index = find_fixed(r.buf, r.len);
+        if (buf_index >= 0) {
+          sqe->opcode = is_write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+          sqe->buf_index = (uint16_t)buf_index;
+        } else {
+          sqe->opcode = is_write ? IORING_OP_WRITE : IORING_OP_READ;
+        }
+        sqe->fd = fd;
+        sqe->addr = (uintptr_t)r.buf;
+        sqe->len = (uint32_t)r.len;
+        sqe->off = r.offset;
+        sqe->user_data = (uintptr_t)&io_ret[j];
+      }
+      m_fy.unchecked_wait(&waiter.fctx);
+      for (size_t j = 0; j < n; j++) {
+        fiber_aio_req& r = reqs[i + j];
+        assert(io_ret[j].done);
+        r.ret = io_ret[j].len;
+        r.err = io_ret[j].err;
+        if (io_ret[j].err)
+          nerr++;
+      }
+      i += n;
+    }
+    return nerr;
+  }
+
+  intptr_t exec_io(int fd, void* buf, size_t len, off_t offset, bool is_write) {
+    fiber_aio_req req = {buf, len, offset, -1, 0};
+    if (batch_io(fd, &req, 1, is_write)) {
+      errno = req.err;
+    }
+    return req.ret;
+  }
+
+  io_uring_fiber_context(boost::fibers::context** pp)
+    : m_fy(pp)
+    , io_fiber(std::bind(&io_uring_fiber_context::fiber_proc, this))
+  {
+    ft_num = g_ft_num++;
+    aio_debug("ft_num = %zd", ft_num);
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    ring_fd = uring_setup(ring_entries, &p);
+    if (ring_fd < 0) {
+      TERARK_DIE("io_uring_setup(%u) = %s", ring_entries, strerror(errno));
+    }
+    sq_ring_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cq_ring_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+      sq_ring_len = cq_ring_len = std::max(sq_ring_len, cq_ring_len);
+    }
+    sq_ring_ptr = mmap(NULL, sq_ring_len, PROT_READ|PROT_WRITE,
+                       MAP_SHARED|MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    if (MAP_FAILED == sq_ring_ptr) {
+      TERARK_DIE("mmap(IORING_OFF_SQ_RING) = %s", strerror(errno));
+    }
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+      cq_ring_ptr = sq_ring_ptr;
+    } else {
+      cq_ring_ptr = mmap(NULL, cq_ring_len, PROT_READ|PROT_WRITE,
+                         MAP_SHARED|MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+      if (MAP_FAILED == cq_ring_ptr) {
+        TERARK_DIE("mmap(IORING_OFF_CQ_RING) = %s", strerror(errno));
+      }
+    }
+    sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    sqes_ptr = mmap(NULL, sqes_len, PROT_READ|PROT_WRITE,
+                    MAP_SHARED|MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    if (MAP_FAILED == sqes_ptr) {
+      TERARK_DIE("mmap(IORING_OFF_SQES) = %s", strerror(errno));
+    }
+    auto sq_base = (byte_t*)sq_ring_ptr;
+    auto cq_base = (byte_t*)cq_ring_ptr;
+    sq_entries = p.sq_entries;
+    sq_mask  = *(unsigned*)(sq_base + p.sq_off.ring_mask);
+    sq_khead =  (unsigned*)(sq_base + p.sq_off.head);
+    sq_ktail =  (unsigned*)(sq_base + p.sq_off.tail);
+    sq_array =  (unsigned*)(sq_base + p.sq_off.array);
+    sq_tail  = *sq_ktail;
+    sqes = (struct io_uring_sqe*)sqes_ptr;
+    cq_entries = p.cq_entries;
+    cq_mask  = *(unsigned*)(cq_base + p.cq_off.ring_mask);
+    cq_khead =  (unsigned*)(cq_base + p.cq_off.head);
+    cq_ktail =  (unsigned*)(cq_base + p.cq_off.tail);
+    cqes = (struct io_uring_cqe*)(cq_base + p.cq_off.cqes);
+    m_state = state::ready;
+    counter = 0;
+  }
+
+  ~io_uring_fiber_context() {
+    aio_debug("ft_num = %zd, counter = %llu ...", ft_num, counter);
+    m_state = state::stopping;
+    while (state::stopping == m_state) {
+      yield();
+    }
+    TERARK_VERIFY(state::stopped == m_state);
+    io_fiber.join();
+    TERARK_VERIFY(0 == io_reqnum);
+    TERARK_VERIFY(0 == sq_pending);
+    munmap(sqes_ptr, sqes_len);
+    if (cq_ring_ptr != sq_ring_ptr)
+      munmap(cq_ring_ptr, cq_ring_len);
+    munmap(sq_ring_ptr, sq_ring_len);
+    ::close(ring_fd); // also unregisters fixed buffers
+  }
+};
+
+static io_uring_fiber_context& tls_io_uring_fiber() {
+  using boost::fibers::context;
+  static thread_local io_uring_fiber_context io_fiber(context::active_pp());
+  return io_fiber;
+}
+
+#endif // TERARK_FIBER_AIO_HAS_URING
+
+static int probe_aio_method() {
+  int method = (int)getEnvLong("aio_method", 1);
+  if (2 == method) {
+#if defined(TERARK_FIBER_AIO_HAS_URING)
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    int fd = uring_setup(1, &p);
+    if (fd >= 0) {
+      ::close(fd);
+      return 2;
+    }
+    fprintf(stderr, "WARN: aio_method = 2: io_uring_setup = %s, fallback to linux aio\n", strerror(errno));
+#else
+    fprintf(stderr, "WARN: aio_method = 2: io_uring is not supported by this build, fallback to linux aio\n");
+#endif
+    return 1;
+  }
+  return method;
+}
+
 // dt_ means 'dedicated thread'
 struct DT_ResetOnExitPtr {
   std::atomic<io_queue_t*> ptr;
@@ -289,6 +721,11 @@ intptr_t fiber_aio_read(int fd, void* buf, size_t len, off_t offset) {
   if (1 == g_aio_method) {
     return tls_io_fiber().exec_io(fd, buf, len, offset, IO_CMD_PREAD);
   }
+  #if defined(TERARK_FIBER_AIO_HAS_URING)
+  if (2 == g_aio_method) {
+    return tls_io_uring_fiber().exec_io(fd, buf, len, offset, false);
+  }
+  #endif
 #endif
 #if BOOST_OS_WINDOWS
   TERARK_DIE("Not Supported for Windows");
@@ -314,6 +751,96 @@ intptr_t fiber_aio_read(int fd, void* buf, size_t len, off_t offset) {
 #endif
 }
 
+TERARK_DLL_EXPORT
+size_t fiber_aio_batch_read(int fd, fiber_aio_req* reqs, size_t num) {
+#if BOOST_OS_LINUX
+  if (1 == g_aio_method) {
+    return tls_io_fiber().batch_io(fd, reqs, num, IO_CMD_PREAD);
+  }
+  #if defined(TERARK_FIBER_AIO_HAS_URING)
+  if (2 == g_aio_method) {
+    return tls_io_uring_fiber().batch_io(fd, reqs, num, false);
+  }
+  #endif
+#endif
+  size_t nerr = 0;
+  for (size_t i = 0; i < num; i++) {
+    fiber_aio_req& r = reqs[i];
+    r.ret = fiber_aio_read(fd, r.buf, r.len, r.offset);
+    r.err = r.ret < 0 ? errno : 0;
+    if (r.ret < 0)
+      nerr++;
+  }
+  return nerr;
+}
+
+TERARK_DLL_EXPORT
+bool fiber_aio_register_buffer(const void* buf, size_t len) {
+#if defined(TERARK_FIBER_AIO_HAS_URING)
+  if (2 == g_aio_method) {
+    // kernel limits a fixed buffer to 1G, split large buffer
+    const size_t max_len = size_t(1) << 30;
+    const size_t max_bufs = 1024; // UIO_MAXIOV, limit of old kernels
+    // pinned pages are charged to RLIMIT_MEMLOCK
+    size_t max_bytes = (size_t)getEnvLong("fiber_aio_maxFixedBytes", LONG_MAX);
+    struct rlimit rl;
+    if (0 == getrlimit(RLIMIT_MEMLOCK, &rl) && RLIM_INFINITY != rl.rlim_cur) {
+      max_bytes = std::min<size_t>(max_bytes, rl.rlim_cur);
+    }
+    std::lock_guard<std::mutex> lock(g_uring_bufs.mtx);
+    size_t nbufs = (len + max_len - 1) / max_len;
+    if (g_uring_bufs.bytes + len > max_bytes || g_uring_bufs.bufs.size() + nbufs > max_bufs) {
+      fprintf(stderr, "WARN: fiber_aio_register_buffer(len=%zd): registered bytes = %zd, limit = %zd, bufs = %zd, use non-fixed buffer\n",
+              len, g_uring_bufs.bytes, max_bytes, g_uring_bufs.bufs.size());
+      return false;
+    }
+    g_uring_bufs.bytes += len;
+    for (size_t pos = 0; pos < len; pos += max_len) {
+      struct iovec iov;
+      iov.iov_base = (byte_t*)buf + pos;
+      iov.iov_len = std::min(len - pos, max_len);
+      g_uring_bufs.bufs.push_back(iov);
+    }
+    g_uring_bufs.version++;
+    return true;
+  }
+#endif
+  (void)buf; (void)len;
+  return false;
+}
+
+TERARK_DLL_EXPORT
+void fiber_aio_unregister_buffer(const void* buf, size_t len) {
+#if defined(TERARK_FIBER_AIO_HAS_URING)
+  if (2 == g_aio_method) {
+    auto beg = (const byte_t*)buf;
+    auto end = beg + len;
+    std::lock_guard<std::mutex> lock(g_uring_bufs.mtx);
+    auto& bufs = g_uring_bufs.bufs;
+    size_t j = 0;
+    for (size_t i = 0; i < bufs.size(); i++) {
+      auto p = (const byte_t*)bufs[i].iov_base;
+      if (p < beg || p >= end)
+        bufs[j++] = bufs[i];
+      else
+        g_uring_bufs.bytes -= bufs[i].iov_len;
+    }
+    bufs.risk_set_size(j);
+    g_uring_bufs.version++;
+  }
+#endif
+  (void)buf; (void)len;
+}
+
+TERARK_DLL_EXPORT
+int fiber_aio_method() {
+#if BOOST_OS_LINUX
+  return g_aio_method;
+#else
+  return 0;
+#endif
+}
+
 static const size_t MY_AIO_PAGE_SIZE = 4096;
 
 TERARK_DLL_EXPORT
@@ -353,6 +880,11 @@ intptr_t fiber_aio_write(int fd, const void* buf, size_t len, off_t offset) {
   if (1 == g_aio_method) {
     return tls_io_fiber().exec_io(fd, (void*)buf, len, offset, IO_CMD_PWRITE);
   }
+  #if defined(TERARK_FIBER_AIO_HAS_URING)
+  if (2 == g_aio_method) {
+    return tls_io_uring_fiber().exec_io(fd, (void*)buf, len, offset, true);
+  }
+  #endif
 #endif
 #if BOOST_OS_WINDOWS
   TERARK_DIE("Not Supported for Windows");
@@ -381,7 +913,8 @@ intptr_t fiber_aio_write(int fd, const void* buf, size_t len, off_t offset) {
 TERARK_DLL_EXPORT
 intptr_t fiber_put_write(int fd, const void* buf, size_t len, off_t offset) {
 #if BOOST_OS_LINUX
-  if (1 == g_aio_method) {
+  // dedicated thread always uses linux aio, even if aio_method is io_uring
+  if (1 == g_aio_method || 2 == g_aio_method) {
     return tls_io_fiber().dt_exec_io(fd, (void*)buf, len, offset, IO_CMD_PWRITE);
   }
   TERARK_DIE("Not Supported aio_method = %d", g_aio_method);
@@ -16,6 +16,37 @@ intptr_t fiber_aio_read(int fd, void* buf, size_t len, off_t offset);
 TERARK_DLL_EXPORT
 void fiber_aio_need(const void* buf, size_t len);
 
+struct fiber_aio_req {
+  void*    buf;
+  size_t   len;
+  off_t    offset;
+  intptr_t ret; // output: bytes read, or -1 on error
+  int      err; // output: errno when ret is -1
+};
+
+/// submit all reads in one batch and wait for all of them to complete,
+/// with io_uring(aio_method=2) or linux aio(aio_method=1) the whole batch
+/// costs one submit syscall.
+///@returns number of failed reqs
+TERARK_DLL_EXPORT
+size_t fiber_aio_batch_read(int fd, fiber_aio_req* reqs, size_t num);
+
+/// register [buf, buf+len) as io_uring fixed buffer, reads into it will use
+/// IORING_OP_READ_FIXED, this saves page pinning on each io.
+/// buf must be unregistered before it is freed.
+/// Total registered bytes are limited by RLIMIT_MEMLOCK and env
+/// fiber_aio_maxFixedBytes, a refused buffer is read by non-fixed io.
+///@returns false if current aio_method is not io_uring or over the limit
+TERARK_DLL_EXPORT
+bool fiber_aio_register_buffer(const void* buf, size_t len);
+
+TERARK_DLL_EXPORT
+void fiber_aio_unregister_buffer(const void* buf, size_t len);
+
+///@returns effective aio_method: 0 posix aio, 1 linux aio, 2 io_uring
+TERARK_DLL_EXPORT
+int fiber_aio_method();
+
 TERARK_DLL_EXPORT
 intptr_t fiber_aio_write(int fd, const void* buf, size_t len, off_t offset);
 
@@ -1,7 +1,13 @@
 #pragma once
 #include <terark/config.hpp>
 #include <boost/noncopyable.hpp>
+#include <atomic>
+#include <stdint.h>
 #include <mutex>
+#include <thread>
+#if defined(__SSE2__) || defined(_M_X64)
+  #include <emmintrin.h>
+#endif
 #if defined(TERARK_WITH_TBB)
   #include <tbb/spin_mutex.h>
 #endif
@@ -24,4 +30,47 @@ namespace terark {
     typedef std::mutex spin_mutex;
 #endif
 
+/// reader-writer spin lock in one word, for very short critical sections.
+/// a waiting writer blocks new readers, after some spins waiters yield cpu
+class spin_rw_mutex : boost::noncopyable {
+    static const uint32_t WRITER = 1, PENDING = 2, READER = 4;
+    std::atomic<uint32_t> m_state;
+    static void pause(unsigned& spins) {
+        if (++spins < 64) {
+#if defined(__SSE2__) || defined(_M_X64)
+            _mm_pause();
+#endif
+        } else {
+            std::this_thread::yield();
+        }
+    }
+public:
+    spin_rw_mutex() : m_state(0) {}
+    void lock() {
+        for (unsigned spins = 0;;) {
+            uint32_t s = m_state.load(std::memory_order_relaxed);
+            if ((s & ~PENDING) == 0) {
+                if (m_state.compare_exchange_weak(s, WRITER, std::memory_order_acquire))
+                    return;
+            }
+            else if (!(s & PENDING)) {
+                m_state.fetch_or(PENDING, std::memory_order_relaxed);
+            }
+            pause(spins);
+        }
+    }
+    void unlock() { m_state.fetch_and(~WRITER, std::memory_order_release); }
+    void lock_shared() {
+        for (unsigned spins = 0;;) {
+            uint32_t s = m_state.load(std::memory_order_relaxed);
+            if (!(s & (WRITER|PENDING))) {
+                if (m_state.compare_exchange_weak(s, s + READER, std::memory_order_acquire))
+                    return;
+            }
+            pause(spins);
+        }
+    }
+    void unlock_shared() { m_state.fetch_sub(READER, std::memory_order_release); }
+};
+
 } // namespace terark
@@ -8,6 +8,7 @@
 #endif
 #include "pipeline.hpp"
 #include <terark/circular_queue.hpp>
+#include <terark/fstring.hpp>
 #include <terark/num_to_str.hpp>
 //#include <terark/util/compare.hpp>
 #include <terark/valvec.hpp>
@@ -15,6 +16,7 @@
 //#include <boost/circular_buffer.hpp>
 #include <terark/util/atomic.hpp>
 #include <terark/util/concurrent_queue.hpp>
+#include <terark/util/mpmc_ring_queue.hpp>
 #include <stdio.h>
 #include <iostream>
 
@@ -62,9 +64,17 @@ public:
     virtual void push_back(const PipelineQueueItem& x, FiberYield*) = 0;
     virtual bool push_back(const PipelineQueueItem&, int timeout, FiberYield*) = 0;
     virtual bool pop_front(PipelineQueueItem& x, int timeout, FiberYield*) = 0;
+    /// push a prefix of x[0,n) before timeout, returns its length
+    virtual size_t push_back_n(const PipelineQueueItem* x, size_t n, int timeout, FiberYield* fy) {
+        size_t i = 0;
+        while (i < n && push_back(x[i], timeout, fy))
+            i++;
+        return i;
+    }
     virtual bool empty() = 0;
     virtual size_t size() = 0;
     virtual size_t peekSize() const = 0;
+    virtual size_t peekBytes() const { return 0; }
 };
 
 class BlockQueue : public PipelineStage::queue_t {
@@ -77,9 +87,13 @@ public:
 	    q.push_back(x);
 	}
     bool push_back(const PipelineQueueItem& x, int timeout, FiberYield*) final {
+	    if (0 == timeout && q.peekFull())
+	        return false; // avoid a timed wait syscall
 	    return q.push_back(x, timeout);
 	}
     bool pop_front(PipelineQueueItem& x, int timeout, FiberYield*) final {
+	    if (0 == timeout && q.peekEmpty())
+	        return false; // avoid a timed wait syscall
         return q.pop_front(x, timeout);
     }
     bool empty() final {return q.empty(); }
@@ -87,6 +101,35 @@ public:
     size_t peekSize() const final { return q.peekSize(); }
 };
 
+// does not block on a mutex when neither producers nor consumers wait
+class LockFreeQueue : public PipelineStage::queue_t {
+    util::mpmc_ring_queue<PipelineQueueItem> q;
+public:
+    LockFreeQueue(size_t size) : q(size) {}
+	void push_back(const PipelineQueueItem& x, FiberYield*) final {
+	    q.push_back(x);
+	}
+    bool push_back(const PipelineQueueItem& x, int timeout, FiberYield*) final {
+	    return q.push_back(x, timeout);
+	}
+    size_t push_back_n(const PipelineQueueItem* x, size_t n, int timeout, FiberYield*) final {
+        size_t i = 0;
+        while (i < n) {
+            size_t k = q.push_back_n(x + i, n - i, timeout);
+            if (0 == k)
+                break;
+            i += k;
+        }
+        return i;
+    }
+    bool pop_front(PipelineQueueItem& x, int timeout, FiberYield*) final {
+        return q.pop_front(x, timeout);
+    }
+    bool empty() final {return q.empty(); }
+    size_t size() final { return q.size(); }
+    size_t peekSize() const final { return q.size(); }
+};
+
 class FiberQueue : public PipelineStage::queue_t {
     circular_queue<PipelineQueueItem> q;
 public:
@@ -156,15 +199,59 @@ public:
 
 static
 PipelineStage::queue_t*
-NewQueue(PipelineProcessor::EUType euType, size_t size) {
+NewQueue(PipelineProcessor::EUType euType, bool lockFree, size_t size) {
 	switch (euType) {
 	default: abort();
 	case PipelineProcessor::EUType::fiber : return new FiberQueue(size);
-	case PipelineProcessor::EUType::thread: return new BlockQueue(size);
+	case PipelineProcessor::EUType::thread:
+		if (lockFree)
+			return new LockFreeQueue(size);
+		else
+			return new BlockQueue(size);
 	case PipelineProcessor::EUType::mixed : return new MixedQueue(size);
 	}
 }
 
+// counts plbytes of the items in the queue, used when there is a budget
+class BytesQueue : public PipelineStage::queue_t {
+    PipelineStage::queue_t* q;
+    std::atomic<size_t> bytes;
+public:
+    explicit BytesQueue(PipelineStage::queue_t* q) : q(q), bytes(0) {}
+    ~BytesQueue() { delete q; }
+	void push_back(const PipelineQueueItem& x, FiberYield* fy) final {
+	    bytes += x.plbytes; // before push, a pop never makes it negative
+	    q->push_back(x, fy);
+	}
+    bool push_back(const PipelineQueueItem& x, int timeout, FiberYield* fy) final {
+        bytes += x.plbytes;
+        if (q->push_back(x, timeout, fy))
+            return true;
+        bytes -= x.plbytes;
+        return false;
+    }
+    size_t push_back_n(const PipelineQueueItem* x, size_t n, int timeout, FiberYield* fy) final {
+        size_t sum = 0;
+        for (size_t i = 0; i < n; ++i)
+            sum += x[i].plbytes;
+        bytes += sum;
+        size_t k = q->push_back_n(x, n, timeout, fy);
+        for (size_t i = k; i < n; ++i)
+            bytes -= x[i].plbytes;
+        return k;
+    }
+    bool pop_front(PipelineQueueItem& x, int timeout, FiberYield* fy) final {
+        if (!q->pop_front(x, timeout, fy))
+            return false;
+        bytes -= x.plbytes;
+        return true;
+    }
+    bool empty() final { return q->empty(); }
+    size_t size() final { return q->size(); }
+    size_t peekSize() const final { return q->peekSize(); }
+    size_t peekBytes() const final { return bytes.load(std::memory_order_relaxed); }
+};
+
 class PipelineStage::ExecUnit {
 public:
     virtual ~ExecUnit() {}
@@ -222,6 +309,134 @@ PipelineStage::ExecUnit* NewExecUnit(bool fiberMode, Function&& func) {
         return new ThreadExecUnit(std::move(func));
 }
 
+// bytes of the tasks between enqueue and leaving the last stage
+class PipelineProcessor::ByteBudget {
+	PipelineProcessor* m_owner;
+	size_t m_limit;
+	size_t m_inflight;
+	size_t m_waiters;
+	mutable std::mutex m_mtx;
+	std::condition_variable m_cond;
+
+	bool admit(size_t n) const { return 0 == m_inflight || m_inflight + n <= m_limit; }
+public:
+	ByteBudget(PipelineProcessor* owner, size_t limit)
+	  : m_owner(owner), m_limit(limit), m_inflight(0), m_waiters(0) {}
+	size_t limit() const { return m_limit; }
+	size_t inflight() const {
+		std::lock_guard<std::mutex> lock(m_mtx);
+		return m_inflight;
+	}
+	bool try_acquire(size_t n) {
+		std::lock_guard<std::mutex> lock(m_mtx);
+		if (!admit(n))
+			return false;
+		m_inflight += n;
+		return true;
+	}
+	// a stopped pipeline may have lost items by exceptions, do not wait
+	// for them to be released
+	void acquire(size_t n, FiberYield* fy) {
+		if (fy) { // fiber mode, blocking the thread would block consumers
+			while (!try_acquire(n)) {
+				if (!m_owner->isRunning()) {
+					std::lock_guard<std::mutex> lock(m_mtx);
+					m_inflight += n;
+					return;
+				}
+				fy->yield();
+			}
+			return;
+		}
+		std::unique_lock<std::mutex> lock(m_mtx);
+		while (!admit(n) && m_owner->isRunning()) {
+			m_waiters++;
+			m_cond.wait_for(lock, std::chrono::milliseconds(m_owner->m_queue_timeout));
+			m_waiters--;
+		}
+		m_inflight += n;
+	}
+	void release(size_t n) {
+		std::lock_guard<std::mutex> lock(m_mtx);
+		assert(m_inflight >= n);
+		m_inflight -= n;
+		if (m_waiters)
+			m_cond.notify_all();
+	}
+};
+
+// consecutive parallel stages form a segment, an item popped from the input
+// queue of a segment is run through all its stages by one worker
+class PipelineProcessor::SharedPool {
+	struct Segment {
+		PipelineStage* first;
+		PipelineStage* last;
+	};
+	class EventQueue;
+	PipelineProcessor* m_owner;
+	valvec<Segment> m_segs;
+	std::vector<thread> m_workers;
+	// event count: a waiting worker sleeps until an input queue is pushed
+	// or an output queue is popped
+	std::atomic<size_t> m_epoch;
+	std::atomic<size_t> m_idle;
+	std::mutex m_mtx;
+	std::condition_variable m_cond;
+
+	void notify();
+	void wait(size_t epoch);
+	bool run_one(size_t k, int w);
+	void run_item(size_t k, int w, PipelineQueueItem& item);
+	void run(int w);
+public:
+	explicit SharedPool(PipelineProcessor* owner);
+	~SharedPool() { join(); }
+	bool has(const PipelineStage*) const;
+	void start();
+	void join();
+};
+
+// input queue of a segment wakes waiting workers on push, output queue of a
+// segment wakes them on pop
+class PipelineProcessor::SharedPool::EventQueue : public PipelineStage::queue_t {
+    PipelineStage::queue_t* q;
+    SharedPool* pool;
+    bool is_input;
+public:
+    EventQueue(PipelineStage::queue_t* q, SharedPool* pool, bool is_input)
+      : q(q), pool(pool), is_input(is_input) {}
+    ~EventQueue() { delete q; }
+	void push_back(const PipelineQueueItem& x, FiberYield* fy) final {
+	    q->push_back(x, fy);
+	    if (is_input)
+	        pool->notify();
+	}
+    bool push_back(const PipelineQueueItem& x, int timeout, FiberYield* fy) final {
+	    if (!q->push_back(x, timeout, fy))
+	        return false;
+	    if (is_input)
+	        pool->notify();
+	    return true;
+	}
+    size_t push_back_n(const PipelineQueueItem* x, size_t n, int timeout, FiberYield* fy) final {
+        size_t k = q->push_back_n(x, n, timeout, fy);
+        if (k && is_input)
+            pool->notify();
+        return k;
+    }
+    bool pop_front(PipelineQueueItem& x, int timeout, FiberYield* fy) final {
+        if (!q->pop_front(x, timeout, fy))
+            return false;
+        if (!is_input)
+            pool->notify();
+        return true;
+    }
+    bool empty() final { return q->empty(); }
+    size_t size() final { return q->size(); }
+    size_t peekSize() const final { return q->peekSize(); }
+    size_t peekBytes() const final { return q->peekBytes(); }
+};
+
 PipelineStage::ThreadData::ThreadData() {
 	m_thread = NULL;
     m_live_fibers = 0;
@@ -273,7 +488,8 @@ PipelineStage::~PipelineStage()
 	delete m_out_queue;
 	for (size_t threadno = 0; threadno != m_threads.size(); ++threadno)
 	{
-		assert(!m_threads[threadno].m_thread->joinable());
+		assert(!m_threads[threadno].m_thread || // run by shared pool
+			   !m_threads[threadno].m_thread->joinable());
 	}
 }
 
@@ -287,10 +503,20 @@ size_t PipelineStage::getOutputQueueSize() const {
 	return this->m_out_queue->size();
 }
 
+size_t PipelineStage::getInputQueueBytes() const {
+	assert(m_prev->m_out_queue);
+	return m_prev->m_out_queue->peekBytes();
+}
+
+size_t PipelineStage::getOutputQueueBytes() const {
+	assert(this->m_out_queue);
+	return this->m_out_queue->peekBytes();
+}
+
 void PipelineStage::createOutputQueue(size_t size) {
 	if (size > 0) {
 		assert(NULL == this->m_out_queue);
-		this->m_out_queue = NewQueue(m_owner->m_EUType, size);
+		this->m_out_queue = m_owner->newQueue(size);
 	}
 }
 
@@ -329,7 +555,8 @@ inline bool PipelineStage::isPrevRunning()
 void PipelineStage::wait()
 {
 	for (size_t t = 0; t != m_threads.size(); ++t)
-		m_threads[t].m_thread->join();
+		if (m_threads[t].m_thread) // NULL if run by shared pool
+			m_threads[t].m_thread->join();
 }
 
 void PipelineStage::start(int queue_size)
@@ -340,7 +567,7 @@ void PipelineStage::start(int queue_size)
 
 	if (this != m_owner->m_head->m_prev) { // is not last step
 		if (NULL == m_out_queue)
-			m_out_queue = NewQueue(euType, queue_size);
+			m_out_queue = m_owner->newQueue(queue_size);
 	}
 	if (m_step_name.empty()) {
 		m_step_name.reserve(15);
@@ -350,6 +577,13 @@ void PipelineStage::start(int queue_size)
 	if (m_threads.size() == 0) {
 		throw std::runtime_error("thread count = 0");
 	}
+	if (m_owner->m_pool && m_owner->m_pool->has(this)) {
+		// set before workers start, the next step must not see it idle
+		m_threads.clear(); // ThreadData is not relocatable, do not realloc
+		m_threads.resize(m_owner->m_poolThreads);
+		m_running_exec_units = m_owner->m_poolThreads;
+		return;
+	}
 	m_running_exec_units = 0;
 
 	for (size_t threadno = 0; threadno != m_threads.size(); ++threadno)
@@ -482,6 +716,7 @@ void PipelineStage::run_wrapper(int threadno)
 				{
 					if (item.task)
 						m_owner->destroyTask(item.task);
+					m_owner->releaseBytes(item);
 				}
 			}
 		}
@@ -537,6 +772,8 @@ void PipelineStage::run_step_first(int threadno)
  			//	queue_t::MutexLockSentry lock(*m_out_queue); // not need lock
 				item.plserial = ++m_plserial;
 			}
+			item.plbytes = item.task->plbytes;
+			m_owner->acquireBytes(item.plbytes, fy);
 			if (m_owner->m_logLevel >= 3) {
                 while (!m_out_queue->push_back(item, m_owner->m_queue_timeout, fy)) {
                     fprintf(stderr, "Pipeline: first_step(%s): tno=%d, wait push timeout, retry ...\n", m_step_name.c_str(), threadno);
@@ -563,6 +800,7 @@ void PipelineStage::run_step_last(int threadno)
 				process(threadno, &item);
 			if (item.task)
 				m_owner->destroyTask(item.task);
+			m_owner->releaseBytes(item);
 		}
 		else {
 		    if (m_owner->m_logLevel >= 3) {
@@ -597,6 +835,8 @@ void PipelineStage::run_step_mid(int threadno)
 				process(threadno, &item);
 			if (item.task || m_owner->m_keepSerial)
 				m_out_queue->push_back(item, fy);
+			else
+				m_owner->releaseBytes(item);
 		}
 		else {
 		    if (m_owner->m_logLevel >= 3) {
@@ -644,53 +884,6 @@ using namespace pipeline_detail;
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 #endif
 
-void PipelineStage::run_serial_step_slow(int threadno,
-								   void (PipelineStage::*fdo)(PipelineQueueItem&)
-								  )
-{
-	assert(ple_keep == m_pl_enum);
-	assert(m_threads.size() == 1);
-	assert(0 == threadno);
-	using namespace std;
-	WaitPtr(m_threads[threadno].m_thread);
-	FiberYield* fy = m_threads[threadno].m_thread->get_fiber_yield();
-	valvec<PipelineQueueItem> cache;
-	m_plserial = 1;
-	while (isPrevRunning()) {
-		PipelineQueueItem item;
-		if (!m_prev->m_out_queue->pop_front(item, m_owner->m_queue_timeout, fy))
-        {
-		    if (m_owner->m_logLevel >= 3) {
-		        fprintf(stderr, "Pipeline: serial_step_slow(%s): tno=%d, wait pop timeout, retry ...\n", m_step_name.c_str(), threadno);
-		    }
-			continue;
-		}
-		CHECK_SERIAL()
-		if (item.plserial == m_plserial)
-		{Loop:
-			if (item.task)
-				process(threadno, &item);
-			(this->*fdo)(item);
-			++m_plserial;
-			if (!cache.empty() && (item = cache[0]).plserial == m_plserial) {
-				pop_heap(cache.begin(), cache.end(), plserial_greater());
-				cache.pop_back();
-				goto Loop;
-			}
-		}
-		else { // plserial out of order
-			cache.push_back(item);
-			push_heap(cache.begin(), cache.end(), plserial_greater());
-		}
-	}
-	std::sort(cache.begin(), cache.end(), plserial_less());
-	for (valvec<PipelineQueueItem>::iterator i = cache.begin(); i != cache.end(); ++i) {
-		if (i->task)
-			process(threadno, &*i);
-		(this->*fdo)(*i);
-	}
-}
-
 // use a local 'cache' to cache the received tasks, if tasks are out of order,
 // hold them in the cache, until next received task is just the expected task.
 // if the next received task's serial number is out of the cache's range,
@@ -749,6 +942,7 @@ void PipelineStage::run_serial_step_fast(int threadno)
 			if (terark_likely(is_last)) {
                 if (terark_likely(NULL != item.task))
                     m_owner->destroyTask(item.task);
+                m_owner->releaseBytes(item);
 			}
 			else {
             	m_out_queue->push_back(item, fy);
@@ -778,6 +972,7 @@ void PipelineStage::run_serial_step_fast(int threadno)
         if (terark_likely(is_last)) {
             if (terark_likely(NULL != i->task))
                 m_owner->destroyTask(i->task);
+            m_owner->releaseBytes(*i);
         }
         else {
             m_out_queue->push_back(*i, fy);
@@ -814,6 +1009,177 @@ void FunPipelineStage::process(int threadno, PipelineQueueItem* task)
 
 //////////////////////////////////////////////////////////////////////////
 
+PipelineProcessor::SharedPool::SharedPool(PipelineProcessor* owner)
+  : m_owner(owner)
+{
+	PipelineStage* head = owner->m_head;
+	for (PipelineStage* s = head->m_next; s != head; s = s->m_next) {
+		// first step without input queue is run by run_step_first
+		if (PipelineStage::ple_none != s->m_pl_enum ||
+				(s == head->m_next && NULL == head->m_out_queue))
+			continue;
+		if (!m_segs.empty() && m_segs.back().last == s->m_prev)
+			m_segs.back().last = s;
+		else
+			m_segs.push_back({s, s});
+	}
+	// called before any stage starts, no thread is using the queues
+	auto wrap = [&](PipelineStage* s, bool is_input) {
+		if (NULL == s->m_out_queue)
+			s->m_out_queue = owner->newQueue(owner->m_queue_size);
+		s->m_out_queue = new EventQueue(s->m_out_queue, this, is_input);
+	};
+	for (const Segment& seg : m_segs) {
+		wrap(seg.first->m_prev, true);
+		if (seg.last != head->m_prev)
+			wrap(seg.last, false);
+	}
+	m_epoch = 0;
+	m_idle = 0;
+}
+
+void PipelineProcessor::SharedPool::notify() {
+	m_epoch.fetch_add(1);
+	if (m_idle.load()) {
+		std::lock_guard<std::mutex> lock(m_mtx);
+		m_cond.notify_all();
+	}
+}
+
+// a notify() after reading epoch either changes m_epoch before we check it
+// or sees m_idle, timeout is for checking whether inputs are finished
+void PipelineProcessor::SharedPool::wait(size_t epoch) {
+	m_idle++;
+	std::unique_lock<std::mutex> lock(m_mtx);
+	if (m_epoch.load() == epoch)
+		m_cond.wait_for(lock, std::chrono::milliseconds(m_owner->m_queue_timeout));
+	m_idle--;
+}
+
+bool PipelineProcessor::SharedPool::has(const PipelineStage* step) const {
+	for (const Segment& seg : m_segs) {
+		for (const PipelineStage* s = seg.first; ; s = s->m_next) {
+			if (s == step)
+				return true;
+			if (s == seg.last)
+				break;
+		}
+	}
+	return false;
+}
+
+void PipelineProcessor::SharedPool::start() {
+	if (m_segs.empty())
+		return;
+	m_workers.reserve(m_owner->m_poolThreads);
+	for (int w = 0; w < m_owner->m_poolThreads; ++w)
+		m_workers.emplace_back(bind(&SharedPool::run, this, w));
+}
+
+void PipelineProcessor::SharedPool::join() {
+	for (thread& t : m_workers) {
+		if (t.joinable())
+			t.join();
+	}
+}
+
+bool PipelineProcessor::SharedPool::run_one(size_t k, int w) {
+	PipelineQueueItem item;
+	auto queue = m_segs[k].first->m_prev->m_out_queue;
+	if (!queue->pop_front(item, 0, NULL))
+		return false;
+	run_item(k, w, item);
+	return true;
+}
+
+void PipelineProcessor::SharedPool::run_item(size_t k, int w, PipelineQueueItem& item) {
+	const Segment& seg = m_segs[k];
+	for (PipelineStage* s = seg.first; ; s = s->m_next) {
+		if (item.task) {
+			try {
+				s->process(w, &item);
+			}
+			catch (const std::exception& exp) {
+				s->onException(w, exp);
+				m_owner->stop();
+				m_owner->destroyTask(item.task);
+				item.task = NULL;
+			}
+		}
+		if (s == seg.last)
+			break;
+	}
+	if (seg.last == m_owner->m_head->m_prev) {
+		if (item.task)
+			m_owner->destroyTask(item.task);
+		m_owner->releaseBytes(item);
+	}
+	else if (item.task || m_owner->m_keepSerial) {
+		// when the queue is full, help downstream segments, the consumer
+		// of the queue may be waiting for them
+		auto queue = seg.last->m_out_queue;
+		for (;;) {
+			const size_t epoch = m_epoch.load();
+			if (queue->push_back(item, 0, NULL))
+				break;
+			bool helped = false;
+			for (size_t j = m_segs.size(); --j > k; ) {
+				if (run_one(j, w)) {
+					helped = true;
+					break;
+				}
+			}
+			if (!helped)
+				wait(epoch);
+		}
+	}
+	else {
+		m_owner->releaseBytes(item);
+	}
+}
+
+void PipelineProcessor::SharedPool::run(int w) {
+	const size_t nseg = m_segs.size();
+	valvec<byte_t> joined(nseg, 1);
+	for (const Segment& seg : m_segs) {
+		for (PipelineStage* s = seg.first; ; s = s->m_next) {
+			try {
+				s->setup(w);
+			}
+			catch (const std::exception& exp) {
+				s->onException(w, exp);
+				m_owner->stop();
+			}
+			if (s == seg.last)
+				break;
+		}
+	}
+	for (size_t live = nseg; live; ) {
+		const size_t epoch = m_epoch.load();
+		bool busy = false;
+		for (size_t k = nseg; k-- > 0; ) { // most downstream first
+			if (!joined[k])
+				continue;
+			if (run_one(k, w)) {
+				busy = true;
+				break;
+			}
+			if (!m_segs[k].first->isPrevRunning()) { // input is finished
+				for (PipelineStage* s = m_segs[k].first; ; s = s->m_next) {
+					s->clean(w);
+					as_atomic(s->m_running_exec_units)--;
+					if (s == m_segs[k].last)
+						break;
+				}
+				joined[k] = 0;
+				live--;
+			}
+		}
+		if (!busy && live)
+			wait(epoch);
+	}
+}
+
 class Null_PipelineStage : public PipelineStage
 {
 public:
@@ -846,9 +1212,14 @@ PipelineProcessor::PipelineProcessor()
 	m_queue_timeout = 20;
 	m_head = new Null_PipelineStage;
 	m_head->m_prev = m_head->m_next = m_head;
+	m_pool = NULL;
+	m_poolThreads = 0;
+	size_t maxInflightBytes = (size_t)getEnvLong("Pipeline_maxInflightBytes", 0);
+	m_budget = maxInflightBytes ? new ByteBudget(this, maxInflightBytes) : NULL;
 	m_mutex = NULL;
 	m_is_mutex_owner = false;
 	m_keepSerial = false;
+	m_lockFreeQueue = getEnvBool("Pipeline_lockFreeQueue", false);
 	m_run = false;
 	m_logLevel = 1;
 	m_EUType = EUType::thread;
@@ -856,6 +1227,8 @@ PipelineProcessor::PipelineProcessor()
 
 PipelineProcessor::~PipelineProcessor()
 {
+	delete m_pool;
+	delete m_budget;
 	clear();
 
 	delete m_head;
@@ -881,6 +1254,48 @@ void PipelineProcessor::setMutex(mutex* pmutex)
 	m_is_mutex_owner = false;
 }
 
+void PipelineProcessor::setSharedPool(int threads) {
+	if (m_run) {
+		throw std::logic_error("can not setSharedPool after PipelineProcessor::start()");
+	}
+	m_poolThreads = threads < 0 ? sysCpuCount() : threads;
+}
+
+void PipelineProcessor::setMaxInflightBytes(size_t bytes) {
+	if (m_run) {
+		throw std::logic_error("can not setMaxInflightBytes after PipelineProcessor::start()");
+	}
+	delete m_budget;
+	m_budget = bytes ? new ByteBudget(this, bytes) : NULL;
+}
+
+size_t PipelineProcessor::getMaxInflightBytes() const {
+	return m_budget ? m_budget->limit() : 0;
+}
+
+size_t PipelineProcessor::getInflightBytes() const {
+	return m_budget ? m_budget->inflight() : 0;
+}
+
+PipelineStage::queue_t* PipelineProcessor::newQueue(size_t size) const {
+	auto q = NewQueue(m_EUType, m_lockFreeQueue, size);
+	return m_budget ? new BytesQueue(q) : q;
+}
+
+void PipelineProcessor::acquireBytes(size_t bytes, FiberYield* fy) {
+	if (m_budget && bytes)
+		m_budget->acquire(bytes, EUType::fiber == m_EUType ? fy : NULL);
+}
+
+bool PipelineProcessor::tryAcquireBytes(size_t bytes) {
+	return !m_budget || !bytes || m_budget->try_acquire(bytes);
+}
+
+void PipelineProcessor::releaseBytes(const PipelineQueueItem& item) {
+	if (m_budget && item.plbytes)
+		m_budget->release(item.plbytes);
+}
+
 const char* PipelineProcessor::euTypeName() const {
 	if (m_EUType > EUType::mixed) {
 		return "invalid";
@@ -899,10 +1314,15 @@ std::string PipelineProcessor::queueInfo()
 	const PipelineStage* p = m_head->m_next;
 	oss << "QueueSize: ";
 	while (p != m_head->m_prev) {
-		oss << "(" << p->m_step_name << "=" << p->m_out_queue->peekSize() << "), ";
+		oss << "(" << p->m_step_name << "=" << p->m_out_queue->peekSize();
+		if (m_budget)
+			oss << "/" << p->m_out_queue->peekBytes() << "B";
+		oss << "), ";
 		p = p->m_next;
 	}
 	oss.resize(oss.size()-2);
+	if (m_budget)
+		oss << ", InflightBytes: " << m_budget->inflight();
 	return std::move(oss);
 }
 
@@ -975,8 +1395,17 @@ void PipelineProcessor::start()
 	if (-1 != plkeep)
 		this->m_keepSerial = true;
 
+	if (m_poolThreads > 0) {
+		if (EUType::thread != m_EUType) {
+			throw std::invalid_argument("shared pool requires EUType::thread");
+		}
+		assert(NULL == m_pool);
+		m_pool = new SharedPool(this);
+	}
 	for (PipelineStage* s = m_head->m_next; s != m_head; s = s->m_next)
 		s->start(m_queue_size);
+	if (m_pool)
+		m_pool->start();
 }
 
 //! this is the recommended usage
@@ -1001,7 +1430,7 @@ void PipelineProcessor::compile(int input_feed_queue_size)
 		}
 	}
 // End check for double start
-	m_head->m_out_queue = NewQueue(m_EUType, input_feed_queue_size);
+	m_head->m_out_queue = newQueue(input_feed_queue_size);
 	start();
 }
 
@@ -1019,6 +1448,8 @@ void PipelineProcessor::enqueue(PipelineTask* task)
 void PipelineProcessor::enqueue_impl(PipelineTask* task) {
     FiberYield fy;
 	PipelineQueueItem item(++m_head->m_plserial, task);
+	item.plbytes = task ? task->plbytes : 0;
+	acquireBytes(item.plbytes, &fy);
     if (m_logLevel >= 3) {
         while (!m_head->m_out_queue->push_back(item, m_queue_timeout, &fy)) {
             fprintf(stderr,
@@ -1044,21 +1475,34 @@ void PipelineProcessor::enqueue_impl(PipelineTask** tasks, size_t num) {
     FiberYield fy;
 	uintptr_t plserial = m_head->m_plserial;
 	auto queue = m_head->m_out_queue;
-    if (m_logLevel >= 3) {
-        for (size_t i = 0; i < num; ++i) {
-            PipelineQueueItem item(++plserial, tasks[i]);
-            while (!queue->push_back(item, m_queue_timeout, &fy)) {
-                fprintf(stderr,
-                        "Pipeline: enqueue(num=%zd): nth=%zd, wait push timeout, serial = %lld, retry ...\n",
-                        num, i, (llong)item.plserial);
-            }
-        }
-    }
-    else {
-        for (size_t i = 0; i < num; ++i) {
-            queue->push_back(PipelineQueueItem(++plserial, tasks[i]), &fy);
-        }
-    }
+	PipelineQueueItem items[64];
+	for (size_t i = 0; i < num; ) {
+		size_t n = std::min(num - i, sizeof(items)/sizeof(items[0]));
+		for (size_t j = 0; j < n; ++j) {
+			PipelineTask* task = tasks[i + j];
+			size_t bytes = task ? task->plbytes : 0;
+			// do not block while holding charged items, push them first
+			if (0 == j)
+				acquireBytes(bytes, &fy);
+			else if (!tryAcquireBytes(bytes)) {
+				n = j;
+				break;
+			}
+			items[j] = PipelineQueueItem(plserial + 1 + j, task);
+			items[j].plbytes = bytes;
+		}
+		// items are pushed in serial order, each push_back_n takes a prefix
+		for (size_t k = 0; k < n; ) {
+			k += queue->push_back_n(items + k, n - k, m_queue_timeout, &fy);
+			if (k < n && m_logLevel >= 3) {
+				fprintf(stderr,
+						"Pipeline: enqueue(num=%zd): nth=%zd, wait push timeout, serial = %lld, retry ...\n",
+						num, i + k, (llong)(plserial + 1 + k));
+			}
+		}
+		plserial += n;
+		i += n;
+	}
 	m_head->m_plserial = plserial;
 }
 
@@ -1069,6 +1513,11 @@ void PipelineProcessor::wait()
 	}
 	for (PipelineStage* s = m_head->m_next; s != m_head; s = s->m_next)
 		s->wait();
+	if (m_pool) {
+		m_pool->join();
+		delete m_pool;
+		m_pool = NULL;
+	}
 }
 
 void PipelineProcessor::add_step(PipelineStage* step)
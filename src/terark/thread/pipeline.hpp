@@ -30,6 +30,8 @@
 
 namespace terark {
 
+class FiberYield;
+
 #if defined(TERARK_CONCURRENT_QUEUE_USE_BOOST)
 	using boost::thread;
 	using boost::mutex;
@@ -43,6 +45,11 @@ namespace terark {
 class TERARK_DLL_EXPORT PipelineTask
 {
 public:
+	/// bytes charged to PipelineProcessor in-flight budget, set it before
+	/// the task enters the pipeline and do not change it in the pipeline
+	size_t plbytes;
+
+	PipelineTask() : plbytes(0) {}
 	virtual ~PipelineTask();
 };
 
@@ -51,15 +58,18 @@ class TERARK_DLL_EXPORT PipelineQueueItem
 public:
 	uintptr_t plserial;
 	PipelineTask* task;
+	size_t plbytes; // charged bytes, released when the item leaves pipeline
 
 	PipelineQueueItem(uintptr_t plserial, PipelineTask* task)
 		: plserial(plserial)
 		, task(task)
+		, plbytes(0)
 	{}
 
 	PipelineQueueItem()
 		: plserial(0)
 		, task(0)
+		, plbytes(0)
 	{}
 };
 
@@ -102,7 +112,6 @@ protected:
 	void run_step_last(int threadno);
 	void run_step_mid(int threadno);
 
-	void run_serial_step_slow(int threadno, void (PipelineStage::*fdo)(PipelineQueueItem&));
 	void run_serial_step_fast(int threadno);
 	void serial_step_do_mid(PipelineQueueItem& item);
 	void serial_step_do_last(PipelineQueueItem& item);
@@ -139,6 +148,8 @@ public:
 	mutex* getMutex() const;
 	size_t getInputQueueSize()  const;
 	size_t getOutputQueueSize() const;
+	size_t getInputQueueBytes()  const; ///< 0 if no in-flight budget
+	size_t getOutputQueueBytes() const; ///< 0 if no in-flight budget
 	void createOutputQueue(size_t size);
 };
 
@@ -169,8 +180,13 @@ public:
 	};
 private:
 	friend class PipelineStage;
+	class SharedPool;
+	class ByteBudget;
 
 	PipelineStage *m_head;
+	SharedPool* m_pool;
+	ByteBudget* m_budget;
+	int m_poolThreads;
 	int m_queue_size;
 	int m_queue_timeout;
 	function<void(PipelineTask*)> m_destroyTask;
@@ -179,6 +195,7 @@ private:
 	volatile size_t m_run; // size_t is CPU word, should be bool
 	bool m_is_mutex_owner;
 	bool m_keepSerial;
+	bool m_lockFreeQueue;
 	signed char m_logLevel;
 	EUType m_EUType;
 
@@ -192,6 +209,11 @@ protected:
 	void enqueue_impl(PipelineTask* task);
 	void enqueue_impl(PipelineTask** tasks, size_t num);
 
+	PipelineStage::queue_t* newQueue(size_t size) const;
+	void acquireBytes(size_t bytes, FiberYield*);
+	bool tryAcquireBytes(size_t bytes);
+	void releaseBytes(const PipelineQueueItem&);
+
 public:
 	static int sysCpuCount();
 
@@ -209,6 +231,31 @@ public:
 
 	const char* euTypeName() const;
 
+	/// use lock-free queues for EUType::thread, must be set before start()
+	/// or compile(), default is env Pipeline_lockFreeQueue
+	void setLockFreeQueue(bool val) { m_lockFreeQueue = val; }
+	bool getLockFreeQueue() const { return m_lockFreeQueue; }
+
+	/// run all parallel stages by one pool of threads instead of the thread
+	/// count of each stage, a worker always takes the most downstream input,
+	/// then runs the item through the consecutive parallel stages.
+	/// threadno passed to process() is in [0, threads), serial and generator
+	/// stages keep their own thread. Only for EUType::thread.
+	/// @param threads 0 disables the pool, < 0 means sysCpuCount()
+	void setSharedPool(int threads);
+	int  getSharedPool() const { return m_poolThreads; }
+
+	/// bound the bytes of tasks in the pipeline by PipelineTask::plbytes
+	/// instead of item count only: enqueue and generator block while the
+	/// budget is exhausted, the bytes are released when the task leaves the
+	/// last stage. A task larger than the budget is admitted when nothing
+	/// else is in flight. Must be set before start() or compile().
+	/// @param bytes 0 disables the budget, default is env
+	///        Pipeline_maxInflightBytes
+	void setMaxInflightBytes(size_t bytes);
+	size_t getMaxInflightBytes() const;
+	size_t getInflightBytes() const;
+
 	void setQueueSize(int queue_size) { m_queue_size = queue_size; }
 	int  getQueueSize() const { return m_queue_size; }
 	void setQueueTimeout(int queue_timeout) { m_queue_timeout = queue_timeout; }
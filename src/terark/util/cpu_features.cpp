@@ -0,0 +1,100 @@
+#include "cpu_features.hpp"
+#include <terark/fstring.hpp>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+  #define TERARK_CPU_X86
+  #if defined(_MSC_VER)
+    #include <intrin.h>
+  #else
+    #include <cpuid.h>
+  #endif
+#endif
+
+namespace terark {
+
+#if defined(TERARK_CPU_X86)
+static void cpuid_count(unsigned leaf, unsigned sub, unsigned r[4]) {
+  #if defined(_MSC_VER)
+    __cpuidex((int*)r, leaf, sub);
+  #else
+    __cpuid_count(leaf, sub, r[0], r[1], r[2], r[3]);
+  #endif
+}
+static unsigned long long get_xcr0() {
+  #if defined(_MSC_VER)
+    return _xgetbv(0);
+  #else
+    unsigned eax, edx;
+    __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (unsigned long long)edx << 32 | eax;
+  #endif
+}
+#endif
+
+static CpuFeatures detect_cpu_features() {
+    CpuFeatures f;
+    memset(&f, 0, sizeof(f));
+#if defined(TERARK_CPU_X86)
+    unsigned r[4]; // eax, ebx, ecx, edx
+    cpuid_count(0, 0, r);
+    const unsigned max_leaf = r[0];
+    cpuid_count(1, 0, r);
+    f.pclmul = (r[2] >> 1 & 1) != 0;
+    f.sse42  = (r[2] >> 20 & 1) != 0;
+    f.popcnt = (r[2] >> 23 & 1) != 0;
+    const bool osxsave = (r[2] >> 27 & 1) != 0;
+    const unsigned long long xcr0 = osxsave ? get_xcr0() : 0;
+    const bool os_ymm = (xcr0 & 0x06) == 0x06;
+    const bool os_zmm = (xcr0 & 0xE6) == 0xE6;
+    if (max_leaf >= 7) {
+        cpuid_count(7, 0, r);
+        f.bmi2 = (r[1] >> 8 & 1) != 0;
+        f.avx2 = os_ymm && (r[1] >> 5 & 1);
+        if (os_zmm) {
+            f.avx512f  = (r[1] >> 16 & 1) != 0;
+            f.avx512bw = (r[1] >> 30 & 1) != 0;
+            f.avx512vl = (r[1] >> 31 & 1) != 0;
+            f.avx512vbmi = (r[2] >> 1 & 1) != 0;
+            f.avx512vpopcntdq = (r[2] >> 14 & 1) != 0;
+        }
+    }
+#endif
+    if (const char* env = getenv("TERARK_CPU_DISABLE")) {
+        fstring str(env);
+        while (!str.empty()) {
+            const char* comma = str.strchr(',');
+            fstring name = comma ? fstring(str.p, comma) : str;
+            str = comma ? fstring(comma + 1, str.end()) : fstring();
+            if (name == "sse42") f.sse42 = false;
+            else if (name == "pclmul") f.pclmul = false;
+            else if (name == "popcnt") f.popcnt = false;
+            else if (name == "bmi2") f.bmi2 = false;
+            else if (name == "avx2") f.avx2 = false;
+            else if (name == "avx512f") f.avx512f = false;
+            else if (name == "avx512bw") f.avx512bw = false;
+            else if (name == "avx512vl") f.avx512vl = false;
+            else if (name == "avx512vbmi") f.avx512vbmi = false;
+            else if (name == "avx512vpopcntdq") f.avx512vpopcntdq = false;
+            else if (name == "avx512") {
+                f.avx512f = f.avx512bw = f.avx512vl = false;
+                f.avx512vbmi = f.avx512vpopcntdq = false;
+            }
+            else if (!name.empty()) {
+                fprintf(stderr, "WARN: TERARK_CPU_DISABLE: unknown feature: %.*s\n",
+                        name.ilen(), name.data());
+            }
+        }
+    }
+    return f;
+}
+
+const CpuFeatures& cpu_features() {
+    static const CpuFeatures f = detect_cpu_features();
+    return f;
+}
+
+CpuFeatures g_cpu_features = cpu_features();
+
+} // namespace terark
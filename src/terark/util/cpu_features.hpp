@@ -0,0 +1,43 @@
+#pragma once
+
+#include <terark/config.hpp>
+
+/// kernels of instruction sets not enabled by -march are compiled with
+/// TERARK_TARGET("isa") and selected by g_cpu_features at runtime
+#if defined(__x86_64__) && \
+	  (defined(__GNUC__) && __GNUC__ * 1000 + __GNUC_MINOR__ >= 4009 || \
+	   defined(__clang__))
+  #define TERARK_TARGET_DISPATCH
+  #define TERARK_TARGET(isa) __attribute__((target(isa)))
+#else
+  #define TERARK_TARGET(isa)
+#endif
+
+namespace terark {
+
+/// x86 features detected by cpuid at runtime, used for dispatching the
+/// kernels which are not compiled with an instruction set by -march.
+/// all are false on non-x86 platforms
+struct CpuFeatures {
+    bool sse42;
+    bool pclmul;
+    bool popcnt;
+    bool bmi2;
+    bool avx2;      // also requires OS saved ymm state
+    bool avx512f;   // avx512* also requires OS saved zmm state
+    bool avx512bw;
+    bool avx512vl;
+    bool avx512vbmi;
+    bool avx512vpopcntdq;
+};
+
+/// detected once, env TERARK_CPU_DISABLE can mask out features for testing
+/// the fallback paths, such as: TERARK_CPU_DISABLE=avx512,sse42
+/// names are same as field names of CpuFeatures, "avx512" for all avx512*
+TERARK_DLL_EXPORT const CpuFeatures& cpu_features();
+
+/// copy of cpu_features() for inline kernels, where a call is too costly,
+/// it is all false until static initialization, which selects fallbacks
+TERARK_DLL_EXPORT extern CpuFeatures g_cpu_features;
+
+} // namespace terark
@@ -1,4 +1,5 @@
 #include "crc.hpp"
+#include "cpu_features.hpp"
 
 #if defined(__GNUC__) && __GNUC__ * 1000 + __GNUC_MINOR__ >= 4005 || defined(__clang__)
   #if defined(__amd64__) || defined(__amd64) || \
@@ -612,7 +613,11 @@ uint32_t crc32c_sb8_64_bit(uint32_t running_crc, const unsigned char* p_buf,
     return crc;
 }
 
-#else // __SSE4_2__
+#endif // __SSE4_2__
+
+// when not compiled with -msse4.2, crc32c_sse42 is compiled with
+// TERARK_TARGET("sse4.2") and selected at runtime if cpu supports sse4.2
+#if defined(__SSE4_2__) || defined(TERARK_TARGET_DISPATCH)
 
 #if TERARK_WORD_BITS == 64
 #define CRC_WORD 8
@@ -628,7 +633,7 @@ uint32_t crc32c_sb8_64_bit(uint32_t running_crc, const unsigned char* p_buf,
  * Use the crc32 instruction from SSE4.2 to compute our checksum - same
  * polynomial as the above function.
  */
-static really_inline
+static really_inline TERARK_TARGET("sse4.2")
 uint32_t crc32c_sse42(uint32_t running_crc, const unsigned char* p_buf,
                       const size_t length) {
     uint32_t crc = running_crc;
@@ -667,7 +672,7 @@ uint32_t crc32c_sse42(uint32_t running_crc, const unsigned char* p_buf,
 
     return crc;
 }
-#endif
+#endif // __SSE4_2__ || TERARK_TARGET_DISPATCH
 
 } // namespace terark
 
@@ -679,8 +684,13 @@ uint32_t crc32c_sse42(uint32_t running_crc, const unsigned char* p_buf,
 namespace terark {
 // Externally visible function
 uint32_t Crc32c_update(uint32_t inCrc32, const void *buf, size_t bufLen) {
-#ifdef __SSE4_2__
+#if defined(__SSE4_2__)
     uint32_t crc = crc32c_sse42(inCrc32, (const unsigned char *)buf, bufLen);
+#elif defined(TERARK_TARGET_DISPATCH)
+    typedef uint32_t (*crc32c_func_t)(uint32_t, const unsigned char*, size_t);
+    static const crc32c_func_t crc32c_impl =
+        cpu_features().sse42 ? &crc32c_sse42 : &crc32c_sb8_64_bit;
+    uint32_t crc = crc32c_impl(inCrc32, (const unsigned char *)buf, bufLen);
 #else
     uint32_t crc = crc32c_sb8_64_bit(inCrc32, (const unsigned char *)buf, bufLen);
 #endif
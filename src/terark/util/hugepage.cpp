@@ -1,5 +1,88 @@
 #include "hugepage.hpp"
+#include <terark/fstring.hpp>
+#include <atomic>
+#include <errno.h>
+#include <string.h>
+#if !defined(_MSC_VER)
+	#include <unistd.h>
+#endif
 
 namespace terark {
 
+HugepageCopy::~HugepageCopy() {
+	if (m_base) {
+		munmap(m_base, m_size);
+	}
+}
+
+bool HugepageCopy::copy(valvec<fstring>* blocks) {
+#if defined(_MSC_VER) || !defined(MADV_HUGEPAGE)
+	TERARK_UNUSED_VAR(blocks);
+	return false;
+#else
+	TERARK_VERIFY(nullptr == m_base);
+	size_t sum = 0;
+	for (const fstring& b : *blocks) {
+		sum += align_up(b.size(), 64);
+	}
+	if (sum < hugepage_size) {
+		return false;
+	}
+	// over allocate then trim, the copy is the remaining pages
+	size_t len = align_up(sum, size_t(sysconf(_SC_PAGESIZE)));
+	size_t rawLen = len + hugepage_size;
+	void* raw = mmap(NULL, rawLen, PROT_READ|PROT_WRITE,
+					 MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	if (MAP_FAILED == raw) {
+		fprintf(stderr, "WARN: %s: mmap(size=%zd) = %s\n",
+			BOOST_CURRENT_FUNCTION, rawLen, strerror(errno));
+		return false;
+	}
+	byte_t* rawBeg = (byte_t*)raw;
+	byte_t* amem = (byte_t*)align_up(size_t(rawBeg), hugepage_size);
+	if (amem > rawBeg) {
+		munmap(rawBeg, amem - rawBeg);
+	}
+	if (rawBeg + rawLen > amem + len) {
+		munmap(amem + len, rawBeg + rawLen - (amem + len));
+	}
+	if (madvise(amem, len, MADV_HUGEPAGE)) {
+		// still a valid copy, just on small pages, drop it
+		fprintf(stderr, "WARN: %s: madvise(MADV_HUGEPAGE, size=%zd[0x%zX]) = %s\n",
+			BOOST_CURRENT_FUNCTION, len, len, strerror(errno));
+		munmap(amem, len);
+		return false;
+	}
+	size_t pos = 0;
+	for (const fstring& b : *blocks) {
+		memcpy(amem + pos, b.data(), b.size());
+		pos += align_up(b.size(), 64);
+	}
+	if (mprotect(amem, len, PROT_READ)) {
+		fprintf(stderr, "WARN: %s: mprotect(PROT_READ, size=%zd[0x%zX]) = %s\n",
+			BOOST_CURRENT_FUNCTION, len, len, strerror(errno));
+		munmap(amem, len);
+		return false;
+	}
+	pos = 0;
+	for (fstring& b : *blocks) {
+		b = fstring(amem + pos, b.size());
+		pos += align_up(b.size(), 64);
+	}
+	m_base = amem;
+	m_size = len;
+	return true;
+#endif
+}
+
+static std::atomic<bool> g_hugepageLoad(getEnvBool("TerarkHugepageLoad", false));
+
+void set_hugepage_load(bool val) {
+	g_hugepageLoad.store(val, std::memory_order_relaxed);
+}
+
+bool get_hugepage_load() {
+	return g_hugepageLoad.load(std::memory_order_relaxed);
+}
+
 } // namespace terark
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <boost/current_function.hpp>
+#include <boost/noncopyable.hpp>
+#include <terark/fstring.hpp>
 #include <terark/stdtypes.hpp>
 #include <terark/valvec.hpp>
 #if defined(_MSC_VER)
@@ -12,6 +14,31 @@ namespace terark {
 
 static const size_t hugepage_size = size_t(2) << 20;
 
+/// Read-only copy of a few hot blocks (the meta blocks of a blob store or
+/// an index) in 2MB aligned anonymous memory advised by MADV_HUGEPAGE, so
+/// random probes into them hit far fewer TLB misses. The other blocks stay
+/// in the file mapping, which is evictable page cache.
+class TERARK_DLL_EXPORT HugepageCopy : boost::noncopyable {
+	void*  m_base = nullptr;
+	size_t m_size = 0;
+public:
+	~HugepageCopy();
+	/// copy *blocks, each 64 bytes aligned, and point them to the copy
+	/// @returns false and keeps *blocks if their sum < hugepage_size or on failure
+	bool copy(valvec<fstring>* blocks);
+	bool empty() const { return nullptr == m_base; }
+	size_t size() const { return m_size; }
+	void swap(HugepageCopy& y) {
+		std::swap(m_base, y.m_base);
+		std::swap(m_size, y.m_size);
+	}
+};
+
+/// Load mode of AbstractBlobStore::load_from_mmap and TerarkIndex::LoadFile,
+/// if true the meta blocks are HugepageCopy'ed, default is env TerarkHugepageLoad
+TERARK_DLL_EXPORT void set_hugepage_load(bool);
+TERARK_DLL_EXPORT bool get_hugepage_load();
+
 template<class T>
 void use_hugepage_advise(valvec<T>* vec) {
 #if defined(_MSC_VER) || !defined(MADV_HUGEPAGE)
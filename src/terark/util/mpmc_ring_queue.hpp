@@ -0,0 +1,230 @@
+#pragma once
+
+#include <terark/stdtypes.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#if defined(__SSE2__) || defined(_M_X64)
+	#include <emmintrin.h>
+#endif
+
+namespace terark { namespace util {
+
+/// Bounded lock-free multi-producer multi-consumer queue (D. Vyukov).
+/// Each cell has a sequence number telling whether it is ready for the
+/// producer or the consumer of the current lap, so push and pop are a CAS
+/// on the shared position, items are FIFO in the order positions are taken.
+/// A blocked caller spins, then yields, then parks on a condition variable,
+/// the mutex is touched by the other side only when somebody is parked.
+/// Capacity is rounded up to a power of 2.
+template<class T>
+class mpmc_ring_queue {
+	DECLARE_NONE_COPYABLE_CLASS(mpmc_ring_queue)
+
+	struct Cell {
+		std::atomic<size_t> seq;
+		T data;
+	};
+	typedef std::chrono::steady_clock Clock;
+	static const size_t SpinLoops = 64;
+	static const size_t YieldLoops = 16;
+
+	std::unique_ptr<Cell[]> m_cells;
+	size_t m_mask;
+	size_t m_spin; // 0 on single cpu, spinning just delays the other side
+	char m_pad0[64];
+	std::atomic<size_t> m_pushPos;
+	char m_pad1[64 - sizeof(size_t)];
+	std::atomic<size_t> m_popPos;
+	char m_pad2[64 - sizeof(size_t)];
+	std::atomic<size_t> m_pushWaiters;
+	std::atomic<size_t> m_popWaiters;
+	std::mutex m_mtx;
+	std::condition_variable m_pushCond;
+	std::condition_variable m_popCond;
+
+	static void pause(size_t loop) {
+		if (loop < SpinLoops) {
+#if defined(__SSE2__) || defined(_M_X64)
+			_mm_pause();
+#endif
+		} else {
+			std::this_thread::yield();
+		}
+	}
+	void wake(std::atomic<size_t>& waiters, std::condition_variable& cond) {
+		// pairs with the fence in park(), either we see the waiter or
+		// the waiter sees the cell we have just published
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (waiters.load(std::memory_order_relaxed)) {
+			std::lock_guard<std::mutex> lock(m_mtx);
+			cond.notify_all();
+		}
+	}
+	// the cell at current position is not yet released for the caller
+	bool push_blocked() const {
+		size_t pos = m_pushPos.load(std::memory_order_relaxed);
+		size_t seq = m_cells[pos & m_mask].seq.load(std::memory_order_acquire);
+		return intptr_t(seq - pos) < 0;
+	}
+	bool pop_blocked() const {
+		size_t pos = m_popPos.load(std::memory_order_relaxed);
+		size_t seq = m_cells[pos & m_mask].seq.load(std::memory_order_acquire);
+		return intptr_t(seq - (pos + 1)) < 0;
+	}
+	// @returns false if timeout, timeout < 0 means infinite
+	template<class Blocked>
+	bool park(std::atomic<size_t>& waiters, std::condition_variable& cond,
+			  Blocked blocked, int timeout, Clock::time_point& deadline) {
+		if (timeout >= 0 && Clock::time_point() == deadline) {
+			deadline = Clock::now() + std::chrono::milliseconds(timeout);
+		}
+		std::unique_lock<std::mutex> lock(m_mtx);
+		waiters.fetch_add(1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		bool ok = true;
+		if (blocked()) {
+			if (timeout < 0)
+				cond.wait(lock);
+			else
+				ok = std::cv_status::no_timeout == cond.wait_until(lock, deadline);
+		}
+		waiters.fetch_sub(1, std::memory_order_relaxed);
+		return ok;
+	}
+
+public:
+	explicit mpmc_ring_queue(size_t capacity) {
+		size_t cap = 2;
+		while (cap < capacity)
+			cap *= 2;
+		m_cells.reset(new Cell[cap]);
+		for (size_t i = 0; i < cap; ++i)
+			m_cells[i].seq.store(i, std::memory_order_relaxed);
+		m_mask = cap - 1;
+		m_spin = std::thread::hardware_concurrency() > 1 ? SpinLoops + YieldLoops : 0;
+		m_pushPos.store(0, std::memory_order_relaxed);
+		m_popPos.store(0, std::memory_order_relaxed);
+		m_pushWaiters.store(0, std::memory_order_relaxed);
+		m_popWaiters.store(0, std::memory_order_relaxed);
+	}
+
+	size_t capacity() const { return m_mask + 1; }
+
+	/// approximate when there are concurrent pushers or poppers
+	size_t size() const {
+		size_t pop = m_popPos.load(std::memory_order_relaxed);
+		size_t push = m_pushPos.load(std::memory_order_relaxed);
+		return intptr_t(push - pop) > 0 ? push - pop : 0;
+	}
+	bool empty() const { return size() == 0; }
+
+	bool try_push_back(const T& x) {
+		return try_push_back_n(&x, 1) == 1;
+	}
+
+	/// push a prefix of x[0,n) into consecutive positions, so the prefix
+	/// is never interleaved with items of other producers
+	/// @returns number of pushed items, 0 if the queue is full
+	size_t try_push_back_n(const T* x, size_t n) {
+		if (0 == n)
+			return 0;
+		size_t pos = m_pushPos.load(std::memory_order_relaxed);
+		for (;;) {
+			size_t k = 0;
+			for (; k < n; ++k) {
+				size_t seq = m_cells[(pos + k) & m_mask].seq.load(std::memory_order_acquire);
+				if (seq != pos + k) {
+					if (0 == k && intptr_t(seq - pos) < 0)
+						return 0; // full
+					break;
+				}
+			}
+			if (0 == k) {
+				pos = m_pushPos.load(std::memory_order_relaxed);
+			}
+			else if (m_pushPos.compare_exchange_weak(pos, pos + k, std::memory_order_relaxed)) {
+				for (size_t i = 0; i < k; ++i) {
+					Cell& c = m_cells[(pos + i) & m_mask];
+					c.data = x[i];
+					c.seq.store(pos + i + 1, std::memory_order_release);
+				}
+				wake(m_popWaiters, m_popCond);
+				return k;
+			}
+		}
+	}
+
+	bool try_pop_front(T& x) {
+		size_t pos = m_popPos.load(std::memory_order_relaxed);
+		for (;;) {
+			Cell& c = m_cells[pos & m_mask];
+			size_t seq = c.seq.load(std::memory_order_acquire);
+			intptr_t dif = intptr_t(seq - (pos + 1));
+			if (0 == dif) {
+				if (m_popPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					x = c.data;
+					c.seq.store(pos + m_mask + 1, std::memory_order_release);
+					wake(m_pushWaiters, m_pushCond);
+					return true;
+				}
+			}
+			else if (dif < 0) {
+				return false; // empty
+			}
+			else {
+				pos = m_popPos.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	/// @param timeout milliseconds, < 0 means infinite, 0 means no wait
+	/// @returns number of pushed items, 0 only if timeout
+	size_t push_back_n(const T* x, size_t n, int timeout) {
+		assert(n > 0);
+		Clock::time_point deadline;
+		for (size_t loop = 0;; ++loop) {
+			if (size_t k = try_push_back_n(x, n))
+				return k;
+			if (0 == timeout)
+				return 0;
+			if (loop < m_spin)
+				pause(loop);
+			else if (!park(m_pushWaiters, m_pushCond,
+						   [this]{ return push_blocked(); }, timeout, deadline))
+				return try_push_back_n(x, n);
+		}
+	}
+	bool push_back(const T& x, int timeout) {
+		return push_back_n(&x, 1, timeout) == 1;
+	}
+	void push_back(const T& x) {
+		push_back_n(&x, 1, -1);
+	}
+
+	/// @param timeout milliseconds, < 0 means infinite, 0 means no wait
+	bool pop_front(T& x, int timeout) {
+		Clock::time_point deadline;
+		for (size_t loop = 0;; ++loop) {
+			if (try_pop_front(x))
+				return true;
+			if (0 == timeout)
+				return false;
+			if (loop < m_spin)
+				pause(loop);
+			else if (!park(m_popWaiters, m_popCond,
+						   [this]{ return pop_blocked(); }, timeout, deadline))
+				return try_pop_front(x);
+		}
+	}
+	T pop_front() {
+		T x;
+		pop_front(x, -1);
+		return x;
+	}
+};
+
+}} // namespace terark::util
@@ -3,6 +3,8 @@
 #include <terark/gold_hash_map.hpp>
 #include <terark/io/DataIO_Basic.hpp>
 #include <terark/util/small_memcpy.hpp>
+#include <atomic>
+#include <thread>
 
 #if defined(__GNUC__) && !defined(__CYGWIN__) && !defined(__clang__)
 #include <parallel/algorithm>
@@ -142,10 +144,237 @@ void SortableStrVec::sort() {
 #endif
 		std::sort(m_index.begin(), m_index.end(), cmp);
 	} else { // use radix sort
-		auto getChar = [pool](const SEntry& x,size_t i){return pool[x.offset+i];};
-		auto getSize = [](const SEntry& x) { return x.length; };
-		radix_sort_tpl(m_index.data(), m_index.size(), getChar, getSize);
+		sort_radix(NULL, (size_t)getEnvLong("SortableStrVec_radixSortThreads", 0));
+	}
+}
+
+namespace {
+
+template<class Func>
+void parallel_run(size_t threads, Func func) {
+	valvec<std::thread> thrVec(threads - 1, valvec_reserve());
+	for (size_t i = 0; i + 1 < threads; ++i) {
+		thrVec.unchecked_emplace_back([&,i](){func(i);});
+	}
+	func(threads - 1);
+	for (auto& t : thrVec) {
+		t.join();
+	}
+}
+
+// MSD radix sort, bucket 0 is for the strings ending at current depth.
+// A pass reads the byte of each string once into the oracle, then counts
+// and scatters by the oracle. Ranges larger than m_bigNum are split by all
+// threads together, then each thread sorts the remaining ranges, largest
+// first. LCP of adjacent strings falls out of the bucket boundaries.
+class SEntryRadixSorter {
+	typedef SortableStrVec::SEntry SEntry;
+	static const size_t kBuckets = 257;
+	static const size_t kInsertSortMax = 32;
+	static const size_t kParallelMin = 64*1024;
+	struct Job {
+		size_t beg;
+		size_t num;
+		size_t depth;
+	};
+	const byte_t* m_pool;
+	SEntry*   m_a;
+	SEntry*   m_t; // scatter buffer
+	uint32_t* m_lcp; // NULL if not required
+	size_t    m_threads;
+	valvec<uint16_t> m_oracle; // for parallel split
+
+	size_t bucket(const SEntry& x, size_t depth) const {
+		return depth < x.length ? size_t(m_pool[x.offset + depth]) + 1 : 0;
+	}
+	size_t common_prefix(const SEntry& x, const SEntry& y, size_t depth) const {
+		size_t n = std::min<size_t>(x.length, y.length);
+		const byte_t* px = m_pool + x.offset;
+		const byte_t* py = m_pool + y.offset;
+		while (depth < n && px[depth] == py[depth])
+			depth++;
+		return depth;
+	}
+	// all strings in a job have the same prefix of depth bytes
+	bool less(const SEntry& x, const SEntry& y, size_t depth) const {
+		size_t n = std::min<size_t>(x.length, y.length);
+		int c = memcmp(m_pool + x.offset + depth, m_pool + y.offset + depth, n - depth);
+		return c < 0 || (0 == c && x.length < y.length);
+	}
+	void insert_sort(const Job& j) {
+		SEntry* a = m_a + j.beg;
+		for (size_t i = 1; i < j.num; ++i) {
+			SEntry x = a[i];
+			size_t k = i;
+			for (; k > 0 && less(x, a[k-1], j.depth); --k)
+				a[k] = a[k-1];
+			a[k] = x;
+		}
+		if (m_lcp) {
+			for (size_t i = 1; i < j.num; ++i)
+				m_lcp[j.beg + i] = uint32_t(common_prefix(a[i-1], a[i], j.depth));
+		}
+	}
+	// lcp of the first string of the job is set by the parent
+	template<class PushJob>
+	void emit(const Job& j, const size_t* cnt, PushJob push) {
+		size_t pos = j.beg;
+		for (size_t c = 0; c < kBuckets; ++c) {
+			size_t n = cnt[c];
+			if (0 == n)
+				continue;
+			if (m_lcp) {
+				if (pos != j.beg)
+					m_lcp[pos] = uint32_t(j.depth);
+				if (0 == c) { // equal strings
+					for (size_t i = 1; i < n; ++i)
+						m_lcp[pos + i] = uint32_t(j.depth);
+				}
+			}
+			if (c && n > 1)
+				push(Job{pos, n, j.depth + 1});
+			pos += n;
+		}
+	}
+	template<class PushJob>
+	void split_seq(Job j, valvec<uint16_t>& oracle, PushJob push) {
+		oracle.resize_no_init(j.num);
+		uint16_t* o = oracle.data();
+		SEntry* a = m_a + j.beg;
+		size_t cnt[kBuckets];
+		for (;;) {
+			std::fill_n(cnt, kBuckets, 0);
+			for (size_t i = 0; i < j.num; ++i) {
+				o[i] = uint16_t(bucket(a[i], j.depth));
+				cnt[o[i]]++;
+			}
+			if (o[0] && cnt[o[0]] == j.num)
+				j.depth++; // common prefix, no need to scatter
+			else
+				break;
+		}
+		size_t off[kBuckets];
+		for (size_t c = 0, pos = 0; c < kBuckets; ++c) {
+			off[c] = pos;
+			pos += cnt[c];
+		}
+		SEntry* t = m_t + j.beg;
+		for (size_t i = 0; i < j.num; ++i)
+			t[off[o[i]]++] = a[i];
+		memcpy(a, t, sizeof(SEntry) * j.num);
+		emit(j, cnt, push);
+	}
+	template<class PushJob>
+	void split_par(Job j, PushJob push) {
+		const size_t nth = m_threads;
+		valvec<size_t> cnt(nth * kBuckets);
+		size_t total[kBuckets];
+		uint16_t* o = m_oracle.data() + j.beg;
+		SEntry* a = m_a + j.beg;
+		SEntry* t = m_t + j.beg;
+		auto chunk = [&](size_t tid) { return j.num * tid / nth; };
+		for (;;) {
+			parallel_run(nth, [&](size_t tid) {
+				size_t* c = cnt.data() + kBuckets * tid;
+				std::fill_n(c, kBuckets, 0);
+				for (size_t i = chunk(tid), e = chunk(tid + 1); i < e; ++i) {
+					o[i] = uint16_t(bucket(a[i], j.depth));
+					c[o[i]]++;
+				}
+			});
+			for (size_t c = 0; c < kBuckets; ++c) {
+				total[c] = 0;
+				for (size_t tid = 0; tid < nth; ++tid)
+					total[c] += cnt[kBuckets * tid + c];
+			}
+			if (o[0] && total[o[0]] == j.num)
+				j.depth++;
+			else
+				break;
+		}
+		// thread tid writes after threads before it in each bucket: stable
+		for (size_t c = 0, pos = 0; c < kBuckets; ++c) {
+			for (size_t tid = 0; tid < nth; ++tid) {
+				size_t n = cnt[kBuckets * tid + c];
+				cnt[kBuckets * tid + c] = pos;
+				pos += n;
+			}
+		}
+		parallel_run(nth, [&](size_t tid) {
+			size_t* off = cnt.data() + kBuckets * tid;
+			for (size_t i = chunk(tid), e = chunk(tid + 1); i < e; ++i)
+				t[off[o[i]]++] = a[i];
+		});
+		parallel_run(nth, [&](size_t tid) {
+			size_t beg = chunk(tid), end = chunk(tid + 1);
+			memcpy(a + beg, t + beg, sizeof(SEntry) * (end - beg));
+		});
+		emit(j, total, push);
+	}
+	void sort_seq(const Job& root, valvec<uint16_t>& oracle, valvec<Job>& stack) {
+		stack.push_back(root);
+		while (!stack.empty()) {
+			Job j = stack.pop_val();
+			if (j.num <= kInsertSortMax)
+				insert_sort(j);
+			else
+				split_seq(j, oracle, [&](const Job& sub) { stack.push_back(sub); });
+		}
+	}
+public:
+	SEntryRadixSorter(const byte_t* pool, SEntry* a, SEntry* t, uint32_t* lcp,
+					  size_t threads)
+	  : m_pool(pool), m_a(a), m_t(t), m_lcp(lcp), m_threads(threads) {}
+
+	void sort(size_t num) {
+		if (0 == num)
+			return;
+		if (m_lcp)
+			m_lcp[0] = 0;
+		valvec<uint16_t> oracle;
+		valvec<Job> stack;
+		if (m_threads <= 1 || num < kParallelMin) {
+			sort_seq(Job{0, num, 0}, oracle, stack);
+			return;
+		}
+		const size_t bigNum = std::max(num / (2 * m_threads), kParallelMin);
+		valvec<Job> big, small;
+		big.push_back(Job{0, num, 0});
+		m_oracle.resize_no_init(num);
+		while (!big.empty()) {
+			split_par(big.pop_val(), [&](const Job& sub) {
+				if (sub.num > bigNum)
+					big.push_back(sub);
+				else
+					small.push_back(sub);
+			});
+		}
+		m_oracle.clear();
+		std::sort(small.begin(), small.end(),
+				  [](const Job& x, const Job& y) { return x.num > y.num; });
+		std::atomic<size_t> next(0);
+		parallel_run(m_threads, [&](size_t) {
+			valvec<uint16_t> oracle;
+			valvec<Job> stack;
+			for (size_t k; (k = next++) < small.size(); )
+				sort_seq(small[k], oracle, stack);
+		});
+	}
+};
+
+} // namespace
+
+void SortableStrVec::sort_radix(valvec<uint32_t>* lcp, size_t threads) {
+	if (0 == threads) {
+		threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+	}
+	valvec<SEntry> tmp(m_index.size(), valvec_no_init());
+	if (lcp) {
+		lcp->resize_no_init(m_index.size());
 	}
+	SEntryRadixSorter sorter(m_strpool.data(), m_index.data(), tmp.data(),
+							 lcp ? lcp->data() : NULL, threads);
+	sorter.sort(m_index.size());
 }
 
 void SortableStrVec::clear() {
@@ -81,6 +81,11 @@ public:
 	void back_grow_no_init(size_t nGrow);
 	void reverse_keys();
 	void sort();
+	/// stable parallel MSD radix sort, needs extra size()*sizeof(SEntry)
+	/// @param lcp if not NULL, (*lcp)[i] is the common prefix length of
+	///            the (i-1)-th and i-th sorted strings, (*lcp)[0] is 0
+	/// @param threads 0 means all cpus
+	void sort_radix(valvec<uint32_t>* lcp, size_t threads = 0);
 	void sort_by_offset();
 	void sort_by_seq_id();
 	void clear();
@@ -4,6 +4,7 @@
 #include <terark/io/FileStream.hpp>
 #include <terark/io/StreamBuffer.hpp>
 #include <terark/util/function.hpp>
+#include <terark/succinct/rank_select_basic.hpp> // for UintSelect1
 #include <boost/intrusive_ptr.hpp>
 
 namespace terark {
@@ -107,6 +108,88 @@ static inline uint64_t GetLoWater_x(const byte_t* ba, size_t* headerLen) {
 	return val;
 }
 
+// Elias-Fano block, x[j] = vals[j+1] - vals[0] for j in [0, blockUnits-1):
+// +-----------+-----------------------+-------------------------------+
+// | lowWidth  | low bits of x[j]      | high bits: bit (x[j]>>lowWidth)+j|
+// |  1 byte   | (blockUnits-1)*lowWidth|   is set, byte aligned         |
+// +-----------+-----------------------+-------------------------------+
+static const size_t EF_MaxLowWidth = 56; // one unaligned uint64 load
+static const size_t EF_Log2Flag = 8; // in ObjectHeader::log2_blockUnits
+
+static inline const byte_t* ef_high_base(const byte_t* block, size_t blockUnits) {
+	return block + 1 + ((blockUnits - 1) * block[0] + 7) / 8;
+}
+
+static inline size_t ef_low(const byte_t* block, size_t j) {
+	size_t lowWidth = block[0];
+	size_t bitpos = 8 + j * lowWidth;
+	uint64_t w = unaligned_load<uint64_t>(block + bitpos / 8) >> (bitpos % 8);
+	return w & ~(uint64_t(-1) << lowWidth);
+}
+
+// position of the rank'th 1 in high bits
+static inline size_t ef_select(const byte_t* high, size_t rank) {
+	for (size_t k = 0; ; ++k) {
+		uint64_t w = unaligned_load<uint64_t>(high + 8 * k);
+		size_t cnt = fast_popcount64(w);
+		if (rank < cnt)
+			return 64 * k + UintSelect1(w, rank);
+		rank -= cnt;
+	}
+}
+
+// position of the first 1 after pos in high bits
+static inline size_t ef_next(const byte_t* high, size_t pos) {
+	size_t k = (pos + 1) / 64;
+	uint64_t w = unaligned_load<uint64_t>(high + 8 * k);
+	w &= uint64_t(-1) << (pos + 1) % 64;
+	while (0 == w) {
+		w = unaligned_load<uint64_t>(high + 8 * ++k);
+	}
+	return 64 * k + fast_ctz64(w);
+}
+
+static inline size_t
+ef_value(const byte_t* block, size_t j, size_t pos, size_t sample0) {
+	return sample0 + (((pos - j) << block[0]) | ef_low(block, j));
+}
+
+static void ef_get2(const byte_t* block, size_t blockUnits, size_t subIdx,
+					size_t sample0, size_t sample1, size_t aVal[2]) {
+	auto high = ef_high_base(block, blockUnits);
+	size_t pos;
+	if (subIdx) {
+		pos = ef_select(high, subIdx - 1);
+		aVal[0] = ef_value(block, subIdx - 1, pos, sample0);
+		if (subIdx + 1 < blockUnits) {
+			pos = ef_next(high, pos);
+			aVal[1] = ef_value(block, subIdx, pos, sample0);
+		} else {
+			aVal[1] = sample1;
+		}
+	} else {
+		pos = ef_select(high, 0);
+		aVal[0] = sample0;
+		aVal[1] = ef_value(block, 0, pos, sample0);
+	}
+}
+
+static void ef_get_block(const byte_t* block, size_t blockUnits,
+						 size_t sample0, size_t* aVals) {
+	auto high = ef_high_base(block, blockUnits);
+	size_t k = 0;
+	uint64_t w = unaligned_load<uint64_t>(high);
+	aVals[0] = sample0;
+	for (size_t j = 0; j < blockUnits - 1; ++j) {
+		while (0 == w) {
+			w = unaligned_load<uint64_t>(high + 8 * ++k);
+		}
+		size_t pos = 64 * k + fast_ctz64(w);
+		w &= w - 1;
+		aVals[j + 1] = ef_value(block, j, pos, sample0);
+	}
+}
+
 static const byte_t g_used_small_width[65] = {0,1,2,3,4,5,6,7,8,9,10
 	,  12 // width = 11, type = NA
 	,  12 // width = 12, type = 12 +++
@@ -233,7 +316,9 @@ static inline size_t s_get_mask(size_t bits) {
 
 struct SortedUintVec::ObjectHeader {
 	uint64_t  units : 48; // SortedUintVec::m_size
-	uint64_t  log2_blockUnits : 4; // 6 or 7
+	// 6 or 7, EF_Log2Flag is added for elias fano blocks, so readers
+	// without elias fano reject it as an invalid log2_blockUnits
+	uint64_t  log2_blockUnits : 4;
 	uint64_t  offsetWidth_1   : 6; // 1 ~ 64, = real_offset_width - 1
 	uint64_t  sampleWidth_1   : 6; // 1 ~ 64, = real_sample_width - 1
 	uint64_t  indexOffset     :48;
@@ -267,6 +352,10 @@ void SortedUintVec::get2(size_t idx, size_t aVal[2]) const {
     assert(offset0 + 2 <= offset1);
     assert(sample0 <= sample1 || !m_is_samples_full_sorted);
 
+    if (m_is_elias_fano) {
+        ef_get2(header, blockUnits, subIdx, sample0, sample1, aVal);
+        return;
+    }
     switch (GetDDWidthType(header)) {
     case 0: { // bits = 0, all diffdiff are zero
         assert(offset0 + 2 <= offset1);
@@ -427,6 +516,10 @@ void SortedUintVec::get_block(size_t blockIdx, size_t* aVals) const {
     assert(offset0 + 2 <= offset1);
     assert(sample0 <= sample1 || !m_is_samples_full_sorted);
 
+    if (m_is_elias_fano) {
+        ef_get_block(header, blockUnits, sample0, aVals);
+        return;
+    }
     switch (GetDDWidthType(header)) {
     case 0: { // bits = 0, all diffdiff are zero
         assert(offset0 + 2 <= offset1);
@@ -540,6 +633,28 @@ void SortedUintVec::get_block(size_t blockIdx, size_t* aVals) const {
     } // switch
 }
 
+void SortedUintVec::get2_sorted(const size_t* sortedIdx, size_t n, size_t* aVal) const {
+	assert(m_is_sorted_uint_vec);
+	size_t log2 = m_log2_blockUnits;
+	size_t mask = (size_t(1) << log2) - 1;
+	size_t block[129]; // BlockUnits can only be 64 or 128
+	size_t blockId = size_t(-1);
+	assert(mask + 2 <= sizeof(block)/sizeof(block[0]));
+	for (size_t i = 0; i < n; ++i) {
+		size_t idx = sortedIdx[i];
+		assert(idx + 1 < m_size);
+		assert(0 == i || sortedIdx[i-1] <= idx);
+		if (idx >> log2 != blockId) {
+			blockId = idx >> log2;
+			get_block(blockId, block);
+			block[mask+1] = get_block_min_val(blockId+1);
+		}
+		size_t inBlockID = idx & mask;
+		aVal[2*i+0] = block[inBlockID+0];
+		aVal[2*i+1] = block[inBlockID+1];
+	}
+}
+
 size_t SortedUintVec::get(size_t idx) const {
 	assert(idx < m_size);
 	assert(m_is_sorted_uint_vec);
@@ -556,6 +671,7 @@ SortedUintVec::SortedUintVec() {
 	m_is_sorted_uint_vec = true;
 	m_is_overall_full_sorted = true;
 	m_is_samples_full_sorted = true;
+	m_is_elias_fano = false;
 #if TERARK_WORD_BITS == 64
 	m_padding = 0xCCCCCCCC;
 #endif
@@ -787,7 +903,8 @@ void SortedUintVec::risk_set_data(const void* base, size_t bytes) {
 	assert(m_is_sorted_uint_vec);
 	auto oheader = (const ObjectHeader*)(base);
 	size_t numUnits = oheader->units;
-	size_t log2_blockUnits = oheader->log2_blockUnits;
+	size_t log2_blockUnits = oheader->log2_blockUnits & ~EF_Log2Flag;
+	bool   is_elias_fano = (oheader->log2_blockUnits & EF_Log2Flag) != 0;
 	size_t offsetWidth = oheader->offsetWidth_1 + 1;
 	size_t sampleWidth = oheader->sampleWidth_1 + 1;
 	size_t blockUnits = size_t(1) << log2_blockUnits;
@@ -824,6 +941,7 @@ void SortedUintVec::risk_set_data(const void* base, size_t bytes) {
 	m_sampleWidth = byte_t(sampleWidth);
 	m_is_overall_full_sorted = oheader->is_overall_full_sorted;
 	m_is_samples_full_sorted = oheader->is_samples_full_sorted;
+	m_is_elias_fano = is_elias_fano;
 }
 
 void SortedUintVec::risk_release_ownership() {
@@ -846,6 +964,7 @@ void SortedUintVec::swap(SortedUintVec& y) {
 	DO_SWAP_BIT(m_is_sorted_uint_vec   , y.m_is_sorted_uint_vec);
 	DO_SWAP_BIT(m_is_overall_full_sorted, y.m_is_overall_full_sorted);
 	DO_SWAP_BIT(m_is_samples_full_sorted, y.m_is_samples_full_sorted);
+	DO_SWAP_BIT(m_is_elias_fano        , y.m_is_elias_fano);
 #if TERARK_WORD_BITS == 64
 	std::swap(m_padding        , y.m_padding);
 #endif
@@ -867,6 +986,7 @@ class SortedUintVec::Builder::Impl : public SortedUintVec::Builder {
 	byte_t   m_log2_blockUnits;
 	bool     m_is_sorted;
 	bool     m_is_real_sorted;
+	bool     m_is_elias_fano;
 
 	// m_smallToLarge[largeCount][smallWidth][largeWidth]
 	AutoFree<unsigned[16][64]> m_smallToLarge;
@@ -890,6 +1010,7 @@ class SortedUintVec::Builder::Impl : public SortedUintVec::Builder {
 	void append_block(uint64_t nextBlockFirstValue);
 	void append_block_impl();
 	void append_block_impl_lagrange(uint64_t nextBlockFirstValue);
+	void append_block_impl_elias_fano();
 
     void init(size_t blockUnits);
 
@@ -972,7 +1093,10 @@ void SortedUintVec::Builder::Impl::append_block(uint64_t nextBlockFirstValue) {
 			break;
 		}
 	}
-	if (isIncreasing) {
+	if (m_is_elias_fano) {
+		assert(isIncreasing); // checked by push_back
+		append_block_impl_elias_fano();
+	} else if (isIncreasing) {
 		append_block_impl();
 	} else {
 		append_block_impl_lagrange(nextBlockFirstValue);
@@ -1201,7 +1325,37 @@ void SortedUintVec::Builder::Impl::append_block_impl_lagrange(uint64_t nextBlock
     assert(bitpos <= m_data.size() * 8);
 }
 
+void SortedUintVec::Builder::Impl::append_block_impl_elias_fano() {
+    const size_t blockUnits = getBlockUnits();
+    auto vals = m_block.data();
+    m_index.push_back({ m_indexOffset - sizeof(ObjectHeader), (size_t)vals[0] });
+    const size_t n = blockUnits - 1;
+    const uint64_t u = vals[n] - vals[0];
+    size_t lowWidth = u > n ? terark_bsr_u64(u / n) : 0;
+    lowWidth = std::min(lowWidth, EF_MaxLowWidth);
+    size_t lowBytes = (n * lowWidth + 7) / 8;
+    size_t highBits = size_t(u >> lowWidth) + n;
+    size_t start = m_data.size();
+    m_data.resize(start + 1 + lowBytes + (highBits + 7) / 8 + 7, 0);
+    m_data[start] = byte_t(lowWidth);
+    uint64_t* pData = (uint64_t*)(m_data.data());
+    size_t lowBitPos = 8 * (start + 1);
+    size_t highBitPos = 8 * (start + 1 + lowBytes);
+    for (size_t j = 0; j < n; ++j) {
+        uint64_t x = vals[j + 1] - vals[0];
+        if (lowWidth) {
+            uint64_t lowBits = x & ~(uint64_t(-1) << lowWidth);
+            febitvec::s_set_uint(pData, lowBitPos + j * lowWidth, lowWidth, lowBits);
+        }
+        size_t bitpos = highBitPos + size_t(x >> lowWidth) + j;
+        pData[bitpos / 64] |= uint64_t(1) << bitpos % 64;
+    }
+    m_data.pop_n(7); // 7 bytes extra for safe uint64
+}
+
 void SortedUintVec::Builder::Impl::init(size_t blockUnits) {
+    m_is_elias_fano = (blockUnits & kEliasFano) != 0;
+    blockUnits &= ~kEliasFano;
     if (64 != blockUnits && 128 != blockUnits) {
         THROW_STD(invalid_argument
             , "invalid blockUnits = %zd, must be 64 or 128"
@@ -1232,6 +1386,9 @@ void SortedUintVec::Builder::Impl::init(size_t blockUnits) {
 SortedUintVec::Builder::Impl::Impl(size_t blockUnits, OutputBuffer* buffer, bool is_sorted) {
     init(blockUnits);
     m_is_sorted = is_sorted;
+    if (m_is_elias_fano && !is_sorted) {
+        THROW_STD(invalid_argument, "kEliasFano requires sorted input");
+    }
     m_is_real_sorted = true;
     // m_fp should not assign
     // for buffer->getOutputStream() can be stack object
@@ -1247,6 +1404,9 @@ SortedUintVec::Builder::Impl::Impl(size_t blockUnits, OutputBuffer* buffer, bool
 SortedUintVec::Builder::Impl::Impl(size_t blockUnits, fstring fpath, bool is_sorted) {
     init(blockUnits);
     m_is_sorted = is_sorted;
+    if (m_is_elias_fano && !is_sorted) {
+        THROW_STD(invalid_argument, "kEliasFano requires sorted input");
+    }
     m_is_real_sorted = true;
     m_fp.reset(new FileStream(fpath.c_str(), "wb+"));
     m_writer.reset(new OutputBuffer(m_fp.get()));
@@ -1404,7 +1564,7 @@ SortedUintVec::Builder::Impl::finish(SortedUintVec* vec) {
 #endif
     auto oheader = (ObjectHeader*)m_data.data();
     oheader->units = m_size;
-    oheader->log2_blockUnits = m_log2_blockUnits;
+    oheader->log2_blockUnits = m_log2_blockUnits | (m_is_elias_fano ? EF_Log2Flag : 0);
     oheader->offsetWidth_1 = offsetWidth - 1;
     oheader->sampleWidth_1 = sampleWidth - 1;
     oheader->indexOffset = m_indexOffset;
@@ -1455,6 +1615,7 @@ SortedUintVec::Builder::Impl::finish(SortedUintVec* vec) {
         vec->m_sampleWidth = sampleWidth;
         vec->m_is_overall_full_sorted = m_is_real_sorted;
         vec->m_is_samples_full_sorted = is_samples_full_sorted;
+        vec->m_is_elias_fano = m_is_elias_fano;
     }
     if (m_smallToLarge) {
         print_histogram();
@@ -23,6 +23,7 @@ class TERARK_DLL_EXPORT SortedUintVec {
 	byte_t         m_is_sorted_uint_vec    : 1;
 	byte_t         m_is_overall_full_sorted : 1;
 	byte_t         m_is_samples_full_sorted : 1;
+	byte_t         m_is_elias_fano         : 1;
 #if TERARK_WORD_BITS == 64
 	uint32_t       m_padding;
 #else
@@ -34,6 +35,12 @@ class TERARK_DLL_EXPORT SortedUintVec {
 
 	struct ObjectHeader;
 public:
+	/// OR'ed into blockUnits of createBuilder to encode each block as an
+	/// Elias-Fano partition instead of diff-diff units, input must be sorted,
+	/// it is opt-in: faster get2, but often larger than diff-diff, and it
+	/// is rejected by readers without Elias-Fano support
+	static const size_t kEliasFano = 0x10000;
+
 	SortedUintVec();
 	~SortedUintVec();
 
@@ -55,11 +62,16 @@ public:
 
 	bool is_overall_full_sorted() const { return m_is_overall_full_sorted; }
 	bool is_samples_full_sorted() const { return m_is_samples_full_sorted; }
+	bool is_elias_fano() const { return m_is_elias_fano; }
 
 	size_t offset_width() const { return m_offsetWidth; }
 	size_t sample_width() const { return m_sampleWidth; }
 	size_t log2_block_units() const { return m_log2_blockUnits; }
 	size_t block_units() const { return size_t(1) << m_log2_blockUnits; }
+	/// blockUnits arg for createBuilder to rebuild with same encoding
+	size_t build_units() const {
+		return block_units() | (m_is_elias_fano ? size_t(kEliasFano) : 0);
+	}
 
 	size_t num_blocks() const {
 		assert(m_is_sorted_uint_vec);
@@ -76,6 +88,10 @@ public:
 	void get2(size_t idx, size_t aVal[2]) const;
 	void get_block(size_t blockIdx, size_t* aVal) const;
 
+	/// batch get2, sortedIdx must be ascending, each block is decoded once
+	/// aVal[2*i], aVal[2*i+1] = get(sortedIdx[i]), get(sortedIdx[i]+1)
+	void get2_sorted(const size_t* sortedIdx, size_t n, size_t* aVal) const;
+
     const void* get_index_base() const { return m_index; }
     size_t get_index_width() const { return m_offsetWidth + m_sampleWidth; }
     size_t get_sample_width() const { return m_sampleWidth; }
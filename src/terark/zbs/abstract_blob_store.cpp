@@ -1,8 +1,10 @@
 #include "abstract_blob_store.hpp"
 #include "blob_store_file_header.hpp"
+#include "zstd_block_blob_store.hpp"
 #include <terark/fsa/fsa.hpp>
 #include <terark/io/FileStream.hpp>
 #include <terark/util/mmap.hpp>
+#include <terark/util/hugepage.hpp>
 #include <terark/hash_strmap.hpp>
 #include <terark/gold_hash_map.hpp>
 #include <terark/zbs/xxhash_helper.hpp>
@@ -62,6 +64,11 @@ AbstractBlobStore::Builder::~Builder() {}
 AbstractBlobStore::Builder*
 AbstractBlobStore::Builder::
 createBuilder(fstring clazz, fstring outputFileName, fstring moreConfig) {
+    if (clazz == "ZstdBlockBlobStore") {
+        ZstdBlockBlobStore::Options opt;
+        opt.set_config(moreConfig);
+        return new ZstdBlockBlobStore::MyBuilder(outputFileName, 0, opt);
+    }
     return nullptr;
 }
 AbstractBlobStore::Builder*
@@ -81,7 +88,7 @@ AbstractBlobStore::load_from_mmap(fstring fpath, bool mmapPopulate) {
     THROW_STD(invalid_argument,
       "AbstractBlobStore File: %s bad file header\n", fpath.c_str());
   }
-  const auto  header = reinterpret_cast<const FileHeaderBase*>(fmmap.base);
+  auto header = reinterpret_cast<const FileHeaderBase*>(fmmap.base);
   const auto& map = g_getFactroyMap();
   auto find = map.find(header->className);
   if (find != map.end()) {
@@ -98,6 +105,20 @@ AbstractBlobStore::load_from_mmap(fstring fpath, bool mmapPopulate) {
     fmmap.size = 0;
     store->m_isMmapData = true;
     store->m_isUserMem = true;
+    if (get_hugepage_load()) {
+      // data blocks stay in the file mapping
+      valvec<fstring> blocks = store->get_meta_blocks();
+      try {
+        HugepageCopy meta;
+        if (meta.copy(&blocks)) {
+          store->detach_meta_blocks(blocks);
+          store->m_hugepageMeta.swap(meta);
+        }
+      }
+      catch (const std::invalid_argument&) {
+        // detach_meta_blocks unsupported, keep using the file mapping
+      }
+    }
     return store.release();
   }
   else {
@@ -207,6 +228,7 @@ void AbstractBlobStore::risk_swap(AbstractBlobStore& y) {
 	std::swap(m_dictCloseType, y.m_dictCloseType);
 	std::swap(m_checksumLevel, y.m_checksumLevel);
 	std::swap(m_mmapBase     , y.m_mmapBase     );
+	m_hugepageMeta.swap(y.m_hugepageMeta);
     std::swap(m_get_record_append             , y.m_get_record_append             );
     std::swap(m_get_record_append_CacheOffsets, y.m_get_record_append_CacheOffsets);
     std::swap(m_fspread_record_append         , y.m_fspread_record_append         );
@@ -1,5 +1,6 @@
 #pragma once
 #include "blob_store.hpp"
+#include <terark/util/hugepage.hpp>
 
 namespace terark {
 
@@ -25,6 +26,7 @@ protected:
 	int             m_checksumLevel;
 	int             m_checksumType;
 	const struct FileHeaderBase* m_mmapBase;
+	HugepageCopy    m_hugepageMeta; // owns detached meta blocks
 
 	void risk_swap(AbstractBlobStore& y);
 
@@ -23,6 +23,7 @@ BlobStore::BlobStore() {
     m_mmap_aio = false;
     m_get_record_append = NULL;
     m_get_record_append_CacheOffsets = NULL;
+    m_get_record_view = NULL;
     m_fspread_record_append = NULL;
     m_pread_record_append = &BlobStore::pread_record_append_default_impl;
 }
@@ -163,6 +164,125 @@ struct BlobStoreLruCachePosRead {
     }
 };
 
+static void BlobStore_sort_ids(const size_t* ids, size_t n, valvec<size_t>* perm) {
+    perm->resize_no_init(n);
+    for (size_t i = 0; i < n; ++i) {
+        (*perm)[i] = i;
+    }
+    std::sort(perm->begin(), perm->end(), [ids](size_t x, size_t y) {
+        return ids[x] < ids[y] || (ids[x] == ids[y] && x < y);
+    });
+}
+
+void BlobStore::get_records(const size_t* ids, size_t n,
+                            valvec<byte_t>* recs)
+const {
+    valvec<size_t> perm;
+    BlobStore_sort_ids(ids, n, &perm);
+    if (is_offsets_zipped()) {
+        // sorted ids hit CacheOffsets, each offsets block is decoded once
+        CacheOffsets co;
+        for (size_t i = 0; i < n; ++i) {
+            size_t k = perm[i];
+            recs[k].erase_all();
+            co.recData.swap(recs[k]); // avoid copy
+            (this->*m_get_record_append_CacheOffsets)(ids[k], &co);
+            co.recData.swap(recs[k]);
+        }
+    }
+    else {
+        for (size_t i = 0; i < n; ++i) {
+            size_t k = perm[i];
+            recs[k].erase_all();
+            (this->*m_get_record_append)(ids[k], &recs[k]);
+        }
+    }
+}
+
+bool BlobStore::get_records_file_range(const size_t*, size_t, size_t*)
+const {
+    return false;
+}
+
+// serves fspread from a buffer which has been read by one pread
+struct BlobStoreRangePosRead {
+    const byte_t* data;
+    size_t offset;
+    size_t len;
+
+    static const byte_t*
+    read(void* lambda, size_t offset, size_t len, valvec<byte_t>*) {
+        auto self = (const BlobStoreRangePosRead*)lambda;
+        TERARK_VERIFY_F(offset >= self->offset &&
+                        offset + len <= self->offset + self->len,
+            "(%zd %zd) is out of range (%zd %zd)",
+            offset, len, self->offset, self->len);
+        return self->data + (offset - self->offset);
+    }
+};
+
+void BlobStore::pread_records(LruReadonlyCache* cache, intptr_t fd,
+                              size_t baseOffset,
+                              const size_t* ids, size_t n,
+                              valvec<byte_t>* recs)
+const {
+    // gap between records which is cheaper to read than a new pread
+    const size_t maxGap = 4096;
+    const size_t maxRunLen = 1 << 20;
+    valvec<size_t> perm;
+    BlobStore_sort_ids(ids, n, &perm);
+    valvec<size_t> sortedIds(n, valvec_no_init());
+    for (size_t i = 0; i < n; ++i) {
+        sortedIds[i] = ids[perm[i]];
+    }
+    valvec<size_t> ranges(2*n, valvec_no_init());
+    valvec<byte_t> rdbuf = tg_buf_pool.get();
+    TERARK_SCOPE_EXIT(tg_buf_pool.put(std::move(rdbuf)));
+    if (NULL == m_fspread_record_append ||
+            !get_records_file_range(sortedIds.data(), n, ranges.data())) {
+        for (size_t i = 0; i < n; ++i) {
+            size_t k = perm[i];
+            recs[k].erase_all();
+            pread_record_append(cache, fd, baseOffset, ids[k], &recs[k], &rdbuf);
+        }
+        return;
+    }
+    valvec<byte_t> recbuf; // for fspread_record_append, normally not used
+    for (size_t i = 0; i < n; ) {
+        size_t runBeg = ranges[2*i+0];
+        size_t runEnd = ranges[2*i+1];
+        size_t j = i + 1;
+        while (j < n && ranges[2*j+0] <= runEnd + maxGap &&
+                std::max(runEnd, ranges[2*j+1]) - runBeg <= maxRunLen) {
+            runEnd = std::max(runEnd, ranges[2*j+1]);
+            j++;
+        }
+        BlobStoreRangePosRead reader;
+        reader.offset = baseOffset + runBeg;
+        reader.len = runEnd - runBeg;
+        if (cache) { // fd is really fi for cache
+            LruReadonlyCache::Buffer b(&rdbuf);
+            reader.data = cache->pread(fd, reader.offset, reader.len, &b);
+            for (size_t l = i; l < j; ++l) {
+                size_t k = perm[l];
+                recs[k].erase_all();
+                (this->*m_fspread_record_append)(&BlobStoreRangePosRead::read,
+                    &reader, baseOffset, ids[k], &recs[k], &recbuf);
+            }
+        }
+        else {
+            reader.data = os_fspread((void*)fd, reader.offset, reader.len, &rdbuf);
+            for (size_t l = i; l < j; ++l) {
+                size_t k = perm[l];
+                recs[k].erase_all();
+                (this->*m_fspread_record_append)(&BlobStoreRangePosRead::read,
+                    &reader, baseOffset, ids[k], &recs[k], &recbuf);
+            }
+        }
+        i = j;
+    }
+}
+
 // default implementation just use get_record_append
 void BlobStore::pread_record_append_default_impl(
                     LruReadonlyCache* cache,
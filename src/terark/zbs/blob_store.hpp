@@ -60,6 +60,28 @@ public:
         return recData;
     }
 
+    /// true if records are stored verbatim and get_record_view is zero copy
+    bool support_get_record_view() const { return NULL != m_get_record_view; }
+
+    /// returns the record pointing into the store memory, it is valid as
+    /// long as the store, record level checksum is verified in place,
+    /// requires support_get_record_view()
+    terark_forceinline
+    fstring get_record_view(size_t recID) const {
+        assert(support_get_record_view());
+        return (this->*m_get_record_view)(recID);
+    }
+    /// zero copy if support_get_record_view(), else the record is copied
+    /// into *buf and the returned view points to buf
+    fstring get_record_view(size_t recID, valvec<byte_t>* buf) const {
+        if (m_get_record_view) {
+            return (this->*m_get_record_view)(recID);
+        }
+        buf->erase_all();
+        (this->*m_get_record_append)(recID, buf);
+        return fstring(buf->data(), buf->size());
+    }
+
     /// Used for optimizing Iterator
     struct CacheOffsets {
         valvec<byte_t> recData;
@@ -145,6 +167,25 @@ public:
         fspread_record_append(fspread, lambda, baseOffset, recID, recData);
     }
 
+    /// batch get_record: recs[i] is set to record ids[i], ids need not be
+    /// sorted or unique, they are sorted internally so records in a same
+    /// offsets block share block decoding
+    void get_records(const size_t* ids, size_t n, valvec<byte_t>* recs) const;
+
+    /// batch pread_record: records are read in ascending id order, records
+    /// whose data are adjacent(or nearly adjacent) in the file are read by
+    /// one pread, then decoded from the read buffer
+    void pread_records(LruReadonlyCache* cache, intptr_t fi,
+                       size_t baseOffset, const size_t* ids, size_t n,
+                       valvec<byte_t>* recs) const;
+
+    /// [ranges[2*i], ranges[2*i+1]) is the file range of record sortedIds[i],
+    /// relative to baseOffset of fspread_record_append
+    ///@returns false if the store can not locate records in the file, then
+    ///         pread_records will fall back to pread_record_append
+    virtual bool get_records_file_range(const size_t* sortedIds, size_t n,
+                                        size_t* ranges) const;
+
     bool is_mmap_aio() const { return m_mmap_aio; }
     void set_mmap_aio(bool mmap_aio) { m_mmap_aio = mmap_aio; }
 
@@ -163,6 +204,9 @@ protected:
     typedef void (BlobStore::*get_record_append_CacheOffsets_func_t)(size_t recID, CacheOffsets*) const;
     get_record_append_CacheOffsets_func_t m_get_record_append_CacheOffsets;
 
+    typedef fstring (BlobStore::*get_record_view_func_t)(size_t recID) const;
+    get_record_view_func_t m_get_record_view; // NULL if not zero copy
+
     typedef void (BlobStore::*fspread_record_append_func_t)(
                         pread_func_t,
                         void* lambdaObj,
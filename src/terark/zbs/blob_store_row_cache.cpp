@@ -0,0 +1,238 @@
+#include "blob_store_row_cache.hpp"
+#include "freq_sketch.hpp"
+#include <terark/gold_hash_map.hpp>
+#include <terark/util/throw.hpp>
+#include <boost/noncopyable.hpp>
+#include <mutex>
+
+namespace terark {
+
+static inline uint64_t RowKeyHash(const BlobStore* store, size_t recID) {
+    uint64_t x = uint64_t(size_t(store)) * 0x9E3779B97F4A7C15ULL ^ recID;
+    x = (x ^ (x >> 33)) * 0xff51afd7ed558ccdULL;
+    x = (x ^ (x >> 33)) * 0xc4ceb9fe1a85ec53ULL;
+    return x ^ (x >> 33);
+}
+
+class BlobStoreRowCache::Shard : boost::noncopyable {
+    struct Key {
+        const BlobStore* store;
+        size_t recID;
+        bool operator==(const Key& y) const {
+            return store == y.store && recID == y.recID;
+        }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& k) const {
+            return size_t(RowKeyHash(k.store, k.recID));
+        }
+    };
+    struct Node {
+        uint32_t len;
+        uint32_t ref; // clock reference bit, set by hit
+        byte_t*  data;
+    };
+    // hash node + link + bucket
+    static const size_t kEntryOverhead = sizeof(std::pair<Key, Node>) + 8;
+
+    std::mutex m_mutex;
+    gold_hash_map<Key, Node, KeyHash> m_map;
+    FreqSketch m_sketch;
+    bool       m_tinyLFU = false;
+    size_t     m_hand = 0; // clock hand, index into m_map
+    size_t     m_capacity = 0;
+    size_t     m_used = 0;
+    Stat       m_stat;
+    char       m_padding[64]; // avoid false sharing between shards
+
+    // hash node index of the clock victim, clears reference bits it passes
+    size_t clock_victim() {
+        assert(m_map.size() > 0);
+        for (size_t n = m_map.end_i();; m_hand++) {
+            if (m_hand >= n)
+                m_hand = 0;
+            if (m_map.is_deleted(m_hand))
+                continue;
+            Node& x = m_map.val(m_hand);
+            if (0 == x.ref)
+                return m_hand;
+            x.ref = 0;
+        }
+    }
+    void remove(size_t i) {
+        Node& x = m_map.val(i);
+        m_used -= x.len + kEntryOverhead;
+        free(x.data);
+        m_map.erase_i(i);
+    }
+public:
+    void init(size_t capacity, bool tinyLFU) {
+        m_map.enable_freelist(); // keep node index stable for clock hand
+        m_capacity = capacity;
+        m_tinyLFU = tinyLFU;
+        if (tinyLFU) {
+            m_sketch.init(capacity / 128); // assume 128 bytes per record
+        }
+    }
+    ~Shard() {
+        for (size_t i = 0, n = m_map.end_i(); i < n; ++i) {
+            if (!m_map.is_deleted(i))
+                free(m_map.val(i).data);
+        }
+    }
+    bool append_if_hit(const BlobStore* store, size_t recID, uint64_t h,
+                       valvec<byte_t>* recData) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_tinyLFU) {
+            m_sketch.increment(h);
+        }
+        size_t i = m_map.find_i(Key{store, recID});
+        if (m_map.end_i() == i) {
+            m_stat.miss++;
+            return false;
+        }
+        Node& x = m_map.val(i);
+        recData->append(x.data, x.len);
+        x.ref = 1;
+        m_stat.hit++;
+        return true;
+    }
+    void insert(const BlobStore* store, size_t recID, uint64_t h, fstring rec) {
+        size_t charge = rec.size() + kEntryOverhead;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (charge > m_capacity / 8) {
+            m_stat.rejected++; // too large, would flush many records
+            return;
+        }
+        Key key{store, recID};
+        if (m_map.find_i(key) != m_map.end_i()) {
+            return; // loaded by another thread
+        }
+        while (m_used + charge > m_capacity) {
+            size_t v = clock_victim();
+            if (m_tinyLFU) {
+                const Key& vk = m_map.key(v);
+                if (m_sketch.frequency(h) <= m_sketch.frequency(RowKeyHash(vk.store, vk.recID))) {
+                    m_stat.rejected++;
+                    return;
+                }
+            }
+            remove(v);
+            m_stat.evicted++;
+        }
+        byte_t* data = (byte_t*)malloc(rec.size() + 1);
+        if (NULL == data) {
+            throw std::bad_alloc();
+        }
+        memcpy(data, rec.data(), rec.size());
+        size_t i = m_map.insert_i(key).first;
+        Node& x = m_map.val(i);
+        x.len = uint32_t(rec.size());
+        x.ref = 0;
+        x.data = data;
+        m_used += charge;
+    }
+    void erase(const BlobStore* store, size_t recID) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        size_t i = m_map.find_i(Key{store, recID});
+        if (m_map.end_i() != i) {
+            remove(i);
+        }
+    }
+    void erase_store(const BlobStore* store) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (size_t i = 0, n = m_map.end_i(); i < n; ++i) {
+            if (!m_map.is_deleted(i) && m_map.key(i).store == store) {
+                remove(i);
+            }
+        }
+    }
+    void add_stat(Stat* st) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        st->hit += m_stat.hit;
+        st->miss += m_stat.miss;
+        st->rejected += m_stat.rejected;
+        st->evicted += m_stat.evicted;
+        st->entries += m_map.size();
+        st->usedBytes += m_used;
+    }
+};
+
+BlobStoreRowCache::BlobStoreRowCache(size_t capacityBytes, size_t shards, bool tinyLFU) {
+    m_shardNum = std::max<size_t>(shards, 1);
+    m_shards.reset(new Shard[m_shardNum]);
+    for (size_t i = 0; i < m_shardNum; ++i) {
+        m_shards[i].init(capacityBytes / m_shardNum, tinyLFU);
+    }
+}
+
+BlobStoreRowCache::~BlobStoreRowCache() {
+}
+
+inline BlobStoreRowCache::Shard&
+BlobStoreRowCache::get_shard(const BlobStore* store, size_t recID, uint64_t* hash) const {
+    uint64_t h = RowKeyHash(store, recID);
+    *hash = h;
+    // gold_hash_map uses low bits of the hash, shards use high bits
+    return m_shards[size_t(h >> 32) % m_shardNum];
+}
+
+void BlobStoreRowCache::get_record_append(const BlobStore* store, size_t recID,
+                                          valvec<byte_t>* recData) {
+    uint64_t h;
+    Shard& shard = get_shard(store, recID, &h);
+    if (shard.append_if_hit(store, recID, h, recData)) {
+        return;
+    }
+    size_t oldsize = recData->size();
+    store->get_record_append(recID, recData);
+    shard.insert(store, recID, h, fstring(recData->data() + oldsize,
+                                          recData->size() - oldsize));
+}
+
+void BlobStoreRowCache::pread_record_append(const BlobStore* store,
+                                            LruReadonlyCache* cache, intptr_t fi,
+                                            size_t baseOffset, size_t recID,
+                                            valvec<byte_t>* recData) {
+    uint64_t h;
+    Shard& shard = get_shard(store, recID, &h);
+    if (shard.append_if_hit(store, recID, h, recData)) {
+        return;
+    }
+    size_t oldsize = recData->size();
+    store->pread_record_append(cache, fi, baseOffset, recID, recData);
+    shard.insert(store, recID, h, fstring(recData->data() + oldsize,
+                                          recData->size() - oldsize));
+}
+
+void BlobStoreRowCache::erase(const BlobStore* store, size_t recID) {
+    uint64_t h;
+    get_shard(store, recID, &h).erase(store, recID);
+}
+
+void BlobStoreRowCache::erase_store(const BlobStore* store) {
+    for (size_t i = 0; i < m_shardNum; ++i) {
+        m_shards[i].erase_store(store);
+    }
+}
+
+BlobStoreRowCache::Stat BlobStoreRowCache::get_stat() const {
+    Stat st;
+    for (size_t i = 0; i < m_shardNum; ++i) {
+        m_shards[i].add_stat(&st);
+    }
+    return st;
+}
+
+void BlobStoreRowCache::print_stat_cnt(FILE* fp) const {
+    Stat st = get_stat();
+    size_t sum = std::max<size_t>(st.hit + st.miss, 1);
+    fprintf(fp, "%-15s : %12zd, %7.3f\n", "hit", st.hit, st.hit/double(sum));
+    fprintf(fp, "%-15s : %12zd, %7.3f\n", "miss", st.miss, st.miss/double(sum));
+    fprintf(fp, "%-15s : %12zd\n", "rejected", st.rejected);
+    fprintf(fp, "%-15s : %12zd\n", "evicted", st.evicted);
+    fprintf(fp, "%-15s : %12zd\n", "entries", st.entries);
+    fprintf(fp, "%-15s : %12zd\n", "usedBytes", st.usedBytes);
+}
+
+} // namespace terark
@@ -0,0 +1,55 @@
+#pragma once
+#include "blob_store.hpp"
+#include <memory>
+#include <stdio.h>
+
+namespace terark {
+
+/// Cache of decoded records in front of any BlobStore, keyed by
+/// (store, recID). Keys are hashed to shards, each shard has its own mutex,
+/// byte budget and CLOCK replacement, a hit is a hash lookup plus memcpy
+/// and only sets the reference bit of the record.
+/// With tinyLFU, a missed record is admitted only if it is more frequent
+/// than the victims it would evict, thus scans do not flush hot records.
+/// Records are keyed by store address, erase_store() must be called before
+/// a cached store is destroyed.
+class TERARK_DLL_EXPORT BlobStoreRowCache : public RefCounter {
+    class Shard;
+    std::unique_ptr<Shard[]> m_shards;
+    size_t m_shardNum;
+    Shard& get_shard(const BlobStore*, size_t recID, uint64_t* hash) const;
+public:
+    struct Stat {
+        size_t hit = 0;
+        size_t miss = 0;
+        size_t rejected = 0; // refused by tinyLFU admission or too large
+        size_t evicted = 0;
+        size_t entries = 0;
+        size_t usedBytes = 0;
+    };
+    BlobStoreRowCache(size_t capacityBytes, size_t shards, bool tinyLFU = false);
+    ~BlobStoreRowCache() override;
+
+    void get_record_append(const BlobStore*, size_t recID, valvec<byte_t>* recData);
+    void get_record(const BlobStore* store, size_t recID, valvec<byte_t>* recData) {
+        recData->erase_all();
+        get_record_append(store, recID, recData);
+    }
+    void pread_record_append(const BlobStore*, LruReadonlyCache*, intptr_t fi,
+                             size_t baseOffset, size_t recID,
+                             valvec<byte_t>* recData);
+    void pread_record(const BlobStore* store, LruReadonlyCache* cache,
+                      intptr_t fi, size_t baseOffset, size_t recID,
+                      valvec<byte_t>* recData) {
+        recData->erase_all();
+        pread_record_append(store, cache, fi, baseOffset, recID, recData);
+    }
+
+    void erase(const BlobStore*, size_t recID);
+    void erase_store(const BlobStore*);
+
+    Stat get_stat() const;
+    void print_stat_cnt(FILE*) const;
+};
+
+} // namespace terark
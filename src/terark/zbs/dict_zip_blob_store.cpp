@@ -19,6 +19,7 @@
 #include <terark/thread/pipeline.hpp>
 #include <terark/thread/fiber_aio.hpp>
 #include <terark/util/crc.hpp>
+#include <terark/util/cpu_features.hpp>
 #include <terark/util/profiling.hpp>
 #include <terark/util/sortable_strvec.hpp>
 #include <terark/util/sorted_uint_vec.hpp>
@@ -167,6 +168,7 @@ void DictZipBlobStore::init() {
     m_reserveOutputMultiplier = 5;
 	m_globalEntropyTableObject = NULL;
     m_huffman_decoder = NULL;
+    m_huffman_compact = NULL;
 	m_isNewRefEncoding = true;
 	new(&m_offsets)UintVecMin0();
     m_gOffsetBits = 0;
@@ -187,6 +189,7 @@ void DictZipBlobStore::swap(DictZipBlobStore& y) {
     std::swap(m_reserveOutputMultiplier, y.m_reserveOutputMultiplier);
 	std::swap(m_globalEntropyTableObject, y.m_globalEntropyTableObject);
     std::swap(m_huffman_decoder, y.m_huffman_decoder);
+    std::swap(m_huffman_compact, y.m_huffman_compact);
 	std::swap(m_entropyAlgo, y.m_entropyAlgo);
 	std::swap(m_isNewRefEncoding, y.m_isNewRefEncoding);
     std::swap(m_entropyInterleaved, y.m_entropyInterleaved);
@@ -459,12 +462,13 @@ void DictZipBlobStoreBuilder::prepareDict() {
 		case Options::kSortRight: dictSortRight(); break;
 		case Options::kSortBoth : dictSortBoth (); break;
 		}
+		size_t numThreads = std::max(m_opt.dictBuildThreads, 1);
 		m_dict.reset(new SuffixDictCacheDFA());
 		//m_dict.reset(new HashSuffixDictCacheDFA()); // :( much slower
-		m_dict->build_sa(m_strDict);
+		m_dict->build_sa(m_strDict, numThreads);
 		size_t minFreq = m_strDict.size() < (1ul << 30) ? 15 : 31;
 		//size_t minFreq = 32*1024; // for benchmark pure suffix array match
-		m_dict->bfs_build_cache(minFreq, 64);
+		m_dict->bfs_build_cache(minFreq, 64, numThreads);
 	}
 }
 
@@ -595,6 +599,7 @@ static int& g_zipThreads() {
 static bool g_isPipelineStarted = false;
 
 static int g_pipelineLogLevel = (int)getEnvLong("DictZipBlobStore_pipelineLogLevel", 1);
+static size_t g_maxInflightBytes = (size_t)getEnvLong("DictZipBlobStore_maxInflightBytes", 0);
 static bool g_printEntropyCount = getEnvBool("DictZipBlobStore_printEntropyCount", false);
 
 TERARK_DLL_EXPORT void DictZipBlobStore_setZipThreads(int zipThreads) {
@@ -607,6 +612,17 @@ TERARK_DLL_EXPORT void DictZipBlobStore_setZipThreads(int zipThreads) {
 	}
 }
 
+/// bound memory of the batches being compressed, 0 means no bound
+TERARK_DLL_EXPORT void DictZipBlobStore_setMaxInflightBytes(size_t bytes) {
+	if (g_isPipelineStarted) {
+		fprintf(stderr,
+			"WARN: DictZipBlobStore pipeline has started, can not change maxInflightBytes\n");
+	}
+	else {
+		g_maxInflightBytes = bytes;
+	}
+}
+
 TERARK_DLL_EXPORT void DictZipBlobStore_setPipelineLogLevel(int level) {
   if (g_isPipelineStarted) {
     fprintf(stderr,
@@ -658,6 +674,11 @@ class DictZipBlobStoreBuilder::MultiThread : public DictZipBlobStoreBuilder {
 		    return fstring(ibuf.data() + off0, off1 - off0);
 		}
 		uint32_t* entropyBitmap() { return offsets + cap + 1; }
+		// input, output is about the same size, plus offsets & bitmap
+		void setPipelineBytes() {
+			size_t ibytes = builder->m_opt.inputIsPerm ? 0 : ibuf.capacity();
+			plbytes = ibytes + ibuf.size() + sizeof(MyTask) + 4*cap;
+		}
 	};
 	class MyZipStage : public PipelineStage {
 	public:
@@ -687,6 +708,7 @@ class DictZipBlobStoreBuilder::MultiThread : public DictZipBlobStoreBuilder {
 			}
 			this->setLogLevel(g_pipelineLogLevel);
 			this->setQueueSize(8*zipThreads);
+			this->setMaxInflightBytes(g_maxInflightBytes);
 			this->add_step(new MyZipStage(zipThreads));
 			this->add_step(new MyWriteStage());
 			this->compile();
@@ -724,6 +746,7 @@ class DictZipBlobStoreBuilder::MultiThread : public DictZipBlobStoreBuilder {
 	MyPipeline* m_pipeline;
 	valvec<MyTask*> m_lake;
 	size_t m_lakeBytes = 0;
+	size_t m_lakeMaxBytes;
 
 public:
 	explicit MultiThread(const DictZipBlobStore::Options& opt)
@@ -733,8 +756,17 @@ public:
 		if (opt.enableLake) {
 			m_lake.reserve(m_pipeline->getQueueSize());
 		}
+		m_lakeMaxBytes = m_pipeline->zipThreads * 1024 * 1024;
+		if (size_t budget = m_pipeline->getMaxInflightBytes()) {
+			// a lake larger than half of the budget makes enqueue wait
+			// for the whole previous lake
+			m_lakeMaxBytes = std::min(m_lakeMaxBytes, budget / 2);
+		}
 	}
 	void finishZip() override {
+		if (m_curTask && m_curTask->num) {
+			m_curTask->setPipelineBytes();
+		}
 		if (m_opt.enableLake) {
 			if (m_curTask && m_curTask->num) {
 				m_lake.push_back(m_curTask);
@@ -811,7 +843,6 @@ public:
 
     terark_forceinline
     MyTask* getTask(const byte* rData, size_t rSize) {
-	    const size_t lake_MAX_BYTES = m_pipeline->zipThreads * 1024 * 1024;
 		MyTask* task = m_curTask;
         assert(!task || task->num <= task->cap);
         if (terark_unlikely(!task)) {
@@ -820,8 +851,9 @@ public:
 		else if (task->num == task->cap ||
                     (task->num && task->ibuf.unused() < rSize)) {
             TERARK_ASSERT_EQ(task->offsets[task->num], task->ibuf.size());
+            task->setPipelineBytes();
 			if (m_opt.enableLake) {
-				if (m_lake.full() || m_lakeBytes >= lake_MAX_BYTES) {
+				if (m_lake.full() || m_lakeBytes >= m_lakeMaxBytes) {
 					drainLake();
 				}
 				m_lakeBytes += task->ibuf.size();
@@ -1315,6 +1347,7 @@ DictZipBlobStore::Options::Options() {
 	useNewRefEncoding = true;
 	compressGlobalDict = false;
     entropyInterleaved = (uint8_t)getEnvLong("Entropy_interleaved", 8);
+    entropyTableCompact = getEnvBool("Entropy_tableCompact", false);
 	offsetArrayBlockUnits = 0; // default use UintVecMin0
     entropyZipRatioRequire = (float)getEnvDouble("Entropy_zipRatioRequire", 0.92);
     embeddedDict = false;
@@ -1325,6 +1358,7 @@ DictZipBlobStore::Options::Options() {
     // the real max is greater or equal than recordsPerBatch
     recordsPerBatch = getEnvLong("DictZipBlobStore_recordsPerBatch", 500);
     bytesPerBatch = getEnvLong("DictZipBlobStore_bytesPerBatch", 256*1024);
+    dictBuildThreads = (int)getEnvLong("DictZipBlobStore_dictBuildThreads", 1);
 }
 
 DictZipBlobStore::ZipStat::ZipStat() {
@@ -1425,7 +1459,8 @@ struct DictZipBlobStore::FileHeader : public FileHeaderBase {
 	uint08_t entropyAlgo;
 	uint08_t isNewRefEncoding : 1;
 	uint08_t entropyTableNoCompress : 1;
-	uint08_t pad1 : 2;
+	uint08_t entropyTableCompact : 1; // Huffman::decoder_o1_compact
+	uint08_t pad1 : 1;
 	uint08_t zipOffsets_log2_blockUnits : 4; // 6 or 7
 	uint32_t entropyTableCRC;
 	uint64_t dictXXHash;
@@ -1477,7 +1512,8 @@ struct DictZipBlobStore::FileHeader : public FileHeaderBase {
 
 	FileHeader(const DictZipBlobStore* store, size_t zipDataSize1, Dictionary dict
              , const UintVecMin0& offsets, fstring entropyBitmap, fstring entropyTab
-             , uint08_t _entropyTableNoCompress, size_t maxOffsetEnt) {
+             , uint08_t _entropyTableNoCompress, uint08_t _entropyTableCompact
+             , size_t maxOffsetEnt) {
 		assert(dict.memory.size() > 0);
 		assert(dict.verified);
 		memset(this, 0, sizeof(*this));
@@ -1494,6 +1530,7 @@ struct DictZipBlobStore::FileHeader : public FileHeaderBase {
 		entropyAlgo = byte_t(store->m_entropyAlgo);
 		isNewRefEncoding = 1; // now always 1
         entropyTableNoCompress = _entropyTableNoCompress;
+        entropyTableCompact = _entropyTableCompact;
 		globalDictSize = dict.memory.size();
 		dictXXHash = dict.xxhash;
 		patchCRC(offsets, entropyBitmap, entropyTab, maxOffsetEnt);
@@ -1538,6 +1575,7 @@ void DictZipBlobStore::destroyMe() {
         m_strDict.risk_release_ownership();
         m_offsets.risk_release_ownership();
         m_huffman_decoder = nullptr;
+        m_huffman_compact = nullptr;
     }
     switch (m_dictCloseType) {
     case MemoryCloseType::Clear:
@@ -1551,12 +1589,14 @@ void DictZipBlobStore::destroyMe() {
         break;
     }
     m_dictCloseType = MemoryCloseType::Clear;
-    if (m_huffman_decoder) {
+    if (m_huffman_decoder || m_huffman_compact) {
         auto mmapBase = (const FileHeader*)m_mmapBase;
         if(!mmapBase || !mmapBase->entropyTableNoCompress) {
             delete m_huffman_decoder;
+            delete m_huffman_compact;
         }
         m_huffman_decoder = nullptr;
+        m_huffman_compact = nullptr;
     }
     if (m_isUserMem) {
         if (m_isMmapData) {
@@ -1853,7 +1893,15 @@ void DictZipBlobStoreBuilder::entropyStore(std::unique_ptr<terark::DictZipBlobSt
             m_huffman_encoder = new Huffman::encoder_o1(m_freq_hist->histogram());
 
             // assert(m_entropyTableData.size()==0);
-            if (!m_opt.compressGlobalDict) {
+            if (!m_opt.compressGlobalDict && m_opt.entropyTableCompact) {
+                // reset entropyTableData from Ctable to compact Dtable
+                m_entropyTableData.ensure_capacity(sizeof(Huffman::decoder_o1_compact));
+                new (m_entropyTableData.data()) Huffman::decoder_o1_compact(
+                                                    fstring(m_huffman_encoder->table().data(),
+                                                        m_huffman_encoder->table().size()));
+                m_entropyTableData.risk_set_size(sizeof(Huffman::decoder_o1_compact));
+            }
+            else if (!m_opt.compressGlobalDict) {
                 // reset entropyTableData from Ctable to Dtable
                 m_entropyTableData.ensure_capacity(sizeof(Huffman::decoder_o1));
                 new (m_entropyTableData.data()) Huffman::decoder_o1(
@@ -2037,6 +2085,8 @@ void DictZipBlobStoreBuilder::entropyStore(std::unique_ptr<terark::DictZipBlobSt
     hp->offsetsUintBits = zoffsets.uintbits();
     hp->entropyAlgo = byte(m_opt.entropyAlgo);
     hp->entropyTableNoCompress = !m_opt.compressGlobalDict;
+    hp->entropyTableCompact = m_opt.entropyAlgo == Options::kHuffmanO1 &&
+                              m_opt.entropyTableCompact;
     // febitvec
     //
     hp->entropyTableSize = m_entropyTableData.size();
@@ -2398,7 +2448,16 @@ void DictZipBlobStore::setDataMemory(const void* base, size_t size) {
                 THROW_STD(logic_error, "bad m_entropyInterleaved = %d"
                     , m_entropyInterleaved);
             }
-            if (!mmapBase->entropyTableNoCompress) {
+            if (mmapBase->entropyTableCompact) {
+                if (!mmapBase->entropyTableNoCompress) {
+                    m_huffman_compact = new Huffman::decoder_o1_compact(fstring(mem, len));
+                }
+                else {
+                    TERARK_VERIFY_EQ(len, sizeof(Huffman::decoder_o1_compact));
+                    m_huffman_compact = reinterpret_cast<const Huffman::decoder_o1_compact*>(mem);
+                }
+            }
+            else if (!mmapBase->entropyTableNoCompress) {
                 m_huffman_decoder = new Huffman::decoder_o1(fstring(mem, len));
             }
             else {
@@ -2493,6 +2552,11 @@ void DictZipBlobStore::get_meta_blocks(valvec<fstring>* blocks) const {
                 reinterpret_cast<const char*>(m_huffman_decoder),
                 sizeof(Huffman::decoder_o1));
     }
+    else if (m_huffman_compact) {
+        blocks->emplace_back(
+                reinterpret_cast<const char*>(m_huffman_compact),
+                sizeof(Huffman::decoder_o1_compact));
+    }
 }
 
 void DictZipBlobStore::get_data_blocks(valvec<fstring>* blocks) const {
@@ -2510,14 +2574,21 @@ void DictZipBlobStore::detach_meta_blocks(const valvec<fstring>& blocks) {
     }
     else {
         TERARK_VERIFY_EQ(blocks.size(), 3);
-        TERARK_VERIFY(m_huffman_decoder != nullptr);
+        TERARK_VERIFY(m_huffman_decoder != nullptr || m_huffman_compact != nullptr);
         auto mmapBase = (const FileHeader*)m_mmapBase;
         if(!mmapBase || !mmapBase->entropyTableNoCompress) {
             delete m_huffman_decoder;
+            delete m_huffman_compact;
         }
         offset_mem = blocks[1];
-        m_huffman_decoder =
-            reinterpret_cast<const Huffman::decoder_o1*>(blocks.back().data());
+        if (m_huffman_compact) {
+            TERARK_VERIFY_EQ(blocks.back().size(), sizeof(Huffman::decoder_o1_compact));
+            m_huffman_compact =
+                reinterpret_cast<const Huffman::decoder_o1_compact*>(blocks.back().data());
+        } else {
+            m_huffman_decoder =
+                reinterpret_cast<const Huffman::decoder_o1*>(blocks.back().data());
+        }
     }
     TERARK_VERIFY_EQ(dict_mem.size(), m_strDict.size());
     TERARK_VERIFY_EQ(offset_mem.size(), m_offsets.mem_size());
@@ -2578,6 +2649,25 @@ size_t DictZipBlobStore::mem_size() const {
     return m_strDict.size() + m_offsets.mem_size() + m_ptrList.size();
 }
 
+bool
+DictZipBlobStore::get_records_file_range(const size_t* sortedIds, size_t n,
+										 size_t* ranges)
+const {
+	if (offsetsIsSortedUintVec()) {
+		m_zOffsets.get2_sorted(sortedIds, n, ranges);
+	}
+	else {
+		for (size_t i = 0; i < n; ++i) {
+			assert(sortedIds[i] + 1 < m_offsets.size());
+			m_offsets.get2(sortedIds[i], ranges + 2*i);
+		}
+	}
+	for (size_t i = 0; i < 2*n; ++i) {
+		ranges[i] += sizeof(FileHeader);
+	}
+	return true;
+}
+
 static inline void CopyForward(const byte* src, byte* op, size_t len) {
     assert(len > 0);
     do {
@@ -2679,8 +2769,7 @@ DictZipBlobStore::fspread_record_append_tpl(pread_func_t fspread,
                                             valvec<byte_t>* rdbuf)
 const {
     auto readRaw = [=](size_t offset, size_t zipLen) {
-        fspread(lambda, baseOffset + offset, zipLen, rdbuf);
-        return rdbuf->data();
+        return fspread(lambda, baseOffset + offset, zipLen, rdbuf);
     };
     read_record_append_tpl<ZipOffset, CheckSumLevel,
         Entropy, EntropyInterLeave>(recID, recData, readRaw);
@@ -2697,6 +2786,104 @@ UpdateOutputPtrAfterGrowCapacity(valvec<byte_t>* buf, size_t len, byte_t*& outpu
 
 TERARK_IF_DEBUG(static thread_local size_t tg_dicLen = 0,);
 
+// wide copy kernels for DoUnzipSimd*, selected at runtime by cpu_features()
+#if defined(TERARK_TARGET_DISPATCH)
+
+/// no access beyond [src, src+len) and [dst, dst+len), overlapping
+/// tails are used instead of byte loops.
+/// requires [src, src+len) and [dst, dst+len) are disjoint,
+/// or it is a lz77 copy and dst - src >= 32
+static inline TERARK_TARGET("avx2")
+void DzCopyAvx2(byte_t* dst, const byte_t* src, size_t len) {
+    typedef uint64_t By8 TERARK_GNU_UNALIGNED;
+    typedef uint32_t By4 TERARK_GNU_UNALIGNED;
+    if (len >= 32) {
+        for (size_t i = 0; i + 32 < len; i += 32) {
+            __m256i x = _mm256_loadu_si256((const __m256i*)(src + i));
+            _mm256_storeu_si256((__m256i*)(dst + i), x);
+        }
+        __m256i t = _mm256_loadu_si256((const __m256i*)(src + len - 32));
+        _mm256_storeu_si256((__m256i*)(dst + len - 32), t);
+    }
+    else if (len >= 16) {
+        __m128i h = _mm_loadu_si128((const __m128i*)(src));
+        __m128i t = _mm_loadu_si128((const __m128i*)(src + len - 16));
+        _mm_storeu_si128((__m128i*)(dst), h);
+        _mm_storeu_si128((__m128i*)(dst + len - 16), t);
+    }
+    else if (len >= 8) {
+        uint64_t h = *(const By8*)(src);
+        uint64_t t = *(const By8*)(src + len - 8);
+        *(By8*)(dst) = h;
+        *(By8*)(dst + len - 8) = t;
+    }
+    else if (len >= 4) {
+        uint32_t h = *(const By4*)(src);
+        uint32_t t = *(const By4*)(src + len - 4);
+        *(By4*)(dst) = h;
+        *(By4*)(dst + len - 4) = t;
+    }
+    else if (len) {
+        byte_t h = src[0], m = src[len/2], t = src[len-1];
+        dst[0] = h; dst[len/2] = m; dst[len-1] = t;
+    }
+}
+
+/// lz77 copy, src < dst, dst may be less than src + len,
+/// requires 32 bytes writable slack after dst + len
+static inline TERARK_TARGET("avx2")
+void DzCopyForwardAvx2(const byte_t* src, byte_t* dst, size_t len) {
+    typedef uint64_t By8 TERARK_GNU_UNALIGNED;
+    size_t distance = dst - src;
+    if (terark_likely(distance >= 32 || distance >= len)) {
+        DzCopyAvx2(dst, src, len);
+    }
+    else if (distance >= 8) {
+        for (size_t i = 0; i < len; i += 8) {
+            *(By8*)(dst + i) = *(const By8*)(src + i);
+        }
+    }
+    else {
+        CopyForward(src, dst, len);
+    }
+}
+
+/// len <= 64, requires 32 bytes writable slack after dst + len
+static inline TERARK_TARGET("avx2")
+void DzFillAvx2(byte_t* dst, byte_t ch, size_t len) {
+    assert(len <= 64);
+    __m256i x = _mm256_set1_epi8(char(ch));
+    _mm256_storeu_si256((__m256i*)(dst), x);
+    if (len > 32)
+        _mm256_storeu_si256((__m256i*)(dst + 32), x);
+}
+
+/// same as DzCopyAvx2, but the tail is copied by masked load and store
+static inline TERARK_TARGET("avx2,bmi2,avx512f,avx512bw,avx512vl")
+void DzCopyAvx512(byte_t* dst, const byte_t* src, size_t len) {
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(src + i));
+        _mm256_storeu_si256((__m256i*)(dst + i), x);
+    }
+    __mmask32 k = _bzhi_u32(uint32_t(-1), uint32_t(len - i));
+    __m256i t = _mm256_maskz_loadu_epi8(k, src + i);
+    _mm256_mask_storeu_epi8(dst + i, k, t);
+}
+
+static inline TERARK_TARGET("avx2,bmi2,avx512f,avx512bw,avx512vl")
+void DzCopyForwardAvx512(const byte_t* src, byte_t* dst, size_t len) {
+    size_t distance = dst - src;
+    if (terark_likely(distance >= 32 || distance >= len)) {
+        DzCopyAvx512(dst, src, len);
+    }
+    else {
+        DzCopyForwardAvx2(src, dst, len);
+    }
+}
+#endif // TERARK_TARGET_DISPATCH
+
+
 #define DoUnzipFuncName DoUnzipSwitchAutoGrow
 #define UnzipUseThreading  0
 #define UnzipReserveBuffer 0
@@ -2738,16 +2925,59 @@ TERARK_IF_DEBUG(static thread_local size_t tg_dicLen = 0,);
 #define UnzipDelayGlobalMatch 1
 #include "dict_zip_blob_store_unzip_func.hpp"
 
-static int const DefaultUnzipImp = 1; // DoUnzipSwitchPreserve
+#if defined(TERARK_TARGET_DISPATCH)
+#define DoUnzipFuncName DoUnzipSimdAvx2
+#define UnzipUseThreading  1
+#define UnzipReserveBuffer 1
+#define UnzipDelayGlobalMatch 0
+#define UnzipWideCopy 1
+#include "dict_zip_blob_store_unzip_func.hpp"
+
+#define DoUnzipFuncName DoUnzipSimdAvx512
+#define UnzipUseThreading  1
+#define UnzipReserveBuffer 1
+#define UnzipDelayGlobalMatch 0
+#define UnzipWideCopy 2
+#include "dict_zip_blob_store_unzip_func.hpp"
+#else
+#define DoUnzipSimdAvx2   DoUnzipThreadPreserve
+#define DoUnzipSimdAvx512 DoUnzipThreadPreserve
+#endif
+
+static bool is_UnzipImp_supported(int val) {
+#if defined(TERARK_TARGET_DISPATCH)
+	const CpuFeatures& cpu = cpu_features();
+	switch (val) {
+	case 6: return cpu.avx2;
+	case 7: return cpu.avx2 && cpu.bmi2 && cpu.avx512bw && cpu.avx512vl;
+	}
+#endif
+	return val >= 0 && val <= 5;
+}
 static int init_get_UnzipImp() {
+	// 6: DoUnzipSimdAvx2, 1: DoUnzipSwitchPreserve
+	// 7 (DoUnzipSimdAvx512) is opt-in: masked tails are not faster than
+	// overlapped avx2 tails on typical records, and zmm may downclock
+	int DefaultUnzipImp = is_UnzipImp_supported(6) ? 6 : 1;
 	int val = (int)getEnvLong("TerarkDictZipUnzipImp", DefaultUnzipImp);
-	if (val < 0 || val > 5) {
+	if (!is_UnzipImp_supported(val)) {
 		val = DefaultUnzipImp;
 	}
-//	fprintf(stderr, "TerarkDictZipUnzipImp=%d\n", val);
 	return val;
 }
-static const int g_DictZipUnzipImp = init_get_UnzipImp();
+// relaxed: each store picks its kernels by the value seen in set_func_ptr
+static std::atomic<int> g_DictZipUnzipImp(init_get_UnzipImp());
+
+bool DictZipBlobStore::setUnzipImp(int imp) {
+	if (!is_UnzipImp_supported(imp)) {
+		return false;
+	}
+	g_DictZipUnzipImp.store(imp, std::memory_order_relaxed);
+	return true;
+}
+int DictZipBlobStore::getUnzipImp() {
+	return g_DictZipUnzipImp.load(std::memory_order_relaxed);
+}
 
 #if defined(DEBUG_CHECK_UNZIP)
 template<int gOffsetBytes>
@@ -2763,10 +2993,13 @@ DoUnzipImp(const byte_t* pos, const byte_t* end, valvec<byte_t>* recData,
         &DoUnzipThreadPreserve<gOffsetBytes>, // 3, // 0b11
         &DoUnzipDelayGAutoGrow<gOffsetBytes>, // 4, // 0100
         &DoUnzipDelayGPreserve<gOffsetBytes>, // 5, // 0101
+        &DoUnzipSimdAvx2      <gOffsetBytes>, // 6, // 0110
+        &DoUnzipSimdAvx512    <gOffsetBytes>, // 7, // 0111
     };
-    assert(int(g_DictZipUnzipImp) >= 0 && int(g_DictZipUnzipImp) <= 5);
-    tab[g_DictZipUnzipImp](pos, end, recData, dic,
-                           gOffsetBits, reserveOutputMultiplier);
+    int imp = g_DictZipUnzipImp.load(std::memory_order_relaxed);
+    assert(imp >= 0 && imp <= 7);
+    tab[imp](pos, end, recData, dic,
+             gOffsetBits, reserveOutputMultiplier);
 }
 
 static inline void
@@ -2808,6 +3041,8 @@ GenDoUnzipHelper(3, DoUnzipThreadPreserve);
 #endif
 GenDoUnzipHelper(4, DoUnzipDelayGAutoGrow);
 GenDoUnzipHelper(5, DoUnzipDelayGPreserve);
+GenDoUnzipHelper(6, DoUnzipSimdAvx2);
+GenDoUnzipHelper(7, DoUnzipSimdAvx512);
 
 template<DictZipBlobStore::EntropyAlgo Entropy, int EntropyInterLeave>
 terark_no_inline void
@@ -2822,7 +3057,16 @@ const {
         data.ensure_capacity((zlen + 1024) * 4);
         if (Entropy == Options::kHuffmanO1) {
             bool success = false;
-            switch (EntropyInterLeave) {
+            if (m_huffman_compact) {
+                switch (EntropyInterLeave) {
+                case 1: success = m_huffman_compact->decode_x1(fstring(zpos, zlen), &data, ctx); break;
+                case 2: success = m_huffman_compact->decode_x2(fstring(zpos, zlen), &data, ctx); break;
+                case 4: success = m_huffman_compact->decode_x4(fstring(zpos, zlen), &data, ctx); break;
+                case 8: success = m_huffman_compact->decode_x8(fstring(zpos, zlen), &data, ctx); break;
+                default: success = false; break;
+                }
+            }
+            else switch (EntropyInterLeave) {
             case 1: success = m_huffman_decoder->decode_x1(fstring(zpos, zlen), &data, ctx); break;
             case 2: success = m_huffman_decoder->decode_x2(fstring(zpos, zlen), &data, ctx); break;
             case 4: success = m_huffman_decoder->decode_x4(fstring(zpos, zlen), &data, ctx); break;
@@ -2986,10 +3230,11 @@ ZipOffset                                                         \
 #define TemplateArgsAre(a, b) \
     a == ZipOffset && b == ChecksumLevel
 
-  assert(int(g_DictZipUnzipImp) >= 0 && int(g_DictZipUnzipImp) <= 5);
+  const int  UnzipImp = g_DictZipUnzipImp.load(std::memory_order_relaxed);
+  assert(UnzipImp >= 0 && UnzipImp <= 7);
   const bool ZipOffset = offsetsIsSortedUintVec();
   const int  ChecksumLevel = 2 == m_checksumLevel ? 2 : 0; // non-2 as 0
-  const int  UnzipPolicy = std::min(g_DictZipUnzipImp&7,5);//tolerate bad value
+  const int  UnzipPolicy = UnzipImp & 7; // checked by is_UnzipImp_supported
   const int  gOffsetBytes = m_gOffsetBits <= 24 ? 3 : 4;
   const int  EI = m_entropyInterleaved;
 
@@ -3011,6 +3256,10 @@ ZipOffset                                                         \
      case_UnzipID(4, 4);
      case_UnzipID(5, 3);
      case_UnzipID(5, 4);
+     case_UnzipID(6, 3);
+     case_UnzipID(6, 4);
+     case_UnzipID(7, 3);
+     case_UnzipID(7, 4);
      default: assert(false); abort(); break;
   }
 
@@ -3106,7 +3355,7 @@ const {
     }
     if (isOffsetsZipped) {
         auto zipOffsetBuilder = std::unique_ptr<SortedUintVec::Builder>(
-            SortedUintVec::createBuilder(m_zOffsets.block_units(), tmpFile.c_str()));
+            SortedUintVec::createBuilder(m_zOffsets.build_units(), tmpFile.c_str()));
         for(assert(newToOld.size() == recNum); !newToOld.eof(); ++newToOld) {
             size_t newId = newToOld.index();
             size_t oldId = *newToOld;
@@ -3176,7 +3425,8 @@ const {
             // UintVecMin0 & SortedUintVec same layour ...
             isOffsetsZipped ? (UintVecMin0&)newZipOffsets : newOffsets,
             fstring((char*)newEntropyBitmap.data(), newEntropyBitmap.mem_size()),
-            fstring(entropyMem, entropyLen), mmapBase->entropyTableNoCompress, maxOffsetEnt);
+            fstring(entropyMem, entropyLen), mmapBase->entropyTableNoCompress,
+            mmapBase->entropyTableCompact, maxOffsetEnt);
         if (mmapBase->embeddedDict != (uint8_t)EmbeddedDictType::kExternal) {
             h.setEmbeddedDictType(mmapBase->getEmbeddedDict().size(),
                                   (EmbeddedDictType)mmapBase->embeddedDict);
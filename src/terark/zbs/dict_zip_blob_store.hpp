@@ -37,13 +37,15 @@ public:
 		bool useNewRefEncoding; // now unused
 		bool compressGlobalDict;
         uint8_t entropyInterleaved;
-		int  offsetArrayBlockUnits; // 0 for no compress
+        bool entropyTableCompact; // kHuffmanO1: use Huffman::decoder_o1_compact
+		int  offsetArrayBlockUnits; // 0 for no compress, 64 or 128, may OR SortedUintVec::kEliasFano
         float entropyZipRatioRequire;
         bool embeddedDict;
         bool enableLake;
         bool inputIsPerm;
         int  recordsPerBatch;
         int  bytesPerBatch;
+        int  dictBuildThreads; // suffix array and cache dfa, default 1
 
 		Options();
 	};
@@ -86,6 +88,7 @@ private:
     size_t        m_reserveOutputMultiplier;
 	void*         m_globalEntropyTableObject;
     const Huffman::decoder_o1* m_huffman_decoder;
+    const Huffman::decoder_o1_compact* m_huffman_compact;
 	Options::EntropyAlgo m_entropyAlgo;
 	bool          m_isNewRefEncoding; // now unused
     byte_t        m_entropyInterleaved;
@@ -154,6 +157,11 @@ public:
 	friend class DictZipBlobStoreBuilder;
 	static ZipBuilder* createZipBuilder(const Options&);
 
+	/// unzip implementation of stores loaded after this call, default is
+	/// env TerarkDictZipUnzipImp, @returns false if cpu does not support imp
+	static bool setUnzipImp(int imp);
+	static int  getUnzipImp();
+
     class TERARK_DLL_EXPORT MyBuilder : public AbstractBlobStore::Builder {
         ~MyBuilder();
         Builder* getPreBuilder() const override;
@@ -175,12 +183,15 @@ public:
 
     Dictionary get_dict() const override;
     const UintVecMin0& get_index() const { return m_offsets; }
+    bool is_entropy_table_compact() const { return m_huffman_compact != nullptr; }
 
     void get_meta_blocks(valvec<fstring>* blocks) const override;
     void get_data_blocks(valvec<fstring>* blocks) const override;
     void detach_meta_blocks(const valvec<fstring>& blocks) override;
 
 	size_t mem_size() const override;
+	bool get_records_file_range(const size_t* sortedIds, size_t n,
+								size_t* ranges) const override;
 
 private:
     template<bool ZipOffset, int CheckSumLevel, EntropyAlgo Entropy, int EntropyInterLeave>
@@ -1,6 +1,29 @@
+#if !defined(UnzipWideCopy)
+  #define UnzipWideCopy 0
+#endif
+#if UnzipWideCopy == 2
+  #define UnzipTarget TERARK_TARGET("avx2,bmi2,avx512f,avx512bw,avx512vl")
+  #define DzCopy(dst, src, len) DzCopyAvx512(dst, src, len)
+  #define DzCopyForward(src, dst, len) DzCopyForwardAvx512(src, dst, len)
+  #define DzFill(dst, ch, len) DzFillAvx2(dst, ch, len)
+  #define DzOutputSlack 32
+#elif UnzipWideCopy == 1
+  #define UnzipTarget TERARK_TARGET("avx2")
+  #define DzCopy(dst, src, len) DzCopyAvx2(dst, src, len)
+  #define DzCopyForward(src, dst, len) DzCopyForwardAvx2(src, dst, len)
+  #define DzFill(dst, ch, len) DzFillAvx2(dst, ch, len)
+  #define DzOutputSlack 32
+#else
+  #define UnzipTarget
+  #define DzCopy(dst, src, len) small_memcpy(dst, src, len)
+  #define DzCopyForward(src, dst, len) CopyForward(src, dst, len)
+  #define DzFill(dst, ch, len) memset(dst, ch, len)
+  #define DzOutputSlack 0
+#endif
+
 template<int gOffsetBytes>
 terark_no_inline
-terark_flatten static void
+terark_flatten UnzipTarget static void
 DoUnzipFuncName(const byte_t* pos, const byte_t* end, valvec<byte_t>* recData,
                 const byte_t* dic,
                 size_t gOffsetBits, size_t reserveOutputMultiplier)
@@ -75,10 +98,13 @@ DoUnzipFuncName(const byte_t* pos, const byte_t* end, valvec<byte_t>* recData,
     auto outEnd = recData->data() + recData->capacity();
     #define Inc_output() output += len
     #define CheckOutputCapacity() \
-        if (terark_unlikely(output + len > outEnd)) \
-            outEnd = UpdateOutputPtrAfterGrowCapacity(recData, len, output)
+        if (terark_unlikely(output + len + DzOutputSlack > outEnd)) \
+            outEnd = UpdateOutputPtrAfterGrowCapacity(recData, len + DzOutputSlack, output)
     #define DbgRecDataSize size_t(output - recData->data())
 #else
+  #if UnzipWideCopy
+    #error "UnzipWideCopy requires UnzipReserveBuffer"
+  #endif
     #define Inc_output()
     #define CheckOutputCapacity() auto output = recData->grow_no_init(len)
     #define DbgRecDataSize recData->size()
@@ -112,7 +138,7 @@ JumpLabel(Literal):
         size_t  len = (b >> 3) + 1;
         DzType_Trace("%zd Literal %zd\n", DbgRecDataSize, len);
         CheckOutputCapacity();
-        small_memcpy(output, pos, len);
+        DzCopy(output, pos, len);
         pos += len;
         JumpToNext();
     }
@@ -143,7 +169,7 @@ JumpLabel(Global):
         last_gLength = len;
         last_gDicOffset = offset;
     #else
-        small_memcpy(output, dic + offset, len);
+        DzCopy(output, dic + offset, len);
     #endif
         JumpToNext();
     }
@@ -152,7 +178,7 @@ JumpLabel(RLE):
         size_t len = (b >> 3) + 2;
         DzType_Trace("%zd RLE %zd\n", DbgRecDataSize, len);
         CheckOutputCapacity();
-        memset(output, output[-1], len);
+        DzFill(output, output[-1], len);
         JumpToNext();
     }
 JumpLabel(NearShort):
@@ -162,7 +188,7 @@ JumpLabel(NearShort):
         assert(distance <= DbgRecDataSize - oldsize);
         DzType_Trace("%zd NearShort %zd %zd\n", DbgRecDataSize, distance, len);
         CheckOutputCapacity();
-        CopyForward(output - distance, output, len);
+        DzCopyForward(output - distance, output, len);
         JumpToNext();
     }
 JumpLabel(Far1Short):
@@ -172,7 +198,7 @@ JumpLabel(Far1Short):
         assert(distance <= DbgRecDataSize - oldsize);
         DzType_Trace("%zd Far1Short %zd %zd\n", DbgRecDataSize, distance, len);
         CheckOutputCapacity();
-        CopyForward(output - distance, output, len);
+        DzCopyForward(output - distance, output, len);
         JumpToNext();
     }
 JumpLabel(Far2Short):
@@ -183,7 +209,7 @@ JumpLabel(Far2Short):
         DzType_Trace("%zd Far2Short %zd %zd\n", DbgRecDataSize, distance, len);
         CheckOutputCapacity();
         pos += 2;
-        small_memcpy(output, output - distance, len); // distance >= 258
+        DzCopy(output, output - distance, len); // distance >= 258
         JumpToNext();
     }
 JumpLabel(Far2Long):
@@ -201,7 +227,7 @@ JumpLabel(Far2Long):
         DzType_Trace("%zd Far2Long %zd %zd\n", DbgRecDataSize, distance, len);
         CheckOutputCapacity();
         pos += 2;
-        CopyForward(output - distance, output, len);
+        DzCopyForward(output - distance, output, len);
         JumpToNext();
     }
 JumpLabel(Far3Long):
@@ -219,7 +245,7 @@ JumpLabel(Far3Long):
         DzType_Trace("%zd Far3Long %zd %zd\n", DbgRecDataSize, distance, len);
         CheckOutputCapacity();
         pos += 3;
-        CopyForward(output - distance, output, len);
+        DzCopyForward(output - distance, output, len);
         JumpToNext();
     }
 #if UnzipDelayGlobalMatch
@@ -392,9 +418,15 @@ assert(pos == end);
 #undef JumpTarget
 #undef JumpToNext
 #undef DzTypeValue
+#undef UnzipTarget
+#undef DzCopy
+#undef DzCopyForward
+#undef DzFill
+#undef DzOutputSlack
 
 #undef UnzipReserveBuffer
 #undef UnzipUseThreading
 #undef UnzipDelayGlobalMatch
+#undef UnzipWideCopy
 #undef DoUnzipFuncName
 
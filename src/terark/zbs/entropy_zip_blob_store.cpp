@@ -37,7 +37,8 @@ struct EntropyZipBlobStore::FileHeader : public FileHeaderBase {
     uint08_t  checksumLevel;
     // resue one-byte's pad space for entropyFlags
     uint08_t  entropyTableNoCompress : 1;
-    uint08_t  reserveFlags : 7;
+    uint08_t  entropyTableCompact : 1; // Huffman::decoder_o1_compact
+    uint08_t  reserveFlags : 6;
     uint08_t  padding21[4];
     uint64_t  tableBytes;
     uint64_t  padding22[2];
@@ -52,7 +53,7 @@ struct EntropyZipBlobStore::FileHeader : public FileHeaderBase {
     FileHeader(fstring mem, size_t entropy_order, size_t raw_size,
                size_t entropy_bits, size_t offsets_size, size_t table_size,
                int _checksumLevel, int _checksumType,
-               bool entropyTableCompress) {
+               bool entropyTableCompress, bool _entropyTableCompact) {
       init();
         fileSize = mem.size();
         assert(fileSize == 0
@@ -73,6 +74,7 @@ struct EntropyZipBlobStore::FileHeader : public FileHeaderBase {
         checksumLevel = static_cast<uint08_t>(_checksumLevel);
         checksumType = static_cast<uint08_t>(_checksumType);
         entropyTableNoCompress = !entropyTableCompress;
+        entropyTableCompact = entropy_order == 1 && _entropyTableCompact;
     }
     FileHeader(const EntropyZipBlobStore* store, const SortedUintVec& offsets) {
         init();
@@ -91,6 +93,7 @@ struct EntropyZipBlobStore::FileHeader : public FileHeaderBase {
         checksumLevel = static_cast<uint08_t>(store->m_checksumLevel);
         checksumType = static_cast<uint08_t>(store->m_checksumType);
         entropyTableNoCompress = !store->is_entropy_table_compress();
+        entropyTableCompact = store->is_entropy_table_compact();
     }
 };
 
@@ -100,6 +103,12 @@ bool EntropyZipBlobStore::is_entropy_table_compress() const {
              : !((const FileHeader*)m_mmapBase)->entropyTableNoCompress;
 }
 
+bool EntropyZipBlobStore::is_entropy_table_compact() const {
+  return m_mmapBase == nullptr
+             ? false
+             : ((const FileHeader*)m_mmapBase)->entropyTableCompact;
+}
+
 bool EntropyZipBlobStore::is_order1() const {
   return m_mmapBase == nullptr
              ? true
@@ -109,20 +118,28 @@ bool EntropyZipBlobStore::is_order1() const {
 void EntropyZipBlobStore::init_get_calls() {
     if (!is_order1()) {
         m_get_record_append = static_cast<get_record_append_func_t>
-            (&EntropyZipBlobStore::get_record_append_imp<0>);
+            (&EntropyZipBlobStore::get_record_append_imp<0, false>);
+        m_fspread_record_append = static_cast<fspread_record_append_func_t>
+            (&EntropyZipBlobStore::fspread_record_append_imp<0, false>);
+        m_get_record_append_CacheOffsets =
+            static_cast<get_record_append_CacheOffsets_func_t>
+            (&EntropyZipBlobStore::get_record_append_CacheOffsets<0, false>);
+    } else if (is_entropy_table_compact()) {
+        m_get_record_append = static_cast<get_record_append_func_t>
+            (&EntropyZipBlobStore::get_record_append_imp<1, true>);
         m_fspread_record_append = static_cast<fspread_record_append_func_t>
-            (&EntropyZipBlobStore::fspread_record_append_imp<0>);
+            (&EntropyZipBlobStore::fspread_record_append_imp<1, true>);
         m_get_record_append_CacheOffsets =
             static_cast<get_record_append_CacheOffsets_func_t>
-            (&EntropyZipBlobStore::get_record_append_CacheOffsets<0>);
+            (&EntropyZipBlobStore::get_record_append_CacheOffsets<1, true>);
     } else {
         m_get_record_append = static_cast<get_record_append_func_t>
-            (&EntropyZipBlobStore::get_record_append_imp<1>);
+            (&EntropyZipBlobStore::get_record_append_imp<1, false>);
         m_fspread_record_append = static_cast<fspread_record_append_func_t>
-            (&EntropyZipBlobStore::fspread_record_append_imp<1>);
+            (&EntropyZipBlobStore::fspread_record_append_imp<1, false>);
         m_get_record_append_CacheOffsets =
             static_cast<get_record_append_CacheOffsets_func_t>
-            (&EntropyZipBlobStore::get_record_append_CacheOffsets<1>);
+            (&EntropyZipBlobStore::get_record_append_CacheOffsets<1, false>);
     }
 }
 
@@ -171,6 +188,15 @@ void EntropyZipBlobStore::init_from_memory(fstring dataMem, Dictionary/*dict*/)
         else {
             m_decoder_o0 = new Huffman::decoder(m_table, &table_size);
         }
+    } else if (mmapBase->entropyTableCompact) {
+        if (mmapBase->entropyTableNoCompress) {
+            TERARK_VERIFY_EQ(mmapBase->tableBytes, sizeof(Huffman::decoder_o1_compact));
+            m_decoder_o1_compact = reinterpret_cast<Huffman::decoder_o1_compact*>(m_table.data());
+            table_size = mmapBase->tableBytes;
+        }
+        else {
+            m_decoder_o1_compact = new Huffman::decoder_o1_compact(m_table, &table_size);
+        }
     } else {
         if (mmapBase->entropyTableNoCompress) {
             assert(mmapBase->tableBytes == sizeof(Huffman::decoder_o1));
@@ -212,6 +238,11 @@ void EntropyZipBlobStore::get_meta_blocks(valvec<fstring>* blocks) const {
                 reinterpret_cast<const char*>(m_decoder_o0),
                 sizeof(Huffman::decoder));
     }
+    else if (m_decoder_o1_compact != nullptr) {
+        blocks->emplace_back(
+                reinterpret_cast<const char*>(m_decoder_o1_compact),
+                sizeof(Huffman::decoder_o1_compact));
+    }
     else {
         blocks->emplace_back(
                 reinterpret_cast<const char*>(m_decoder_o1),
@@ -231,17 +262,16 @@ void EntropyZipBlobStore::detach_meta_blocks(const valvec<fstring>& blocks) {
     auto decoder_mem = blocks.back();
     assert(offset_mem.size() == m_offsets.mem_size());
     assert(decoder_mem.size() == sizeof(Huffman::decoder) ||
-           decoder_mem.size() == sizeof(Huffman::decoder_o1));
+           decoder_mem.size() == sizeof(Huffman::decoder_o1) ||
+           decoder_mem.size() == sizeof(Huffman::decoder_o1_compact));
     if (is_entropy_table_compress()) {
-        if (m_decoder_o0 != nullptr) {
-            delete m_decoder_o0;
-        }
-        if (m_decoder_o1 != nullptr) {
-            delete m_decoder_o1;
-        }
+        delete m_decoder_o0;
+        delete m_decoder_o1;
+        delete m_decoder_o1_compact;
     }
     m_decoder_o0 = nullptr;
     m_decoder_o1 = nullptr;
+    m_decoder_o1_compact = nullptr;
     if (m_isUserMem) {
         m_offsets.risk_release_ownership();
     } else {
@@ -252,6 +282,9 @@ void EntropyZipBlobStore::detach_meta_blocks(const valvec<fstring>& blocks) {
     if (!is_order1()) {
         m_decoder_o0 =
             reinterpret_cast<const Huffman::decoder*>(decoder_mem.data());
+    } else if (is_entropy_table_compact()) {
+        m_decoder_o1_compact =
+            reinterpret_cast<const Huffman::decoder_o1_compact*>(decoder_mem.data());
     } else {
         m_decoder_o1 =
             reinterpret_cast<const Huffman::decoder_o1*>(decoder_mem.data());
@@ -291,6 +324,7 @@ EntropyZipBlobStore::EntropyZipBlobStore() {
     m_checksumType = 0;  // crc32c
     m_decoder_o0 = nullptr;
     m_decoder_o1 = nullptr;
+    m_decoder_o1_compact = nullptr;
     init_get_calls();
 }
 
@@ -299,6 +333,7 @@ EntropyZipBlobStore::~EntropyZipBlobStore() {
         m_offsets.risk_release_ownership();
         m_decoder_o0 = nullptr;
         m_decoder_o1 = nullptr;
+        m_decoder_o1_compact = nullptr;
     }
     if (m_decoder_o0) {
         if(is_entropy_table_compress()) {
@@ -312,6 +347,12 @@ EntropyZipBlobStore::~EntropyZipBlobStore() {
         }
         m_decoder_o1 = nullptr;
     }
+    if (m_decoder_o1_compact) {
+        if(is_entropy_table_compress()) {
+            delete m_decoder_o1_compact;
+        }
+        m_decoder_o1_compact = nullptr;
+    }
     if (m_isUserMem) {
         if (m_isMmapData) {
             mmap_close((void*)m_mmapBase, m_mmapBase->fileSize);
@@ -338,13 +379,29 @@ void EntropyZipBlobStore::swap(EntropyZipBlobStore& other) {
   m_table.swap(other.m_table);
   std::swap(m_decoder_o0, other.m_decoder_o0);
   std::swap(m_decoder_o1, other.m_decoder_o1);
+  std::swap(m_decoder_o1_compact, other.m_decoder_o1_compact);
 }
 
 size_t EntropyZipBlobStore::mem_size() const {
     return m_content.size() + m_offsets.mem_size() + m_table.size();
 }
 
-template<size_t Order>
+bool
+EntropyZipBlobStore::get_records_file_range(const size_t* sortedIds, size_t n,
+                                            size_t* ranges)
+const {
+    // m_offsets are bit offsets, same as fspread_record_append_imp
+    m_offsets.get2_sorted(sortedIds, n, ranges);
+    for (size_t i = 0; i < n; ++i) {
+        size_t byte_beg = (ranges[2*i+0] - ranges[2*i+0] % 64) / 8;
+        size_t byte_end = (ranges[2*i+1] + 63) / 64 * 8;
+        ranges[2*i+0] = sizeof(FileHeader) + byte_beg;
+        ranges[2*i+1] = sizeof(FileHeader) + byte_end;
+    }
+    return true;
+}
+
+template<size_t Order, bool CompactO1>
 void
 EntropyZipBlobStore::get_record_append_imp(size_t recID, valvec<byte_t>* recData)
 const {
@@ -368,6 +425,8 @@ const {
     bool ok;
     if (Order == 0) {
         ok = m_decoder_o0->bitwise_decode(bits, &ctx_data.get(), ctx);
+    } else if (CompactO1) {
+        ok = m_decoder_o1_compact->bitwise_decode_x1(bits, &ctx_data.get(), ctx);
     } else {
         ok = m_decoder_o1->bitwise_decode_x1(bits, &ctx_data.get(), ctx);
     }
@@ -397,7 +456,7 @@ const {
     recData->append(data);
 }
 
-template<size_t Order>
+template<size_t Order, bool CompactO1>
 void
 EntropyZipBlobStore::get_record_append_CacheOffsets(size_t recID, CacheOffsets* co)
 const {
@@ -429,6 +488,8 @@ const {
     bool ok;
     if (Order == 0) {
         ok = m_decoder_o0->bitwise_decode(bits, &ctx_data.get(), ctx);
+    } else if (CompactO1) {
+        ok = m_decoder_o1_compact->bitwise_decode_x1(bits, &ctx_data.get(), ctx);
     } else {
         ok = m_decoder_o1->bitwise_decode_x1(bits, &ctx_data.get(), ctx);
     }
@@ -457,7 +518,7 @@ const {
     co->recData.append(data);
 }
 
-template<size_t Order>
+template<size_t Order, bool CompactO1>
 void
 EntropyZipBlobStore::fspread_record_append_imp(
                     pread_func_t fspread, void* lambda,
@@ -490,6 +551,8 @@ const {
     bool ok;
     if (Order == 0) {
         ok = m_decoder_o0->bitwise_decode(bits, &ctx_data.get(), ctx);
+    } else if (CompactO1) {
+        ok = m_decoder_o1_compact->bitwise_decode_x1(bits, &ctx_data.get(), ctx);
     } else {
         ok = m_decoder_o1->bitwise_decode_x1(bits, &ctx_data.get(), ctx);
     }
@@ -528,7 +591,7 @@ const {
     TERARK_UNUSED_VAR(recNum);
     size_t offset = 0;
     auto zipOffsetBuilder = std::unique_ptr<SortedUintVec::Builder>(
-        SortedUintVec::createBuilder(m_offsets.block_units(), tmpFile.c_str()));
+        SortedUintVec::createBuilder(m_offsets.build_units(), tmpFile.c_str()));
 #if !defined(NDEBUG)
     size_t maxOffsetEnt = m_offsets[recNum];
 #endif
@@ -606,10 +669,12 @@ class EntropyZipBlobStore::MyBuilder::Impl : boost::noncopyable {
     int m_checksumLevel;
     int m_checksumType;
     bool m_entropyTableCompress; // for FileHeader::entropyTablenoCompress
+    bool m_entropyTableCompact;  // for FileHeader::entropyTableCompact
 
 public:
     Impl(freq_hist_o1& freq, size_t blockUnits, fstring fpath, size_t offset,
-         int checksumLevel, int checksumType, bool entropyTableCompress)
+         int checksumLevel, int checksumType, bool entropyTableCompress,
+         bool entropyTableCompact)
         : m_fpath(fpath.begin(), fpath.end())
         , m_fpath_offset(fpath + ".offset")
         , m_builder(SortedUintVec::createBuilder(blockUnits, m_fpath_offset.c_str()))
@@ -623,7 +688,8 @@ public:
         , m_entropy_bits(0)
         , m_checksumLevel(checksumLevel)
         , m_checksumType(checksumType)
-        , m_entropyTableCompress(entropyTableCompress) {
+        , m_entropyTableCompress(entropyTableCompress)
+        , m_entropyTableCompact(entropyTableCompact) {
         assert(offset % 8 == 0);
         if (offset == 0) {
           m_file.open(fpath, "wb");
@@ -636,7 +702,8 @@ public:
         init(freq);
     }
     Impl(freq_hist_o1& freq, size_t blockUnits, FileMemIO& mem,
-         int checksumLevel, int checksumType, bool entropyTableCompress)
+         int checksumLevel, int checksumType, bool entropyTableCompress,
+         bool entropyTableCompact)
         : m_fpath()
         , m_fpath_offset()
         , m_builder(SortedUintVec::createBuilder(blockUnits))
@@ -650,7 +717,8 @@ public:
         , m_entropy_bits(0)
         , m_checksumLevel(checksumLevel)
         , m_checksumType(checksumType)
-        , m_entropyTableCompress(entropyTableCompress) {
+        , m_entropyTableCompress(entropyTableCompress)
+        , m_entropyTableCompact(entropyTableCompact) {
         init(freq);
     }
     void init(freq_hist_o1& freq) {
@@ -716,7 +784,13 @@ public:
             m_encoder_o0.reset();
             order = 0;
         } else {
-            if (!m_entropyTableCompress) {
+            if (!m_entropyTableCompress && m_entropyTableCompact) {
+                // reset table from Ctable to compact Dtable
+                table.ensure_capacity(sizeof(Huffman::decoder_o1_compact));
+                new (table.data()) Huffman::decoder_o1_compact(fstring(m_encoder_o1->table().data(),
+                                                        m_encoder_o1->table().size()));
+                table.risk_set_size(sizeof(Huffman::decoder_o1_compact));
+            } else if (!m_entropyTableCompress) {
                 // reset table from Ctable to Dtable
                 table.ensure_capacity(sizeof(Huffman::decoder_o1));
                 new (table.data()) Huffman::decoder_o1(fstring(m_encoder_o1->table().data(),
@@ -751,7 +825,8 @@ public:
             *(FileHeader*)m_memStream.stream()->begin() =
                 FileHeader(fstring(m_memStream.stream()->begin(), m_memStream.size()),
                     order, m_raw_size, m_entropy_bits, offsets_size, table.size(),
-                    m_checksumLevel, m_checksumType, m_entropyTableCompress);
+                    m_checksumLevel, m_checksumType, m_entropyTableCompress,
+                    m_entropyTableCompact);
 
             XXHash64 xxhash64(g_debsnark_seed);
             xxhash64.update(m_memStream.stream()->begin(), m_memStream.size() - sizeof(BlobStoreFileFooter));
@@ -784,7 +859,8 @@ public:
             fstring mem((const char*)mmap.base + m_offset, (ptrdiff_t)(file_size - m_offset));
             *(FileHeader*)mem.data() =
                 FileHeader(mem, order, m_raw_size, m_entropy_bits, offsets_size, table.size(),
-                           m_checksumLevel, m_checksumType, m_entropyTableCompress);
+                           m_checksumLevel, m_checksumType, m_entropyTableCompress,
+                           m_entropyTableCompact);
 
             XXHash64 xxhash64(g_debsnark_seed);
             xxhash64.update(mem.data(), mem.size() - sizeof(BlobStoreFileFooter));
@@ -802,16 +878,18 @@ EntropyZipBlobStore::MyBuilder::~MyBuilder() {
 EntropyZipBlobStore::MyBuilder::MyBuilder(freq_hist_o1& freq, size_t blockUnits,
                                           fstring fpath, size_t offset,
                                           int checksumLevel, int checksumType,
-                                          bool entropyTableCompress) {
+                                          bool entropyTableCompress,
+                                          bool entropyTableCompact) {
   impl = new Impl(freq, blockUnits, fpath, offset, checksumLevel, checksumType,
-                  entropyTableCompress);
+                  entropyTableCompress, entropyTableCompact);
 }
 EntropyZipBlobStore::MyBuilder::MyBuilder(freq_hist_o1& freq, size_t blockUnits,
                                           FileMemIO& mem, int checksumLevel,
                                           int checksumType,
-                                          bool entropyTableCompress) {
+                                          bool entropyTableCompress,
+                                          bool entropyTableCompact) {
   impl = new Impl(freq, blockUnits, mem, checksumLevel, checksumType,
-                  entropyTableCompress);
+                  entropyTableCompress, entropyTableCompact);
 }
 void EntropyZipBlobStore::MyBuilder::addRecord(fstring rec) {
     assert(NULL != impl);
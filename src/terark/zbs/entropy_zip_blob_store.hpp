@@ -23,12 +23,14 @@ class TERARK_DLL_EXPORT EntropyZipBlobStore : public AbstractBlobStore {
     valvec<byte_t> m_table;
     const Huffman::decoder* m_decoder_o0;
     const Huffman::decoder_o1* m_decoder_o1;
+    const Huffman::decoder_o1_compact* m_decoder_o1_compact;
 
-    template<size_t Order>
+    // CompactO1: order 1 decoded by m_decoder_o1_compact
+    template<size_t Order, bool CompactO1>
     void get_record_append_imp(size_t recID, valvec<byte_t>* recData) const;
-    template<size_t Order>
+    template<size_t Order, bool CompactO1>
     void get_record_append_CacheOffsets(size_t recID, CacheOffsets*) const;
-    template<size_t Order>
+    template<size_t Order, bool CompactO1>
     void fspread_record_append_imp(pread_func_t fspread, void* lambda,
                                    size_t baseOffset, size_t recID,
                                    valvec<byte_t>* recData,
@@ -38,6 +40,7 @@ public:
     ~EntropyZipBlobStore();
 
     bool is_entropy_table_compress() const;
+    bool is_entropy_table_compact() const;
     bool is_order1() const;
 
     void swap(EntropyZipBlobStore& other);
@@ -53,6 +56,8 @@ public:
     using AbstractBlobStore::save_mmap;
 
     size_t mem_size() const override;
+    bool get_records_file_range(const size_t* sortedIds, size_t n,
+                                size_t* ranges) const override;
     void reorder_zip_data(ZReorderMap& newToOld,
         function<void(const void* data, size_t size)> writeAppend,
         fstring tmpFile) const override;
@@ -61,9 +66,11 @@ public:
         class TERARK_DLL_EXPORT Impl; Impl* impl;
     public:
         MyBuilder(freq_hist_o1& freq, size_t blockUnits, fstring fpath, size_t offset = 0,
-                  int checksumLevel = 3, int checksumType = 0, bool entropyTableCompress = false);
+                  int checksumLevel = 3, int checksumType = 0, bool entropyTableCompress = false,
+                  bool entropyTableCompact = false);
         MyBuilder(freq_hist_o1& freq, size_t blockUnits, FileMemIO& mem,
-                  int checksumLevel = 3, int checksumType = 0, bool entropyTableCompress = false);
+                  int checksumLevel = 3, int checksumType = 0, bool entropyTableCompress = false,
+                  bool entropyTableCompact = false);
         virtual ~MyBuilder();
         void addRecord(fstring rec) override;
         void finish() override;
@@ -0,0 +1,63 @@
+#pragma once
+#include <terark/valvec.hpp>
+#include <algorithm>
+
+namespace terark {
+
+/// count-min sketch with 4-bit counters, 4 counters of a key are in a
+/// same 64-byte block, all counters are halved after 10*items increments
+/// thus it estimates recent frequency, for TinyLFU admission
+class FreqSketch {
+	valvec<uint64_t> m_table;
+	size_t m_block_mask = 0;
+	size_t m_count = 0;
+	size_t m_sample = 0;
+	static uint64_t spread(uint64_t x) {
+		x = (x ^ (x >> 33)) * 0xff51afd7ed558ccdULL;
+		x = (x ^ (x >> 33)) * 0xc4ceb9fe1a85ec53ULL;
+		return x ^ (x >> 33);
+	}
+	// word index in m_table and bit shift in the word of counter i
+	void locate(uint64_t h, size_t i, size_t* idx, unsigned* shift) const {
+		size_t block = size_t(h >> 32) & m_block_mask;
+		*idx = block * 8 + (size_t(h >> 8*i) & 7);
+		*shift = 4 * (unsigned(h >> (8*i + 3)) & 15);
+	}
+public:
+	void init(size_t items) {
+		size_t blocks = 8;
+		while (blocks * 8 < items) blocks *= 2;
+		m_table.resize(blocks * 8, 0);
+		m_block_mask = blocks - 1;
+		m_sample = 10 * std::max<size_t>(items, 1);
+	}
+	unsigned frequency(uint64_t key) const {
+		uint64_t h = spread(key);
+		unsigned freq = 15;
+		for (size_t i = 0; i < 4; ++i) {
+			size_t idx; unsigned shift;
+			locate(h, i, &idx, &shift);
+			freq = std::min(freq, unsigned(m_table[idx] >> shift) & 15);
+		}
+		return freq;
+	}
+	void increment(uint64_t key) {
+		uint64_t h = spread(key);
+		bool added = false;
+		for (size_t i = 0; i < 4; ++i) {
+			size_t idx; unsigned shift;
+			locate(h, i, &idx, &shift);
+			if ((unsigned(m_table[idx] >> shift) & 15) != 15) {
+				m_table[idx] += uint64_t(1) << shift;
+				added = true;
+			}
+		}
+		if (added && ++m_count >= m_sample) {
+			for (uint64_t& w : m_table)
+				w = (w >> 1) & 0x7777777777777777ULL;
+			m_count /= 2;
+		}
+	}
+};
+
+} // namespace terark
@@ -1,4 +1,5 @@
 #include "lru_page_cache.hpp"
+#include "freq_sketch.hpp"
 #if (defined(_WIN32) || defined(_WIN64)) && !defined(__CYGWIN__)
 	#define WIN32_LEAN_AND_MEAN
 	#define NOMINMAX
@@ -17,6 +18,7 @@
 #include <terark/bitmap.hpp>
 #include <terark/num_to_str.hpp>
 #include <atomic>
+#include <chrono>
 #include <boost/preprocessor/cat.hpp>
 #include <boost/fiber/operations.hpp>
 #include <terark/thread/fiber_aio.hpp>
@@ -362,8 +364,9 @@ namespace lru_detail {
 		uint32_t lru_next;
 		uint16_t ref_count;
 		volatile uint08_t is_loaded;
-		uint08_t reserved;
+		uint08_t lru_flags; // segment and ColdFlag
 		uint32_t hash_link;
+		uint32_t access_ms; // time of last access which is not correlated
 
 		uint32_t get_fi() const { return uint32_t(fi_offset >> 32); }
 
@@ -434,6 +437,14 @@ namespace lru_detail {
 			base[p].lru_next = x;
 		}
 	};
+
+	enum LruFlags : uint08_t {
+		SegProbation = 0, // the only segment for kLRU
+		SegProtected = 1,
+		SegWindow    = 2,
+		SegMask      = 3,
+		ColdFlag     = 4, // loaded by no_cache(fi), insert to lru tail
+	};
 }
 using namespace lru_detail;
 
@@ -451,6 +462,7 @@ using namespace lru_detail;
 class SingleLruReadonlyCache final: public LruReadonlyCache {
 public:
 	bool                m_use_aio;
+	bool                m_fixed_buf; // registered as io_uring fixed buffer
 	valvec<size_t>      m_histogram;
 	Node*               m_hash_nodes;
 	uint32_t*           m_bucket;
@@ -462,6 +474,13 @@ public:
 	uint32_t            m_fi_busylist;
 	uint32_t            m_busypage_num;
 //	uint32_t            m_droppage_num;
+	Policy              m_policy;
+	uint32_t            m_window_cap;
+	uint32_t            m_protected_cap;
+	uint32_t            m_seg_head[3]; // sentinel of each segment list
+	uint32_t            m_seg_cnt[3];  // including referenced pages
+	uint32_t            m_min_promote_ms;
+	FreqSketch          m_sketch;
 	size_t   m_stat_cnt[6];
 	MY_MUTEX_PADDING
 	mutable MyMutex     m_mutex;
@@ -470,7 +489,7 @@ public:
 	MyMutex          m_mutex_fd_fi;
 #endif
 	MY_MUTEX_PADDING
-	SingleLruReadonlyCache(size_t capacityBytes, size_t maxFiles, bool aio);
+	SingleLruReadonlyCache(size_t capacityBytes, size_t maxFiles, bool aio, Policy);
 	~SingleLruReadonlyCache();
 	const byte_t* pread(intptr_t fi, size_t offset, size_t len, Buffer*) override;
 	void discard_impl(const Buffer& b);
@@ -481,24 +500,29 @@ public:
 	static void print_stat_cnt_impl(FILE*, const size_t cnt[6], const valvec<size_t>& histogram);
 	valvec<size_t> get_histogram_snapshot() const;
 private:
-	uint32_t alloc_page(size_t hpos, uint64_t fi_offset_key, Buffer::CacheType*, intptr_t* fd);
+	uint32_t alloc_page(size_t hpos, uint64_t fi_offset_key, Buffer::CacheType*, intptr_t* fd, bool no_cache, uint32_t now_ms);
 	void remove_from_hash(size_t bucketIdx, size_t slot);
+	void set_segment(uint32_t p, unsigned seg);
+	void lru_on_hit(uint32_t p, bool no_cache, uint32_t now_ms);
+	void lru_release(uint32_t p);
+	uint32_t lru_victim();
 };
 
 ///
 SingleLruReadonlyCache::
-SingleLruReadonlyCache(size_t capacityBytes, size_t maxFiles, bool aio)
+SingleLruReadonlyCache(size_t capacityBytes, size_t maxFiles, bool aio, Policy policy)
 	: m_fi_to_fd(maxFiles)
 {
 	m_use_aio = aio;
+	m_policy = policy;
 	size_t pgNum = ceiled_div(capacityBytes, PAGE_SIZE);
-	if (pgNum >= nillink-2) {
+	if (pgNum >= nillink-4) {
 		THROW_STD(invalid_argument
 			, "capacityBytes = %zd is too large, yield page num = %zd"
 			, capacityBytes, pgNum);
 	}
 	m_bucket_size = __hsm_stl_next_prime(pgNum * 3 / 2);
-	size_t node_bytes = sizeof(Node) * (pgNum + 1);
+	size_t node_bytes = sizeof(Node) * (pgNum + 3); // 3 segment sentinels
 	size_t page_bytes = pgNum * PAGE_SIZE;
 	size_t bucket_bytes = sizeof(uint32_t) * m_bucket_size;
 	size_t bytes = page_bytes + node_bytes + bucket_bytes;
@@ -531,19 +555,46 @@ SingleLruReadonlyCache(size_t capacityBytes, size_t maxFiles, bool aio)
 	}
 #endif
 	m_bufmem = mem;
+	if (aio) {
+		// use io_uring fixed buffer if aio_method is io_uring
+		m_fixed_buf = fiber_aio_register_buffer(mem, page_bytes);
+	} else {
+		m_fixed_buf = false;
+	}
 	m_hash_nodes = (Node*)(mem + page_bytes);
-	for (size_t i = 0; i < pgNum+1; ++i) {
+	for (size_t i = 0; i < pgNum+3; ++i) {
 		m_hash_nodes[i].fi_offset = uint64_t(-1);
 		m_hash_nodes[i].ref_count = 0;
 		m_hash_nodes[i].is_loaded = false;
-		m_hash_nodes[i].reserved = 0;
+		m_hash_nodes[i].lru_flags = SegProbation;
+		m_hash_nodes[i].access_ms = 0;
 		m_hash_nodes[i].hash_link = nillink;
 		m_hash_nodes[i].fi_next = nillink; m_hash_nodes[i].lru_next = i+1;
 		m_hash_nodes[i].fi_prev = nillink; m_hash_nodes[i].lru_prev = i-1;
 	}
 	m_hash_nodes[pgNum].lru_next = 0;
 	m_hash_nodes[0].lru_prev = pgNum;
-	m_bucket = (uint32_t*)(m_hash_nodes + pgNum + 1);
+	// node 0 is sentinel of probation list, which has all pages initially
+	m_seg_head[SegProbation] = 0;
+	m_seg_head[SegProtected] = uint32_t(pgNum + 1);
+	m_seg_head[SegWindow] = uint32_t(pgNum + 2);
+	for (uint32_t seg : {SegProtected, SegWindow}) {
+		uint32_t h = m_seg_head[seg];
+		m_hash_nodes[h].lru_next = m_hash_nodes[h].lru_prev = h;
+	}
+	m_seg_cnt[SegProbation] = uint32_t(pgNum);
+	m_seg_cnt[SegProtected] = 0;
+	m_seg_cnt[SegWindow] = 0;
+	m_window_cap = kTinyLFU == policy ? uint32_t(std::max<size_t>(pgNum/100, 1)) : 0;
+	m_protected_cap = uint32_t((pgNum - m_window_cap) * 4 / 5);
+	// a page is often read multiple times in a short time, such as reading
+	// records in a page by a scan, these correlated reads are counted as
+	// one access, like innodb_old_blocks_time of MySQL
+	m_min_promote_ms = (uint32_t)getEnvLong("Terark_lruMinPromoteMs", 1000);
+	if (kTinyLFU == policy) {
+		m_sketch.init(pgNum);
+	}
+	m_bucket = (uint32_t*)(m_hash_nodes + pgNum + 3);
 	std::fill_n(m_bucket, m_bucket_size, nillink);
 	m_page_num = pgNum;
 	m_fi_freelist = nillink;
@@ -554,6 +605,9 @@ SingleLruReadonlyCache(size_t capacityBytes, size_t maxFiles, bool aio)
 }
 
 SingleLruReadonlyCache::~SingleLruReadonlyCache() {
+	if (m_fixed_buf) {
+		fiber_aio_unregister_buffer(m_bufmem, PAGE_SIZE * m_page_num);
+	}
 	TERARK_IF_MSVC(_aligned_free, free)(m_bufmem);
 }
 
@@ -587,6 +641,27 @@ do_pread(intptr_t fd, void* buf, size_t offset, size_t minlen, size_t maxlen, bo
 #endif
 }
 
+// read all pages in one aio batch
+static void
+do_batch_pread(intptr_t fd, fiber_aio_req* reqs, size_t num, size_t minlen_last) {
+	fiber_aio_batch_read((int)fd, reqs, num);
+	for (size_t i = 0; i < num; ++i) {
+		size_t minlen = i + 1 == num ? minlen_last : reqs[i].len;
+		if (reqs[i].ret < intptr_t(minlen)) {
+			THROW_STD(logic_error
+				, "fiber_aio_batch_read(offset = %zd, len = %zd) = %zd (minlen = %zd), err = %s"
+				, size_t(reqs[i].offset), reqs[i].len, reqs[i].ret, minlen
+				, strerror(reqs[i].err));
+		}
+	}
+}
+
+static inline uint32_t lru_now_ms() {
+	using namespace std::chrono;
+	auto ms = duration_cast<milliseconds>(steady_clock::now().time_since_epoch());
+	return uint32_t(ms.count()); // wrap around is ok
+}
+
 static inline uint64_t MyHash(uint64_t fi_page_id) {
 	uint64_t hash1 = (fi_page_id << 3) | (fi_page_id >> 61);
 	return byte_swap(hash1);
@@ -600,7 +675,8 @@ void fdpread(intptr_t fd, void* buf, size_t len, size_t offset) {
 // already in m_mutex lock
 uint32_t
 SingleLruReadonlyCache::alloc_page(size_t hpos, uint64_t fi_offset_key,
-							 Buffer::CacheType* cache_type, intptr_t* fd) {
+							 Buffer::CacheType* cache_type, intptr_t* fd,
+							 bool no_cache, uint32_t now_ms) {
 	uint32_t* bucket = m_bucket;
 	Node*     nodes = m_hash_nodes;
 	uint32_t  fi = uint32_t(fi_offset_key >> 32);
@@ -658,7 +734,7 @@ SingleLruReadonlyCache::alloc_page(size_t hpos, uint64_t fi_offset_key,
 	}
 	else {
 	SwapOut:
-		p = nodes[0].lru_prev; // lru tail
+		p = lru_victim();
 		if (0 == p) {
 			THROW_STD(logic_error
 				, "can not evict a page, busy pages = %zd, max pages = %zd"
@@ -712,9 +788,102 @@ SingleLruReadonlyCache::alloc_page(size_t hpos, uint64_t fi_offset_key,
 	nodes[p].fi_offset = fi_offset_key;
 	nodes[p].hash_link = bucket[hpos];
 	bucket[hpos] = p; // insert to hash
+	nodes[p].access_ms = now_ms;
+	if (no_cache) {
+		set_segment(p, SegProbation);
+		nodes[p].lru_flags |= ColdFlag;
+	}
+	else {
+		set_segment(p, kTinyLFU == m_policy ? SegWindow : SegProbation);
+		if (kTinyLFU == m_policy)
+			m_sketch.increment(fi_offset_key);
+	}
 	return p;
 }
 
+// m_mutex is locked before calling the lru_* functions
+
+void SingleLruReadonlyCache::set_segment(uint32_t p, unsigned seg) {
+	Node* nodes = m_hash_nodes;
+	m_seg_cnt[nodes[p].lru_flags & SegMask]--;
+	m_seg_cnt[seg]++;
+	nodes[p].lru_flags = uint08_t(seg); // also clear ColdFlag
+}
+
+// page p is referenced, so it is not in any lru list
+void SingleLruReadonlyCache::lru_on_hit(uint32_t p, bool no_cache, uint32_t now_ms) {
+	if (no_cache) {
+		return;
+	}
+	Node* nodes = m_hash_nodes;
+	nodes[p].lru_flags &= ~ColdFlag;
+	if (kLRU == m_policy) {
+		return;
+	}
+	if (now_ms - nodes[p].access_ms < m_min_promote_ms) {
+		return; // correlated access
+	}
+	nodes[p].access_ms = now_ms;
+	if (kTinyLFU == m_policy) {
+		m_sketch.increment(nodes[p].fi_offset);
+	}
+	if (SegProbation == (nodes[p].lru_flags & SegMask)) {
+		set_segment(p, SegProtected);
+	}
+}
+
+// ref_count of page p was just decreased to 0
+void SingleLruReadonlyCache::lru_release(uint32_t p) {
+	Node* nodes = m_hash_nodes;
+	unsigned seg = nodes[p].lru_flags & SegMask;
+	uint32_t head = m_seg_head[seg];
+	if (nodes[p].lru_flags & ColdFlag)
+		Node::lru_insert_after(nodes, nodes[head].lru_prev, p); // tail
+	else
+		Node::lru_insert_after(nodes, head, p);
+	if (SegProtected == seg && m_seg_cnt[SegProtected] > m_protected_cap) {
+		// demote protected lru tail to probation mru
+		uint32_t q = nodes[head].lru_prev;
+		Node::lru_remove(nodes, q);
+		set_segment(q, SegProbation);
+		Node::lru_insert_after(nodes, m_seg_head[SegProbation], q);
+	}
+}
+
+///@returns page to be evicted, 0 if all pages are referenced
+uint32_t SingleLruReadonlyCache::lru_victim() {
+	Node* nodes = m_hash_nodes;
+	uint32_t v = nodes[0].lru_prev; // probation lru tail
+	if (0 == v && kLRU != m_policy) {
+		uint32_t h = m_seg_head[SegProtected];
+		v = nodes[h].lru_prev != h ? nodes[h].lru_prev : 0;
+	}
+	if (kTinyLFU != m_policy) {
+		return v;
+	}
+	uint32_t h = m_seg_head[SegWindow];
+	uint32_t c = nodes[h].lru_prev; // window lru tail, the candidate
+	if (c == h) {
+		return v;
+	}
+	if (0 == v) {
+		return c;
+	}
+	if (m_seg_cnt[SegWindow] < m_window_cap) {
+		return v;
+	}
+	if (uint64_t(-1) == nodes[v].fi_offset || (nodes[v].lru_flags & ColdFlag) ||
+			m_sketch.frequency(nodes[c].fi_offset) >
+			m_sketch.frequency(nodes[v].fi_offset)) {
+		// admit the candidate to probation, evict v
+		Node::lru_remove(nodes, c);
+		set_segment(c, SegProbation);
+		Node::lru_insert_after(nodes, 0, c);
+		return v;
+	}
+	return c;
+}
+
 intptr_t SingleLruReadonlyCache::open(intptr_t fd) {
 	if (fd < 0) {
 		THROW_STD(invalid_argument, "invalid fd = %zd", fd);
@@ -742,9 +911,12 @@ struct MyPageEntry {
 
 const byte_t*
 SingleLruReadonlyCache::pread(intptr_t fi, size_t offset, size_t len, Buffer* b) {
+	const bool no_cache = (fi & NoCacheFlag) != 0;
+	fi &= ~NoCacheFlag;
 	if (terark_unlikely(fi < 0)) {
 		THROW_STD(invalid_argument, "invalid fi = %zd", fi);
 	}
+	const uint32_t now_ms = kLRU == m_policy ? 0 : lru_now_ms();
 	size_t pg_offset = offset % PAGE_SIZE;
 	uint32_t* bucket = m_bucket;
 	Node*     nodes = m_hash_nodes;
@@ -767,6 +939,7 @@ SingleLruReadonlyCache::pread(intptr_t fi, size_t offset, size_t len, Buffer* b)
 					if (nodes[p].ref_count++ == 0) {
 						Node::lru_remove(nodes, p);
 					}
+					lru_on_hit(p, no_cache, now_ms);
 					if (terark_likely(nodes[p].is_loaded)) {
 						m_stat_cnt[Buffer::hit]++;
 						byte_t* bufptr = m_bufmem + PAGE_SIZE*(p-1) + pg_offset;
@@ -779,7 +952,7 @@ SingleLruReadonlyCache::pread(intptr_t fi, size_t offset, size_t len, Buffer* b)
 				}
 				conflict_len++;
 			}
-			p = alloc_page(hpos, fi_offset_key, &b->cache_type, &fd);
+			p = alloc_page(hpos, fi_offset_key, &b->cache_type, &fd, no_cache, now_ms);
 		}
 		if (0) {
 	OnHitOthersLoad:
@@ -853,6 +1026,7 @@ SingleLruReadonlyCache::pread(intptr_t fi, size_t offset, size_t len, Buffer* b)
 						if (nodes[p].ref_count++ == 0) {
 							Node::lru_remove(nodes, p);
 						}
+						lru_on_hit(p, no_cache, now_ms);
 						m_stat_cnt[Buffer::hit]++;
 						pgvec[pg - first_page].alloc_by_me = false;
 						m_histogram.ensure_get(conflict_len)++;
@@ -860,7 +1034,7 @@ SingleLruReadonlyCache::pread(intptr_t fi, size_t offset, size_t len, Buffer* b)
 					}
 					conflict_len++;
 				}
-				p = alloc_page(hpos, fi_offset_key, &b->cache_type, &fd);
+				p = alloc_page(hpos, fi_offset_key, &b->cache_type, &fd, no_cache, now_ms);
 				missed_cnt++;
 				pgvec[pg - first_page].alloc_by_me = true;
 			CrossPageNext:
@@ -902,21 +1076,52 @@ SingleLruReadonlyCache::pread(intptr_t fi, size_t offset, size_t len, Buffer* b)
 			for (size_t fpg = first_page; fpg < last; ++fpg) {
 				auto  p = pgvec_p[fpg - first_page].page_id;
 				if (0 == --nodes_p[p].ref_count)
-					Node::lru_insert_after(nodes, 0, p);
+					lru_release(p);
 			}
 		);
 		if (missed_cnt > 0) {
-			readpage(first_page, PAGE_SIZE, pg_offset);
-			size_t pg = first_page + 1;
-			for (; pg < plast_page - 1; ++pg) {
-				readpage(pg, PAGE_SIZE, 0);
+			if (m_use_aio && missed_cnt > 1) {
+				// one submit syscall for all missed pages
+				static thread_local recycle_pool<valvec<fiber_aio_req> > tss_req;
+				valvec<fiber_aio_req> reqs = tss_req.get();
+				reqs.erase_all();
+				reqs.reserve(missed_cnt);
+				size_t last_page = plast_page - 1;
+				size_t minlen_last = PAGE_SIZE;
+				for (size_t pg = first_page; pg < plast_page; ++pg) {
+					if (pgvec[pg - first_page].alloc_by_me) {
+						auto p = pgvec[pg - first_page].page_id;
+						fiber_aio_req r;
+						r.buf = m_bufmem + PAGE_SIZE*(p-1);
+						r.len = PAGE_SIZE;
+						r.offset = off_t(pg * PAGE_SIZE);
+						r.ret = -1;
+						r.err = 0;
+						reqs.push_back(r);
+						if (pg == last_page)
+							minlen_last = (offset + len - 1) % PAGE_SIZE + 1;
+					}
+				}
+				assert(reqs.size() == missed_cnt);
+				do_batch_pread(fd, reqs.data(), reqs.size(), minlen_last);
+				for (size_t pg = first_page; pg < plast_page; ++pg) {
+					if (pgvec[pg - first_page].alloc_by_me)
+						nodes[pgvec[pg - first_page].page_id].is_loaded = true;
+				}
+				tss_req.put(std::move(reqs));
 			}
-			readpage(pg, (offset + len - 1) % PAGE_SIZE + 1, 0);
-			assert(unibuf->size() == len);
 			if (missed_cnt > 1) {
 				b->cache_type = Buffer::mix;
 			}
 		}
+		// pages must be copied even if all of them are hit
+		readpage(first_page, PAGE_SIZE, pg_offset);
+		size_t pg = first_page + 1;
+		for (; pg < plast_page - 1; ++pg) {
+			readpage(pg, PAGE_SIZE, 0);
+		}
+		readpage(pg, (offset + len - 1) % PAGE_SIZE + 1, 0);
+		assert(unibuf->size() == len);
 		b->index = 0;
 		tss.put(std::move(pgvec_obj));
 		return unibuf->data();
@@ -955,7 +1160,7 @@ void SingleLruReadonlyCache::discard_impl(const Buffer& b) {
 	assert(f.pgcnt > 0);
 #endif
 	if (0 == --nodes[p].ref_count) {
-		Node::lru_insert_after(nodes, 0, p);
+		lru_release(uint32_t(p));
 	}
 }
 
@@ -1065,25 +1270,27 @@ public:
 	typedef std::lock_guard<MutexType> MutexGuard;
 	MutexType m_mutex;
 
-	explicit MultiLruReadonlyCache(size_t capacityBytes, size_t shards, size_t maxFiles, bool aio) {
+	explicit MultiLruReadonlyCache(size_t capacityBytes, size_t shards, size_t maxFiles, bool aio, Policy policy) {
 		m_shards.reserve(shards);
 		size_t cap_all = align_up(capacityBytes, shards*PAGE_SIZE);
 		size_t cap_one = cap_all / shards;
 		for (size_t i = 0; i < shards; ++i) {
-			m_shards.emplace_back(new SingleLruReadonlyCache(cap_one, maxFiles, aio));
+			m_shards.emplace_back(new SingleLruReadonlyCache(cap_one, maxFiles, aio, policy));
 		}
 	}
 	~MultiLruReadonlyCache() {
 	}
 	static inline
 	size_t get_shard_id(uint64_t fi_page_id, uint32_t n_shards) {
-		uint64_t hash1 = (fi_page_id << 3) | (fi_page_id >> 61);
-		uint64_t hash2 = byte_swap(hash1);
-		return size_t(hash2 % n_shards);
+		// low bits of MyHash are high bits of fi, they are almost always
+		// 0, which maps all pages to shard 0 when n_shards is power of 2
+		uint64_t hash = fi_page_id * 0x9E3779B97F4A7C15ULL;
+		return size_t((hash >> 32) % n_shards);
 	}
 	const byte_t*
 	pread(intptr_t fi, size_t offset, size_t len, Buffer* b) override {
-		const uint64_t fi_at_hi32 = (uint64_t(fi) << 32);
+		// fi may has NoCacheFlag, which is passed to shards
+		const uint64_t fi_at_hi32 = (uint64_t(fi & ~NoCacheFlag) << 32);
 		const uint32_t n_shards = uint32_t(m_shards.size());
 		size_t shard = get_shard_id(fi_at_hi32|(offset>>PAGE_BITS), n_shards);
 		if ((offset & (PAGE_SIZE - 1)) + len <= PAGE_SIZE) {
@@ -1165,19 +1372,23 @@ public:
 };
 
 LruReadonlyCache*
-LruReadonlyCache::create(size_t totalcapacityBytes, size_t shards, size_t maxFiles, bool aio) {
+LruReadonlyCache::create(size_t totalcapacityBytes, size_t shards, size_t maxFiles, bool aio,
+						 Policy policy) {
 	if (g_lruLogLevel >= 3) {
 		fprintf(stderr,
-			"INFO: LruReadonlyCache::create(cap=%zd, shards=%zd, files=%zd, aio=%d)\n",
-			totalcapacityBytes, shards, maxFiles, aio);
+			"INFO: LruReadonlyCache::create(cap=%zd, shards=%zd, files=%zd, aio=%d, policy=%d)\n",
+			totalcapacityBytes, shards, maxFiles, aio, policy);
+	}
+	if (policy > kTinyLFU) {
+		THROW_STD(invalid_argument, "invalid policy = %d", policy);
 	}
 	if (shards <= 1) {
-		return new SingleLruReadonlyCache(totalcapacityBytes, maxFiles, aio);
+		return new SingleLruReadonlyCache(totalcapacityBytes, maxFiles, aio, policy);
 	}
 	if (shards >= 500) {
 		THROW_STD(invalid_argument, "too large shard num = %zd", shards);
 	}
-	return new MultiLruReadonlyCache(totalcapacityBytes, shards, maxFiles, aio);
+	return new MultiLruReadonlyCache(totalcapacityBytes, shards, maxFiles, aio, policy);
 }
 
 } // namespace terark
@@ -34,8 +34,32 @@ public:
 		~Buffer() { discard(); }
 		void discard() { if (index) discard_impl(); }
 	};
+	/// kLRU    : pure lru
+	/// kSLRU   : segmented lru(a 2Q variant), missed pages enter probation
+	///           segment, hit pages are promoted to protected segment(80%),
+	///           so pages touched once by a scan can not evict hot pages
+	/// kTinyLFU: W-TinyLFU, a 1% lru window in front of SLRU, the window
+	///           victim is admitted only if it is more frequent than the
+	///           SLRU victim, frequency is estimated by a count-min sketch
+	/// for kSLRU and kTinyLFU, reads of a page within env
+	/// Terark_lruMinPromoteMs(default 1000) since its last counted access
+	/// are counted as one access, thus reading records of a page one by
+	/// one does not promote the page
+	enum Policy : unsigned char {
+		kLRU,
+		kSLRU,
+		kTinyLFU,
+	};
 	static LruReadonlyCache*
-	create(size_t totalcapacityBytes, size_t shards, size_t maxFiles, bool aio);
+	create(size_t totalcapacityBytes, size_t shards, size_t maxFiles, bool aio,
+		   Policy policy = kLRU);
+
+	/// pread with no_cache(fi) does not pollute the cache: missed pages are
+	/// loaded into the coldest slots which will be evicted first, hit pages
+	/// are not promoted. it can be passed to BlobStore::pread_record* as fi,
+	/// for full scans such as compaction
+	static const intptr_t NoCacheFlag = intptr_t(1) << (sizeof(intptr_t)*8 - 2);
+	static intptr_t no_cache(intptr_t fi) { return fi | NoCacheFlag; }
 
 	virtual const byte_t* pread(intptr_t fi, size_t offset, size_t len, Buffer*) = 0;
 	virtual intptr_t open(intptr_t fd) = 0;
@@ -149,12 +149,16 @@ void MixedLenBlobStoreTpl<rank_select_t>::set_func_ptr() {
 		if (size_t(-1) != m_fixedLen) {
             m_get_record_append = static_cast<get_record_append_func_t>
                       (&MixedLenBlobStoreTpl::getFixLenRecordAppend);
+            m_get_record_view = static_cast<get_record_view_func_t>
+                      (&MixedLenBlobStoreTpl::getFixLenRecordView);
             m_fspread_record_append = static_cast<fspread_record_append_func_t>
                       (&MixedLenBlobStoreTpl::fspread_FixLenRecordAppend);
 		}
 		else {
             m_get_record_append = static_cast<get_record_append_func_t>
                       (&MixedLenBlobStoreTpl::getVarLenRecordAppend);
+            m_get_record_view = static_cast<get_record_view_func_t>
+                      (&MixedLenBlobStoreTpl::getVarLenRecordView);
             m_fspread_record_append = static_cast<fspread_record_append_func_t>
                       (&MixedLenBlobStoreTpl::fspread_VarLenRecordAppend);
 		}
@@ -162,6 +166,8 @@ void MixedLenBlobStoreTpl<rank_select_t>::set_func_ptr() {
 	else {
         m_get_record_append = static_cast<get_record_append_func_t>
                   (&MixedLenBlobStoreTpl::get_record_append_has_fixed_rs);
+        m_get_record_view = static_cast<get_record_view_func_t>
+                  (&MixedLenBlobStoreTpl::get_record_view_has_fixed_rs);
         m_fspread_record_append = static_cast<fspread_record_append_func_t>
                     (&MixedLenBlobStoreTpl::fspread_record_append_has_fixed_rs);
 	}
@@ -187,7 +193,20 @@ get_record_append_has_fixed_rs(size_t recID, valvec<byte_t>* recData) const {
 }
 
 template<class rank_select_t>
-void MixedLenBlobStoreTpl<rank_select_t>::getFixLenRecordAppend(size_t fixLenRecID, valvec<byte_t>* recData)
+fstring
+MixedLenBlobStoreTpl<rank_select_t>::
+get_record_view_has_fixed_rs(size_t recID) const {
+	assert(m_isFixedLen.size() == m_numRecords);
+	if (m_isFixedLen[recID]) {
+		return getFixLenRecordView(m_isFixedLen.rank1(recID));
+	}
+	else {
+		return getVarLenRecordView(m_isFixedLen.rank0(recID));
+	}
+}
+
+template<class rank_select_t>
+fstring MixedLenBlobStoreTpl<rank_select_t>::getFixLenRecordView(size_t fixLenRecID)
 const {
 	assert(size_t(-1) != m_fixedLen);
 	assert(m_fixedLen == 0 || m_fixedLenValues.size() % m_fixedLen == 0);
@@ -211,11 +230,18 @@ const {
             }
         }
     }
-	recData->append(pData, m_fixedLenWithoutCRC);
+	return fstring(pData, m_fixedLenWithoutCRC);
 }
 
 template<class rank_select_t>
-void MixedLenBlobStoreTpl<rank_select_t>::getVarLenRecordAppend(size_t varLenRecID, valvec<byte_t>* recData)
+void MixedLenBlobStoreTpl<rank_select_t>::getFixLenRecordAppend(size_t fixLenRecID, valvec<byte_t>* recData)
+const {
+	fstring rec = getFixLenRecordView(fixLenRecID);
+	recData->append(rec.udata(), rec.size());
+}
+
+template<class rank_select_t>
+fstring MixedLenBlobStoreTpl<rank_select_t>::getVarLenRecordView(size_t varLenRecID)
 const {
 	assert(varLenRecID + 1 < m_varLenOffsets.size());
 	auto   basePtr = m_varLenValues.data();
@@ -245,7 +271,14 @@ const {
             }
         }
     }
-	recData->append(pData, nData);
+	return fstring(pData, nData);
+}
+
+template<class rank_select_t>
+void MixedLenBlobStoreTpl<rank_select_t>::getVarLenRecordAppend(size_t varLenRecID, valvec<byte_t>* recData)
+const {
+	fstring rec = getVarLenRecordView(varLenRecID);
+	recData->append(rec.udata(), rec.size());
 }
 
 template<class rank_select_t>
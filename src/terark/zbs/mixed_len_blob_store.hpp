@@ -17,11 +17,14 @@ class TERARK_DLL_EXPORT MixedLenBlobStoreTpl : public AbstractBlobStore {
 	terark::valvec<byte_t> m_varLenValues;
 	terark::UintVecMin0    m_varLenOffsets;
 
+	fstring getFixLenRecordView(size_t fixLenRecID) const;
+	fstring getVarLenRecordView(size_t varLenRecID) const;
 	void getFixLenRecordAppend(size_t fixLenRecID, valvec<byte_t>* recData) const;
 	void getVarLenRecordAppend(size_t varLenRecID, valvec<byte_t>* recData) const;
 
     void set_func_ptr();
     void get_record_append_has_fixed_rs(size_t recID, valvec<byte_t>* recData) const;
+    fstring get_record_view_has_fixed_rs(size_t recID) const;
 
     void fspread_record_append_has_fixed_rs(
                         pread_func_t fspread, void* lambda,
@@ -125,7 +125,7 @@ void PlainBlobStore::detach_meta_blocks(const valvec<fstring>& blocks) {
     } else {
         m_offsets.clear();
     }
-    m_offsets.risk_set_data((byte_t*)offset_mem.data() + align_up(m_content.size(), 16),
+    m_offsets.risk_set_data((byte_t*)offset_mem.data(),
         m_numRecords + 1, ((const FileHeader*)m_mmapBase)->offsetsUintBits);
     m_isDetachMeta = true;
 }
@@ -159,6 +159,8 @@ PlainBlobStore::PlainBlobStore() {
     m_checksumType = 0;
     m_get_record_append = static_cast<get_record_append_func_t>
                     (&PlainBlobStore::get_record_append_imp);
+    m_get_record_view = static_cast<get_record_view_func_t>
+                    (&PlainBlobStore::get_record_view_imp);
     m_fspread_record_append = static_cast<fspread_record_append_func_t>
                     (&PlainBlobStore::fspread_record_append_imp);
     // binary compatible:
@@ -204,8 +206,21 @@ size_t PlainBlobStore::mem_size() const {
     return m_content.size() + m_offsets.mem_size();
 }
 
-void
-PlainBlobStore::get_record_append_imp(size_t recID, valvec<byte_t>* recData)
+bool
+PlainBlobStore::get_records_file_range(const size_t* sortedIds, size_t n,
+                                       size_t* ranges)
+const {
+    for (size_t i = 0; i < n; ++i) {
+        assert(sortedIds[i] + 1 < m_offsets.size());
+        m_offsets.get2(sortedIds[i], ranges + 2*i);
+        ranges[2*i+0] += sizeof(FileHeader);
+        ranges[2*i+1] += sizeof(FileHeader);
+    }
+    return true;
+}
+
+fstring
+PlainBlobStore::get_record_view_imp(size_t recID)
 const {
     assert(recID + 1 < m_offsets.size());
     size_t BegEnd[2];
@@ -233,7 +248,14 @@ const {
             }
         }
     }
-    recData->append(p, len);
+    return fstring(p, len);
+}
+
+void
+PlainBlobStore::get_record_append_imp(size_t recID, valvec<byte_t>* recData)
+const {
+    fstring rec = get_record_view_imp(recID);
+    recData->append(rec.udata(), rec.size());
 }
 
 void
@@ -20,6 +20,7 @@ class TERARK_DLL_EXPORT PlainBlobStore : public AbstractBlobStore {
     valvec<byte_t> m_content;
     UintVecMin0    m_offsets;
 
+    fstring get_record_view_imp(size_t recID) const;
     void get_record_append_imp(size_t recID, valvec<byte_t>* recData) const;
     void fspread_record_append_imp(pread_func_t fspread, void* lambda,
                                    size_t baseOffset, size_t recID,
@@ -39,6 +40,8 @@ public:
     void take(fstrvec& vec);
 
     size_t mem_size() const override;
+    bool get_records_file_range(const size_t* sortedIds, size_t n,
+                                size_t* ranges) const override;
     void reorder_zip_data(ZReorderMap& newToOld,
         function<void(const void* data, size_t size)> writeAppend,
         fstring tmpFile) const override;
@@ -10,6 +10,10 @@
 #include <terark/fsa/double_array_trie.hpp>
 #include <terark/util/hugepage.hpp>
 #include <terark/util/profiling.hpp>
+#include <thread>
+#if defined(TERARK_DIVSUFSORT_OPENMP)
+#include <omp.h>
+#endif
 
 namespace terark {
 
@@ -194,7 +198,7 @@ SuffixDictCacheDFA::SuffixDictCacheDFA() {
 SuffixDictCacheDFA::~SuffixDictCacheDFA() {
 }
 
-void SuffixDictCacheDFA::build_sa(valvec<byte>& str) {
+void SuffixDictCacheDFA::build_sa(valvec<byte>& str, size_t numThreads) {
 	profiling pf;
 	size_t nStrLen = str.size();
 	size_t nStrLenAligned = align_up(str.size(), sizeof(saidx_t));
@@ -211,6 +215,23 @@ void SuffixDictCacheDFA::build_sa(valvec<byte>& str) {
 	m_sa_size = nStrLen;
 	m_str = str.data();
 	llong t0 = pf.now();
+#if defined(TERARK_DIVSUFSORT_OPENMP)
+	// type B* suffixes are sorted in parallel by openmp threads, other
+	// steps of divsufsort are serial, it is faster than SAIS on >= 2 threads
+	const bool parallel = numThreads > 1;
+	if (parallel) {
+		// divsufsort has no num_threads param, set and restore the
+		// calling thread's default, other threads are not affected
+		int oldNumThreads = omp_get_max_threads();
+		omp_set_num_threads(int(numThreads));
+		divsufsort((byte*)str.data(), sa_data, nStrLen, 1);
+		omp_set_num_threads(oldNumThreads);
+	}
+	else
+#else
+	const bool parallel = false;
+	TERARK_UNUSED_VAR(numThreads);
+#endif
 	if (g_useDivSufSort == 1)
 		divsufsort((byte*)str.data(), sa_data, nStrLen, 0);
 	else
@@ -219,7 +240,9 @@ void SuffixDictCacheDFA::build_sa(valvec<byte>& str) {
 	if (g_suffixDictShowState) {
 		printf("SuffixDictCacheDFA::build_sa(): g_useHugePage = %d\n"
 			"%s: %zd bytes, time: %f seconds, through-put: %f MB/s\n"
-			, g_useHugePage, g_useDivSufSort == 1 ? "divsufsort" : "SAIS"
+			, g_useHugePage
+			, parallel ? "parallel divsufsort" :
+			  g_useDivSufSort == 1 ? "divsufsort" : "SAIS"
 			, nStrLen, pf.sf(t0,t1), nStrLen/pf.uf(t0,t1));
 	}
 }
@@ -255,20 +278,27 @@ struct SuffixDictCacheDFA::BfsQueueElem {
 	uint32_t state;
 };
 void
-SuffixDictCacheDFA::bfs_build_cache(size_t minFreq, size_t maxBfsDepth) {
+SuffixDictCacheDFA::bfs_build_cache(size_t minFreq, size_t maxBfsDepth,
+                                    size_t numThreads) {
 #ifdef SuffixDictCacheDebug
 	auto trie = new MyBitmapSmartTrie();
 	m_bm.reset(trie);
-	tpl_bfs_build_cache(trie, minFreq, maxBfsDepth);
+	tpl_bfs_build_cache(trie, minFreq, maxBfsDepth, numThreads);
 	m_bm.reset();
 #else
 	std::unique_ptr<MyAppendOnlyTrie> trie(new MyAppendOnlyTrie());
-	tpl_bfs_build_cache(trie.get(), minFreq, maxBfsDepth);
+	tpl_bfs_build_cache(trie.get(), minFreq, maxBfsDepth, numThreads);
 #endif
 }
+
+// a bfs depth is expanded by multiple threads only if each thread has
+// at least so many parents
+static const size_t ParallelBfsMinParents = 256;
+
 template<class TrieClass>
 void
-SuffixDictCacheDFA::tpl_bfs_build_cache(TrieClass* trie, size_t minFreq, size_t maxBfsDepth) {
+SuffixDictCacheDFA::tpl_bfs_build_cache(TrieClass* trie, size_t minFreq,
+                                        size_t maxBfsDepth, size_t numThreads) {
 	profiling pf;
 	long long t0 = pf.now();
 {
@@ -282,45 +312,110 @@ SuffixDictCacheDFA::tpl_bfs_build_cache(TrieClass* trie, size_t minFreq, size_t
 	trie->states[0].m_suffixHig = sa_size;
 	AutoFree<CharTarget<size_t> > children(trie->sigma);
 	valvec<BfsQueueElem> q1, q2;
+	struct BfsChild {
+		byte_t   ch;
+		uint32_t lo, hi;
+	};
+	// expanding result of a parent, children are in a BfsChild vector
+	struct BfsExpand {
+		uint32_t depth; // matching depth after zpath
+		uint32_t zlen;  // 0 for no zpath
+		uint32_t childEnd;
+	};
+	// expanding does not modify trie, so parents can be expanded by
+	// threads, then children are added to trie in the same order as
+	// serial expanding, thus the result is identical
+	auto expand = [&](BfsQueueElem e, valvec<BfsChild>& cv) {
+		size_t lo = trie->states[e.state].m_suffixLow;
+		size_t hi = trie->states[e.state].m_suffixHig;
+		size_t depth = e.depth;
+		size_t zlen = 0;
+		if (sa[lo] + depth < sa_size) {
+			size_t saLo = sa[lo];
+			size_t saHi = sa[hi-1];
+			if (str[saLo + depth] == str[saHi + depth]) {
+				size_t maxPos = std::min(saLo + depth + MaxDepth, sa_size);
+				do ++depth;
+				while (	    saLo + depth  < maxPos &&
+						str[saLo + depth] == str[saHi + depth] );
+				zlen = depth - e.depth;
+			}
+		}
+		if (sa[lo] + depth >= sa_size) {
+			lo++;
+		}
+		while (lo < hi) {
+			byte_t c = str[sa[lo] + depth];
+			size_t u = sa_upper_bound(lo, hi, depth, c);
+			if (u - lo >= minFreq) {
+				cv.push_back({c, uint32_t(lo), uint32_t(u)});
+			}
+			lo = u;
+		}
+		return BfsExpand{uint32_t(depth), uint32_t(zlen), uint32_t(cv.size())};
+	};
+	auto add_children = [&](BfsQueueElem e, BfsExpand x, const BfsChild* cv, size_t childcnt) {
+		if (x.zlen) {
+			trie->states[e.state].setZstrLen(x.zlen);
+		//	trie->states[e.state].set_pzip_bit();
+		}
+		for (size_t i = 0; i < childcnt; ++i) {
+			size_t child = trie->new_state();
+			q2.push_back({x.depth + 1, uint32_t(child)});
+			children[i].ch = cv[i].ch;
+			children[i].target = child;
+			trie->states[child].m_suffixLow = cv[i].lo;
+			trie->states[child].m_suffixHig = cv[i].hi;
+		}
+		trie->add_all_move(e.state, children, childcnt);
+	};
+	struct BfsPart {
+		valvec<BfsExpand> parents;
+		valvec<BfsChild>  children;
+	};
+	valvec<BfsPart> parts;
+	valvec<BfsChild> cv;
 	q1.push_back({0, 0});
 	size_t bfsDepth = 0;
 	while (!q1.empty() && bfsDepth < maxBfsDepth) {
-		for(auto e : q1) {
-			size_t lo = trie->states[e.state].m_suffixLow;
-			size_t hi = trie->states[e.state].m_suffixHig;
-			size_t depth = e.depth;
-			if (sa[lo] + depth < sa_size) {
-				size_t saLo = sa[lo];
-				size_t saHi = sa[hi-1];
-				if (str[saLo + depth] == str[saHi + depth]) {
-					size_t maxPos = std::min(saLo + depth + MaxDepth, sa_size);
-					do ++depth;
-					while (	    saLo + depth  < maxPos &&
-							str[saLo + depth] == str[saHi + depth] );
-					trie->states[e.state].setZstrLen(depth - e.depth);
-				//	trie->states[e.state].set_pzip_bit();
-				}
+		size_t nth = std::min(numThreads, q1.size() / ParallelBfsMinParents);
+		if (nth > 1) {
+			parts.resize(nth);
+			auto thread_fun = [&](size_t tid) {
+				BfsPart& part = parts[tid];
+				part.parents.erase_all();
+				part.children.erase_all();
+				size_t beg = q1.size() * tid / nth;
+				size_t end = q1.size() * (tid + 1) / nth;
+				for (size_t i = beg; i < end; ++i)
+					part.parents.push_back(expand(q1[i], part.children));
+			};
+			valvec<std::thread> thrVec(nth - 1, valvec_reserve());
+			for (size_t i = 0; i + 1 < nth; ++i) {
+				thrVec.unchecked_emplace_back([&,i](){thread_fun(i);});
 			}
-			if (sa[lo] + depth >= sa_size) {
-				lo++;
+			thread_fun(nth - 1); // last partition
+			for (auto& t : thrVec) {
+				t.join();
 			}
-			size_t childcnt = 0;
-			while (lo < hi) {
-				byte_t c = str[sa[lo] + depth];
-				size_t u = sa_upper_bound(lo, hi, depth, c);
-				if (u - lo >= minFreq) {
-					size_t child = trie->new_state();
-					q2.push_back({uint32_t(depth) + 1, uint32_t(child)});
-					children[childcnt].ch = c;
-					children[childcnt].target = child;
-					trie->states[child].m_suffixLow = lo;
-					trie->states[child].m_suffixHig = u;
-					childcnt++;
+			size_t k = 0;
+			for (BfsPart& part : parts) {
+				size_t childBeg = 0;
+				for (BfsExpand x : part.parents) {
+					add_children(q1[k++], x, part.children.data() + childBeg,
+								 x.childEnd - childBeg);
+					childBeg = x.childEnd;
 				}
-				lo = u;
 			}
-			trie->add_all_move(e.state, children, childcnt);
-		//	int keepStackFrameForMSVC = 1;
+			assert(q1.size() == k);
+		}
+		else {
+			for(auto e : q1) {
+				cv.erase_all();
+				BfsExpand x = expand(e, cv);
+				add_children(e, x, cv.data(), cv.size());
+			//	int keepStackFrameForMSVC = 1;
+			}
 		}
 		q1.swap(q2);
 		q2.erase_all();
@@ -1027,7 +1122,8 @@ HashSuffixDictCacheDFA::~HashSuffixDictCacheDFA() {
 }
 
 void
-HashSuffixDictCacheDFA::bfs_build_cache(size_t minFreq, size_t maxBfsDepth) {
+HashSuffixDictCacheDFA::bfs_build_cache(size_t minFreq, size_t maxBfsDepth,
+                                        size_t /*numThreads*/) {
 	auto sa = m_sa_data;
 	auto str = m_str;
 	auto sa_size = m_sa_size;
@@ -29,13 +29,17 @@ protected:
 	std::unique_ptr<MyDoubleArrayTrie> m_da;
 	struct BfsQueueElem;
 	template<class TrieClass>
-	void tpl_bfs_build_cache(TrieClass*, size_t minFreq, size_t maxBfsDepth);
+	void tpl_bfs_build_cache(TrieClass*, size_t minFreq, size_t maxBfsDepth,
+	                         size_t numThreads);
 public:
 	SuffixDictCacheDFA();
 	virtual ~SuffixDictCacheDFA();
-	void build_sa(valvec<byte>& str);
+	/// numThreads > 1 uses parallel divsufsort if it is built with openmp,
+	/// suffix array is unique, so it is same as single thread
+	void build_sa(valvec<byte>& str, size_t numThreads = 1);
+	/// the cache dfa is identical for any numThreads
 	SuffixDictCacheDFA_virtual
-	void bfs_build_cache(size_t minFreq, size_t maxBfsDepth);
+	void bfs_build_cache(size_t minFreq, size_t maxBfsDepth, size_t numThreads = 1);
 #ifdef SuffixDictCacheDebug
 	SuffixDictCacheDFA_virtual
 	void pfs_build_cache(size_t minFreq);
@@ -93,7 +97,7 @@ class TERARK_DLL_EXPORT HashSuffixDictCacheDFA : public SuffixDictCacheDFA {
 public:
 	HashSuffixDictCacheDFA();
 	~HashSuffixDictCacheDFA();
-	void bfs_build_cache(size_t minFreq, size_t maxBfsDepth) override;
+	void bfs_build_cache(size_t minFreq, size_t maxBfsDepth, size_t numThreads) override;
 	void pfs_build_cache(size_t minFreq) override;
 	MatchStatus da_match_max_length(const byte*, size_t len) const noexcept override;
 };
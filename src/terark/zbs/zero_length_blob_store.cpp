@@ -50,6 +50,8 @@ void ZeroLengthBlobStore::save_mmap(function<void(const void*, size_t)> write) c
 ZeroLengthBlobStore::ZeroLengthBlobStore() {
     m_get_record_append = static_cast<get_record_append_func_t>
                (&ZeroLengthBlobStore::get_record_append_imp);
+    m_get_record_view = static_cast<get_record_view_func_t>
+               (&ZeroLengthBlobStore::get_record_view_imp);
     // binary compatible:
     m_get_record_append_CacheOffsets =
         reinterpret_cast<get_record_append_CacheOffsets_func_t>
@@ -83,6 +85,13 @@ const {
     assert(recID < m_numRecords);
 }
 
+fstring
+ZeroLengthBlobStore::get_record_view_imp(size_t recID)
+const {
+    assert(recID < m_numRecords);
+    return fstring();
+}
+
 void
 ZeroLengthBlobStore::fspread_record_append_imp(
     pread_func_t fspread, void* lambda,
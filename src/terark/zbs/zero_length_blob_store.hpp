@@ -32,6 +32,7 @@ public:
 
     size_t mem_size() const override;
     void get_record_append_imp(size_t recID, valvec<byte_t>* recData) const;
+    fstring get_record_view_imp(size_t recID) const;
     void fspread_record_append_imp(
         pread_func_t fspread, void* lambda,
         size_t baseOffset, size_t recID,
@@ -220,6 +220,17 @@ static void ZipOffsetBlobStore_AppendDecompress(size_t id, const byte_t* data, s
   output->risk_set_size(curr_size + size);
 }
 
+bool
+ZipOffsetBlobStore::get_records_file_range(const size_t* sortedIds, size_t n,
+                                           size_t* ranges)
+const {
+    m_offsets.get2_sorted(sortedIds, n, ranges);
+    for (size_t i = 0; i < 2*n; ++i) {
+        ranges[i] += sizeof(FileHeader);
+    }
+    return true;
+}
+
 void
 ZipOffsetBlobStore::get_record_append_imp(size_t recID, valvec<byte_t>* recData)
 const {
@@ -351,7 +362,7 @@ const {
     TERARK_UNUSED_VAR(recNum);
     size_t offset = 0;
     auto zipOffsetBuilder = std::unique_ptr<SortedUintVec::Builder>(
-        SortedUintVec::createBuilder(m_offsets.block_units(), tmpFile.c_str()));
+        SortedUintVec::createBuilder(m_offsets.build_units(), tmpFile.c_str()));
 #if !defined(NDEBUG)
     size_t maxOffsetEnt = m_offsets[recNum];
 #endif
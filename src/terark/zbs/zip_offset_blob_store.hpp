@@ -34,7 +34,7 @@ public:
 
     struct Options {
       Options() : block_units(128), compress_level(0), checksum_level(3), checksum_type(0) {}
-      int block_units;
+      int block_units; // 64 or 128, may OR SortedUintVec::kEliasFano
       int compress_level;
       int checksum_level;
       int checksum_type;
@@ -50,6 +50,8 @@ public:
     using AbstractBlobStore::save_mmap;
 
     size_t mem_size() const override;
+    bool get_records_file_range(const size_t* sortedIds, size_t n,
+                                size_t* ranges) const override;
     void reorder_zip_data(ZReorderMap& newToOld,
         function<void(const void* data, size_t size)> writeAppend,
         fstring tmpFile) const override;
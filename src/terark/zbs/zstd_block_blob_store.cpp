@@ -0,0 +1,696 @@
+#include "zstd_block_blob_store.hpp"
+#include "blob_store_file_header.hpp"
+#include "zip_reorder_map.hpp"
+#include <terark/io/FileStream.hpp>
+#include <terark/io/MemStream.hpp>
+#include <terark/io/IStreamWrapper.hpp>
+#include <terark/util/checksum_exception.hpp>
+#include <terark/util/mmap.hpp>
+#include <terark/zbs/xxhash_helper.hpp>
+#include <terark/io/StreamBuffer.hpp>
+#define ZSTD_STATIC_LINKING_ONLY // ZSTD_compress_advanced, ZSTD_createCDict_advanced
+#include <zstd/zstd.h>
+#include <zstd/dictBuilder/zdict.h>
+
+namespace terark {
+
+REGISTER_BlobStore(ZstdBlockBlobStore, "ZstdBlockBlobStore");
+
+static const uint64_t g_zbbs_seed = 0x53424b6c42647453ull; // echo StdBlkBS | od -t x8
+
+struct ZstdBlockBlobStore::FileHeader : public FileHeaderBase {
+    uint64_t  contentBytes;
+    uint64_t  dictBytes;
+    uint64_t  blockOffsetsBytes;
+    uint64_t  recOffsetsBytes;
+    uint32_t  blockRecords;
+    uint08_t  checksumLevel;
+    uint08_t  compressLevel;
+    uint08_t  padding21[2];
+    uint64_t  padding22;
+
+    void init() {
+        BOOST_STATIC_ASSERT(sizeof(FileHeader) == 128);
+        memset(this, 0, sizeof(*this));
+        magic_len = MagicStrLen;
+        strcpy(magic, MagicString);
+        strcpy(className, "ZstdBlockBlobStore");
+    }
+    void set_sizes(size_t content_size, size_t dict_size,
+                   size_t boffs_size, size_t roffs_size) {
+        contentBytes = content_size;
+        dictBytes = dict_size;
+        blockOffsetsBytes = boffs_size;
+        recOffsetsBytes = roffs_size;
+        fileSize = 0
+            + sizeof(FileHeader)
+            + align_up(content_size, 16)
+            + align_up(dict_size, 16)
+            + boffs_size
+            + roffs_size
+            + sizeof(BlobStoreFileFooter);
+    }
+    FileHeader(size_t records_, size_t unzip_size,
+               size_t content_size, size_t dict_size,
+               size_t boffs_size, size_t roffs_size, const Options& opt) {
+        init();
+        set_sizes(content_size, dict_size, boffs_size, roffs_size);
+        unzipSize = unzip_size;
+        records = records_;
+        blockRecords = static_cast<uint32_t>(opt.block_records);
+        checksumLevel = static_cast<uint08_t>(opt.checksum_level);
+        compressLevel = static_cast<uint08_t>(opt.compress_level);
+    }
+    explicit FileHeader(const ZstdBlockBlobStore* store) {
+        init();
+        set_sizes(store->m_content.size(), store->m_dict.size(),
+                  store->m_blockOffsets.mem_size(),
+                  store->m_recOffsets.mem_size());
+        unzipSize = store->m_unzipSize;
+        records = store->m_numRecords;
+        blockRecords = static_cast<uint32_t>(store->m_blockRecords);
+        checksumLevel = static_cast<uint08_t>(store->m_checksumLevel);
+        checksumType = static_cast<uint08_t>(store->m_checksumType);
+        compressLevel = static_cast<uint08_t>(store->m_compressLevel);
+    }
+};
+
+/// Per thread, per store cache of decoded blocks, direct mapped by blockId
+struct ZstdBlockBlobStore::BlockCache : boost::noncopyable {
+    static const size_t kBlocks = 4;
+    struct Entry {
+        size_t blockId = size_t(-1);
+        valvec<byte_t> data;
+    };
+    Entry      slots[kBlocks];
+    ZSTD_DCtx* dctx = nullptr;
+    ~BlockCache() {
+        if (dctx)
+            ZSTD_freeDCtx(dctx);
+    }
+};
+
+void ZstdBlockBlobStore::Options::set_config(fstring conf) {
+    valvec<fstring> items;
+    conf.split(';', &items);
+    for (fstring item : items) {
+        if (item.empty())
+            continue;
+        std::string kv = item.str();
+        size_t eq = kv.find('=');
+        if (std::string::npos == eq) {
+            THROW_STD(invalid_argument, "bad config item: %s", kv.c_str());
+        }
+        std::string key = kv.substr(0, eq);
+        size_t val = (size_t)strtoull(kv.c_str() + eq + 1, NULL, 10);
+        if (key == "block_records")
+            block_records = val;
+        else if (key == "block_bytes")
+            block_bytes = val;
+        else if (key == "compress_level")
+            compress_level = (int)strtol(kv.c_str() + eq + 1, NULL, 10);
+        else if (key == "dict_size")
+            dict_size = val;
+        else if (key == "sample_bytes")
+            sample_bytes = val;
+        else if (key == "checksum_level")
+            checksum_level = (int)val;
+        else
+            THROW_STD(invalid_argument, "unknown config key: %s", key.c_str());
+    }
+    check_compress_level(compress_level);
+}
+
+// FileHeader::compressLevel is uint8, and the bundled zstd has no
+// negative (fast) levels
+void ZstdBlockBlobStore::Options::check_compress_level(int level) {
+    if (level < 1 || level > ZSTD_maxCLevel()) {
+        THROW_STD(invalid_argument, "compress_level = %d, must be in [1, %d]",
+                  level, ZSTD_maxCLevel());
+    }
+}
+
+void ZstdBlockBlobStore::init_from_memory(fstring dataMem, Dictionary/*dict*/) {
+    auto mmapBase = (const FileHeader*)dataMem.p;
+    m_mmapBase = mmapBase;
+    m_numRecords = mmapBase->records;
+    m_unzipSize = mmapBase->unzipSize;
+    m_checksumLevel = mmapBase->checksumLevel;
+    m_checksumType = mmapBase->checksumType;
+    m_compressLevel = mmapBase->compressLevel;
+    m_blockRecords = mmapBase->blockRecords;
+    if (m_checksumLevel == 3 && isChecksumVerifyEnabled()) {
+        XXHash64 hash(g_zbbs_seed);
+        hash.update(mmapBase, mmapBase->fileSize - sizeof(BlobStoreFileFooter));
+        const uint64_t hashVal = hash.digest();
+        auto &footer = ((const BlobStoreFileFooter*)((const byte_t*)(mmapBase) + mmapBase->fileSize))[-1];
+        if (hashVal != footer.fileXXHash) {
+            std::string msg = "ZstdBlockBlobStore::load_mmap(\"" + m_fpath + "\")";
+            throw BadChecksumException(msg, footer.fileXXHash, hashVal);
+        }
+    }
+    if (0 == m_blockRecords) {
+        TERARK_THROW(std::invalid_argument, "blockRecords must not be 0");
+    }
+    byte_t* p = (byte_t*)(mmapBase + 1);
+    m_content.risk_set_data(p, mmapBase->contentBytes);
+    p += align_up(mmapBase->contentBytes, 16);
+    m_dict.risk_set_data(p, mmapBase->dictBytes);
+    p += align_up(mmapBase->dictBytes, 16);
+    m_blockOffsets.risk_set_data(p, mmapBase->blockOffsetsBytes);
+    p += mmapBase->blockOffsetsBytes;
+    m_recOffsets.risk_set_data(p, mmapBase->recOffsetsBytes);
+    size_t numBlocks = (m_numRecords + m_blockRecords - 1) / m_blockRecords;
+    if (m_blockOffsets.size() != numBlocks + 1) {
+        TERARK_THROW(std::length_error
+            , "m_blockOffsets.size() = %zd, numBlocks+1 = %zd, must be equal"
+            ,  m_blockOffsets.size(), numBlocks + 1
+        );
+    }
+    if (m_recOffsets.size() != m_numRecords + 1) {
+        TERARK_THROW(std::length_error
+            , "m_recOffsets.size() = %zd, mmapBase->records+1 = %lld, must be equal"
+            ,  m_recOffsets.size(), llong(m_numRecords + 1)
+        );
+    }
+    if (!m_dict.empty()) {
+        m_ddict = ZSTD_createDDict(m_dict.data(), m_dict.size());
+        TERARK_VERIFY(nullptr != m_ddict);
+    }
+}
+
+void ZstdBlockBlobStore::get_meta_blocks(valvec<fstring>* blocks) const {
+    blocks->erase_all();
+    blocks->emplace_back(m_dict);
+    blocks->emplace_back(m_blockOffsets.data(), m_blockOffsets.mem_size());
+    blocks->emplace_back(m_recOffsets.data(), m_recOffsets.mem_size());
+}
+
+void ZstdBlockBlobStore::get_data_blocks(valvec<fstring>* blocks) const {
+    blocks->erase_all();
+    blocks->emplace_back(m_content);
+}
+
+void ZstdBlockBlobStore::detach_meta_blocks(const valvec<fstring>& blocks) {
+    assert(!m_isDetachMeta);
+    assert(blocks.size() == 3);
+    assert(blocks[0].size() == m_dict.size());
+    assert(blocks[1].size() == m_blockOffsets.mem_size());
+    assert(blocks[2].size() == m_recOffsets.mem_size());
+    if (m_isUserMem) {
+        m_dict.risk_release_ownership();
+        m_blockOffsets.risk_release_ownership();
+        m_recOffsets.risk_release_ownership();
+    } else {
+        m_dict.clear();
+        m_blockOffsets.clear();
+        m_recOffsets.clear();
+    }
+    // m_ddict holds its own copy of the dictionary
+    m_dict.risk_set_data((byte_t*)blocks[0].data(), blocks[0].size());
+    m_blockOffsets.risk_set_data((byte_t*)blocks[1].data(), blocks[1].size());
+    m_recOffsets.risk_set_data((byte_t*)blocks[2].data(), blocks[2].size());
+    m_isDetachMeta = true;
+}
+
+void ZstdBlockBlobStore::save_mmap(function<void(const void*, size_t)> write) const {
+    FunctionAdaptBuffer adaptBuffer(write);
+    OutputBuffer buffer(&adaptBuffer);
+
+    XXHash64 xxhash64(g_zbbs_seed);
+    FileHeader header(this);
+
+    xxhash64.update(&header, sizeof header);
+    buffer.ensureWrite(&header, sizeof(header));
+
+    xxhash64.update(m_content.data(), m_content.size());
+    buffer.ensureWrite(m_content.data(), m_content.size());
+    PadzeroForAlign<16>(buffer, xxhash64, m_content.size());
+
+    xxhash64.update(m_dict.data(), m_dict.size());
+    buffer.ensureWrite(m_dict.data(), m_dict.size());
+    PadzeroForAlign<16>(buffer, xxhash64, m_dict.size());
+
+    xxhash64.update(m_blockOffsets.data(), m_blockOffsets.mem_size());
+    buffer.ensureWrite(m_blockOffsets.data(), m_blockOffsets.mem_size());
+
+    xxhash64.update(m_recOffsets.data(), m_recOffsets.mem_size());
+    buffer.ensureWrite(m_recOffsets.data(), m_recOffsets.mem_size());
+
+    BlobStoreFileFooter footer;
+    footer.fileXXHash = xxhash64.digest();
+    buffer.ensureWrite(&footer, sizeof footer);
+}
+
+ZstdBlockBlobStore::ZstdBlockBlobStore() {
+    m_checksumLevel = 3; // check all data
+    m_checksumType = 0;
+    m_compressLevel = 0;
+    m_blockRecords = 0;
+    m_ddict = nullptr;
+    m_get_record_append = static_cast<get_record_append_func_t>
+                (&ZstdBlockBlobStore::get_record_append_imp);
+    m_fspread_record_append = static_cast<fspread_record_append_func_t>
+                (&ZstdBlockBlobStore::fspread_record_append_imp);
+    m_get_record_append_CacheOffsets =
+        static_cast<get_record_append_CacheOffsets_func_t>
+        (&ZstdBlockBlobStore::get_record_append_CacheOffsets);
+}
+
+ZstdBlockBlobStore::~ZstdBlockBlobStore() {
+    if (m_ddict) {
+        ZSTD_freeDDict(m_ddict);
+    }
+    if (m_isDetachMeta) {
+        m_dict.risk_release_ownership();
+        m_blockOffsets.risk_release_ownership();
+        m_recOffsets.risk_release_ownership();
+    }
+    if (m_isUserMem) {
+        if (m_isMmapData) {
+            mmap_close((void*)m_mmapBase, m_mmapBase->fileSize);
+        }
+        m_mmapBase = nullptr;
+        m_isMmapData = false;
+        m_isUserMem = false;
+        m_content.risk_release_ownership();
+        m_dict.risk_release_ownership();
+        m_blockOffsets.risk_release_ownership();
+        m_recOffsets.risk_release_ownership();
+    }
+    else {
+        m_content.clear();
+        m_dict.clear();
+        m_blockOffsets.clear();
+        m_recOffsets.clear();
+    }
+}
+
+size_t ZstdBlockBlobStore::mem_size() const {
+    return m_content.size() + m_dict.size()
+         + m_blockOffsets.mem_size() + m_recOffsets.mem_size();
+}
+
+bool
+ZstdBlockBlobStore::get_records_file_range(const size_t* sortedIds, size_t n,
+                                           size_t* ranges)
+const {
+    size_t lastBlock = size_t(-1);
+    size_t BegEnd[2] = {0, 0};
+    for (size_t i = 0; i < n; ++i) {
+        size_t blockId = sortedIds[i] / m_blockRecords;
+        if (blockId != lastBlock) {
+            m_blockOffsets.get2(blockId, BegEnd);
+            lastBlock = blockId;
+        }
+        ranges[2*i+0] = sizeof(FileHeader) + BegEnd[0];
+        ranges[2*i+1] = sizeof(FileHeader) + BegEnd[1];
+    }
+    return true;
+}
+
+void
+ZstdBlockBlobStore::decode_block(size_t blockId, size_t rawBeg,
+                                 const byte_t* zdata, size_t zlen,
+                                 valvec<byte_t>* block)
+const {
+    size_t lastRec = std::min((blockId + 1) * m_blockRecords, m_numRecords);
+    size_t rawLen = m_recOffsets[lastRec] - rawBeg;
+    BlockCache& tc = m_cache.get();
+    if (nullptr == tc.dctx) {
+        tc.dctx = ZSTD_createDCtx();
+        TERARK_VERIFY(nullptr != tc.dctx);
+    }
+    block->resize_no_init(rawLen);
+    size_t size = m_ddict
+        ? ZSTD_decompress_usingDDict(tc.dctx, block->data(), rawLen, zdata, zlen, m_ddict)
+        : ZSTD_decompressDCtx(tc.dctx, block->data(), rawLen, zdata, zlen);
+    if (ZSTD_isError(size)) {
+        TERARK_THROW(std::logic_error
+            , "ZstdBlockBlobStore::decode_block: blockId = %zd, error %s"
+            , blockId, ZSTD_getErrorName(size));
+    }
+    if (size != rawLen) {
+        TERARK_THROW(std::logic_error
+            , "ZstdBlockBlobStore::decode_block: blockId = %zd, size = %zd, expect %zd"
+            , blockId, size, rawLen);
+    }
+}
+
+const valvec<byte_t>&
+ZstdBlockBlobStore::get_block(size_t blockId, size_t rawBeg) const {
+    auto& e = m_cache.get().slots[blockId % BlockCache::kBlocks];
+    if (terark_likely(e.blockId == blockId)) {
+        return e.data;
+    }
+    size_t BegEnd[2];
+    m_blockOffsets.get2(blockId, BegEnd);
+    assert(BegEnd[0] <= BegEnd[1]);
+    assert(BegEnd[1] <= m_content.size());
+    e.blockId = size_t(-1); // stays invalid if decode_block throws
+    decode_block(blockId, rawBeg, m_content.data() + BegEnd[0],
+                 BegEnd[1] - BegEnd[0], &e.data);
+    e.blockId = blockId;
+    return e.data;
+}
+
+void
+ZstdBlockBlobStore::get_record_append_imp(size_t recID, valvec<byte_t>* recData)
+const {
+    assert(recID < m_numRecords);
+    size_t blockId = recID / m_blockRecords;
+    size_t rawBeg = m_recOffsets[blockId * m_blockRecords];
+    const valvec<byte_t>& block = get_block(blockId, rawBeg);
+    size_t BegEnd[2];
+    m_recOffsets.get2(recID, BegEnd);
+    assert(BegEnd[0] <= BegEnd[1]);
+    assert(BegEnd[1] - rawBeg <= block.size());
+    recData->append(block.data() + (BegEnd[0] - rawBeg), BegEnd[1] - BegEnd[0]);
+}
+
+void
+ZstdBlockBlobStore::get_record_append_CacheOffsets(size_t recID, CacheOffsets* co)
+const {
+    assert(recID < m_numRecords);
+    size_t blockId = recID / m_blockRecords;
+    if (terark_unlikely(blockId != co->blockId)) {
+        // co->offsets[0] holds the unzipped offset of the block
+        co->offsets[0] = m_recOffsets[blockId * m_blockRecords];
+        co->blockId = blockId;
+    }
+    size_t rawBeg = co->offsets[0];
+    const valvec<byte_t>& block = get_block(blockId, rawBeg);
+    size_t BegEnd[2];
+    m_recOffsets.get2(recID, BegEnd);
+    assert(BegEnd[1] - rawBeg <= block.size());
+    co->recData.append(block.data() + (BegEnd[0] - rawBeg), BegEnd[1] - BegEnd[0]);
+}
+
+void
+ZstdBlockBlobStore::fspread_record_append_imp(
+                    pread_func_t fspread, void* lambda,
+                    size_t baseOffset, size_t recID,
+                    valvec<byte_t>* recData,
+                    valvec<byte_t>* rdbuf)
+const {
+    assert(recID < m_numRecords);
+    size_t blockId = recID / m_blockRecords;
+    size_t rawBeg = m_recOffsets[blockId * m_blockRecords];
+    auto& e = m_cache.get().slots[blockId % BlockCache::kBlocks];
+    if (e.blockId != blockId) {
+        size_t BegEnd[2];
+        m_blockOffsets.get2(blockId, BegEnd);
+        size_t zlen = BegEnd[1] - BegEnd[0];
+        size_t offset = sizeof(FileHeader) + BegEnd[0];
+        auto zdata = fspread(lambda, baseOffset + offset, zlen, rdbuf);
+        assert(NULL != zdata);
+        e.blockId = size_t(-1);
+        decode_block(blockId, rawBeg, zdata, zlen, &e.data);
+        e.blockId = blockId;
+    }
+    size_t BegEnd[2];
+    m_recOffsets.get2(recID, BegEnd);
+    assert(BegEnd[1] - rawBeg <= e.data.size());
+    recData->append(e.data.data() + (BegEnd[0] - rawBeg), BegEnd[1] - BegEnd[0]);
+}
+
+///////////////////////////////////////////////////////////////////////////
+class ZstdBlockBlobStore::MyBuilder::Impl : boost::noncopyable {
+    std::string m_fpath;
+    std::string m_fpath_boffs;
+    std::string m_fpath_roffs;
+    std::unique_ptr<SortedUintVec::Builder> m_blockOffsets;
+    std::unique_ptr<SortedUintVec::Builder> m_recOffsets;
+    FileStream m_file;
+    SeekableOutputStreamWrapper<FileMemIO*> m_memStream;
+    NativeDataOutput<OutputBuffer> m_writer;
+    Options m_options;
+    size_t m_offset;
+    size_t m_content_size;
+    size_t m_unzip_size;
+    size_t m_records;
+    bool   m_dictReady;
+    valvec<byte_t> m_dict;
+    valvec<byte_t> m_samples; // records buffered until the dict is trained
+    valvec<size_t> m_sampleLens;
+    valvec<byte_t> m_block;
+    size_t         m_blockRecCnt;
+    valvec<byte_t> m_zbuf;
+    ZSTD_parameters m_params;
+    ZSTD_CCtx*  m_cctx;
+    ZSTD_CDict* m_cdict;
+
+    void init() {
+        Options::check_compress_level(m_options.compress_level);
+        m_content_size = 0;
+        m_unzip_size = 0;
+        m_records = 0;
+        m_dictReady = false;
+        m_blockRecCnt = 0;
+        m_cctx = nullptr;
+        m_cdict = nullptr;
+        std::aligned_storage<sizeof(FileHeader)>::type header;
+        memset(&header, 0, sizeof header);
+        m_writer.ensureWrite(&header, sizeof header);
+    }
+    void prepare_dict() {
+        assert(!m_dictReady);
+        if (m_dict.empty() && m_options.dict_size && m_sampleLens.size() > 1) {
+            m_dict.resize_no_init(m_options.dict_size);
+            size_t len = ZDICT_trainFromBuffer(m_dict.data(), m_dict.size(),
+                                               m_samples.data(), m_sampleLens.data(),
+                                               (unsigned)m_sampleLens.size());
+            if (ZDICT_isError(len)) {
+                m_dict.clear(); // too few samples, compress without dict
+            } else {
+                m_dict.risk_set_size(len);
+            }
+        }
+        if (0 == m_options.block_records) {
+            size_t avgLen = m_samples.size() / std::max<size_t>(m_sampleLens.size(), 1);
+            size_t blockRecords = m_options.block_bytes / std::max<size_t>(avgLen, 1);
+            m_options.block_records = std::min<size_t>(std::max<size_t>(blockRecords, 1), 4096);
+        }
+        m_params = ZSTD_getParams(m_options.compress_level, m_options.block_bytes, m_dict.size());
+        m_params.fParams.checksumFlag = 2 == m_options.checksum_level;
+        m_cctx = ZSTD_createCCtx();
+        TERARK_VERIFY(nullptr != m_cctx);
+        if (!m_dict.empty()) {
+            ZSTD_customMem defaultMem = { nullptr, nullptr, nullptr };
+            m_cdict = ZSTD_createCDict_advanced(m_dict.data(), m_dict.size(), 0,
+                                                m_params, defaultMem);
+            TERARK_VERIFY(nullptr != m_cdict);
+        }
+        m_dictReady = true;
+        size_t pos = 0;
+        for (size_t len : m_sampleLens) {
+            push_record(fstring(m_samples.data() + pos, len));
+            pos += len;
+        }
+        m_samples.clear();
+        m_sampleLens.clear();
+    }
+    void push_record(fstring rec) {
+        m_recOffsets->push_back(m_unzip_size);
+        m_block.append(rec.udata(), rec.size());
+        m_unzip_size += rec.size();
+        m_records++;
+        if (++m_blockRecCnt == m_options.block_records) {
+            flush_block();
+        }
+    }
+    void flush_block() {
+        m_zbuf.resize_no_init(ZSTD_compressBound(m_block.size()));
+        size_t zlen = m_cdict
+            ? ZSTD_compress_usingCDict(m_cctx, m_zbuf.data(), m_zbuf.size(),
+                                       m_block.data(), m_block.size(), m_cdict)
+            : ZSTD_compress_advanced(m_cctx, m_zbuf.data(), m_zbuf.size(),
+                                     m_block.data(), m_block.size(),
+                                     nullptr, 0, m_params);
+        if (ZSTD_isError(zlen)) {
+            TERARK_THROW(std::logic_error
+                , "ZstdBlockBlobStore::MyBuilder::flush_block: error %s"
+                , ZSTD_getErrorName(zlen));
+        }
+        m_blockOffsets->push_back(m_content_size);
+        m_writer.ensureWrite(m_zbuf.data(), zlen);
+        m_content_size += zlen;
+        m_block.erase_all();
+        m_blockRecCnt = 0;
+    }
+public:
+    Impl(fstring fpath, size_t offset, Options options)
+        : m_fpath(fpath.begin(), fpath.end())
+        , m_fpath_boffs(fpath + ".boffs")
+        , m_fpath_roffs(fpath + ".roffs")
+        , m_blockOffsets(SortedUintVec::createBuilder(128, m_fpath_boffs.c_str()))
+        , m_recOffsets(SortedUintVec::createBuilder(128, m_fpath_roffs.c_str()))
+        , m_file()
+        , m_memStream(nullptr)
+        , m_writer(&m_file)
+        , m_options(options)
+        , m_offset(offset) {
+        assert(offset % 8 == 0);
+        if (offset == 0) {
+          m_file.open(fpath, "wb");
+        }
+        else {
+          m_file.open(fpath, "rb+");
+          m_file.seek(offset);
+        }
+        m_file.disbuf();
+        init();
+    }
+    Impl(FileMemIO& mem, Options options)
+        : m_fpath()
+        , m_fpath_boffs()
+        , m_fpath_roffs()
+        , m_blockOffsets(SortedUintVec::createBuilder(128))
+        , m_recOffsets(SortedUintVec::createBuilder(128))
+        , m_file()
+        , m_memStream(&mem)
+        , m_writer(&m_memStream)
+        , m_options(options)
+        , m_offset(0) {
+        init();
+    }
+    ~Impl() {
+        if (m_cdict)
+            ZSTD_freeCDict(m_cdict);
+        if (m_cctx)
+            ZSTD_freeCCtx(m_cctx);
+    }
+    /// compress with an existing dictionary, used by reorder_zip_data
+    void use_dict(fstring dict) {
+        assert(0 == m_records && m_sampleLens.empty());
+        assert(m_options.block_records > 0);
+        m_dict.assign(dict.udata(), dict.size());
+        prepare_dict();
+    }
+    void add_record(fstring rec) {
+        if (terark_likely(m_dictReady)) {
+            push_record(rec);
+            return;
+        }
+        m_samples.append(rec.udata(), rec.size());
+        m_sampleLens.push_back(rec.size());
+        if (m_samples.size() >= m_options.sample_bytes) {
+            prepare_dict();
+        }
+    }
+    void finish() {
+        if (!m_dictReady) {
+            prepare_dict();
+        }
+        if (m_blockRecCnt) {
+            flush_block();
+        }
+        m_blockOffsets->push_back(m_content_size);
+        m_recOffsets->push_back(m_unzip_size);
+        PadzeroForAlign<16>(m_writer, m_content_size);
+        m_writer.ensureWrite(m_dict.data(), m_dict.size());
+        PadzeroForAlign<16>(m_writer, m_dict.size());
+        size_t boffs_size, roffs_size;
+        byte_t* base;
+        MmapWholeFile mmap;
+        if (m_file.fp() == nullptr) {
+            SortedUintVec boffs, roffs;
+            m_blockOffsets->finish(&boffs);
+            m_recOffsets->finish(&roffs);
+            m_blockOffsets.reset();
+            m_recOffsets.reset();
+            boffs_size = boffs.mem_size();
+            roffs_size = roffs.mem_size();
+            m_writer.ensureWrite(boffs.data(), boffs_size);
+            m_writer.ensureWrite(roffs.data(), roffs_size);
+            m_writer.flush_buffer();
+            m_memStream.stream()->resize(m_memStream.size() + sizeof(BlobStoreFileFooter));
+            base = m_memStream.stream()->begin();
+        } else {
+            m_blockOffsets->finish(nullptr);
+            m_recOffsets->finish(nullptr);
+            m_blockOffsets.reset();
+            m_recOffsets.reset();
+            m_writer.flush_buffer();
+            FileStream boffs(m_fpath_boffs, "rb");
+            FileStream roffs(m_fpath_roffs, "rb");
+            boffs_size = boffs.fsize();
+            roffs_size = roffs.fsize();
+            m_file.cat(boffs);
+            m_file.cat(roffs);
+            boffs.close();
+            roffs.close();
+            ::remove(m_fpath_boffs.c_str());
+            ::remove(m_fpath_roffs.c_str());
+            m_file.close();
+            FileStream(m_fpath, "rb+").chsize(m_offset
+                + sizeof(FileHeader)
+                + align_up(m_content_size, 16)
+                + align_up(m_dict.size(), 16)
+                + boffs_size
+                + roffs_size
+                + sizeof(BlobStoreFileFooter));
+            MmapWholeFile(m_fpath, true).swap(mmap);
+            base = (byte_t*)mmap.base + m_offset;
+        }
+        FileHeader* header = (FileHeader*)base;
+        *header = FileHeader(m_records, m_unzip_size, m_content_size,
+                             m_dict.size(), boffs_size, roffs_size, m_options);
+
+        XXHash64 xxhash64(g_zbbs_seed);
+        xxhash64.update(base, header->fileSize - sizeof(BlobStoreFileFooter));
+
+        BlobStoreFileFooter footer;
+        footer.fileXXHash = xxhash64.digest();
+        ((BlobStoreFileFooter*)(base + header->fileSize))[-1] = footer;
+    }
+};
+
+void ZstdBlockBlobStore::reorder_zip_data(ZReorderMap& newToOld,
+        function<void(const void* data, size_t size)> writeAppend,
+        fstring tmpFile)
+const {
+    Options opt;
+    opt.block_records = m_blockRecords;
+    opt.compress_level = m_compressLevel;
+    opt.dict_size = 0; // reuse m_dict, do not train again
+    opt.checksum_level = m_checksumLevel;
+    {
+        MyBuilder builder(tmpFile, 0, opt);
+        builder.impl->use_dict(m_dict);
+        valvec<byte_t> rec;
+        for (assert(newToOld.size() == m_numRecords); !newToOld.eof(); ++newToOld) {
+            size_t oldId = *newToOld;
+            assert(oldId < m_numRecords);
+            rec.erase_all();
+            get_record_append_imp(oldId, &rec);
+            builder.addRecord(rec);
+        }
+        builder.finish();
+    }
+    {
+        MmapWholeFile mmap(tmpFile);
+        writeAppend(mmap.base, mmap.size);
+    }
+    ::remove(tmpFile.c_str());
+}
+
+ZstdBlockBlobStore::MyBuilder::~MyBuilder() {
+    delete impl;
+}
+ZstdBlockBlobStore::MyBuilder::MyBuilder(fstring fpath, size_t offset, Options options) {
+    impl = new Impl(fpath, offset, options);
+}
+ZstdBlockBlobStore::MyBuilder::MyBuilder(FileMemIO& mem, Options options) {
+    impl = new Impl(mem, options);
+}
+void ZstdBlockBlobStore::MyBuilder::addRecord(fstring rec) {
+    assert(NULL != impl);
+    impl->add_record(rec);
+}
+void ZstdBlockBlobStore::MyBuilder::finish() {
+    assert(NULL != impl);
+    return impl->finish();
+}
+
+} // namespace terark
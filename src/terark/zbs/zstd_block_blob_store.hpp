@@ -0,0 +1,91 @@
+#ifndef ZBS_ZSTD_BLOCK_BLOB_STORE_HPP_
+#define ZBS_ZSTD_BLOCK_BLOB_STORE_HPP_
+#pragma once
+
+#include "abstract_blob_store.hpp"
+#include <terark/io/FileMemStream.hpp>
+#include <terark/util/sorted_uint_vec.hpp>
+#include <terark/thread/instance_tls.hpp>
+
+struct ZSTD_DDict_s;
+
+namespace terark {
+
+/// Consecutive records are grouped into blocks, each block is one zstd frame
+/// compressed with a dictionary trained on the first records.
+/// Decoded blocks are kept in a small per-thread cache, so sequential and
+/// clustered reads decompress each block only once.
+class TERARK_DLL_EXPORT ZstdBlockBlobStore : public AbstractBlobStore {
+    struct FileHeader; friend struct FileHeader;
+    struct BlockCache;
+    int            m_compressLevel;
+    size_t         m_blockRecords;
+    valvec<byte_t> m_content;
+    valvec<byte_t> m_dict;
+    SortedUintVec  m_blockOffsets; // zipped offset of each block
+    SortedUintVec  m_recOffsets;   // unzipped offset of each record
+    ZSTD_DDict_s*  m_ddict;
+    instance_tls<BlockCache> m_cache;
+
+    const valvec<byte_t>& get_block(size_t blockId, size_t rawBeg) const;
+    void decode_block(size_t blockId, size_t rawBeg,
+                      const byte_t* zdata, size_t zlen,
+                      valvec<byte_t>* block) const;
+    void get_record_append_imp(size_t recID, valvec<byte_t>* recData) const;
+    void get_record_append_CacheOffsets(size_t recID, CacheOffsets*) const;
+    void fspread_record_append_imp(pread_func_t fspread, void* lambda,
+                                   size_t baseOffset, size_t recID,
+                                   valvec<byte_t>* recData,
+                                   valvec<byte_t>* rdbuf) const;
+public:
+    ZstdBlockBlobStore();
+    ~ZstdBlockBlobStore();
+
+    struct TERARK_DLL_EXPORT Options {
+      Options() : block_records(0), block_bytes(4*1024), compress_level(3),
+                  dict_size(32*1024), sample_bytes(4*1024*1024),
+                  checksum_level(3) {}
+      size_t block_records; // records per block, 0 means by block_bytes
+      size_t block_bytes;   // target unzipped block size
+      int    compress_level; // 1 ~ ZSTD_maxCLevel()
+      size_t dict_size;     // 0 disables dictionary training
+      size_t sample_bytes;  // records buffered for dictionary training
+      int    checksum_level; // 2: per block checksum, 3: whole file
+
+      /// @param conf "key=value;key=value", keys are the field names above
+      void set_config(fstring conf);
+      /// throws invalid_argument unless level is in [1, ZSTD_maxCLevel()]
+      static void check_compress_level(int level);
+    };
+
+    size_t block_records() const { return m_blockRecords; }
+    fstring zstd_dict() const { return m_dict; }
+
+    void init_from_memory(fstring dataMem, Dictionary dict) override;
+    void get_meta_blocks(valvec<fstring>* blocks) const override;
+    void get_data_blocks(valvec<fstring>* blocks) const override;
+    void detach_meta_blocks(const valvec<fstring>& blocks) override;
+    void save_mmap(function<void(const void*, size_t)> write) const override;
+    using AbstractBlobStore::save_mmap;
+
+    size_t mem_size() const override;
+    bool get_records_file_range(const size_t* sortedIds, size_t n,
+                                size_t* ranges) const override;
+    void reorder_zip_data(ZReorderMap& newToOld,
+        function<void(const void* data, size_t size)> writeAppend,
+        fstring tmpFile) const override;
+
+    struct TERARK_DLL_EXPORT MyBuilder : public AbstractBlobStore::Builder {
+        class Impl; Impl* impl;
+    public:
+        MyBuilder(fstring fpath, size_t offset = 0, Options options = Options());
+        MyBuilder(FileMemIO& mem, Options options = Options());
+        virtual ~MyBuilder();
+        void addRecord(fstring rec) override;
+        void finish() override;
+    };
+};
+
+} // namespace terark
+
+#endif /* ZBS_ZSTD_BLOCK_BLOB_STORE_HPP_ */
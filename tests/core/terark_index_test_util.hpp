@@ -0,0 +1,124 @@
+#pragma once
+
+#include <terark/idx/terark_zip_index.hpp>
+#include <terark/entropy/entropy_base.hpp> // GetTlsTerarkContext
+#include <terark/zbs/zip_reorder_map.hpp>
+#include <terark/int_vector.hpp>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <unistd.h>
+
+namespace terark {
+
+struct StrVecKeyReader : TerarkKeyReader {
+    const SortableStrVec& m_keys;
+    size_t m_pos = 0;
+    explicit StrVecKeyReader(const SortableStrVec& keys) : m_keys(keys) {}
+    fstring next() override { return m_keys[m_pos++]; }
+    void rewind() override { m_pos = 0; }
+};
+
+/// sorted unique keys "user/..." with shared short prefixes
+inline SortableStrVec gen_user_keys(std::mt19937_64& rng, size_t num) {
+    std::set<std::string> uniq;
+    for (size_t i = 0; i < num; ++i) {
+        std::string key = "user/";
+        size_t len = 1 + rng() % 24;
+        for (size_t j = 0; j < len; ++j)
+            key.push_back('a' + rng() % (j < 3 ? 4 : 26));
+        uniq.insert(key);
+    }
+    SortableStrVec keys;
+    for (auto& key : uniq)
+        keys.push_back(key);
+    return keys;
+}
+
+/// each key, a prefix and an extension of it, then numRandom random
+/// strings, most of the prefixes, extensions and random strings are absent
+inline std::vector<std::string>
+gen_queries(std::mt19937_64& rng, const SortableStrVec& keys, size_t numRandom) {
+    std::vector<std::string> queries;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        fstring key = keys[i];
+        queries.push_back(key.str());
+        queries.push_back(key.substr(0, rng() % key.size()).str());
+        queries.push_back(key.str() + char('a' + rng() % 26));
+    }
+    for (size_t i = 0; i < numRandom; ++i) {
+        std::string q = rng() % 2 ? "user/" : "";
+        size_t len = rng() % 20;
+        for (size_t j = 0; j < len; ++j)
+            q.push_back('a' + rng() % 26);
+        queries.push_back(q);
+    }
+    return queries;
+}
+
+/// build a nest louds trie index of sorted keys, save it (reordered if
+/// needed) into mem and load it from mem, a composite index stores the
+/// distinguishing prefixes in the trie and the rest in a suffix
+inline std::unique_ptr<TerarkIndex>
+build_index(const SortableStrVec& keys, const TerarkIndexOptions& opt,
+            valvec<byte_t>& mem, bool composite = false) {
+    size_t n = keys.size();
+    TerarkIndex::KeyStat ks;
+    ks.keyCount = n;
+    for (size_t i = 0; i < n; ++i) {
+        size_t len = keys[i].size();
+        ks.sumKeyLen += len;
+        ks.minKeyLen = std::min(ks.minKeyLen, len);
+        ks.maxKeyLen = std::max(ks.maxKeyLen, len);
+        size_t prefixLen = len;
+        if (composite) {
+            size_t lcp = 0;
+            if (i > 0)
+                lcp = fstring(keys[i]).commonPrefixLen(keys[i-1]);
+            if (i + 1 < n)
+                lcp = std::max(lcp, fstring(keys[i]).commonPrefixLen(keys[i+1]));
+            prefixLen = std::min(len, lcp + 1);
+        }
+        ks.sumPrefixLen += prefixLen;
+        ks.minPrefixLen = std::min(ks.minPrefixLen, prefixLen);
+        ks.maxPrefixLen = std::max(ks.maxPrefixLen, prefixLen);
+        ks.minSuffixLen = std::min(ks.minSuffixLen, len - prefixLen);
+        ks.maxSuffixLen = std::max(ks.maxSuffixLen, len - prefixLen);
+    }
+    ks.minKey.assign(keys[0]);
+    ks.maxKey.assign(keys[n-1]);
+    TerarkIndex::PrefixBuildInfo info = {};
+    info.common_prefix = fstring(ks.minKey).commonPrefixLen(ks.maxKey);
+    info.zip_ratio = 1;
+    info.type = TerarkIndex::PrefixBuildInfo::nest_louds_trie;
+    StrVecKeyReader reader(keys);
+    std::unique_ptr<TerarkIndex> built(
+        TerarkIndex::Factory::Build(&reader, opt, ks, &info));
+    auto write = [&](const void* data, size_t len) {
+        mem.append((const byte_t*)data, len);
+    };
+    if (built->NeedsReorder()) {
+        std::string map_file = opt.localTempDir + "/test_index_reorder." +
+                               std::to_string(getpid());
+        UintVecMin0 newToOld(n, n-1);
+        built->GetOrderMap(newToOld);
+        {
+            ZReorderMap::Builder builder(n, 1, map_file, "wb");
+            for (size_t i = 0; i < n; ++i)
+                builder.push_back(newToOld[i]);
+            builder.finish();
+        }
+        ZReorderMap map(map_file);
+        built->Reorder(map, write, map_file + ".tmp");
+        ::remove(map_file.c_str());
+        ::remove((map_file + ".tmp").c_str());
+    } else {
+        built->SaveMmap(write);
+    }
+    return TerarkIndex::LoadMemory(mem);
+}
+
+} // namespace terark
@@ -0,0 +1,102 @@
+#include <terark/concurrent_hash_map.hpp>
+#include <terark/util/throw.hpp>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+
+using namespace terark;
+
+static const size_t Threads = 8;
+static const size_t KeysPerThread = 20000;
+
+static void test_gold_map(size_t stripes) {
+    concurrent_gold_hash_map<size_t, size_t> map(stripes);
+    TERARK_VERIFY_EQ(map.stripe_num(), stripes);
+    std::atomic<size_t> found(0);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < Threads; ++t) {
+        threads.emplace_back([&,t]() {
+            size_t base = t * KeysPerThread;
+            for (size_t i = 0; i < KeysPerThread; ++i) {
+                TERARK_VERIFY(map.insert(base + i, (base + i) * 3));
+                // read keys of other threads while they may be rehashing,
+                // the value may have been upserted
+                size_t other = ((t + 1) % Threads) * KeysPerThread + i / 2;
+                size_t val = 0;
+                if (map.find(other, &val)) {
+                    TERARK_VERIFY_EQ(val / 3, other);
+                    found++;
+                }
+            }
+            for (size_t i = 0; i < KeysPerThread; i += 2)
+                TERARK_VERIFY_EQ(map.erase(base + i), 1);
+            for (size_t i = 1; i < KeysPerThread; i += 2)
+                map.upsert(base + i, 0, [](size_t& v) { v++; });
+        });
+    }
+    for (auto& th : threads)
+        th.join();
+    TERARK_VERIFY_EQ(map.size(), Threads * KeysPerThread / 2);
+    for (size_t k = 0; k < Threads * KeysPerThread; ++k) {
+        size_t val = 0;
+        bool has = map.find(k, &val);
+        TERARK_VERIFY_EQ(has, (k % 2 == 1));
+        if (has) {
+            TERARK_VERIFY_EQ(val, k * 3 + 1);
+        }
+        TERARK_VERIFY(!map.insert(k, 0) || k % 2 == 0);
+    }
+    size_t cnt = 0;
+    map.for_each([&](size_t, size_t) { cnt++; });
+    TERARK_VERIFY_EQ(cnt, Threads * KeysPerThread);
+    map.clear();
+    TERARK_VERIFY(map.empty());
+    printf("gold_hash_map: stripes = %zd, found while inserting = %zd\n",
+           stripes, size_t(found));
+}
+
+static void test_strmap() {
+    concurrent_hash_strmap<size_t> map;
+    map.reserve(Threads * KeysPerThread);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < Threads; ++t) {
+        threads.emplace_back([&,t]() {
+            for (size_t i = 0; i < KeysPerThread; ++i) {
+                std::string key = "key:" + std::to_string(t * KeysPerThread + i);
+                TERARK_VERIFY(map.insert(fstring(key), i));
+                TERARK_VERIFY(map.exists(fstring(key)));
+                if (i % 3 == 0)
+                    TERARK_VERIFY_EQ(map.erase(fstring(key)), 1);
+                else
+                    map.insert_or_assign(fstring(key), t);
+            }
+        });
+    }
+    for (auto& th : threads)
+        th.join();
+    size_t cnt = 0;
+    for (size_t t = 0; t < Threads; ++t) {
+        for (size_t i = 0; i < KeysPerThread; ++i) {
+            std::string key = "key:" + std::to_string(t * KeysPerThread + i);
+            size_t val = size_t(-1);
+            bool has = map.find_and(fstring(key), [&](size_t v) { val = v; });
+            TERARK_VERIFY_EQ(has, (i % 3 != 0));
+            if (has) {
+                TERARK_VERIFY_EQ(val, t);
+                cnt++;
+            }
+        }
+    }
+    TERARK_VERIFY_EQ(map.size(), cnt);
+    printf("hash_strmap: stripes = %zd, size = %zd\n", map.stripe_num(), cnt);
+}
+
+int main() {
+    test_gold_map(16);
+    test_gold_map(1); // all keys in one stripe
+    test_strmap();
+    printf("passed\n");
+    return 0;
+}
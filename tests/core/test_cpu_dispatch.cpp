@@ -0,0 +1,75 @@
+#include <terark/util/cpu_features.hpp>
+#include <terark/util/crc.hpp>
+#include <terark/fsa/fast_search_byte.hpp>
+#include <terark/util/throw.hpp>
+#include <algorithm>
+#include <random>
+
+using namespace terark;
+
+static uint32_t crc32c_bitwise(uint32_t crc, const byte_t* p, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        crc ^= p[i];
+        for (int k = 0; k < 8; ++k)
+            crc = (crc >> 1) ^ (0x82F63B78 & (0 - (crc & 1)));
+    }
+    return crc;
+}
+
+int main() {
+    const CpuFeatures& f = cpu_features();
+    printf("sse42=%d pclmul=%d popcnt=%d bmi2=%d avx2=%d avx512f=%d "
+           "avx512bw=%d avx512vl=%d avx512vbmi=%d avx512vpopcntdq=%d\n",
+           f.sse42, f.pclmul, f.popcnt, f.bmi2, f.avx2, f.avx512f,
+           f.avx512bw, f.avx512vl, f.avx512vbmi, f.avx512vpopcntdq);
+
+    // standard check value of crc32c
+    TERARK_VERIFY_EQ(~Crc32c_update(~0u, "123456789", 9), 0xE3069283u);
+
+    std::mt19937 rng(1234);
+    byte_t buf[1024 + 8];
+    for (auto& b : buf) b = byte_t(rng());
+    for (size_t off = 0; off < 8; ++off) {
+        for (size_t len = 0; len <= 1024; len += 1 + len / 8) {
+            uint32_t init = rng();
+            TERARK_VERIFY_EQ(Crc32c_update(init, buf + off, len),
+                             crc32c_bitwise(init, buf + off, len));
+        }
+    }
+
+    // rank/select kernel, by pdep if bmi2 is enabled by -march or dispatched
+    for (int iter = 0; iter < 10000; ++iter) {
+        uint64_t x = uint64_t(rng()) << 32 | rng();
+        x &= uint64_t(rng()) << 32 | rng(); // sparser
+        if (0 == x) continue;
+        size_t r = 0;
+        for (size_t pos = 0; pos < 64; ++pos) {
+            if (x >> pos & 1) {
+                TERARK_VERIFY_EQ(size_t(UintSelect1(x, r)), pos);
+                r++;
+            }
+        }
+    }
+
+    byte_t label[64];
+    for (size_t len = 0; len <= 35; ++len) {
+        for (int iter = 0; iter < 100; ++iter) {
+            std::generate_n(label, 64, [&]{ return byte_t(rng()); });
+            std::sort(label, label + len);
+            size_t n = std::unique(label, label + len) - label;
+            for (int key = 0; key < 256; ++key) {
+                size_t expect = std::find(label, label + n, key) - label;
+                size_t pos = fast_search_byte_max_35(label, n, byte_t(key));
+                TERARK_VERIFY(pos >= n ? expect == n : expect == pos);
+                pos = fast_search_byte(label, n, byte_t(key));
+                TERARK_VERIFY(pos >= n ? expect == n : expect == pos);
+                if (n <= 16) {
+                    pos = fast_search_byte_max_16(label, int(n), byte_t(key));
+                    TERARK_VERIFY(pos >= n ? expect == n : expect == pos);
+                }
+            }
+        }
+    }
+    printf("passed\n");
+    return 0;
+}
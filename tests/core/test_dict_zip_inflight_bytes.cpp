@@ -0,0 +1,76 @@
+#include <terark/zbs/dict_zip_blob_store.hpp>
+#include <terark/io/MemStream.hpp>
+#include <terark/util/throw.hpp>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+
+namespace terark {
+// the pipeline is shared by all DictZip builders of the process, these must
+// be called before the first multi thread builder
+void DictZipBlobStore_setZipThreads(int zipThreads);
+void DictZipBlobStore_setMaxInflightBytes(size_t bytes);
+}
+
+using namespace terark;
+
+static void build(const std::vector<std::string>& records, bool enableLake,
+                  FileMemIO& mem) {
+    DictZipBlobStore::Options opt;
+    opt.embeddedDict = true;
+    opt.enableLake = enableLake;
+    opt.recordsPerBatch = 50;
+    opt.bytesPerBatch = 4*1024;
+    std::unique_ptr<DictZipBlobStore::ZipBuilder> builder(
+        DictZipBlobStore::createZipBuilder(opt));
+    for (size_t i = 0; i < records.size(); i += 20)
+        builder->addSample(records[i]);
+    builder->finishSample();
+    builder->prepare(records.size(), mem);
+    for (auto& rec : records)
+        builder->addRecord(rec);
+    builder->finish(DictZipBlobStore::ZipBuilder::FinishFreeDict);
+    printf("multi thread = %d, lake = %d, zip size = %zd\n",
+           builder->isMultiThread(), enableLake, mem.size());
+}
+
+int main() {
+    std::mt19937 gen(97531);
+    std::vector<std::string> records;
+    for (int i = 0; i < 20000; ++i) {
+        std::string rec = "user_" + std::to_string(gen() % 5000) + ":";
+        for (size_t j = 0, n = gen() % 300; j < n; ++j)
+            rec.push_back(char('a' + (j * 7 + gen() % 3) % 26));
+        records.push_back(std::move(rec));
+    }
+    // unbounded: single thread, no pipeline
+    DictZipBlobStore_setZipThreads(0);
+    FileMemIO unbounded;
+    build(records, false, unbounded);
+
+    // a few batches in flight, tasks wait for the budget
+    DictZipBlobStore_setMaxInflightBytes(32*1024);
+    DictZipBlobStore_setZipThreads(2);
+    for (bool enableLake : {false, true}) {
+        // with the lake, finish drains the last partial lake
+        FileMemIO bounded;
+        build(records, enableLake, bounded);
+        TERARK_VERIFY_EQ(bounded.size(), unbounded.size());
+        TERARK_VERIFY(memcmp(bounded.begin(), unbounded.begin(), unbounded.size()) == 0);
+        std::unique_ptr<AbstractBlobStore> store(
+            AbstractBlobStore::load_from_user_memory(
+                fstring(bounded.begin(), bounded.size()),
+                AbstractBlobStore::Dictionary()));
+        TERARK_VERIFY_EQ(store->num_records(), records.size());
+        valvec<byte_t> buf;
+        for (size_t i = 0; i < records.size(); ++i) {
+            store->get_record(i, &buf);
+            TERARK_VERIFY(fstring(buf) == fstring(records[i]));
+        }
+    }
+    printf("passed\n");
+    return 0;
+}
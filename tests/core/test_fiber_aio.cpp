@@ -2,6 +2,7 @@
 #include <terark/fstring.hpp>
 #include <terark/util/atomic.hpp>
 #include <terark/util/profiling.hpp>
+#include <terark/util/throw.hpp>
 #include <random>
 #include <thread>
 #include <vector>
@@ -13,7 +14,70 @@
 #include <fcntl.h>
 #include <unistd.h>
 
-int main() {
+// batch reads into fixed and non-fixed buffers, by each thread's own ring
+// if aio_method is io_uring
+static void test_batch_read(intptr_t Threads) {
+    using namespace terark;
+    const char* fname = "fiber_aio.batch.test.bin";
+    const size_t PageSize = 4096, Pages = 64, Bytes = PageSize * Pages;
+    int fd = open(fname, O_CLOEXEC|O_CREAT|O_RDWR|O_TRUNC, 0600);
+    if (fd < 0) {
+        fprintf(stderr, "ERROR: open(%s) = %s\n", fname, strerror(errno));
+        exit(1);
+    }
+    std::vector<char> data(Bytes);
+    std::mt19937_64 rand;
+    for (auto& c : data) c = char(rand());
+    TERARK_VERIFY_EQ(pwrite(fd, data.data(), Bytes, 0), intptr_t(Bytes));
+    auto thr_fun = [&](intptr_t tno) {
+        char* fixed = NULL;
+        TERARK_VERIFY_EQ(posix_memalign((void**)&fixed, PageSize, Bytes), 0);
+        bool registered = fiber_aio_register_buffer(fixed, Bytes);
+        std::vector<char> plain(Bytes);
+        std::vector<fiber_aio_req> reqs;
+        for (size_t i = 0; i < Pages; i++) {
+            size_t j = Pages - 1 - i; // reversed order
+            reqs.push_back({fixed + PageSize*j, PageSize, off_t(PageSize*j), -1, 0});
+            reqs.push_back({&plain[PageSize*i], PageSize, off_t(PageSize*i), -1, 0});
+        }
+        char tail[16];
+        reqs.push_back({tail, sizeof(tail), off_t(Bytes), -1, 0}); // eof
+        TERARK_VERIFY_EQ(fiber_aio_batch_read(fd, reqs.data(), reqs.size()), 0u);
+        for (size_t i = 0; i + 1 < reqs.size(); i++) {
+            TERARK_VERIFY_EQ(reqs[i].ret, intptr_t(PageSize));
+        }
+        TERARK_VERIFY_EQ(reqs.back().ret, 0);
+        TERARK_VERIFY(memcmp(fixed, data.data(), Bytes) == 0);
+        TERARK_VERIFY(memcmp(plain.data(), data.data(), Bytes) == 0);
+        TERARK_VERIFY_EQ(fiber_aio_read(fd, fixed, PageSize, PageSize), intptr_t(PageSize));
+        if (registered) {
+            fiber_aio_unregister_buffer(fixed, Bytes);
+        }
+        fprintf(stderr, "tno = %zd, aio_method = %d, fixed buffer = %d, batch read passed\n",
+                tno, fiber_aio_method(), registered);
+        free(fixed);
+    };
+    std::vector<std::thread> tv;
+    for (intptr_t tno = 0; tno < Threads; ++tno) {
+        tv.emplace_back(thr_fun, tno);
+    }
+    for (std::thread& t : tv) {
+        t.join();
+    }
+    if (2 == fiber_aio_method()) {
+        // over the limit, refused and read by non-fixed io
+        setenv("fiber_aio_maxFixedBytes", "4096", 1);
+        std::vector<char> big(Bytes);
+        TERARK_VERIFY(!fiber_aio_register_buffer(big.data(), Bytes));
+        unsetenv("fiber_aio_maxFixedBytes");
+        TERARK_VERIFY_EQ(fiber_aio_read(fd, big.data(), Bytes, 0), intptr_t(Bytes));
+        TERARK_VERIFY(memcmp(big.data(), data.data(), Bytes) == 0);
+    }
+    close(fd);
+    remove(fname);
+}
+
+int main(int argc, char* argv[]) {
   #if defined(__DARWIN_NULL)
     return 0;
   #endif
@@ -73,6 +137,7 @@ int main() {
             }
             sum += BlockSize;
         }
+        free(buf);
         as_atomic(allsum) += sum;
     };
     std::vector<std::thread> tv;
@@ -92,5 +157,16 @@ int main() {
     fprintf(stderr, "wr time = %8.3f sec\n", pf.sf(t0,t1));
     fprintf(stderr, "wr iops = %8.3f K\n", WriteSize/BlockSize/pf.mf(t0,t1));
     fprintf(stderr, "wr iobw = %8.3f GiB\n", WriteSize/pf.sf(t0,t1)/(1L<<30));
+
+    test_batch_read(Threads);
+  #if defined(__linux__)
+    if (argc > 0 && NULL == getenv("aio_method")) {
+        // aio_method is read at startup, run again with io_uring engine
+        setenv("aio_method", "2", 1);
+        execv("/proc/self/exe", argv);
+        fprintf(stderr, "ERROR: execv(/proc/self/exe) = %s\n", strerror(errno));
+        return 1;
+    }
+  #endif
     return 0;
 }
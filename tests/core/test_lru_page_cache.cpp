@@ -0,0 +1,105 @@
+#include <terark/zbs/lru_page_cache.hpp>
+#include <terark/util/throw.hpp>
+#include <memory>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace terark;
+
+static const size_t PageSize = 4096;
+static const size_t FilePages = 1000;
+static const size_t CachePages = 100;
+static const size_t HotPages = 40;
+
+static size_t get_hit_cnt(const LruReadonlyCache* cache) {
+    char* buf = NULL;
+    size_t len = 0;
+    FILE* fp = open_memstream(&buf, &len);
+    cache->print_stat_cnt(fp);
+    fclose(fp);
+    size_t hit = 0;
+    TERARK_VERIFY(sscanf(buf, "hit : %zd", &hit) == 1);
+    free(buf);
+    return hit;
+}
+
+static void read_page(LruReadonlyCache* cache, intptr_t fi, size_t pg, size_t len) {
+    valvec<byte_t> rdbuf;
+    LruReadonlyCache::Buffer b(&rdbuf);
+    size_t offset = pg * PageSize + 7;
+    const byte_t* data = cache->pread(fi, offset, len, &b);
+    for (size_t i = 0; i < len; ++i) {
+        TERARK_VERIFY_EQ(data[i], byte_t((offset + i) / PageSize * 31 + (offset + i)));
+    }
+}
+
+/// @returns hits of hot pages after a full scan
+static size_t hot_hits_after_scan(int fd, LruReadonlyCache::Policy policy,
+                                  size_t shards, bool no_cache_scan) {
+    std::unique_ptr<LruReadonlyCache> cache(LruReadonlyCache::create(
+        CachePages * PageSize, shards, 16, false, policy));
+    intptr_t fi = cache->open(fd);
+    for (int round = 0; round < 3; ++round) {
+        for (size_t pg = 0; pg < HotPages; ++pg)
+            read_page(cache.get(), fi, pg * 10, 100);
+        usleep(30000); // > Terark_lruMinPromoteMs
+    }
+    intptr_t scan_fi = no_cache_scan ? LruReadonlyCache::no_cache(fi) : fi;
+    for (size_t pg = 0; pg + 1 < FilePages; ++pg) {
+        if (pg % 3 == 0) // cross page read
+            read_page(cache.get(), scan_fi, pg, PageSize);
+        else
+            read_page(cache.get(), scan_fi, pg, 100);
+    }
+    size_t hit0 = get_hit_cnt(cache.get());
+    for (size_t pg = 0; pg < HotPages; ++pg)
+        read_page(cache.get(), fi, pg * 10, 100);
+    size_t hot_hits = get_hit_cnt(cache.get()) - hit0;
+    cache->close(fi);
+    return hot_hits;
+}
+
+int main() {
+    setenv("Terark_lruMinPromoteMs", "20", 1);
+    char fname[] = "/tmp/test_lru_page_cache.XXXXXX";
+    int fd = mkstemp(fname);
+    TERARK_VERIFY_F(fd >= 0, "mkstemp = %s", strerror(errno));
+    unlink(fname);
+    valvec<byte_t> data(FilePages * PageSize);
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = byte_t(i / PageSize * 31 + i);
+    TERARK_VERIFY_EQ(write(fd, data.data(), data.size()), ssize_t(data.size()));
+
+    {   // cross page read on which all pages are hit
+        std::unique_ptr<LruReadonlyCache> cache(LruReadonlyCache::create(
+            CachePages * PageSize, 1, 16, false));
+        intptr_t fi = cache->open(fd);
+        read_page(cache.get(), fi, 5, 3 * PageSize);
+        read_page(cache.get(), fi, 5, 3 * PageSize);
+        TERARK_VERIFY_EQ(get_hit_cnt(cache.get()), 4);
+        cache->close(fi);
+    }
+    const char* names[] = {"LRU", "SLRU", "TinyLFU"};
+    for (size_t shards : {1, 4}) {
+        for (auto policy : {LruReadonlyCache::kLRU, LruReadonlyCache::kSLRU,
+                            LruReadonlyCache::kTinyLFU}) {
+            size_t scan = hot_hits_after_scan(fd, policy, shards, false);
+            size_t hint = hot_hits_after_scan(fd, policy, shards, true);
+            printf("shards = %zd, %-8s: hot hits after scan = %2zd, "
+                   "after no_cache scan = %2zd, hot pages = %zd\n",
+                   shards, names[policy], scan, hint, HotPages);
+            if (LruReadonlyCache::kLRU == policy)
+                TERARK_VERIFY_LT(scan, HotPages / 4);
+            else // sharding makes capacity of a shard a bit unbalanced
+                TERARK_VERIFY_GE(scan, HotPages * 3 / 4);
+            TERARK_VERIFY_GE(hint, HotPages * 3 / 4);
+        }
+    }
+    close(fd);
+    printf("passed\n");
+    return 0;
+}
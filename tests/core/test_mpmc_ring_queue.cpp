@@ -0,0 +1,81 @@
+#include <terark/util/mpmc_ring_queue.hpp>
+#include <terark/util/throw.hpp>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+
+using namespace terark;
+
+static const size_t Producers = 4;
+static const size_t Consumers = 4;
+static const size_t ItemsPerProducer = 100000;
+static const size_t Batch = 5;
+
+int main() {
+    util::mpmc_ring_queue<size_t> q(6); // rounded up to 8, often full
+    TERARK_VERIFY_EQ(q.capacity(), 8u);
+
+    // single thread: fifo, full, empty, partial batch push
+    size_t buf[16];
+    for (size_t i = 0; i < 16; ++i) buf[i] = i;
+    TERARK_VERIFY_EQ(q.try_push_back_n(buf, 5), 5u);
+    TERARK_VERIFY_EQ(q.try_push_back_n(buf + 5, 5), 3u);
+    TERARK_VERIFY(!q.try_push_back(99));
+    TERARK_VERIFY(!q.push_back(99, 1)); // timeout
+    TERARK_VERIFY_EQ(q.size(), 8u);
+    for (size_t i = 0; i < 8; ++i) {
+        size_t x = 0;
+        TERARK_VERIFY(q.try_pop_front(x));
+        TERARK_VERIFY_EQ(x, i);
+    }
+    size_t x;
+    TERARK_VERIFY(!q.try_pop_front(x));
+    TERARK_VERIFY(!q.pop_front(x, 1)); // timeout
+    TERARK_VERIFY(q.empty());
+
+    // item = producer << 32 | seq, each consumer must see the items of
+    // one producer in increasing order
+    std::atomic<size_t> popped(0), sum(0);
+    std::vector<std::thread> threads;
+    for (size_t p = 0; p < Producers; ++p) {
+        threads.emplace_back([&,p]() {
+            size_t items[Batch];
+            for (size_t i = 0; i < ItemsPerProducer; ) {
+                if (p % 2) {
+                    q.push_back(p << 32 | i++);
+                    continue;
+                }
+                size_t n = std::min(Batch, ItemsPerProducer - i);
+                for (size_t j = 0; j < n; ++j) items[j] = p << 32 | (i + j);
+                for (size_t k = 0; k < n; )
+                    k += q.push_back_n(items + k, n - k, -1);
+                i += n;
+            }
+        });
+    }
+    for (size_t c = 0; c < Consumers; ++c) {
+        threads.emplace_back([&]() {
+            std::vector<long long> last(Producers, -1);
+            size_t mysum = 0;
+            while (popped.load() < Producers * ItemsPerProducer) {
+                size_t y;
+                if (!q.pop_front(y, 2))
+                    continue;
+                popped++;
+                size_t p = y >> 32, i = y & 0xFFFFFFFF;
+                TERARK_VERIFY_LT(p, Producers);
+                TERARK_VERIFY_GT((long long)i, last[p]);
+                last[p] = i;
+                mysum += i;
+            }
+            sum += mysum;
+        });
+    }
+    for (auto& t : threads) t.join();
+    TERARK_VERIFY(q.empty());
+    TERARK_VERIFY_EQ(popped.load(), Producers * ItemsPerProducer);
+    TERARK_VERIFY_EQ(sum.load(), Producers * (ItemsPerProducer * (ItemsPerProducer - 1) / 2));
+    printf("passed\n");
+    return 0;
+}
@@ -0,0 +1,33 @@
+#include "terark_index_test_util.hpp"
+#include <terark/entropy/entropy_base.hpp>
+#include <terark/util/throw.hpp>
+#include <memory>
+#include <random>
+#include <stdio.h>
+#include <string.h>
+
+using namespace terark;
+
+int main() {
+    std::mt19937_64 rng(12345);
+    // wide BFS depths, so that they are expanded by threads
+    SortableStrVec keys = gen_user_keys(rng, 200000);
+    TerarkIndexOptions opt;
+    valvec<byte_t> serial_mem;
+    std::unique_ptr<TerarkIndex> serial = build_index(keys, opt, serial_mem);
+    for (uint32_t threads : {2, 4}) {
+        opt.nltBuildThreads = threads;
+        valvec<byte_t> parallel_mem;
+        std::unique_ptr<TerarkIndex> parallel = build_index(keys, opt, parallel_mem);
+        printf("%s, keys = %zd, mem = %zd, threads = %u\n",
+               parallel->Name().c_str(), keys.size(), parallel_mem.size(), threads);
+        TERARK_VERIFY_EQ(parallel_mem.size(), serial_mem.size());
+        TERARK_VERIFY(memcmp(parallel_mem.data(), serial_mem.data(), serial_mem.size()) == 0);
+        auto ctx = GetTlsTerarkContext();
+        for (size_t i = 0; i < keys.size(); i += 97) {
+            TERARK_VERIFY_EQ(parallel->Find(keys[i], ctx), serial->Find(keys[i], ctx));
+        }
+    }
+    printf("passed\n");
+    return 0;
+}
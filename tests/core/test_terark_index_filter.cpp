@@ -0,0 +1,91 @@
+#include "terark_index_test_util.hpp"
+#include <terark/idx/terark_index_filter.hpp>
+#include <terark/util/throw.hpp>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace terark;
+
+static void check_same(const TerarkIndex* index, const TerarkIndex* base,
+                       const std::vector<std::string>& queries) {
+    auto ctx = GetTlsTerarkContext();
+    for (auto& q : queries) {
+        TERARK_VERIFY_EQ(index->Find(q, ctx), base->Find(q, ctx));
+    }
+    valvec<fstring> qv(queries.size(), valvec_reserve());
+    for (auto& q : queries)
+        qv.push_back(q);
+    valvec<size_t> ids(qv.size());
+    index->FindBatch(qv.data(), qv.size(), ids.data(), ctx);
+    for (size_t i = 0; i < qv.size(); ++i) {
+        TERARK_VERIFY_EQ(ids[i], base->Find(qv[i], ctx));
+    }
+}
+
+/// no false negative, false positive rate of absent keys is bounded by
+/// twice the rate of an optimal standard bloom filter, 0.6185^bits_per_key
+static void check_false_positive(const SortableStrVec& keys, size_t bits_per_key,
+                                 std::mt19937_64& rng) {
+    TerarkIndexFilter filter;
+    filter.Build(keys.size(), bits_per_key, [&](const TerarkIndexFilter::KeyCallback& cb) {
+        for (size_t i = 0; i < keys.size(); ++i)
+            cb(keys[i]);
+    });
+    for (size_t i = 0; i < keys.size(); ++i) {
+        TERARK_VERIFY(filter.MayContain(keys[i]));
+    }
+    size_t num = 200000, fp = 0;
+    for (size_t i = 0; i < num; ++i) {
+        std::string absent = "absent/" + std::to_string(rng());
+        fp += filter.MayContain(absent);
+    }
+    double rate = double(fp) / num;
+    double bound = 2 * pow(0.6185, double(bits_per_key));
+    printf("bits_per_key = %zd, false positive rate = %f, bound = %f\n",
+           bits_per_key, rate, bound);
+    TERARK_VERIFY_LT(rate, bound);
+}
+
+int main() {
+    std::mt19937_64 rng(12345);
+    SortableStrVec keys = gen_user_keys(rng, 50000);
+    valvec<byte_t> base_mem, filter_mem, both_mem;
+    TerarkIndexOptions opt;
+    std::unique_ptr<TerarkIndex> base = build_index(keys, opt, base_mem);
+    opt.filterBitsPerKey = 10;
+    std::unique_ptr<TerarkIndex> filter = build_index(keys, opt, filter_mem);
+    opt.mphfFingerprintBits = 8;
+    std::unique_ptr<TerarkIndex> both = build_index(keys, opt, both_mem);
+    printf("%s, keys = %zd, mem = %zd, with filter = %zd, with both = %zd\n",
+           filter->Name().c_str(), keys.size(), base->Memory().size(),
+           filter->Memory().size(), both->Memory().size());
+    TERARK_VERIFY_GT(filter->Memory().size(), base->Memory().size());
+    TERARK_VERIFY_GT(both->Memory().size(), filter->Memory().size());
+
+    std::vector<std::string> queries = gen_queries(rng, keys, 5000);
+    check_same(filter.get(), base.get(), queries);
+    check_same(both.get(), base.get(), queries);
+
+    // sections block is the first meta data block and can be detached
+    valvec<fstring> meta = filter->GetMetaData();
+    valvec<fstring> base_meta = base->GetMetaData();
+    TERARK_VERIFY_EQ(meta.size(), base_meta.size() + 1);
+    std::vector<std::string> copies;
+    for (auto& block : meta)
+        copies.push_back(block.str());
+    valvec<fstring> detached;
+    for (auto& copy : copies)
+        detached.push_back(copy);
+    filter->DetachMetaData(detached);
+    check_same(filter.get(), base.get(), queries);
+
+    for (size_t bits_per_key : {4, 8, 12}) {
+        check_false_positive(keys, bits_per_key, rng);
+    }
+    printf("passed\n");
+    return 0;
+}
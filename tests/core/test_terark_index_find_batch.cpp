@@ -0,0 +1,48 @@
+#include "terark_index_test_util.hpp"
+#include <terark/util/throw.hpp>
+#include <memory>
+#include <random>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace terark;
+
+int main() {
+    // force the interleaved walk even though the test trie is small
+    setenv("NestTrieDAWG_indexBatchMinMem", "0", 1);
+    std::mt19937_64 rng(12345);
+    SortableStrVec keys = gen_user_keys(rng, 20000);
+    valvec<byte_t> mem;
+    std::unique_ptr<TerarkIndex> index = build_index(keys, TerarkIndexOptions(), mem);
+    printf("%s, keys = %zd, mem = %zd\n", index->Name().c_str(),
+           keys.size(), index->Memory().size());
+
+    std::vector<std::string> queries = gen_queries(rng, keys, 5000);
+    std::shuffle(queries.begin(), queries.end(), rng);
+
+    valvec<fstring> qv(queries.size(), valvec_reserve());
+    for (auto& q : queries)
+        qv.push_back(q);
+    auto ctx = GetTlsTerarkContext();
+    valvec<size_t> ids(qv.size());
+    for (size_t batch : {1, 2, 7, 64, 1000}) {
+        for (size_t i = 0; i < qv.size(); i += batch) {
+            size_t n = std::min(batch, qv.size() - i);
+            index->FindBatch(qv.data() + i, n, ids.data() + i, ctx);
+        }
+        for (size_t i = 0; i < qv.size(); ++i) {
+            TERARK_VERIFY_EQ(ids[i], index->Find(qv[i], ctx));
+        }
+    }
+    valvec<size_t> key_ids(keys.size());
+    valvec<fstring> kv(keys.size(), valvec_reserve());
+    for (size_t i = 0; i < keys.size(); ++i)
+        kv.push_back(keys[i]);
+    index->FindBatch(kv.data(), kv.size(), key_ids.data(), ctx);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        TERARK_VERIFY_LT(key_ids[i], keys.size());
+    }
+    printf("passed\n");
+    return 0;
+}
@@ -0,0 +1,44 @@
+#include "terark_index_test_util.hpp"
+#include <terark/entropy/entropy_base.hpp>
+#include <terark/io/FileStream.hpp>
+#include <terark/util/hugepage.hpp>
+#include <terark/util/throw.hpp>
+#include <memory>
+#include <random>
+#include <stdio.h>
+
+using namespace terark;
+
+int main() {
+    std::mt19937_64 rng(67890);
+    // the trie of 500000 keys exceeds hugepage_size
+    SortableStrVec keys = gen_user_keys(rng, 500000);
+    TerarkIndexOptions opt;
+    valvec<byte_t> mem;
+    std::unique_ptr<TerarkIndex> expected = build_index(keys, opt, mem);
+    std::string fpath = "/tmp/test_terark_index_load_file." + std::to_string(getpid());
+    {
+        FileStream fp(fpath.c_str(), "wb");
+        fp.ensureWrite(mem.data(), mem.size());
+    }
+    bool old = get_hugepage_load();
+    for (bool hugepage : {false, true}) {
+        set_hugepage_load(hugepage);
+        std::unique_ptr<TerarkIndex> index = TerarkIndex::LoadFile(fpath);
+        size_t metaSize = 0;
+        for (fstring block : index->GetMetaData())
+            metaSize += block.size();
+        printf("%s, keys = %zd, meta = %zd, hugepage = %d\n",
+               index->Name().c_str(), keys.size(), metaSize, hugepage);
+        TERARK_VERIFY_EQ(index->NumKeys(), keys.size());
+        auto ctx = GetTlsTerarkContext();
+        for (size_t i = 0; i < keys.size(); ++i) {
+            TERARK_VERIFY_EQ(index->Find(keys[i], ctx), expected->Find(keys[i], ctx));
+        }
+        TERARK_VERIFY_EQ(index->Find("user/~", ctx), size_t(-1));
+    }
+    set_hugepage_load(old);
+    ::remove(fpath.c_str());
+    printf("passed\n");
+    return 0;
+}
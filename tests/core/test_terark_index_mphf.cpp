@@ -0,0 +1,83 @@
+#include "terark_index_test_util.hpp"
+#include <terark/idx/terark_index_mphf.hpp>
+#include <terark/util/throw.hpp>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace terark;
+
+static void check_mphf(const SortableStrVec& keys, bool composite,
+                       std::mt19937_64& rng) {
+    valvec<byte_t> base_mem, mphf_mem;
+    TerarkIndexOptions opt;
+    std::unique_ptr<TerarkIndex> base = build_index(keys, opt, base_mem, composite);
+    opt.mphfFingerprintBits = 8;
+    std::unique_ptr<TerarkIndex> index = build_index(keys, opt, mphf_mem, composite);
+    printf("%s, keys = %zd, mem = %zd, with mphf = %zd\n", index->Name().c_str(),
+           keys.size(), base->Memory().size(), index->Memory().size());
+    TERARK_VERIFY_GT(index->Memory().size(), base->Memory().size());
+    TERARK_VERIFY_EQ(index->Memory().size(), mphf_mem.size());
+
+    std::vector<std::string> queries = gen_queries(rng, keys, 5000);
+    auto ctx = GetTlsTerarkContext();
+    for (auto& q : queries) {
+        TERARK_VERIFY_EQ(index->Find(q, ctx), base->Find(q, ctx));
+    }
+    valvec<fstring> qv(queries.size(), valvec_reserve());
+    for (auto& q : queries)
+        qv.push_back(q);
+    valvec<size_t> ids(qv.size());
+    index->FindBatch(qv.data(), qv.size(), ids.data(), ctx);
+    for (size_t i = 0; i < qv.size(); ++i) {
+        TERARK_VERIFY_EQ(ids[i], base->Find(qv[i], ctx));
+    }
+    for (size_t i = 0; i < keys.size(); ++i) {
+        TERARK_VERIFY_LT(index->Find(keys[i], ctx), keys.size());
+    }
+
+    // reload from a copy, sections must survive SaveMmap
+    valvec<byte_t> saved;
+    index->SaveMmap([&](const void* data, size_t len) {
+        saved.append((const byte_t*)data, len);
+    });
+    TERARK_VERIFY_EQ(saved.size(), mphf_mem.size());
+    std::unique_ptr<TerarkIndex> reloaded = TerarkIndex::LoadMemory(saved);
+    for (auto& q : queries) {
+        TERARK_VERIFY_EQ(reloaded->Find(q, ctx), base->Find(q, ctx));
+    }
+}
+
+int main() {
+    std::mt19937_64 rng(12345);
+    SortableStrVec keys = gen_user_keys(rng, 50000);
+    check_mphf(keys, false, rng);
+
+    // long tails after short distinguishing prefixes are kept in a suffix,
+    // a fingerprint match must also be checked against the suffix
+    SortableStrVec tail_keys;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        std::string key = keys[i].str() + "/";
+        for (size_t j = 0; j < 16; ++j)
+            key.push_back('0' + rng() % 10);
+        tail_keys.push_back(key);
+    }
+    check_mphf(tail_keys, true, rng);
+
+    // fingerprint and id bits must fit in a slot
+    TerarkIndexOptions opt;
+    opt.mphfFingerprintBits = uint8_t(TerarkIndexMphf::MaxFingerprintBits(keys.size()) + 1);
+    valvec<byte_t> mem;
+    bool thrown = false;
+    try {
+        build_index(keys, opt, mem);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    TERARK_VERIFY(thrown);
+    printf("passed\n");
+    return 0;
+}
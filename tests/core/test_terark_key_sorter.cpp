@@ -0,0 +1,96 @@
+#include <terark/idx/terark_zip_index.hpp>
+#include <terark/entropy/entropy_base.hpp>
+#include <terark/util/throw.hpp>
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+#include <stdio.h>
+
+using namespace terark;
+
+static std::vector<std::string> gen_keys(size_t num, bool unique) {
+    std::mt19937_64 rng(num);
+    std::set<std::string> uniq;
+    std::vector<std::string> keys;
+    while (keys.size() < num) {
+        std::string key = "key/";
+        size_t len = rng() % 20;
+        for (size_t j = 0; j < len; ++j)
+            key.push_back('a' + rng() % (j < 2 ? 3 : 26));
+        if (!unique || uniq.insert(key).second)
+            keys.push_back(key);
+    }
+    return keys;
+}
+
+static std::unique_ptr<TerarkKeyReader>
+sort_keys(const std::vector<std::string>& keys, size_t memory, size_t threads,
+          size_t* runs, TerarkIndex::KeyStat* ks) {
+    TerarkIndexOptions opt;
+    opt.localTempDir = "/tmp";
+    opt.smallTaskMemory = memory;
+    opt.keySortThreads = threads;
+    TerarkKeySorter sorter(opt);
+    for (auto& key : keys)
+        sorter.Add(key);
+    *runs = sorter.NumRuns();
+    return std::unique_ptr<TerarkKeyReader>(sorter.Finish(ks));
+}
+
+static void check_sorted(std::vector<std::string> keys, size_t memory,
+                         size_t threads = 1) {
+    size_t runs = 0;
+    TerarkIndex::KeyStat ks;
+    auto reader = sort_keys(keys, memory, threads, &runs, &ks);
+    std::sort(keys.begin(), keys.end());
+    size_t sumKeyLen = 0;
+    for (auto& key : keys)
+        sumKeyLen += key.size();
+    printf("memory = %7zd, threads = %zd, keys = %6zd, runs = %4zd\n",
+           memory, threads, keys.size(), runs);
+    TERARK_VERIFY_EQ(ks.keyCount, keys.size());
+    TERARK_VERIFY_EQ(ks.sumKeyLen, sumKeyLen);
+    TERARK_VERIFY(fstring(ks.minKey) == keys.front());
+    TERARK_VERIFY(fstring(ks.maxKey) == keys.back());
+    for (int pass = 0; pass < 2; ++pass) {
+        reader->rewind();
+        for (auto& key : keys) {
+            TERARK_VERIFY(reader->next() == key);
+        }
+    }
+}
+
+int main() {
+    auto dupKeys = gen_keys(30000, false);
+    check_sorted(dupKeys, 1 << 30);  // in memory
+    check_sorted(dupKeys, 64 << 10); // a few runs
+    check_sorted(dupKeys, 4 << 10);  // more runs than the merge fan-in
+    check_sorted(dupKeys, 64 << 10, 4);
+    dupKeys.push_back(std::string(8 << 10, 'k')); // exceeds the memory
+    check_sorted(dupKeys, 4 << 10);
+
+    // build an index from the merged runs
+    auto keys = gen_keys(20000, true);
+    size_t runs = 0;
+    TerarkIndex::KeyStat ks;
+    auto reader = sort_keys(keys, 32 << 10, 1, &runs, &ks);
+    TERARK_VERIFY_GT(runs, 1u);
+    TerarkIndexOptions opt;
+    std::unique_ptr<TerarkIndex> index(
+        TerarkIndex::Factory::Build(reader.get(), opt, ks, NULL));
+    TERARK_VERIFY_EQ(index->NumKeys(), keys.size());
+    auto ctx = GetTlsTerarkContext();
+    std::vector<bool> found(keys.size());
+    for (auto& key : keys) {
+        size_t id = index->Find(key, ctx);
+        TERARK_VERIFY_LT(id, keys.size());
+        TERARK_VERIFY(!found[id]);
+        found[id] = true;
+    }
+    printf("%s, keys = %zd, runs = %zd\n", index->Name().c_str(), keys.size(), runs);
+    printf("passed\n");
+    return 0;
+}
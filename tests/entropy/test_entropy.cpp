@@ -1,6 +1,9 @@
 
 #include <memory>
+#include <random>
 #include <terark/entropy/huffman_encoding.hpp>
+#include <terark/entropy/rans_encoding.hpp>
+#include <terark/util/cpu_features.hpp>
 
 using namespace terark;
 
@@ -43,6 +46,92 @@ int BUG_Huffman_decoder_2() {
     return 0;
 }
 
+int rANS_x32_round_trip() {
+    using namespace rANS_static_64;
+    std::mt19937 rand(42);
+    std::string sample;
+    for (size_t i = 0; i < 1000000; ++i) {
+        // skewed text-like distribution, all bytes present
+        sample.push_back(i % 997 == 0 ? char(i % 256) : char('a' + rand() % 7 * rand() % 26));
+    }
+    freq_hist h;
+    h.add_record(sample);
+    h.finish();
+    h.normalise(NORMALISE);
+    encoder e(h.histogram());
+    decoder d(e.table());
+    for (size_t len : {0, 1, 31, 32, 33, 127, 1000, 65536, 1000000}) {
+        fstring raw(sample.data(), len);
+        auto encoded = e.encode_x32(raw, GetTlsTerarkContext());
+        valvec<byte_t> record;
+        size_t read = d.decode_x32(encoded.data, &record);
+        if (read != size_t(encoded.data.size())) {
+            return -1;
+        }
+        if (record != raw) {
+            return -2;
+        }
+        if (len >= 1000 && d.decode_x32(encoded.data.substr(0, encoded.data.size() - 2),
+                                        &record) != 0) {
+            return -3; // truncated
+        }
+        // scalar fallback on avx2 hosts must read the same stream
+        const CpuFeatures saved = g_cpu_features;
+        g_cpu_features.avx2 = false;
+        valvec<byte_t> scalar;
+        size_t scalar_read = d.decode_x32(encoded.data, &scalar);
+        g_cpu_features = saved;
+        if (scalar_read != read || scalar != record) {
+            return -5;
+        }
+    }
+    auto x8 = e.encode_x8(fstring(sample.data(), 1000), GetTlsTerarkContext());
+    valvec<byte_t> record;
+    if (x8.data[0] != 0xA5 && d.decode_x32(x8.data, &record) != 0) {
+        return -4; // not a x32 stream
+    }
+    return 0;
+}
+
+int Huffman_o1_compact_round_trip() {
+    using namespace Huffman;
+    std::mt19937 rand(7);
+    std::string sample;
+    for (size_t i = 0; i < 200000; ++i) {
+        // mostly short codes, plus rare bytes to get codes longer than LUT_BITS
+        sample.push_back(i % 331 == 0 ? char(rand() % 256) : char('a' + rand() % 5 * rand() % 26));
+    }
+    freq_hist_o1 h;
+    h.add_record(sample);
+    h.finish();
+    h.normalise(NORMALISE);
+    encoder_o1 e(h.histogram());
+    std::unique_ptr<decoder_o1> d(new decoder_o1(e.table()));
+    std::unique_ptr<decoder_o1_compact> c(new decoder_o1_compact(e.table()));
+    if (sizeof(decoder_o1_compact) * 4 > sizeof(decoder_o1)) {
+        return -1;
+    }
+    auto ctx = GetTlsTerarkContext();
+    for (size_t len : {1, 2, 7, 8, 9, 100, 1000, 65536}) {
+        for (size_t pos = 0; pos + len <= sample.size(); pos += 40000 + len) {
+            fstring raw(sample.data() + pos, len);
+            valvec<byte_t> r1, r2;
+#define CHECK_XN(X) {                                                          \
+            auto encoded = e.encode_##X(raw, ctx);                              \
+            if (!d->decode_##X(encoded.data, &r1, ctx) || r1 != raw) {          \
+                return -2;                                                      \
+            }                                                                   \
+            if (!c->decode_##X(encoded.data, &r2, ctx) || r2 != raw) {          \
+                return -3;                                                      \
+            }                                                                   \
+        }
+            CHECK_XN(x1) CHECK_XN(x2) CHECK_XN(x4) CHECK_XN(x8)
+#undef CHECK_XN
+        }
+    }
+    return 0;
+}
+
 int main(int argc, char* argv[]) {
     if (BUG_Huffman_decoder() != 0) {
         return -1;
@@ -50,6 +139,14 @@ int main(int argc, char* argv[]) {
     if (BUG_Huffman_decoder_2() != 0) {
         return -1;
     }
+    if (int err = rANS_x32_round_trip()) {
+        fprintf(stderr, "rANS_x32_round_trip failed: %d\n", err);
+        return -1;
+    }
+    if (int err = Huffman_o1_compact_round_trip()) {
+        fprintf(stderr, "Huffman_o1_compact_round_trip failed: %d\n", err);
+        return -1;
+    }
     return 0;
 }
 
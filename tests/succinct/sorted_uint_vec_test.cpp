@@ -115,10 +115,65 @@ void unit_test_binary_search() {
     printf("done unit_test_binary_search!\n");
 }
 
+void unit_test_elias_fano() {
+    std::mt19937_64 random(1);
+    valvec<size_t> truth;
+    size_t curVal = 0;
+    for (size_t i = 0; i < 3000; ++i) {
+        size_t r = random();
+        switch (i / 500) {
+        default: curVal += r % 300; break;
+        case 1:  curVal += 17; break;   // all diffs equal
+        case 2:  break;                 // all values equal
+        case 3:  curVal += r % 16 == 1 ? r % (1ull << 40) : r % 4; break;
+        }
+        truth.push_back(curVal);
+    }
+    for (size_t units : {64, 128}) {
+      for (size_t n : {1, 2, 63, 64, 65, 129, 3000}) {
+        SortedUintVec ef;
+        std::unique_ptr<SortedUintVec::Builder>
+            builder(SortedUintVec::createBuilder(units | SortedUintVec::kEliasFano));
+        for (size_t i = 0; i < n; ++i) builder->push_back(truth[i]);
+        builder->finish(&ef);
+        TERARK_VERIFY(ef.is_elias_fano());
+        TERARK_VERIFY_EQ(ef.build_units(), units | SortedUintVec::kEliasFano);
+        // readers without elias fano accept only log2_blockUnits 6 or 7
+        size_t log2_blockUnits = (unaligned_load<uint64_t>(ef.data()) >> 48) & 15;
+        TERARK_VERIFY(6 != log2_blockUnits && 7 != log2_blockUnits);
+        SortedUintVec loaded;
+        loaded.risk_set_data(ef.data(), ef.mem_size());
+        TERARK_VERIFY(loaded.is_elias_fano());
+        for (size_t i = 0; i + 1 < n; ++i) {
+            size_t z[2];
+            loaded.get2(i, z);
+            TERARK_VERIFY_EQ(z[0], truth[i]);
+            TERARK_VERIFY_EQ(z[1], truth[i+1]);
+        }
+        TERARK_VERIFY_EQ(loaded.get(n-1), truth[n-1]);
+        size_t block[128];
+        for (size_t b = 0; b < loaded.num_blocks(); ++b) {
+            loaded.get_block(b, block);
+            for (size_t j = 0; j < units && b*units + j < n; ++j) {
+                TERARK_VERIFY_EQ(block[j], truth[b*units + j]);
+            }
+        }
+        for (size_t i = 0; i < n; i += 7) {
+            size_t k = truth[i] + i % 2;
+            TERARK_VERIFY_EQ(loaded.lower_bound(0, n, k), lower_bound_n(truth, 0, n, k));
+            TERARK_VERIFY_EQ(loaded.upper_bound(0, n, k), upper_bound_n(truth, 0, n, k));
+        }
+        loaded.risk_release_ownership();
+      }
+    }
+    printf("done unit_test_elias_fano!\n");
+}
+
 int main(int argc, char* argv[]) {
 	unit_test_bug1();
 	unit_test_small();
 	unit_test_binary_search();
+	unit_test_elias_fano();
 	size_t groupSize = 200;
 	if (argc >= 2) {
 		groupSize = atoi(argv[1]);
@@ -210,9 +265,13 @@ int main(int argc, char* argv[]) {
 			}
 		}
 	}
+	size_t blockUnits = 128;
+	if (getEnvBool("elias_fano", false)) {
+		blockUnits |= SortedUintVec::kEliasFano;
+	}
 	SortedUintVec szipVals;
 	std::unique_ptr<SortedUintVec::Builder>
-		builder(SortedUintVec::createBuilder(mustSorted, 128, fname));
+		builder(SortedUintVec::createBuilder(mustSorted, blockUnits, fname));
 	for (size_t i = 0; i < trueVals.size(); ++i) {
 		builder->push_back(trueVals[i]);
 	}
@@ -278,7 +337,7 @@ int main(int argc, char* argv[]) {
 	printf("random raw: time = %12.3f sec, avg = %8.1f ns, QPS = %8.3f M/sec, sum = %016llX\n"
 		, pf.mf(t1,t2), pf.nf(t1,t2)/(n*loop), (n*loop)/pf.uf(t1,t2), usum);
 
-    size_t blockUnits = size_t(1) << szipVals.log2_block_units();
+    blockUnits = szipVals.block_units();
     valvec<size_t> buf(blockUnits);
     long long xsum = 0;
     zsum = 0;
@@ -1,6 +1,8 @@
 #include <inttypes.h>
 
+#include <memory>
 #include <random>
+#include <stdexcept>
 #include <string>
 #include <terark/fsa/crit_bit_trie.hpp>
 using namespace terark;
@@ -69,6 +71,44 @@ void test(std::vector<std::string>& rand_string,
   fstrvec bounds;
   CritBitTriePacked* cbt_pack = packed_builder.newcbt();
   packed_builder.get_bounds(false, &bounds);
+
+  // parallel build must produce the same bytes
+  CritBitTriePackedBuilder parallel_builder(rand_string.size(), pack, 0, false,
+                                            0);
+  size_t next_pos = 0;
+  parallel_builder.build([&]() { return fstring(rand_string[next_pos++]); }, 4);
+  std::unique_ptr<CritBitTriePacked> parallel_pack(parallel_builder.newcbt());
+  std::string serial_mem, parallel_mem;
+  cbt_pack->save([&](const void* data, size_t size) {
+    serial_mem.append((const char*)data, size);
+  });
+  parallel_pack->save([&](const void* data, size_t size) {
+    parallel_mem.append((const char*)data, size);
+  });
+  if (serial_mem != parallel_mem) {
+    printf("parallel build mismatch\n");
+    exit(1);
+  }
+  // a throwing key source must not leave workers joinable
+  if (rand_string.size() > 2 * pack) {
+    CritBitTriePackedBuilder failed_builder(rand_string.size(), pack, 0, false,
+                                            0);
+    size_t fail_pos = 0;
+    bool thrown = false;
+    try {
+      failed_builder.build([&]() {
+        if (fail_pos == rand_string.size() / 2)
+          throw std::runtime_error("key source failed");
+        return fstring(rand_string[fail_pos++]);
+      }, 4);
+    } catch (const std::runtime_error&) {
+      thrown = true;
+    }
+    if (!thrown) {
+      printf("exception in build is lost\n");
+      exit(1);
+    }
+  }
   // printf("succient :");
   // for (size_t i = 0; i < cbt.encoded_trie_.size(); ++i) {
   //   printf("%d ", cbt.encoded_trie_.is0(i) ? 0 : 1);
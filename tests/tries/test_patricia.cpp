@@ -2,10 +2,176 @@
 // Created by leipeng on 2020/7/15.
 //
 #include <terark/fsa/cspptrie.hpp>
+#include <atomic>
+#include <random>
 #include <set>
+#include <thread>
 
 using namespace terark;
 
+// keys make fast nodes(>= 64 children) at root, "a".."h" and "a0".."b1",
+// chains through them, final and non-final inner nodes
+static std::vector<std::string> stress_keys() {
+  std::vector<std::string> keys;
+  keys.push_back("");
+  for (int c1 = 0; c1 < 8; c1++) {
+    std::string k1(1, char('a' + c1));
+    keys.push_back(k1);
+    for (int c2 = 0; c2 < 80; c2++) {
+      std::string k2 = k1 + char('0' + c2);
+      if (c2 % 3 == 0)
+        keys.push_back(k2);
+      keys.push_back(k2 + "/chain/tail");
+      if (c1 < 2 && c2 < 2) {
+        for (int c3 = 0; c3 < 70; c3++)
+          keys.push_back(k2 + char(' ' + c3) + "x");
+      }
+    }
+  }
+  return keys;
+}
+
+// writers repeatedly fill and drain their own part of keys, so fast nodes
+// and chains are emptied and pruned, while readers iterate and lookup
+static void erase_stress(Patricia::ConcurrentLevel level, int nWriters, int nReaders) {
+  const auto keys = stress_keys();
+  std::unique_ptr<Patricia> trie(Patricia::create(sizeof(size_t), 16<<20, level));
+  std::vector<std::set<size_t> > owned(nWriters);
+  std::atomic<int> running_writers(nWriters);
+  auto writer = [&](int tid) {
+    std::mt19937_64 rng(tid);
+    std::vector<size_t> mine;
+    for (size_t i = tid; i < keys.size(); i += nWriters)
+      mine.push_back(i);
+    auto& myset = owned[tid];
+    auto wtok = trie->tls_writer_token_nn();
+    size_t ops = 0;
+    auto insert = [&](size_t i) {
+      if (++ops % 64 == 0) { wtok->idle(); wtok->acquire(trie.get()); }
+      TERARK_VERIFY(trie->insert(keys[i], &i, wtok));
+      TERARK_VERIFY(NULL != wtok->value());
+      TERARK_VERIFY_EQ(aligned_load<size_t>(wtok->value()), i);
+      myset.insert(i);
+    };
+    auto erase = [&](size_t i) {
+      if (++ops % 64 == 0) { wtok->idle(); wtok->acquire(trie.get()); }
+      TERARK_VERIFY(trie->erase(keys[i], wtok));
+      TERARK_VERIFY(!trie->erase(keys[i], wtok));
+      myset.erase(i);
+    };
+    wtok->acquire(trie.get());
+    for (int round = 0; round < 30; round++) {
+      std::shuffle(mine.begin(), mine.end(), rng);
+      for (size_t i : mine)
+        if (!myset.count(i)) insert(i); // some are kept by last round
+      std::shuffle(mine.begin(), mine.end(), rng);
+      for (size_t j = 0; j < mine.size() / 2; j++) erase(mine[j]);
+      for (size_t j = 0; j < mine.size() / 2; j++) insert(mine[j]);
+      std::shuffle(mine.begin(), mine.end(), rng);
+      size_t keep = round % 3 == 0 ? rng() % mine.size() : 0;
+      for (size_t j = keep; j < mine.size(); j++) erase(mine[j]);
+    }
+    wtok->release();
+    running_writers--;
+  };
+  auto reader = [&](int tid) {
+    std::mt19937_64 rng(100 + tid);
+    Patricia::IteratorPtr iter(trie->new_iter());
+    auto rtok = trie->tls_reader_token();
+    while (running_writers > 0) {
+      if (iter->seek_begin()) {
+        std::string prev;
+        bool first = true;
+        do {
+          size_t i = aligned_load<size_t>(iter->value());
+          TERARK_VERIFY_LT(i, keys.size());
+          TERARK_VERIFY(iter->word() == keys[i]);
+          TERARK_VERIFY(first || prev < keys[i]);
+          prev = keys[i];
+          first = false;
+        } while (iter->incr());
+      }
+      iter->idle();
+      rtok->acquire(trie.get());
+      for (int j = 0; j < 64; j++) {
+        size_t i = rng() % keys.size();
+        if (rtok->lookup(keys[i]))
+          TERARK_VERIFY_EQ(aligned_load<size_t>(rtok->value()), i);
+      }
+      rtok->release();
+    }
+    iter->release();
+  };
+  std::vector<std::thread> threads;
+  for (int i = 0; i < nWriters; i++) threads.emplace_back(writer, i);
+  for (int i = 0; i < nReaders; i++) threads.emplace_back(reader, i);
+  for (auto& t : threads) t.join();
+
+  std::set<std::string> expected;
+  for (auto& myset : owned)
+    for (size_t i : myset) expected.insert(keys[i]);
+  trie->sync_stat();
+  TERARK_VERIFY_EQ(trie->num_words(), expected.size());
+  Patricia::IteratorPtr iter(trie->new_iter());
+  auto it = expected.begin();
+  for (bool ok = iter->seek_begin(); ok; ok = iter->incr(), ++it) {
+    TERARK_VERIFY(it != expected.end());
+    TERARK_VERIFY(iter->word() == *it);
+  }
+  TERARK_VERIFY(it == expected.end());
+  iter->idle();
+  auto wtok = trie->tls_writer_token_nn();
+  wtok->acquire(trie.get());
+  for (auto& key : expected) {
+    TERARK_VERIFY(trie->erase(key, wtok));
+  }
+  wtok->release();
+  trie->sync_stat();
+  TERARK_VERIFY_EQ(trie->num_words(), 0);
+  TERARK_VERIFY(!iter->seek_begin());
+  iter->release();
+  printf("erase_stress(level = %d, writers = %d, readers = %d) passed\n",
+         int(level), nWriters, nReaders);
+}
+
+// with a fixed capacity, erase which must copy a node fails as insert does:
+// returns true and token->value() is NULL, the key is kept
+static void erase_mem_limit() {
+  std::unique_ptr<Patricia> trie(
+      Patricia::create(sizeof(size_t), 64<<10, Patricia::OneWriteMultiRead));
+  auto wtok = trie->tls_writer_token_nn();
+  auto rtok = trie->tls_reader_token();
+  wtok->acquire(trie.get());
+  std::vector<std::string> keys;
+  for (size_t i = 0; ; i++) {
+    std::string key = "k" + std::to_string(i * 7919 % 100003);
+    if (!trie->insert(key, &i, wtok)) continue;
+    if (NULL == wtok->value()) break; // reached memory limit
+    keys.push_back(key);
+  }
+  trie->sync_stat();
+  size_t num_words = trie->num_words();
+  TERARK_VERIFY_EQ(num_words, keys.size());
+  size_t n_fail = 0;
+  for (auto& key : keys) {
+    TERARK_VERIFY(trie->erase(key, wtok));
+    if (NULL == wtok->value()) {
+      n_fail++;
+      rtok->acquire(trie.get());
+      TERARK_VERIFY(rtok->lookup(key));
+      rtok->release();
+    } else {
+      num_words--;
+    }
+  }
+  TERARK_VERIFY_GT(n_fail, 0);
+  wtok->release();
+  trie->sync_stat();
+  TERARK_VERIFY_EQ(trie->num_words(), num_words);
+  printf("erase_mem_limit: %zd keys, %zd erase hit memory limit, passed\n",
+         keys.size(), n_fail);
+}
+
 int main() {
   std::unique_ptr<Patricia> trie(
       Patricia::create(sizeof(void*), 4<<20, Patricia::MultiWriteMultiRead));
@@ -107,5 +273,11 @@ int main() {
   wtok->release();
   iter->dispose();
 
+  erase_stress(Patricia::SingleThreadStrict, 1, 0);
+  erase_stress(Patricia::SingleThreadShared, 1, 0);
+  erase_stress(Patricia::OneWriteMultiRead, 1, 2);
+  erase_stress(Patricia::MultiWriteMultiRead, 3, 2);
+  erase_mem_limit();
+
   return 0;
 }
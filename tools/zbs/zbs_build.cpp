@@ -541,7 +541,7 @@ GetoptDone:
     else if (select_store == 'e') {
       EntropyZipBlobStore::MyBuilder ezbuilder(
           *freq.get(), dzopt.offsetArrayBlockUnits, nlt_fname, 0, checksumLevel,
-          checksumType, true);
+          checksumType, true, dzopt.entropyTableCompact);
       for (size_t i = 0, ei = strVec.size(); i < ei; ++i) {
             ezbuilder.addRecord(strVec[i]);
         }